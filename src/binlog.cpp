@@ -15,6 +15,7 @@
 #include "memio.h"
 
 static constexpr int BINLOG_WRITE_BUFFER = 256*1024;
+static constexpr int64_t BINLOG_REPLAY_BATCH = 64*1024*1024; // how many bytes of decoded txns to accumulate before parallel apply
 static constexpr int64_t BINLOG_AUTO_FLUSH = 1000000; // 1 sec
 
 static constexpr DWORD		BINLOG_HEADER_MAGIC_SPBL = 0x4c425053;	/// magic 'SPBL' header that marks binlog file
@@ -72,6 +73,22 @@ struct BinlogReplayFileDesc_t
 	CSphVector<BinlogIndexReplayInfo_t> m_dIndexInfos;
 };
 
+/// txn decoded from binlog (crc and tid already checked), waiting to be applied to its table
+struct BinlogReplayTxn_t
+{
+	CSphVector<BYTE>	m_dData;		///< txn payload, starting from txn op
+	int64_t				m_iTID = 0;
+	int64_t				m_iTxnPos = 0;	///< purely for reporting
+};
+
+/// decoded txns of one binlog file, grouped by table id (same as in BinlogReplayFileDesc_t)
+/// tables are independent, so they're applied in parallel; txns of one table - sequentially, in TID order
+struct BinlogReplayBatch_t
+{
+	CSphVector<CSphVector<BinlogReplayTxn_t>>	m_dTables;
+	int64_t										m_iBytes = 0;
+};
+
 
 class BinlogWriter_c final : public MemoryWriter2_c
 {
@@ -82,6 +99,14 @@ public:
 	bool			Write ( bool bRemoveUnsuccessful = true );
 	bool			Fsync();
 	int64_t			GetFilePos() const noexcept			{ return m_iLastFilePos; }
+	void			DiscardUnwritten();
+
+	// monotonic position in the stream of all txns ever passed through this writer (not reset on file reopen)
+	int64_t			GetStreamPos() const noexcept		{ return m_iStreamConsumed + m_dBuf.GetLength(); }
+	int64_t			GetStreamWritten() const noexcept	{ return m_iStreamConsumed; }
+	int				DupFD() const;
+	int				GetFileGen() const noexcept			{ return m_iFileGen; }
+	void			MarkSynced ( int iFileGen, int64_t iFilePos );
 
 	bool			OpenFile ( const CSphString & sFile, CSphString & sError );
 	void			CloseFile();
@@ -109,6 +134,25 @@ private:
 	int64_t			m_iLastFilePos = 0;
 	int64_t			m_iLastFsyncPos = 0;
 	int				m_iLastTransactionStartPos = 0;
+	int64_t			m_iStreamConsumed = 0;	///< bytes either written or discarded over the whole writer lifetime
+	int				m_iFileGen = 0;			///< bumped on every OpenFile(), to tell whether a file pos still refers to the current file
+};
+
+
+/// reads txn payload already fetched from binlog into memory
+class BinlogTxnReader_c final : public CSphReader
+{
+public:
+	explicit BinlogTxnReader_c ( CSphVector<BYTE> & dData )
+		: CSphReader ( dData.Begin(), dData.GetLength() )
+	{
+		m_iBuffUsed = dData.GetLength();
+	}
+
+	bool IsConsumed() const { return m_iBuffPos==m_iBuffUsed; }
+
+protected:
+	void UpdateCache() final { m_iBuffPos = m_iBuffUsed; } // nothing beyond payload, so read past it will flag error
 };
 
 
@@ -153,6 +197,12 @@ class SingleBinlog_c final
 	BinlogWriter_c m_tWriter GUARDED_BY ( m_tWriteAccess );
 	CSphVector<BinlogFileDesc_t> m_dLogFiles GUARDED_BY ( m_tWriteAccess ); // active log files
 
+	// group commit (binlog_flush=1): one leader writes and syncs all the txns accumulated so far, others just wait
+	Threads::Coro::Mutex_c m_tFlushAccess;
+	std::atomic<int64_t> m_iSyncedPos { 0 };	// writer stream pos, up to which everything is on disk
+	CSphVector<std::pair<int64_t, int64_t>> m_dFailedGroups GUARDED_BY ( m_tFlushAccess ); // stream ranges which failed to write or sync
+	std::atomic<int> m_iWaiting { 0 };			// txns appended, but not yet through GroupSync; failed ranges may be dropped once there are none
+
 public:
 	NONCOPYMOVABLE( SingleBinlog_c );
 
@@ -164,7 +214,8 @@ public:
 
 	void DoFlush ( OnCommitAction_e eAction ) EXCLUDES ( m_tWriteAccess );
 	void CollectBinlogFiles ( CSphVector<int>& tOutput ) const noexcept REQUIRES ( m_tWriteAccess );
-	bool BinlogCommit ( int64_t * pTID, const char* szIndexName, FnWriteCommit fnSaver, CSphString & sError ) EXCLUDES ( m_tWriteAccess );
+	bool BinlogCommit ( int64_t * pTID, const char* szIndexName, FnWriteCommit fnSaver, int64_t * pSyncPos, CSphString & sError ) EXCLUDES ( m_tWriteAccess, m_tFlushAccess );
+	bool GroupSync ( int64_t iTxnEnd, CSphString & sError ) EXCLUDES ( m_tWriteAccess, m_tFlushAccess );
 	void NotifyIndexFlush ( int64_t iFlushedTID, const char * szIndexName, bool bShutdown, bool bForceSave ) EXCLUDES ( m_tWriteAccess );
 	void AdoptIndex ( int iExt, const BinlogIndexInfo_t & tIdx ) REQUIRES ( m_tWriteAccess );
 	void AdoptFile ( int iExt ) REQUIRES ( m_tWriteAccess );
@@ -173,7 +224,11 @@ public:
 
 private:
 	void RemoveLastEmptyLog () REQUIRES ( m_tWriteAccess );
+	bool DoGroupSync ( int64_t iTxnEnd, CSphString & sError ) REQUIRES ( m_tFlushAccess ) EXCLUDES ( m_tWriteAccess );
+	bool IsGroupFailed ( int64_t iTxnEnd ) const REQUIRES ( m_tFlushAccess );
+	void UpdateSyncedPos ( int64_t iPos ) noexcept;
 	int GetWriteIndexID ( const char * szIndexName, int64_t iTID ) REQUIRES ( m_tWriteAccess );
+	bool AppendTxn ( int64_t * pTID, const char * szIndexName, FnWriteCommit fnSaver, bool bGroupCommit, int64_t & iTxnEnd, CSphString & sError ) REQUIRES ( m_tWriteAccess );
 	void DoCacheWrite () REQUIRES ( m_tWriteAccess );
 	void CheckDoRestart () REQUIRES ( m_tWriteAccess );
 	bool CheckDoFlush () REQUIRES ( m_tWriteAccess );
@@ -190,7 +245,8 @@ public:
 			~Binlog_c();
 
 	void	NotifyIndexFlush ( int64_t iTID, const char * szIndexName, bool bShutdown, bool bForceSave );
-	bool	BinlogCommit ( int64_t * pTID, const char * szIndexName, FnWriteCommit fnSaver, CSphString & sError );
+	bool	BinlogCommit ( int64_t * pTID, const char * szIndexName, FnWriteCommit fnSaver, int64_t * pSyncPos, CSphString & sError );
+	void	WaitSynced ( const char * szIndexName, int64_t iSyncPos );
 
 	void	Configure ( const CSphConfigSection & hSearchd, DWORD uReplayFlags );
 	void	SetCommon ( bool bCommonBinlog );
@@ -198,11 +254,14 @@ public:
 
 	bool	IsActive () const { return !m_bDisabled; }
 	bool 	MockDisabled ( bool bNewVal );
+	bool	MockSyncFailure ( bool bNewVal ) { return std::exchange ( m_bMockSyncFailure, bNewVal ); }
+	int64_t	GetGroupSyncs() const noexcept { return m_iGroupSyncs.load ( std::memory_order_relaxed ); }
 	void	CheckAndSetPath ( CSphString sBinlogPath );
 
 	bool	IsFlushingEnabled() const;
 	void	DoFlush (); // invoked by task binlog flush, every BINLOG_AUTO_FLUSH (1 sec)
 	int64_t	NextFlushingTime() const noexcept;
+	bool	IsGroupCommit() const noexcept { return m_eOnCommit==ACTION_FSYNC; }
 
 	inline CSphString GetLogPath() const noexcept { return m_sLogPath; }
 	int64_t LastTidFor ( const CSphString & sIndex ) const noexcept EXCLUDES ( m_tHashAccess );
@@ -212,6 +271,9 @@ private:
 	int64_t					m_iFlushPeriod = BINLOG_AUTO_FLUSH;
 
 	OnCommitAction_e		m_eOnCommit { ACTION_NONE };
+	int						m_iGroupCommitWindowMs = 0; // how long the group commit leader waits for followers; searchd.binlog_group_commit_window
+	std::atomic<int64_t>	m_iGroupSyncs {0};			// fsyncs issued by group commit leaders
+	bool					m_bMockSyncFailure = false;	// tests only: group fsync fails
 
 	mutable Threads::Coro::RWLock_c m_tHashAccess;
 	SmallStringHash_T<SingleBinlogPtr> m_hBinlogs GUARDED_BY ( m_tHashAccess );
@@ -248,7 +310,9 @@ private:
 	void					RemoveFile ( int iExt );
 
 	BinlogFileState_e		ReplayBinlog ( BinlogReplayFileDesc_t & tLog, const SmallStringHash_T<CSphIndex*> & hIndexes );
-	bool					ReplayTxn ( const BinlogReplayFileDesc_t & tLog, BinlogReader_c & tReader ) const;
+	bool					ReplayTxn ( const BinlogReplayFileDesc_t & tLog, BinlogReader_c & tReader, BinlogReplayBatch_t & tBatch ) const;
+	bool					ApplyReplayBatch ( const BinlogReplayFileDesc_t & tLog, BinlogReplayBatch_t & tBatch ) const;
+	bool					ApplyTableTxns ( BinlogIndexReplayInfo_t & tIndex, VecTraits_T<BinlogReplayTxn_t> dTxns ) const;
 	bool					ReplayIndexAdd ( BinlogReplayFileDesc_t & tLog, const SmallStringHash_T<CSphIndex*> & hIndexes, BinlogReader_c & tReader ) const;
 	bool					ReplayCacheAdd ( const BinlogReplayFileDesc_t & tLog, DWORD uVersion, BinlogReader_c & tReader ) const;
 	bool 					IsBinlogWritable () const noexcept;
@@ -275,6 +339,7 @@ inline const char * SzTxnName ( Txn_e eTxn )
 	case COMMIT: return "commit";
 	case PQ_ADD_DELETE: return "pq_add_delete";
 	}
+	return "unknown";
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -351,6 +416,7 @@ bool BinlogWriter_c::Write ( bool bRemoveUnsuccessful )
 			// remove last transaction from memory buffer
 			// other unwritten transactions may still be in the buffer, but we can't tell the daemon that they failed at this point,
 			// so we remove only the last one
+			m_iStreamConsumed += m_dBuf.GetLength() - m_iLastTransactionStartPos;
 			m_dBuf.Resize ( m_iLastTransactionStartPos );
 		}
 
@@ -358,11 +424,38 @@ bool BinlogWriter_c::Write ( bool bRemoveUnsuccessful )
 	}
 
 	m_iLastFilePos += m_dBuf.GetLength ();
+	m_iStreamConsumed += m_dBuf.GetLength ();
 	m_iLastTransactionStartPos = 0;
 	m_dBuf.Resize(0);
 	return true;
 }
 
+
+// drop everything not yet written (used by group commit, when the whole group failed)
+void BinlogWriter_c::DiscardUnwritten()
+{
+	m_iStreamConsumed += m_dBuf.GetLength ();
+	m_iLastTransactionStartPos = 0;
+	m_dBuf.Resize ( 0 );
+}
+
+
+// returns independent descriptor of the current file, which survives CloseFile(), or -1 if no file is open
+int BinlogWriter_c::DupFD() const
+{
+	if ( !IsOpen() )
+		return -1;
+	return ::dup ( m_tFile.GetFD() );
+}
+
+
+// file was synced up to iFilePos outside of the writer (via DupFD); no need to sync that part again on flush
+void BinlogWriter_c::MarkSynced ( int iFileGen, int64_t iFilePos )
+{
+	if ( iFileGen==m_iFileGen )
+		m_iLastFsyncPos = Max ( m_iLastFsyncPos, iFilePos );
+}
+
 #if _WIN32
 int fsync ( int iFD )
 {
@@ -409,6 +502,7 @@ bool BinlogWriter_c::Fsync()
 bool BinlogWriter_c::OpenFile ( const CSphString & sFile, CSphString & sError )
 {
 	m_iLastFilePos = 0;
+	++m_iFileGen;
 	return m_tFile.Open ( sFile, SPH_O_NEW, sError )>=0;
 }
 
@@ -531,16 +625,39 @@ void SingleBinlog_c::CollectBinlogFiles ( CSphVector<int> & tOutput ) const noex
 }
 
 
-bool SingleBinlog_c::BinlogCommit ( int64_t * pTID, const char * szIndexName, FnWriteCommit fnSaver, CSphString & sError )
+bool SingleBinlog_c::BinlogCommit ( int64_t * pTID, const char * szIndexName, FnWriteCommit fnSaver, int64_t * pSyncPos, CSphString & sError )
 {
 	MEMORY ( MEM_BINLOG );
-	Threads::ScopedCoroMutex_t tLock ( m_tWriteAccess );
+	const bool bGroupCommit = m_pOwner->IsGroupCommit();
+	int64_t iTxnEnd = 0;
+	{
+		Threads::ScopedCoroMutex_t tLock ( m_tWriteAccess );
+		if ( !AppendTxn ( pTID, szIndexName, std::move ( fnSaver ), bGroupCommit, iTxnEnd, sError ) )
+			return false;
+	}
+
+	if ( !bGroupCommit )
+		return true;
+
+	// caller will wait by itself, when out of its own serialization
+	if ( pSyncPos )
+	{
+		*pSyncPos = iTxnEnd;
+		return true;
+	}
 
+	return GroupSync ( iTxnEnd, sError );
+}
+
+
+bool SingleBinlog_c::AppendTxn ( int64_t * pTID, const char * szIndexName, FnWriteCommit fnSaver, bool bGroupCommit, int64_t & iTxnEnd, CSphString & sError )
+{
 	int64_t iTID = ++( *pTID );
 	const int uIndex = GetWriteIndexID ( szIndexName, iTID );
 
 	{
-		BinlogTransactionGuard_c tGuard ( m_tWriter, m_pOwner->m_eOnCommit==ACTION_NONE );
+		// with group commit we don't write immediately, so the buffer may grow while leader syncs; allow partial writes then
+		BinlogTransactionGuard_c tGuard ( m_tWriter, m_pOwner->m_eOnCommit==ACTION_NONE || bGroupCommit );
 
 		// header
 		m_tWriter.PutByte ( Blop_e::ADD_TXN );
@@ -551,9 +668,12 @@ bool SingleBinlog_c::BinlogCommit ( int64_t * pTID, const char * szIndexName, Fn
 		// save txn data
 		fnSaver ( m_tWriter );
 	}
+	iTxnEnd = m_tWriter.GetStreamPos();
+	if ( bGroupCommit )
+		m_iWaiting.fetch_add ( 1, std::memory_order_relaxed );
 
-	// finalize
-	if ( !CheckDoFlush () )
+	// finalize; in group mode it is done later by GroupSync
+	if ( !bGroupCommit && !CheckDoFlush () )
 	{
 		sError.SetSprintf ( "unable to write to binlog: %s", m_tWriter.GetError ().cstr () );
 		return false;
@@ -564,6 +684,110 @@ bool SingleBinlog_c::BinlogCommit ( int64_t * pTID, const char * szIndexName, Fn
 }
 
 
+// wait until txn which ends at iTxnEnd is on disk. If nobody is syncing now, become a leader and sync
+// everything accumulated so far (our txn + txns of everybody who arrived meanwhile) with one write and one fsync.
+bool SingleBinlog_c::GroupSync ( int64_t iTxnEnd, CSphString & sError )
+{
+	Threads::ScopedCoroMutex_t tFlush ( m_tFlushAccess );
+	bool bOk = DoGroupSync ( iTxnEnd, sError );
+
+	// a txn appended from now on ends after any failed range, so with nobody waiting the ranges are of no use
+	if ( m_iWaiting.fetch_sub ( 1, std::memory_order_acq_rel )==1 )
+		m_dFailedGroups.Reset();
+
+	return bOk;
+}
+
+
+bool SingleBinlog_c::DoGroupSync ( int64_t iTxnEnd, CSphString & sError )
+{
+	if ( IsGroupFailed ( iTxnEnd ) )
+	{
+		sError = "unable to write to binlog: group commit failed";
+		return false;
+	}
+
+	// previous leader already synced our txn
+	if ( m_iSyncedPos.load ( std::memory_order_acquire )>=iTxnEnd )
+		return true;
+
+	// give concurrent committers a chance to join the group
+	if ( m_pOwner->m_iGroupCommitWindowMs>0 )
+		Threads::Coro::SleepMsec ( m_pOwner->m_iGroupCommitWindowMs );
+
+	int64_t iGroupStart = m_iSyncedPos.load ( std::memory_order_acquire );
+	int64_t iGroupEnd = 0;
+	int64_t iFilePos = 0;
+	int iFileGen = 0;
+	int iFD = -1;
+	bool bOk = true;
+	{
+		Threads::ScopedCoroMutex_t tLock ( m_tWriteAccess );
+		bOk = m_tWriter.Write ( false );
+		if ( !bOk )
+		{
+			sError.SetSprintf ( "unable to write to binlog: %s", m_tWriter.GetError().cstr() );
+			m_tWriter.DiscardUnwritten();
+		}
+		iGroupEnd = m_tWriter.GetStreamWritten();
+
+		// fsync via own descriptor, so that the log may be closed or rotated meanwhile
+		if ( bOk )
+		{
+			iFD = m_tWriter.DupFD();
+			iFilePos = m_tWriter.GetFilePos();
+			iFileGen = m_tWriter.GetFileGen();
+		}
+	}
+
+	// sync without write lock held, so that the next group accumulates while we wait for disk
+	if ( iFD>=0 )
+	{
+		m_pOwner->m_iGroupSyncs.fetch_add ( 1, std::memory_order_relaxed );
+		if ( m_pOwner->m_bMockSyncFailure )
+		{
+			sError = "unable to sync binlog: mocked failure";
+			bOk = false;
+		} else if ( fsync ( iFD )!=0 )
+		{
+			sError.SetSprintf ( "unable to sync binlog: %s", strerrorm ( errno ) );
+			bOk = false;
+		}
+		::close ( iFD );
+	}
+
+	if ( !bOk )
+	{
+		m_dFailedGroups.Add ( { iGroupStart, iGroupEnd } );
+		return false;
+	}
+
+	UpdateSyncedPos ( iGroupEnd );
+
+	// let periodic flush know it has nothing to sync (unless the file was rotated meanwhile)
+	if ( iFD>=0 )
+	{
+		Threads::ScopedCoroMutex_t tLock ( m_tWriteAccess );
+		m_tWriter.MarkSynced ( iFileGen, iFilePos );
+	}
+
+	return true;
+}
+
+
+bool SingleBinlog_c::IsGroupFailed ( int64_t iTxnEnd ) const
+{
+	return m_dFailedGroups.any_of ( [iTxnEnd] ( const auto & tRange ) { return iTxnEnd>tRange.first && iTxnEnd<=tRange.second; } );
+}
+
+
+void SingleBinlog_c::UpdateSyncedPos ( int64_t iPos ) noexcept
+{
+	int64_t iSynced = m_iSyncedPos.load ( std::memory_order_relaxed );
+	while ( iSynced<iPos && !m_iSyncedPos.compare_exchange_weak ( iSynced, iPos, std::memory_order_release, std::memory_order_relaxed ) );
+}
+
+
 void SingleBinlog_c::NotifyIndexFlush ( int64_t iFlushedTID, const char * szFlushedIndexName, bool bShutdown, bool bForceSave )
 {
 	MEMORY ( MEM_BINLOG );
@@ -811,6 +1035,16 @@ void SingleBinlog_c::CheckDoRestart ()
 	MEMORY ( MEM_BINLOG );
 	assert ( !m_dLogFiles.IsEmpty () );
 	DoCacheWrite ();
+
+	// group commit waiters may still wait for the tail of this file; sync it before closing
+	if ( m_pOwner->IsGroupCommit() )
+	{
+		if ( m_tWriter.Fsync() )
+			UpdateSyncedPos ( m_tWriter.GetStreamWritten() );
+		else
+			sphWarning ( "binlog: failed to sync before rotation: %s", m_tWriter.GetError().cstr() );
+	}
+
 	m_tWriter.CloseFile ();
 	OpenNewLog ();
 }
@@ -1005,6 +1239,7 @@ void Binlog_c::Configure ( const CSphConfigSection & hSearchd, DWORD uReplayFlag
 	}
 
 	m_iRestartSize = hSearchd.GetSize ( "binlog_max_log_size", m_iRestartSize );
+	m_iGroupCommitWindowMs = Max ( hSearchd.GetMsTimeMs ( "binlog_group_commit_window", 0 ), 0 );
 	m_uReplayFlags = uReplayFlags;
 	m_iBinlogFileDigits = hSearchd.GetInt ( "binlog_filename_digits", 4 );
 
@@ -1173,13 +1408,27 @@ bool Binlog_c::IsBinlogWritable () const noexcept
 
 
 // commit stuff. Indexes call this function with serialization cb; binlog is agnostic to alien data structures.
-bool Binlog_c::BinlogCommit ( int64_t * pTID, const char* szIndexName, FnWriteCommit fnSaver, CSphString & sError )
+bool Binlog_c::BinlogCommit ( int64_t * pTID, const char* szIndexName, FnWriteCommit fnSaver, int64_t * pSyncPos, CSphString & sError )
 {
 	if ( !IsBinlogWritable () ) // m.b. need to advance TID as index flush according to it
 		return true;
 
 	auto pSingleBinlog = GetWriteIndexBinlog ( szIndexName );
-	return pSingleBinlog->BinlogCommit ( pTID, szIndexName, std::move ( fnSaver ), sError );
+	return pSingleBinlog->BinlogCommit ( pTID, szIndexName, std::move ( fnSaver ), pSyncPos, sError );
+}
+
+
+// the txn is already applied and visible; it can't be rolled back, and mustn't stay live without being on disk.
+// So failed sync is fatal, as failed meta save is: on restart only what is really in the log is replayed.
+void Binlog_c::WaitSynced ( const char * szIndexName, int64_t iSyncPos )
+{
+	if ( !iSyncPos || !IsBinlogWritable () )
+		return;
+
+	CSphString sError;
+	auto pSingleBinlog = GetWriteIndexBinlog ( szIndexName );
+	if ( !pSingleBinlog->GroupSync ( iSyncPos, sError ) )
+		sphDie ( "binlog: table %s: %s; applied txn is not durable, restart to recover from the log", szIndexName, sError.cstr() );
 }
 
 
@@ -1371,6 +1620,7 @@ BinlogFileState_e Binlog_c::ReplayBinlog ( BinlogReplayFileDesc_t & tLog, const
 	bool bReplayOK = true;
 	bool bHaveCacheOp = false;
 	int64_t iPos = -1;
+	BinlogReplayBatch_t tBatch;
 
 	int64_t tmReplay = sphMicroTimer();
 
@@ -1418,7 +1668,9 @@ BinlogFileState_e Binlog_c::ReplayBinlog ( BinlogReplayFileDesc_t & tLog, const
 				break;
 
 			case ADD_TXN:
-				bReplayOK = ReplayTxn ( tLog, tReader );
+				bReplayOK = ReplayTxn ( tLog, tReader, tBatch );
+				if ( bReplayOK && tBatch.m_iBytes>=BINLOG_REPLAY_BATCH )
+					bReplayOK = ApplyReplayBatch ( tLog, tBatch );
 				break;
 
 			default:
@@ -1431,6 +1683,10 @@ BinlogFileState_e Binlog_c::ReplayBinlog ( BinlogReplayFileDesc_t & tLog, const
 		++dTotal [ TOTAL ];
 	}
 
+	// apply the tail (or everything decoded before the error, as sequential replay would do)
+	if ( !ApplyReplayBatch ( tLog, tBatch ) )
+		bReplayOK = false;
+
 	tmReplay = sphMicroTimer() - tmReplay;
 
 	if ( tReader.GetErrorFlag() )
@@ -1598,7 +1854,8 @@ void SkipBytes ( CSphAutoreader& tReader, DWORD uSize )
 }
 }
 
-bool Binlog_c::ReplayTxn ( const BinlogReplayFileDesc_t & tLog, BinlogReader_c & tReader ) const NO_THREAD_SAFETY_ANALYSIS
+// decode txn and put it into batch; it will be applied later by ApplyReplayBatch
+bool Binlog_c::ReplayTxn ( const BinlogReplayFileDesc_t & tLog, BinlogReader_c & tReader, BinlogReplayBatch_t & tBatch ) const NO_THREAD_SAFETY_ANALYSIS
 {
 	// load and lookup index
 	const int64_t iTxnPos = tReader.GetPos();
@@ -1613,6 +1870,7 @@ bool Binlog_c::ReplayTxn ( const BinlogReplayFileDesc_t & tLog, BinlogReader_c &
 	auto uSize = tReader.GetDword();
 
 	// skip txns of non-existent (deleted) indexes (skip blobs by size)
+	// note, index TID is not yet touched by txns of the pending batch; they all are greater than skipped ones anyway
 	if ( !tIndex.m_pIndex || iTID<=tIndex.m_pIndex->m_iTID || tIndex.m_pIndex->m_iTID==-1 )
 	{
 		tIndex.m_iMinTID = Min ( tIndex.m_iMinTID, iTID );
@@ -1627,49 +1885,135 @@ bool Binlog_c::ReplayTxn ( const BinlogReplayFileDesc_t & tLog, BinlogReader_c &
 
 	assert ( tIndex.m_pIndex );
 
-	CSphString sError;
-	BYTE uOp = tReader.GetByte();
-	CSphString sOp = SzTxnName ( (Txn_e) uOp );
-	CheckTnxResult_t tReplayed = tIndex.m_pIndex->ReplayTxn ( tReader, sError, uOp, [ iTxnPos, iTID, this, &tReader, &tIndex, &sOp ] {
-		
-		CheckTnxResult_t tRes;
-		tRes.m_bValid = PerformChecks ( sOp.cstr (), tIndex, iTID, iTxnPos, tReader );
-		if ( !tRes.m_bValid )
-			return tRes;
-
-		// only replay transaction when index exists and does not have it yet (based on TID)
-		if ( tIndex.m_pIndex && iTID>tIndex.m_pIndex->m_iTID )
-		{
-			tRes.m_bApply = true;
-			// we normally expect per-index TIDs to be sequential
-			// but let's be graceful about that
-			if ( iTID!=tIndex.m_pIndex->m_iTID+1 )
-				sphWarning (
-						"binlog: %s: unexpected tid (table=%s, indextid=" INT64_FMT ", logtid=" INT64_FMT ", pos=" INT64_FMT ")",
-						sOp.cstr (), tIndex.m_sName.cstr (), tIndex.m_pIndex->m_iTID, iTID, iTxnPos );
-		}
-		return tRes;
-	});
+	tBatch.m_dTables.Resize ( tLog.m_dIndexInfos.GetLength() );
+	auto & dTxns = tBatch.m_dTables[iIdx];
+	BinlogReplayTxn_t & tTxn = dTxns.Add();
+	tTxn.m_iTID = iTID;
+	tTxn.m_iTxnPos = iTxnPos;
+	tTxn.m_dData.Resize ( uSize );
+	if ( uSize )
+		tReader.GetBytes ( tTxn.m_dData.Begin(), (int) uSize );
 
-	// could be invalid TXN in binlog
-	if ( !tReplayed.m_bValid )
+	if ( !uSize )
 	{
-		Log ( REPLAY_IGNORE_TRX_ERROR, "binlog: %s (table=%s, lasttid=" INT64_FMT ", logtid=" INT64_FMT ", pos=" INT64_FMT ", error=%s)",
-			  sOp.cstr (), tIndex.m_sName.cstr(), tIndex.m_iMaxTID, iTID, iTxnPos, sError.cstr() );
+		Log ( REPLAY_IGNORE_TRX_ERROR, "binlog: empty txn (table=%s, lasttid=" INT64_FMT ", logtid=" INT64_FMT ", pos=" INT64_FMT ")",
+			  tIndex.m_sName.cstr (), tIndex.m_iMaxTID, iTID, iTxnPos );
+		dTxns.Pop();
 		return false;
 	}
 
-	// could be TXN in binlog that index already has should not apply again that TXN and should not change index TID by that TXN
-	if ( tReplayed.m_bApply )
+	if ( !PerformChecks ( SzTxnName ( (Txn_e) tTxn.m_dData[0] ), tIndex, iTID, iTxnPos, tReader ) )
 	{
-		// update committed tid on replay in case of unexpected / mismatched tid
-		tIndex.m_pIndex->m_iTID = iTID;
-	} 
+		dTxns.Pop();
+		return false;
+	}
 
+	tBatch.m_iBytes += uSize;
 	tIndex.m_iMinTID = Min ( tIndex.m_iMinTID, iTID );
 	tIndex.m_iMaxTID = Max ( tIndex.m_iMaxTID, iTID );
 	return true;
+}
+
+
+// apply decoded txns; every table gets own worker on the current scheduler.
+// Failed txn is fatal (unless ignored by replay flags), so the tables applied in parallel never outlive it. With errors
+// ignored, replay of the file stops at the failed txn, and txns of other tables after it must not be applied;
+// so then the batch is applied sequentially, in file order, as the txns were written
+bool Binlog_c::ApplyReplayBatch ( const BinlogReplayFileDesc_t & tLog, BinlogReplayBatch_t & tBatch ) const NO_THREAD_SAFETY_ANALYSIS
+{
+	CSphVector<int> dJobs;
+	ARRAY_FOREACH ( i, tBatch.m_dTables )
+		if ( !tBatch.m_dTables[i].IsEmpty() )
+			dJobs.Add ( i );
+
+	std::atomic<bool> bOk { true };
+	if ( ( m_uReplayFlags & REPLAY_IGNORE_TRX_ERROR ) && dJobs.GetLength()>1 )
+	{
+		// (txn pos, table, txn idx)
+		CSphVector<std::tuple<int64_t, int, int>> dOrder;
+		for ( int iIdx : dJobs )
+			ARRAY_FOREACH ( i, tBatch.m_dTables[iIdx] )
+				dOrder.Add ( { tBatch.m_dTables[iIdx][i].m_iTxnPos, iIdx, i } );
+		dOrder.Sort ( Lesser ( [] ( const auto & a, const auto & b ) { return std::get<0> ( a )<std::get<0> ( b ); } ) );
+
+		for ( const auto & tTxn : dOrder )
+			if ( !ApplyTableTxns ( tLog.m_dIndexInfos[std::get<1> ( tTxn )], tBatch.m_dTables[std::get<1> ( tTxn )].Slice ( std::get<2> ( tTxn ), 1 ) ) )
+			{
+				bOk.store ( false, std::memory_order_relaxed );
+				break;
+			}
+	} else if ( !dJobs.IsEmpty() )
+	{
+		std::atomic<int> iCurJob { 0 };
+		Threads::Coro::ExecuteN ( Min ( dJobs.GetLength(), Threads::NThreads() ), [&]
+		{
+			for ( int iJob = iCurJob.fetch_add ( 1, std::memory_order_relaxed ); iJob<dJobs.GetLength(); iJob = iCurJob.fetch_add ( 1, std::memory_order_relaxed ) )
+			{
+				int iIdx = dJobs[iJob];
+				if ( !ApplyTableTxns ( tLog.m_dIndexInfos[iIdx], tBatch.m_dTables[iIdx] ) )
+					bOk.store ( false, std::memory_order_relaxed );
+			}
+		});
+	}
 
+	for ( auto & dTxns : tBatch.m_dTables )
+		dTxns.Reset();
+	tBatch.m_iBytes = 0;
+	return bOk.load ( std::memory_order_relaxed );
+}
+
+
+bool Binlog_c::ApplyTableTxns ( BinlogIndexReplayInfo_t & tIndex, VecTraits_T<BinlogReplayTxn_t> dTxns ) const NO_THREAD_SAFETY_ANALYSIS
+{
+	assert ( tIndex.m_pIndex );
+	for ( auto & tTxn : dTxns )
+	{
+		const int64_t iTID = tTxn.m_iTID;
+		const int64_t iTxnPos = tTxn.m_iTxnPos;
+
+		BinlogTxnReader_c tReader ( tTxn.m_dData );
+		CSphString sError;
+		BYTE uOp = tReader.GetByte();
+		CSphString sOp = SzTxnName ( (Txn_e) uOp );
+		CheckTnxResult_t tReplayed = tIndex.m_pIndex->ReplayTxn ( tReader, sError, uOp, [ iTxnPos, iTID, &tReader, &tIndex, &sOp ] {
+
+			CheckTnxResult_t tRes;
+
+			// crc was checked on decode; here just ensure the payload was parsed exactly
+			tRes.m_bValid = !tReader.GetErrorFlag() && tReader.IsConsumed();
+			if ( !tRes.m_bValid )
+				return tRes;
+
+			// only replay transaction when index exists and does not have it yet (based on TID)
+			if ( iTID>tIndex.m_pIndex->m_iTID )
+			{
+				tRes.m_bApply = true;
+				// we normally expect per-index TIDs to be sequential
+				// but let's be graceful about that
+				if ( iTID!=tIndex.m_pIndex->m_iTID+1 )
+					sphWarning (
+							"binlog: %s: unexpected tid (table=%s, indextid=" INT64_FMT ", logtid=" INT64_FMT ", pos=" INT64_FMT ")",
+							sOp.cstr (), tIndex.m_sName.cstr (), tIndex.m_pIndex->m_iTID, iTID, iTxnPos );
+			}
+			return tRes;
+		});
+
+		// could be invalid TXN in binlog
+		if ( !tReplayed.m_bValid )
+		{
+			Log ( REPLAY_IGNORE_TRX_ERROR, "binlog: %s (table=%s, logtid=" INT64_FMT ", indextid=" INT64_FMT ", pos=" INT64_FMT ", error=%s)",
+				  sOp.cstr (), tIndex.m_sName.cstr(), iTID, tIndex.m_pIndex->m_iTID, iTxnPos, sError.cstr() );
+			return false;
+		}
+
+		// could be TXN in binlog that index already has should not apply again that TXN and should not change index TID by that TXN
+		if ( tReplayed.m_bApply )
+		{
+			// update committed tid on replay in case of unexpected / mismatched tid
+			tIndex.m_pIndex->m_iTID = iTID;
+		}
+	}
+	return true;
 }
 
 bool Binlog_c::MockDisabled ( bool bNewVal )
@@ -1749,7 +2093,21 @@ bool Binlog::MockDisabled ( bool bNewVal )
 	return bNewVal;
 }
 
-bool Binlog::Commit ( int64_t * pTID, const char* szIndexName, CSphString & sError, FnWriteCommit && fnSaver )
+bool Binlog::MockSyncFailure ( bool bNewVal )
+{
+	if ( g_pRtBinlog )
+		return g_pRtBinlog->MockSyncFailure ( bNewVal );
+	return bNewVal;
+}
+
+int64_t Binlog::GetGroupSyncs()
+{
+	if ( !g_pRtBinlog )
+		return 0;
+	return g_pRtBinlog->GetGroupSyncs();
+}
+
+bool Binlog::Commit ( int64_t * pTID, const char* szIndexName, CSphString & sError, FnWriteCommit && fnSaver, int64_t * pSyncPos )
 {
 	if ( !g_pRtBinlog )
 		return true;
@@ -1757,7 +2115,13 @@ bool Binlog::Commit ( int64_t * pTID, const char* szIndexName, CSphString & sErr
 	if ( *pTID==-1 )
 		return true;
 
-	return g_pRtBinlog->BinlogCommit ( pTID, szIndexName, std::move (fnSaver), sError );
+	return g_pRtBinlog->BinlogCommit ( pTID, szIndexName, std::move (fnSaver), pSyncPos, sError );
+}
+
+void Binlog::WaitSynced ( const char * szIndexName, int64_t iSyncPos )
+{
+	if ( g_pRtBinlog )
+		g_pRtBinlog->WaitSynced ( szIndexName, iSyncPos );
 }
 
 void Binlog::NotifyIndexFlush ( int64_t iTID, const char * szIndexName, Shutdown_e eShutdown, ForceSave_e eForceSave )
@@ -62,12 +62,18 @@ namespace Binlog {
 	void Deinit ();
 	bool IsActive();
 	bool MockDisabled ( bool bNewVal );
+	bool MockSyncFailure ( bool bNewVal );
+	int64_t GetGroupSyncs();
 
 	bool IsFlushEnabled();
 	void Flush();
 	int64_t NextFlushTimestamp();
 
-	bool Commit ( int64_t * pTID, const char* szIndexName, CSphString & sError, FnWriteCommit && fnSaver );
+	/// with pSyncPos and binlog_flush=1 (group commit), only appends the txn and returns in *pSyncPos where it ends (or leaves it 0);
+	/// the caller then passes it to WaitSynced once out of its own serialization, so that its next txns may join the same fsync
+	bool Commit ( int64_t * pTID, const char* szIndexName, CSphString & sError, FnWriteCommit && fnSaver, int64_t * pSyncPos = nullptr );
+	/// txn is already applied at this point, so failed sync is fatal
+	void WaitSynced ( const char * szIndexName, int64_t iSyncPos );
 
 	/// replay stored binlog
 	void Replay ( const SmallStringHash_T<CSphIndex*> & hIndexes, ProgressCallbackSimple_t * pfnProgressCallback = nullptr );
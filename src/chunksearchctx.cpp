@@ -56,6 +56,27 @@ void DiskChunkSearcherCtx_t::MergeChild ( DiskChunkSearcherCtx_t tChild ) const
 }
 
 
+void DiskChunkSearcherCtx_t::MergeChildren ( VecTraits_T<DiskChunkSearcherCtx_t> dChildren ) const
+{
+	// first try to merge sorters of all the children at once, split by group keys over all the threads that worked
+	// sorters that did so are left empty, so MergeChild only moves the rest
+	CSphVector<ISphMatchSorter *> dChildSorters;
+	ARRAY_CONSTFOREACH ( i, m_dSorters )
+	{
+		dChildSorters.Resize(0);
+		for ( const auto & tChild : dChildren )
+			if ( tChild.m_dSorters[i] )
+				dChildSorters.Add ( tChild.m_dSorters[i] );
+
+		if ( !dChildSorters.IsEmpty() )
+			m_dSorters[i]->MoveFromParallel ( dChildSorters, dChildren.GetLength()+1 );
+	}
+
+	for ( const auto & tChild : dChildren )
+		MergeChild ( tChild );
+}
+
+
 bool DiskChunkSearcherCtx_t::IsClonable () const
 {
 	return m_dSorters.all_of ( [] ( const ISphMatchSorter * p ) { return p->CanBeCloned (); } );
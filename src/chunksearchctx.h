@@ -26,6 +26,7 @@ struct DiskChunkSearcherCtx_t
 
 	// called from finalize
 	void	MergeChild ( DiskChunkSearcherCtx_t tChild ) const;
+	void	MergeChildren ( VecTraits_T<DiskChunkSearcherCtx_t> dChildren ) const;
 	bool	IsClonable () const;
 };
 
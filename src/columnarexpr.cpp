@@ -422,14 +422,62 @@ public:
 	float		Eval ( const CSphMatch & tMatch ) const override		{ return (float)FetchValue(tMatch); }
 	int			IntEval ( const CSphMatch & tMatch ) const override		{ return (int)FetchValue(tMatch); }
 	int64_t		Int64Eval ( const CSphMatch & tMatch ) const override	{ return FetchValue(tMatch); }
+	void		EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, float * pRes ) const override;
+	void		IntEvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int * pRes ) const override;
+	void		Int64EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int64_t * pRes ) const override { FetchValues ( dMatches, pRes ); }
+	bool		IsBatchable() const final								{ return true; }
 	uint64_t	GetHash ( const ISphSchema & tSorterSchema, uint64_t uPrevHash, bool & bDisable ) final;
 	ISphExpr *	Clone() const override									{ return new Expr_GetColumnarInt_c ( m_sName, m_bStored ); }
 
 protected:
 	inline SphAttr_t FetchValue ( const CSphMatch & tMatch ) const		{  return m_pIterator->Get ( tMatch.m_tRowID ); }
+	void		FetchValues ( const VecTraits_T<CSphMatch *> & dMatches, int64_t * pValues ) const;
 };
 
 
+void Expr_GetColumnarInt_c::EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, float * pRes ) const
+{
+	CSphFixedVector<int64_t> dValues ( dMatches.GetLength() );
+	FetchValues ( dMatches, dValues.Begin() );
+	ARRAY_FOREACH ( i, dValues )
+		pRes[i] = (float)dValues[i];
+}
+
+
+void Expr_GetColumnarInt_c::IntEvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int * pRes ) const
+{
+	CSphFixedVector<int64_t> dValues ( dMatches.GetLength() );
+	FetchValues ( dMatches, dValues.Begin() );
+	ARRAY_FOREACH ( i, dValues )
+		pRes[i] = (int)dValues[i];
+}
+
+
+void Expr_GetColumnarInt_c::FetchValues ( const VecTraits_T<CSphMatch *> & dMatches, int64_t * pValues ) const
+{
+	CSphFixedVector<uint32_t> dRowIDs ( dMatches.GetLength() );
+	bool bAscending = true;
+	ARRAY_FOREACH ( i, dMatches )
+	{
+		dRowIDs[i] = dMatches[i]->m_tRowID;
+		bAscending &= !i || dRowIDs[i]>dRowIDs[i-1];
+	}
+
+	// block fetch only works for sequential access, fall back to random access otherwise
+	if ( !bAscending )
+	{
+		ARRAY_FOREACH ( i, dRowIDs )
+			pValues[i] = m_pIterator->Get ( dRowIDs[i] );
+
+		return;
+	}
+
+	util::Span_T<uint32_t> dFetchRowIDs ( dRowIDs.Begin(), dRowIDs.GetLength() );
+	util::Span_T<int64_t> dFetchValues ( pValues, dRowIDs.GetLength() );
+	m_pIterator->Fetch ( dFetchRowIDs, dFetchValues );
+}
+
+
 uint64_t Expr_GetColumnarInt_c::GetHash ( const ISphSchema & tSorterSchema, uint64_t uPrevHash, bool & bDisable )
 {
 	EXPR_CLASS_NAME("Expr_GetColumnarInt_c");
@@ -446,9 +494,38 @@ public:
 	float	Eval ( const CSphMatch & tMatch ) const final		{ return sphDW2F ( (DWORD)FetchValue(tMatch) ); }
 	int		IntEval ( const CSphMatch & tMatch ) const final	{ return (int)sphDW2F ( (DWORD)FetchValue(tMatch) ); }
 	int64_t	Int64Eval ( const CSphMatch & tMatch ) const final	{ return (int64_t)sphDW2F ( (DWORD)FetchValue(tMatch) ); }
+	void	EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, float * pRes ) const final;
+	void	IntEvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int * pRes ) const final;
+	void	Int64EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int64_t * pRes ) const final;
 	ISphExpr *	Clone() const final								{ return new Expr_GetColumnarFloat_c ( m_sName, m_bStored ); }
 };
 
+
+void Expr_GetColumnarFloat_c::EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, float * pRes ) const
+{
+	CSphFixedVector<int64_t> dValues ( dMatches.GetLength() );
+	FetchValues ( dMatches, dValues.Begin() );
+	ARRAY_FOREACH ( i, dValues )
+		pRes[i] = sphDW2F ( (DWORD)dValues[i] );
+}
+
+
+void Expr_GetColumnarFloat_c::IntEvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int * pRes ) const
+{
+	CSphFixedVector<int64_t> dValues ( dMatches.GetLength() );
+	FetchValues ( dMatches, dValues.Begin() );
+	ARRAY_FOREACH ( i, dValues )
+		pRes[i] = (int)sphDW2F ( (DWORD)dValues[i] );
+}
+
+
+void Expr_GetColumnarFloat_c::Int64EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int64_t * pRes ) const
+{
+	FetchValues ( dMatches, pRes );
+	for ( int i = 0, iLen = dMatches.GetLength(); i < iLen; i++ )
+		pRes[i] = (int64_t)sphDW2F ( (DWORD)pRes[i] );
+}
+
 /////////////////////////////////////////////////////////////////////
 
 class Expr_GetColumnarString_c : public Expr_GetColumnar_Traits_c
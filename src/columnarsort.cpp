@@ -293,6 +293,7 @@ public:
 	void	Finalize ( MatchProcessor_i & tProcessor, bool bCallProcessInResultSetOrder, bool bFinalizeMatches ) override;
 	int		Flatten ( CSphMatch * pTo ) override;
 	void	MoveTo ( ISphMatchSorter * pRhs, bool bCopyMeta ) override;
+	bool	MoveFromParallel ( const VecTraits_T<ISphMatchSorter *> & dSources, int iThreads ) override;
 
 	ISphMatchSorter * Clone() const override								{ return new ColumnarProxySorter_T<GENERIC,COMP,SINGLE> ( m_pSorter->Clone(), m_iSize, m_iFastPathAttrs ); }
 	void	CloneTo ( ISphMatchSorter * pTrg ) const override;
@@ -515,6 +516,22 @@ void ColumnarProxySorter_T<GENERIC,COMP,SINGLE>::MoveTo ( ISphMatchSorter * pRhs
 	m_pSorter->MoveTo ( pRhsProxy->m_pSorter.get(), bCopyMeta );
 }
 
+template <typename GENERIC, typename COMP, typename SINGLE>
+bool ColumnarProxySorter_T<GENERIC,COMP,SINGLE>::MoveFromParallel ( const VecTraits_T<ISphMatchSorter *> & dSources, int iThreads )
+{
+	PushCollectedToSorter();
+
+	CSphVector<ISphMatchSorter *> dWrapped;
+	for ( auto * pSource : dSources )
+	{
+		auto pProxy = (ColumnarProxySorter_T<GENERIC,COMP,SINGLE>*)pSource;
+		pProxy->PushCollectedToSorter();
+		dWrapped.Add ( pProxy->m_pSorter.get() );
+	}
+
+	return m_pSorter->MoveFromParallel ( dWrapped, iThreads );
+}
+
 template <typename GENERIC, typename COMP, typename SINGLE>
 void ColumnarProxySorter_T<GENERIC,COMP,SINGLE>::SetState ( const CSphMatchComparatorState & tState )
 {
@@ -16,6 +16,7 @@
 #include <atomic>
 #include <chrono>
 #include <optional>
+#include <vector>
 
 // note: we not yet link to boost::fiber, so just inclusion of some of it's header is enough.
 // Once we do link - add searching of that component into Cmake, than m.b. remove this comment as redundant
@@ -168,6 +169,10 @@ public:
 
 	void Finalize();
 
+	// same as Finalize(), but parent gets all the children at once (in jobs order) via MergeChildren()
+	template<ECONTEXT ORD = IS_ORDERED>
+	std::enable_if_t<ORD == ECONTEXT::ORDERED> FinalizeAll();
+
 	// called once per coroutine, when it really has to process something. 2-nd result is JobID, m.b. used in SetJobOrder.
 	template <ECONTEXT ORD = IS_ORDERED>
 	std::enable_if_t<ORD == ECONTEXT::UNORDERED, std::pair<REFCONTEXT, int>> CloneNewContext();
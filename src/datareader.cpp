@@ -11,6 +11,12 @@
 #include "datareader.h"
 #include "sphinxint.h"
 #include "fileutils.h"
+#include "std/mm.h"
+#include "std/sys.h"
+
+#if HAVE_POSIX_FADVISE
+#include <fcntl.h>
+#endif
 
 //////////////////////////////////////////////////////////////////////////
 
@@ -246,6 +252,15 @@ public:
 		m_dReader.m_pProfile = pProfile;
 	}
 
+	// kernel reads the range into page cache in background, so subsequent preads don't block
+	void Prefetch ( SphOffset_t iPos, int64_t iSize ) const final
+	{
+#if HAVE_POSIX_FADVISE && defined(POSIX_FADV_WILLNEED)
+		if ( iSize>0 )
+			posix_fadvise ( m_dReader.GetFD(), iPos, iSize, POSIX_FADV_WILLNEED );
+#endif
+	}
+
 protected:
 	~DirectFactory_c() final {} // d-tr only by Release
 
@@ -305,6 +320,19 @@ public:
 		return pReader;
 	}
 
+	// kernel faults the pages in background, so subsequent access doesn't stall on them
+	void Prefetch ( SphOffset_t iPos, int64_t iSize ) const final
+	{
+		SphOffset_t iLength = m_tBackendFile.GetLength64();
+		if ( iSize<=0 || iPos<0 || iPos>=iLength )
+			return;
+
+		auto iPageMask = (SphOffset_t)GetMemPageSize()-1;
+		SphOffset_t iStart = iPos & ~iPageMask;
+		SphOffset_t iEnd = Min ( iPos+iSize, iLength );
+		mmadvise ( const_cast<BYTE*> ( m_tBackendFile.GetReadPtr() ) + iStart, size_t ( iEnd-iStart ), Advise_e::WILLNEED );
+	}
+
 protected:
 	~MMapFactory_c() final {} // d-tr only by Release
 
@@ -59,6 +59,9 @@ public:
 	virtual FileBlockReader_i *	MakeReader ( BYTE * pBuf, int iSize ) = 0;
 	virtual void				SetProfile ( QueryProfile_c * ) {}
 
+	/// hint that given range is going to be read soon; starts async readahead and returns immediately
+	virtual void				Prefetch ( SphOffset_t /*iPos*/, int64_t /*iSize*/ ) const {}
+
 protected:
 								~DataReaderFactory_c () override {}
 
@@ -162,6 +162,16 @@ void ClonableCtx_T<REFCONTEXT, CONTEXT, IS_ORDERED>::Finalize()
 	ForAll ( [this] ( REFCONTEXT tContext ) { m_dParentContext.MergeChild ( tContext ); }, false );
 }
 
+template<typename REFCONTEXT, typename CONTEXT, ECONTEXT IS_ORDERED>
+template<ECONTEXT ORD>
+std::enable_if_t<ORD == ECONTEXT::ORDERED> ClonableCtx_T<REFCONTEXT, CONTEXT, IS_ORDERED>::FinalizeAll()
+{
+	// ref contexts are usually not assignable (hold references), so CSphVector won't do
+	std::vector<REFCONTEXT> dChildren;
+	ForAll ( [&dChildren] ( REFCONTEXT tContext ) { dChildren.push_back ( tContext ); }, false );
+	m_dParentContext.MergeChildren ( VecTraits_T<REFCONTEXT> ( dChildren.data(), (int64_t)dChildren.size() ) );
+}
+
 /////////////////////////////////////////////////////////////////////////////
 /// HighFreqChecker_c
 /////////////////////////////////////////////////////////////////////////////
@@ -20,6 +20,11 @@
 #include "lz4/lz4hc.h"
 #include "sphinxint.h"
 
+#if WITH_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+#endif
+
 
 enum BlockFlags_e : BYTE
 {
@@ -46,7 +51,10 @@ enum FieldFlags_e : BYTE
 	FIELD_FLAG_EMPTY		= 1 << 1
 };
 
-static const int STORAGE_VERSION = 1;
+// v.2 stores zstd dictionary in the header; other compressions are still written as v.1, so that older binaries can read them
+static const int STORAGE_VERSION = 2;
+static const int STORAGE_VERSION_NO_DICT = 1;
+static const DWORD MAX_SANE_DICT_SIZE = 16777216;
 
 //////////////////////////////////////////////////////////////////////////
 
@@ -57,6 +65,7 @@ static BYTE Compression2Byte ( Compression_e eComp )
 	case Compression_e::NONE:	return 0;
 	case Compression_e::LZ4:	return 1;
 	case Compression_e::LZ4HC:	return 2;
+	case Compression_e::ZSTD:	return 3;
 	default:
 		assert ( 0 && "Unknown compression type" );
 		return 0;
@@ -71,6 +80,7 @@ static Compression_e Byte2Compression ( BYTE uComp )
 	case 0:		return Compression_e::NONE;
 	case 1:		return Compression_e::LZ4;
 	case 2:		return Compression_e::LZ4HC;
+	case 3:		return Compression_e::ZSTD;
 	default:
 		assert ( 0 && "Unknown compression type" );
 		return Compression_e::NONE;
@@ -184,12 +194,192 @@ int	Compressor_LZ4HC_c::DoCompression ( const VecTraits_T<BYTE> & dUncompressed,
 }
 
 
-std::unique_ptr<Compressor_i> CreateCompressor ( Compression_e eComp, int iCompressionLevel )
+#if WITH_ZSTD
+
+#if DL_ZSTD
+
+static decltype ( &ZSTD_createCCtx ) sph_ZSTD_createCCtx = nullptr;
+static decltype ( &ZSTD_freeCCtx ) sph_ZSTD_freeCCtx = nullptr;
+static decltype ( &ZSTD_createDCtx ) sph_ZSTD_createDCtx = nullptr;
+static decltype ( &ZSTD_freeDCtx ) sph_ZSTD_freeDCtx = nullptr;
+static decltype ( &ZSTD_createCDict ) sph_ZSTD_createCDict = nullptr;
+static decltype ( &ZSTD_freeCDict ) sph_ZSTD_freeCDict = nullptr;
+static decltype ( &ZSTD_createDDict ) sph_ZSTD_createDDict = nullptr;
+static decltype ( &ZSTD_freeDDict ) sph_ZSTD_freeDDict = nullptr;
+static decltype ( &ZSTD_compressBound ) sph_ZSTD_compressBound = nullptr;
+static decltype ( &ZSTD_compressCCtx ) sph_ZSTD_compressCCtx = nullptr;
+static decltype ( &ZSTD_compress_usingCDict ) sph_ZSTD_compress_usingCDict = nullptr;
+static decltype ( &ZSTD_decompressDCtx ) sph_ZSTD_decompressDCtx = nullptr;
+static decltype ( &ZSTD_decompress_usingDDict ) sph_ZSTD_decompress_usingDDict = nullptr;
+static decltype ( &ZSTD_isError ) sph_ZSTD_isError = nullptr;
+static decltype ( &ZDICT_trainFromBuffer ) sph_ZDICT_trainFromBuffer = nullptr;
+static decltype ( &ZDICT_isError ) sph_ZDICT_isError = nullptr;
+
+static bool InitDynamicZstd()
+{
+	const char * sFuncs[] = { "ZSTD_createCCtx", "ZSTD_freeCCtx", "ZSTD_createDCtx", "ZSTD_freeDCtx", "ZSTD_createCDict", "ZSTD_freeCDict",
+		"ZSTD_createDDict", "ZSTD_freeDDict", "ZSTD_compressBound", "ZSTD_compressCCtx", "ZSTD_compress_usingCDict", "ZSTD_decompressDCtx",
+		"ZSTD_decompress_usingDDict", "ZSTD_isError", "ZDICT_trainFromBuffer", "ZDICT_isError" };
+	void ** pFuncs[] = { (void**)&sph_ZSTD_createCCtx, (void**)&sph_ZSTD_freeCCtx, (void**)&sph_ZSTD_createDCtx, (void**)&sph_ZSTD_freeDCtx,
+		(void**)&sph_ZSTD_createCDict, (void**)&sph_ZSTD_freeCDict, (void**)&sph_ZSTD_createDDict, (void**)&sph_ZSTD_freeDDict,
+		(void**)&sph_ZSTD_compressBound, (void**)&sph_ZSTD_compressCCtx, (void**)&sph_ZSTD_compress_usingCDict, (void**)&sph_ZSTD_decompressDCtx,
+		(void**)&sph_ZSTD_decompress_usingDDict, (void**)&sph_ZSTD_isError, (void**)&sph_ZDICT_trainFromBuffer, (void**)&sph_ZDICT_isError };
+
+	static CSphDynamicLibrary dLib ( ZSTD_LIB );
+	static bool bLoaded = dLib.LoadSymbols ( sFuncs, pFuncs, sizeof ( pFuncs ) / sizeof ( void** ) );
+	return bLoaded;
+}
+
+#else
+
+#define sph_ZSTD_createCCtx ZSTD_createCCtx
+#define sph_ZSTD_freeCCtx ZSTD_freeCCtx
+#define sph_ZSTD_createDCtx ZSTD_createDCtx
+#define sph_ZSTD_freeDCtx ZSTD_freeDCtx
+#define sph_ZSTD_createCDict ZSTD_createCDict
+#define sph_ZSTD_freeCDict ZSTD_freeCDict
+#define sph_ZSTD_createDDict ZSTD_createDDict
+#define sph_ZSTD_freeDDict ZSTD_freeDDict
+#define sph_ZSTD_compressBound ZSTD_compressBound
+#define sph_ZSTD_compressCCtx ZSTD_compressCCtx
+#define sph_ZSTD_compress_usingCDict ZSTD_compress_usingCDict
+#define sph_ZSTD_decompressDCtx ZSTD_decompressDCtx
+#define sph_ZSTD_decompress_usingDDict ZSTD_decompress_usingDDict
+#define sph_ZSTD_isError ZSTD_isError
+#define sph_ZDICT_trainFromBuffer ZDICT_trainFromBuffer
+#define sph_ZDICT_isError ZDICT_isError
+#define InitDynamicZstd() ( true )
+
+#endif // DL_ZSTD
+
+// decompression context is expensive to create, and a docstore is read from many threads at once; so keep one per thread
+static ZSTD_DCtx * GetThreadZstdDCtx()
+{
+	struct ThreadDCtx_t
+	{
+		ZSTD_DCtx * m_pCtx = nullptr;
+		~ThreadDCtx_t() { if ( m_pCtx ) sph_ZSTD_freeDCtx ( m_pCtx ); }
+	};
+
+	static thread_local ThreadDCtx_t tDCtx;
+	if ( !tDCtx.m_pCtx )
+		tDCtx.m_pCtx = sph_ZSTD_createDCtx();
+
+	return tDCtx.m_pCtx;
+}
+
+
+class Compressor_ZSTD_c : public Compressor_i
+{
+public:
+					Compressor_ZSTD_c ( int iCompressionLevel, const VecTraits_T<BYTE> & dDict );
+					~Compressor_ZSTD_c() override;
+
+	bool			Compress ( const VecTraits_T<BYTE> & dUncompressed, CSphVector<BYTE> & dCompressed ) const final;
+	bool			Decompress ( const VecTraits_T<BYTE> & dCompressed, VecTraits_T<BYTE> & dDecompressed ) const final;
+
+private:
+	int				m_iCompressionLevel = DEFAULT_COMPRESSION_LEVEL;
+	ZSTD_CDict *	m_pCDict = nullptr;
+	ZSTD_DDict *	m_pDDict = nullptr;
+	mutable ZSTD_CCtx * m_pCCtx = nullptr;	// only the builder compresses, and it does so from one thread
+};
+
+
+Compressor_ZSTD_c::Compressor_ZSTD_c ( int iCompressionLevel, const VecTraits_T<BYTE> & dDict )
+	: m_iCompressionLevel ( iCompressionLevel )
+{
+	if ( dDict.IsEmpty() )
+		return;
+
+	m_pCDict = sph_ZSTD_createCDict ( dDict.Begin(), dDict.GetLength(), m_iCompressionLevel );
+	m_pDDict = sph_ZSTD_createDDict ( dDict.Begin(), dDict.GetLength() );
+}
+
+
+Compressor_ZSTD_c::~Compressor_ZSTD_c()
+{
+	if ( m_pCCtx )
+		sph_ZSTD_freeCCtx ( m_pCCtx );
+	if ( m_pCDict )
+		sph_ZSTD_freeCDict ( m_pCDict );
+	if ( m_pDDict )
+		sph_ZSTD_freeDDict ( m_pDDict );
+}
+
+
+bool Compressor_ZSTD_c::Compress ( const VecTraits_T<BYTE> & dUncompressed, CSphVector<BYTE> & dCompressed ) const
+{
+	// with a dictionary even small fields compress well, so the threshold is lower than in LZ4
+	const int MIN_COMPRESSIBLE_SIZE = 16;
+	if ( dUncompressed.GetLength() < MIN_COMPRESSIBLE_SIZE )
+		return false;
+
+	if ( !m_pCCtx )
+		m_pCCtx = sph_ZSTD_createCCtx();
+
+	dCompressed.Resize ( (int64_t)sph_ZSTD_compressBound ( dUncompressed.GetLength() ) );
+	size_t uCompressedSize = m_pCDict
+		? sph_ZSTD_compress_usingCDict ( m_pCCtx, dCompressed.Begin(), dCompressed.GetLength(), dUncompressed.Begin(), dUncompressed.GetLength(), m_pCDict )
+		: sph_ZSTD_compressCCtx ( m_pCCtx, dCompressed.Begin(), dCompressed.GetLength(), dUncompressed.Begin(), dUncompressed.GetLength(), m_iCompressionLevel );
+
+	const float WORST_COMPRESSION_RATIO = 0.95f;
+	if ( sph_ZSTD_isError ( uCompressedSize ) || float(uCompressedSize)/dUncompressed.GetLength() > WORST_COMPRESSION_RATIO )
+		return false;
+
+	dCompressed.Resize ( (int64_t)uCompressedSize );
+	return true;
+}
+
+
+bool Compressor_ZSTD_c::Decompress ( const VecTraits_T<BYTE> & dCompressed, VecTraits_T<BYTE> & dDecompressed ) const
+{
+	ZSTD_DCtx * pCtx = GetThreadZstdDCtx();
+	if ( !pCtx )
+		return false;
+
+	size_t uRes = m_pDDict
+		? sph_ZSTD_decompress_usingDDict ( pCtx, dDecompressed.Begin(), dDecompressed.GetLength(), dCompressed.Begin(), dCompressed.GetLength(), m_pDDict )
+		: sph_ZSTD_decompressDCtx ( pCtx, dDecompressed.Begin(), dDecompressed.GetLength(), dCompressed.Begin(), dCompressed.GetLength() );
+
+	return !sph_ZSTD_isError ( uRes ) && uRes==(size_t)dDecompressed.GetLength();
+}
+
+
+// trains dictionary on given documents; returns empty one if there's too little data to train on
+static CSphVector<BYTE> TrainZstdDictionary ( const VecTraits_T<BYTE> & dSamples, const VecTraits_T<size_t> & dSampleSizes )
+{
+	const int ZSTD_DICT_SIZE = 65536;
+	const int MIN_SAMPLES = 16;
+
+	CSphVector<BYTE> dDict;
+	if ( dSampleSizes.GetLength()<MIN_SAMPLES || !InitDynamicZstd() )
+		return dDict;
+
+	dDict.Resize ( Min ( ZSTD_DICT_SIZE, dSamples.GetLength() ) );
+	size_t uDictSize = sph_ZDICT_trainFromBuffer ( dDict.Begin(), dDict.GetLength(), dSamples.Begin(), dSampleSizes.Begin(), dSampleSizes.GetLength() );
+	if ( sph_ZDICT_isError ( uDictSize ) )
+		dDict.Resize(0);
+	else
+		dDict.Resize ( (int64_t)uDictSize );
+
+	return dDict;
+}
+
+#endif // WITH_ZSTD
+
+
+std::unique_ptr<Compressor_i> CreateCompressor ( Compression_e eComp, int iCompressionLevel, const VecTraits_T<BYTE> & dDict = VecTraits_T<BYTE>() )
 {
 	switch (  eComp )
 	{
 		case Compression_e::LZ4:	return std::make_unique<Compressor_LZ4_c>();
 		case Compression_e::LZ4HC:	return std::make_unique<Compressor_LZ4HC_c> ( iCompressionLevel );
+#if WITH_ZSTD
+		case Compression_e::ZSTD:	return InitDynamicZstd() ? std::make_unique<Compressor_ZSTD_c> ( iCompressionLevel, dDict ) : nullptr;
+#else
+		case Compression_e::ZSTD:	return nullptr;
+#endif
 		default:					return std::make_unique<Compressor_None_c>();
 	}
 }
@@ -316,9 +506,9 @@ struct BlockUtil_t
 };
 
 
-class BlockCache_c : public LRUCache_T<HashKey_t, BlockData_t, BlockUtil_t>
+class BlockCache_c : public ShardedLRUCache_T<HashKey_t, BlockData_t, BlockUtil_t>
 {
-	using BASE = LRUCache_T<HashKey_t, BlockData_t, BlockUtil_t>;
+	using BASE = ShardedLRUCache_T<HashKey_t, BlockData_t, BlockUtil_t>;
 	using BASE::BASE;
 
 public:
@@ -599,9 +789,31 @@ bool Docstore_c::Init ( CSphString & sError )
 	m_uBlockSize = tReader.GetDword();
 	m_eCompression = Byte2Compression ( tReader.GetByte() );
 
-	m_pCompressor = CreateCompressor ( m_eCompression, m_iCompressionLevel );
+	CSphVector<BYTE> dDict;
+	if ( m_eCompression==Compression_e::ZSTD )
+	{
+		DWORD uDictSize = tReader.GetDword();
+		if ( uDictSize > MAX_SANE_DICT_SIZE )
+		{
+			sError.SetSprintf ( "Unable to load docstore: zstd dictionary too big (%u) in %s", uDictSize, m_sFilename.cstr() );
+			return false;
+		}
+
+		dDict.Resize ( uDictSize );
+		tReader.GetBytes ( dDict.Begin(), dDict.GetLength() );
+		if ( tReader.GetErrorFlag() )
+		{
+			sError.SetSprintf ( "Unable to load docstore: %s", tReader.GetErrorMessage().cstr() );
+			return false;
+		}
+	}
+
+	m_pCompressor = CreateCompressor ( m_eCompression, m_iCompressionLevel, dDict );
 	if ( !m_pCompressor )
+	{
+		sError.SetSprintf ( "Unable to load docstore: %s is compressed with %s, which is not available", m_sFilename.cstr(), CompressionToStr ( m_eCompression ).cstr() );
 		return false;
+	}
 
 	m_tFields.Load(tReader);
 
@@ -1002,6 +1214,12 @@ private:
 		CSphVector<CSphVector<BYTE>>	m_dFields;
 	};
 
+	struct PendingBlock_t
+	{
+		CSphVector<StoredDoc_t>	m_dDocs;
+		DWORD					m_uStoredLen = 0;
+	};
+
 	CSphString				m_sFilename;
 	CSphVector<StoredDoc_t>	m_dStoredDocs;
 	CSphVector<BYTE>		m_dHeader;
@@ -1021,6 +1239,14 @@ private:
 	CSphVector<SortedField_t>		m_dFieldSort;
 	CSphVector<CSphVector<BYTE>>	m_dCompressedBuffers;
 
+	// zstd dictionary is trained on the first blocks, so these are held back until there's enough of them
+	bool						m_bCollectSamples = false;
+	CSphVector<PendingBlock_t>	m_dPendingBlocks;
+	int64_t						m_iPendingBytes = 0;
+	CSphVector<BYTE>			m_dDict;
+
+	void	CollectSamples();
+	void	FlushPendingBlocks();
 	void	WriteInitialHeader();
 	void	WriteTrailingHeader();
 	void	WriteBlock();
@@ -1044,8 +1270,12 @@ bool DocstoreBuilder_c::Init ( CSphString & sError )
 {
 	m_pCompressor = CreateCompressor ( m_eCompression, m_iCompressionLevel );
 	if ( !m_pCompressor )
+	{
+		sError.SetSprintf ( "docstore compression '%s' is not available", CompressionToStr ( m_eCompression ).cstr() );
 		return false;
+	}
 
+	m_bCollectSamples = m_eCompression==Compression_e::ZSTD;
 	m_tWriter.SetBufferSize(m_iBufferSize);
 	return m_tWriter.OpenFile ( m_sFilename, sError );
 }
@@ -1084,15 +1314,85 @@ void DocstoreBuilder_c::AddDoc ( RowID_t tRowID, const Doc_t & tDoc )
 void DocstoreBuilder_c::Finalize()
 {
 	WriteBlock();
+	if ( m_bCollectSamples )
+		FlushPendingBlocks();
+
 	WriteTrailingHeader();
 }
 
 
+void DocstoreBuilder_c::CollectSamples()
+{
+	if ( m_dStoredDocs.GetLength() )
+	{
+		PendingBlock_t & tBlock = m_dPendingBlocks.Add();
+		tBlock.m_dDocs.SwapData ( m_dStoredDocs );
+		tBlock.m_uStoredLen = m_uStoredLen;
+		m_iPendingBytes += m_uStoredLen;
+	}
+
+	m_uStoredLen = 0;
+	m_dStoredDocs.Resize(0);
+
+	// zstd guidelines suggest ~100x of dictionary size as training set
+	const int64_t ZSTD_TRAIN_SIZE = 4*1048576;
+	if ( m_iPendingBytes>=ZSTD_TRAIN_SIZE )
+		FlushPendingBlocks();
+}
+
+
+void DocstoreBuilder_c::FlushPendingBlocks()
+{
+	assert ( m_bCollectSamples );
+
+#if WITH_ZSTD
+	// every document is a sample
+	CSphVector<BYTE> dSamples;
+	CSphVector<size_t> dSampleSizes;
+	for ( const auto & tBlock : m_dPendingBlocks )
+		for ( const auto & tDoc : tBlock.m_dDocs )
+		{
+			size_t uSize = 0;
+			for ( const auto & dField : tDoc.m_dFields )
+			{
+				dSamples.Append ( dField );
+				uSize += dField.GetLength();
+			}
+
+			if ( uSize )
+				dSampleSizes.Add ( uSize );
+		}
+
+	m_dDict = TrainZstdDictionary ( dSamples, dSampleSizes );
+	m_pCompressor = CreateCompressor ( m_eCompression, m_iCompressionLevel, m_dDict );
+#endif
+
+	m_bCollectSamples = false;
+	WriteInitialHeader();
+
+	for ( auto & tBlock : m_dPendingBlocks )
+	{
+		m_dStoredDocs.SwapData ( tBlock.m_dDocs );
+		m_uStoredLen = tBlock.m_uStoredLen;
+		WriteBlock();
+	}
+
+	m_dPendingBlocks.Reset();
+	m_iPendingBytes = 0;
+}
+
+
 void DocstoreBuilder_c::WriteInitialHeader()
 {
-	m_tWriter.PutDword ( STORAGE_VERSION );
+	m_tWriter.PutDword ( m_eCompression==Compression_e::ZSTD ? STORAGE_VERSION : STORAGE_VERSION_NO_DICT );
 	m_tWriter.PutDword ( m_uBlockSize );
 	m_tWriter.PutByte ( Compression2Byte(m_eCompression) );
+	if ( m_eCompression==Compression_e::ZSTD )
+	{
+		m_tWriter.PutDword ( m_dDict.GetLength() );
+		m_tWriter.PutBytes ( m_dDict.Begin(), m_dDict.GetLength() );
+	}
+
 	m_tFields.Save(m_tWriter);
 
 	m_tHeaderOffset = m_tWriter.GetPos();
@@ -1294,6 +1594,12 @@ void DocstoreBuilder_c::WriteBigBlock()
 
 void DocstoreBuilder_c::WriteBlock()
 {
+	if ( m_bCollectSamples )
+	{
+		CollectSamples();
+		return;
+	}
+
 	if ( !m_tWriter.GetPos() )
 		WriteInitialHeader();
 
@@ -1628,11 +1934,22 @@ bool DocstoreChecker_c::Check()
 
 	m_tReader.GetDword();	// block size
 	BYTE uCompression = m_tReader.GetByte();
-	if ( uCompression > 2 )
+	if ( uCompression > 3 )
 		return m_tReporter.Fail ( "Unknown docstore compression %u in %s", uCompression, m_szFilename );
 
 	Compression_e eCompression = Byte2Compression(uCompression);
-	m_pCompressor = CreateCompressor ( eCompression, DEFAULT_COMPRESSION_LEVEL );
+	CSphVector<BYTE> dDict;
+	if ( eCompression==Compression_e::ZSTD )
+	{
+		DWORD uDictSize = m_tReader.GetDword();
+		if ( uDictSize > MAX_SANE_DICT_SIZE )
+			return m_tReporter.Fail ( "Docstore zstd dictionary too big (%u) in %s", uDictSize, m_szFilename );
+
+		dDict.Resize ( uDictSize );
+		m_tReader.GetBytes ( dDict.Begin(), dDict.GetLength() );
+	}
+
+	m_pCompressor = CreateCompressor ( eCompression, DEFAULT_COMPRESSION_LEVEL, dDict );
 	if ( !m_pCompressor )
 		return m_tReporter.Fail ( "Unable to create compressor in %s", m_szFilename );
 
@@ -1953,6 +2270,23 @@ void ShutdownDocstore()
 }
 
 
+DocstoreCacheStats_t GetDocstoreCacheStats()
+{
+	DocstoreCacheStats_t tStats;
+	BlockCache_c * pBlockCache = BlockCache_c::Get();
+	if ( !pBlockCache )
+		return tStats;
+
+	LRUCacheStats_t tCache = pBlockCache->GetStats();
+	tStats.m_iMaxBytes = tCache.m_iMaxBytes;
+	tStats.m_iUsedBytes = tCache.m_iUsedBytes;
+	tStats.m_iEntries = tCache.m_iEntries;
+	tStats.m_iEvictions = tCache.m_iEvictions;
+	tStats.m_iContended = tCache.m_iContended;
+	return tStats;
+}
+
+
 bool CheckDocstore ( CSphAutoreader & tReader, DebugCheckError_i & tReporter, int64_t iRowsCount )
 {
 	DocstoreChecker_c tChecker ( tReader, tReporter, iRowsCount );
@@ -122,8 +122,18 @@ std::unique_ptr<DocstoreBuilder_i>	CreateDocstoreBuilder ( const CSphString & sF
 std::unique_ptr<DocstoreRT_i>		CreateDocstoreRT();
 std::unique_ptr<DocstoreFields_i>	CreateDocstoreFields();
 
+struct DocstoreCacheStats_t
+{
+	int64_t	m_iMaxBytes = 0;
+	int64_t	m_iUsedBytes = 0;
+	int64_t	m_iEntries = 0;
+	int64_t	m_iEvictions = 0;
+	int64_t	m_iContended = 0;	///< lookups which had to wait for the lock of their cache shard
+};
+
 void				InitDocstore ( int64_t iCacheSize );
 void				ShutdownDocstore();
+DocstoreCacheStats_t GetDocstoreCacheStats();
 
 class DebugCheckError_i;
 class CSphAutoreader;
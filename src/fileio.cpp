@@ -675,6 +675,13 @@ void CSphWriter::CloseFile ( bool bTruncate )
 }
 
 
+const CSphString & CSphWriter::GetErrorMessage () const
+{
+	static const CSphString sNoError;
+	return m_pError ? *m_pError : sNoError;
+}
+
+
 void CSphWriter::UpdatePoolUsed()
 {
 	if ( m_pPool-m_pBuffer.get() > m_iPoolUsed )
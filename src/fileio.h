@@ -231,6 +231,7 @@ public:
 	void			ZipOffset ( uint64_t uValue ) override;
 
 	bool			IsError () const	{ return m_bError; }
+	const CSphString & GetErrorMessage () const;	///< error reported into the sError given to OpenFile()/SetFile()
 	SphOffset_t		GetPos () const		{ return m_iPos; }
 	CSphString		GetFilename() const	{ return m_sName; }
 
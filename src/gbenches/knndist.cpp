@@ -0,0 +1,99 @@
+//
+// Copyright (c) 2024, Manticore Software LTD (https://manticoresearch.com)
+// All rights reserved
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License. You should have
+// received a copy of the GPL license along with this program; if you
+// did not, you can find it at http://www.gnu.org/
+//
+
+#include <benchmark/benchmark.h>
+
+#include "knndist.h"
+
+static float ScalarL2Sqr ( const float * pA, const float * pB, int iDims )
+{
+	float fRes = 0.0f;
+	for ( int i = 0; i < iDims; i++ )
+	{
+		float fDiff = pA[i]-pB[i];
+		fRes += fDiff*fDiff;
+	}
+
+	return fRes;
+}
+
+static float ScalarDot ( const float * pA, const float * pB, int iDims )
+{
+	float fRes = 0.0f;
+	for ( int i = 0; i < iDims; i++ )
+		fRes += pA[i]*pB[i];
+
+	return fRes;
+}
+
+// 1024 vectors of state.range(0) dims, scored against one point
+class bench_knndist : public benchmark::Fixture
+{
+public:
+	static constexpr int NUM_VECTORS = 1024;
+
+	void SetUp ( const ::benchmark::State & state ) override
+	{
+		sphSrand(0);
+		iDims = (int)state.range(0);
+		dPoint.Resize(iDims);
+		for ( auto & i : dPoint )
+			i = sphRand() / float(UINT_MAX);
+
+		dVectors.Resize ( iDims*NUM_VECTORS );
+		for ( auto & i : dVectors )
+			i = sphRand() / float(UINT_MAX);
+	}
+
+	int iDims = 0;
+	CSphVector<float> dPoint;
+	CSphVector<float> dVectors;
+};
+
+BENCHMARK_DEFINE_F( bench_knndist, l2_scalar ) ( benchmark::State & st )
+{
+	for ( auto _ : st )
+		for ( int i = 0; i < NUM_VECTORS; i++ )
+			benchmark::DoNotOptimize ( ScalarL2Sqr ( dVectors.Begin() + i*iDims, dPoint.Begin(), iDims ) );
+
+	st.SetItemsProcessed ( st.iterations()*NUM_VECTORS );
+}
+
+BENCHMARK_DEFINE_F( bench_knndist, l2_native ) ( benchmark::State & st )
+{
+	for ( auto _ : st )
+		for ( int i = 0; i < NUM_VECTORS; i++ )
+			benchmark::DoNotOptimize ( KNNDistL2Sqr ( dVectors.Begin() + i*iDims, dPoint.Begin(), iDims ) );
+
+	st.SetItemsProcessed ( st.iterations()*NUM_VECTORS );
+}
+
+BENCHMARK_DEFINE_F( bench_knndist, dot_scalar ) ( benchmark::State & st )
+{
+	for ( auto _ : st )
+		for ( int i = 0; i < NUM_VECTORS; i++ )
+			benchmark::DoNotOptimize ( ScalarDot ( dVectors.Begin() + i*iDims, dPoint.Begin(), iDims ) );
+
+	st.SetItemsProcessed ( st.iterations()*NUM_VECTORS );
+}
+
+BENCHMARK_DEFINE_F( bench_knndist, dot_native ) ( benchmark::State & st )
+{
+	for ( auto _ : st )
+		for ( int i = 0; i < NUM_VECTORS; i++ )
+			benchmark::DoNotOptimize ( KNNDistDot ( dVectors.Begin() + i*iDims, dPoint.Begin(), iDims ) );
+
+	st.SetItemsProcessed ( st.iterations()*NUM_VECTORS );
+}
+
+BENCHMARK_REGISTER_F( bench_knndist, l2_scalar )->Arg(128)->Arg(768);
+BENCHMARK_REGISTER_F( bench_knndist, l2_native )->Arg(128)->Arg(768);
+BENCHMARK_REGISTER_F( bench_knndist, dot_scalar )->Arg(128)->Arg(768);
+BENCHMARK_REGISTER_F( bench_knndist, dot_native )->Arg(128)->Arg(768);
@@ -0,0 +1,115 @@
+//
+// Copyright (c) 2024, Manticore Software LTD (https://manticoresearch.com)
+// All rights reserved
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License. You should have
+// received a copy of the GPL license along with this program; if you
+// did not, you can find it at http://www.gnu.org
+//
+
+#include <benchmark/benchmark.h>
+
+#include "sphinxrt.h"
+#include "std/bitpack.h"
+
+// decoding of RAM segment doclists: varint vs packed (rt_doclist_format)
+
+class bench_rtdoclist : public benchmark::Fixture
+{
+public:
+	void SetUp ( const ::benchmark::State & state ) override
+	{
+		sphSrand ( 0 );
+		m_tSchema.AddAttr ( CSphColumnInfo ( sphGetDocidName(), SPH_ATTR_BIGINT ), false );
+		m_pVarint = MakeSegment ( RtDocFormat_e::VARINT, (int)state.range ( 0 ), (int)state.range ( 1 ) );
+		m_pPacked = MakeSegment ( RtDocFormat_e::PACKED, (int)state.range ( 0 ), (int)state.range ( 1 ) );
+	}
+
+	void TearDown ( const ::benchmark::State & ) override
+	{
+		m_pVarint = nullptr;
+		m_pPacked = nullptr;
+	}
+
+	// one word with iDocs docs, rowids step up to iMaxGap
+	RtSegmentRefPtf_t MakeSegment ( RtDocFormat_e eFormat, int iDocs, int iMaxGap )
+	{
+		RtSegmentRefPtf_t pSeg { new RtSegment_t ( 0, m_tSchema ) };
+		pSeg->m_eDocFormat = eFormat;
+
+		sphSrand ( 0 );
+		{
+			RtDocWriter_c tWriter ( pSeg->m_dDocs, eFormat );
+			RtDoc_t tDoc;
+			tDoc.m_tRowID = 0;
+			for ( int i = 0; i < iDocs; ++i )
+			{
+				tDoc.m_tRowID += 1 + sphRand() % iMaxGap;
+				tDoc.m_uDocFields = 1 << ( sphRand() % 4 );
+				tDoc.m_uHits = sphRand() % 4 ? 1 : 2 + sphRand() % 8;
+				tDoc.m_uHit = tDoc.m_uHits==1 ? HITMAN::Create ( sphRand() % 4, sphRand() % 1000 ) : i * 4;
+				tWriter << tDoc;
+			}
+		}
+
+		m_tWord.m_uDocs = iDocs;
+		m_tWord.m_uDoc = 0;
+		return pSeg;
+	}
+
+	static void Decode ( benchmark::State & st, const RtSegment_t * pSeg, const RtWord_t & tWord )
+	{
+		RtDocReader_c tReader;
+		for ( auto _ : st )
+		{
+			tReader.Init ( pSeg, tWord );
+			RowID_t tSum = 0;
+			while ( tReader.UnzipDoc() )
+				tSum += tReader->m_tRowID + tReader->m_uHits;
+			benchmark::DoNotOptimize ( tSum );
+		}
+		st.SetItemsProcessed ( st.iterations() * tWord.m_uDocs );
+		st.counters["bytes_per_doc"] = double ( pSeg->m_dDocs.GetLength() ) / tWord.m_uDocs;
+	}
+
+	CSphSchema m_tSchema;
+	RtSegmentRefPtf_t m_pVarint;
+	RtSegmentRefPtf_t m_pPacked;
+	RtWord_t m_tWord;
+};
+
+BENCHMARK_DEFINE_F ( bench_rtdoclist, varint ) ( benchmark::State & st )
+{
+	Decode ( st, m_pVarint, m_tWord );
+}
+
+BENCHMARK_DEFINE_F ( bench_rtdoclist, packed ) ( benchmark::State & st )
+{
+	Decode ( st, m_pPacked, m_tWord );
+}
+
+// docs count, max rowid gap
+BENCHMARK_REGISTER_F ( bench_rtdoclist, varint )->ArgsProduct ( { { 1000, 100000 }, { 1, 16, 1000 } } );
+BENCHMARK_REGISTER_F ( bench_rtdoclist, packed )->ArgsProduct ( { { 1000, 100000 }, { 1, 16, 1000 } } );
+
+
+static void BM_bitunpack ( benchmark::State & st )
+{
+	int iWidth = (int)st.range ( 0 );
+	DWORD dValues[BITPACK_GROUP];
+	BYTE dPacked[BitpackGroupBytes ( 32 )];
+	DWORD uMask = iWidth==32 ? 0xFFFFFFFFU : ( 1U << iWidth ) - 1;
+	for ( auto & uValue : dValues )
+		uValue = sphRand() & uMask;
+	BitpackGroup ( dValues, dPacked, iWidth );
+
+	for ( auto _ : st )
+	{
+		BitunpackGroup ( dPacked, dValues, iWidth );
+		benchmark::DoNotOptimize ( dValues );
+	}
+	st.SetItemsProcessed ( st.iterations() * BITPACK_GROUP );
+}
+
+BENCHMARK ( BM_bitunpack )->DenseRange ( 1, 32, 7 );
@@ -0,0 +1,240 @@
+//
+// Copyright (c) 2017-2024, Manticore Software LTD (https://manticoresearch.com)
+// All rights reserved
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License. You should have
+// received a copy of the GPL license along with this program; if you
+// did not, you can find it at http://www.gnu.org/
+//
+
+#include "groupspill.h"
+
+#include "attribute.h"
+#include "fileutils.h"
+#include "sphinxutils.h"
+#include "threadutils.h"
+#include "schema/ischema.h"
+
+#include <atomic>
+
+static const int SPILL_READ_BUFFER = 65536;
+
+static CSphString GetSpillDir()
+{
+#if _WIN32
+	const char * szDir = getenv ( "TEMP" );
+	const char * szDefault = ".";
+#else
+	const char * szDir = getenv ( "TMPDIR" );
+	const char * szDefault = "/tmp";
+#endif
+	return ( szDir && *szDir ) ? szDir : szDefault;
+}
+
+
+GroupSpill_c::~GroupSpill_c()
+{
+	Reset();
+}
+
+
+bool GroupSpill_c::OpenFile()
+{
+	static std::atomic<int> iFiles { 0 };
+
+	CSphString sName;
+	sName.SetSprintf ( "%s/groupby_%d_%d.tmp", GetSpillDir().cstr(), GetOsProcessId(), iFiles.fetch_add ( 1, std::memory_order_relaxed ) );
+	if ( m_tFile.Open ( sName, SPH_O_NEW, m_sError, true )<0 )
+		return false;
+
+	m_pWriter = std::make_unique<CSphWriter>();
+	m_pWriter->SetFile ( m_tFile, nullptr, m_sError );
+	return true;
+}
+
+
+void GroupSpill_c::SetupPtrAttrs ( const ISphSchema & tSchema )
+{
+	m_pSchema = &tSchema;
+	m_iDynamic = tSchema.GetDynamicSize();
+	m_dPtrAttrs.Resize(0);
+	for ( int i = 0; i < tSchema.GetAttrsCount(); i++ )
+	{
+		const CSphColumnInfo & tAttr = tSchema.GetAttr(i);
+		if ( tAttr.IsDataPtr() && tAttr.m_tLocator.m_bDynamic )
+			m_dPtrAttrs.Add ( tAttr.m_tLocator.m_iBitOffset >> ROWITEM_SHIFT );
+	}
+}
+
+
+void GroupSpill_c::WriteMatch ( const CSphMatch & tMatch )
+{
+	CSphWriter & tWriter = *m_pWriter;
+	tWriter.PutDword ( tMatch.m_tRowID );
+	tWriter.PutDword ( tMatch.m_iWeight );
+	tWriter.PutDword ( tMatch.m_iTag );
+	tWriter.Write ( tMatch.m_pStatic ); // static rows belong to the index, which outlives the query
+	tWriter.PutBytes ( tMatch.m_pDynamic, m_iDynamic*sizeof(CSphRowitem) );
+
+	// 0 is null, otherwise length+1 and the data
+	for ( auto iPtr : m_dPtrAttrs )
+	{
+		const BYTE * pData = *(const BYTE **)( tMatch.m_pDynamic+iPtr );
+		if ( !pData )
+		{
+			tWriter.ZipInt(0);
+			continue;
+		}
+
+		ByteBlob_t tBlob = sphUnpackPtrAttr ( pData );
+		tWriter.ZipInt ( tBlob.second+1 );
+		tWriter.PutBytes ( tBlob.first, tBlob.second );
+	}
+}
+
+
+bool GroupSpill_c::AddRun ( const VecTraits_T<CSphMatch> & dMatches, const VecTraits_T<int> & dOrder, const ISphSchema & tSchema )
+{
+	if ( m_bWriteFailed )
+		return false;
+
+	if ( !m_pWriter && !OpenFile() )
+	{
+		m_bWriteFailed = true;
+		sphWarning ( "group-by spill disabled: %s", m_sError.cstr() );
+		return false;
+	}
+
+	SetupPtrAttrs ( tSchema );
+
+	Run_t & tRun = m_dRuns.Add();
+	tRun.m_iStart = m_pWriter->GetPos();
+	for ( auto i : dOrder )
+		WriteMatch ( dMatches[i] );
+
+	// runs are read with pread, so they must be on disk before the merge
+	m_pWriter->Flush();
+	tRun.m_iEnd = m_pWriter->GetPos();
+	if ( !m_pWriter->IsError() )
+		return true;
+
+	// partial run is useless; the runs written before are still fine to merge
+	m_dRuns.Pop();
+	m_bWriteFailed = true;
+	sphWarning ( "group-by spill disabled: %s", m_sError.cstr() );
+	return false;
+}
+
+
+bool GroupSpill_c::ReadMatch ( int iRun )
+{
+	CSphReader & tReader = m_dReaders[iRun];
+	if ( tReader.GetPos()>=m_dRuns[iRun].m_iEnd )
+		return false;
+
+	CSphMatch & tMatch = m_dCurrent[iRun];
+	m_pSchema->FreeDataPtrs ( tMatch );
+	tMatch.Reset ( m_iDynamic );
+
+	tMatch.m_tRowID = tReader.GetDword();
+	tMatch.m_iWeight = (int)tReader.GetDword();
+	tMatch.m_iTag = (int)tReader.GetDword();
+	tReader.GetBytes ( &tMatch.m_pStatic, sizeof(tMatch.m_pStatic) );
+	tReader.GetBytes ( tMatch.m_pDynamic, m_iDynamic*sizeof(CSphRowitem) );
+
+	for ( auto iPtr : m_dPtrAttrs )
+		*(BYTE **)( tMatch.m_pDynamic+iPtr ) = nullptr;
+
+	for ( auto iPtr : m_dPtrAttrs )
+	{
+		DWORD uLength = tReader.UnzipInt();
+		if ( !uLength || tReader.GetErrorFlag() )
+			continue;
+
+		BYTE * pData = nullptr;
+		*(BYTE **)( tMatch.m_pDynamic+iPtr ) = sphPackPtrAttr ( uLength-1, &pData );
+		tReader.GetBytes ( pData, uLength-1 );
+	}
+
+	if ( !tReader.GetErrorFlag() )
+		return true;
+
+	m_sError = tReader.GetErrorMessage();
+	return false;
+}
+
+
+bool GroupSpill_c::StartMerge ( const ISphSchema & tSchema, const CSphAttrLocator & tLocGroupby )
+{
+	assert ( m_pWriter );
+	m_sError = "";
+	SetupPtrAttrs ( tSchema );
+	m_tLocGroupby = tLocGroupby;
+
+	int iRuns = m_dRuns.GetLength();
+	m_dReaders.Reset ( iRuns );
+	m_dCurrent.Reset ( iRuns );
+	m_tQueue.Reset ( iRuns );
+	m_iPopped = -1;
+
+	ARRAY_FOREACH ( i, m_dRuns )
+	{
+		const Run_t & tRun = m_dRuns[i];
+		CSphReader & tReader = m_dReaders[i];
+		tReader.SetBuffers ( SPILL_READ_BUFFER, 0 );
+		tReader.SetFile ( m_tFile );
+		tReader.SeekTo ( tRun.m_iStart, (int)Min ( tRun.m_iEnd-tRun.m_iStart, SPILL_READ_BUFFER ) );
+
+		if ( ReadMatch(i) )
+			m_tQueue.Push ( { m_dCurrent[i].GetAttr ( m_tLocGroupby ), i } );
+		else if ( !m_sError.IsEmpty() )
+			return false;
+	}
+
+	return true;
+}
+
+
+const CSphMatch * GroupSpill_c::Next()
+{
+	// the match returned last time was consumed by now; refill its run
+	if ( m_iPopped>=0 && ReadMatch ( m_iPopped ) )
+		m_tQueue.Push ( { m_dCurrent[m_iPopped].GetAttr ( m_tLocGroupby ), m_iPopped } );
+
+	m_iPopped = -1;
+	if ( !m_tQueue.GetLength() || !m_sError.IsEmpty() )
+		return nullptr;
+
+	m_iPopped = m_tQueue.Root().m_iRun;
+	m_tQueue.Pop();
+	return &m_dCurrent[m_iPopped];
+}
+
+
+void GroupSpill_c::FreeMatches()
+{
+	if ( !m_pSchema )
+		return;
+
+	for ( auto & tMatch : m_dCurrent )
+		m_pSchema->FreeDataPtrs ( tMatch );
+
+	m_dCurrent.Reset(0);
+}
+
+
+void GroupSpill_c::Reset()
+{
+	FreeMatches();
+	m_dReaders.Reset(0);
+	m_tQueue.Clear();
+	m_iPopped = -1;
+
+	m_pWriter.reset();
+	m_tFile.Close();
+	m_dRuns.Resize(0);
+	m_pSchema = nullptr;
+	m_sError = "";
+	m_bWriteFailed = false;
+}
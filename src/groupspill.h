@@ -0,0 +1,77 @@
+//
+// Copyright (c) 2017-2024, Manticore Software LTD (https://manticoresearch.com)
+// All rights reserved
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License. You should have
+// received a copy of the GPL license along with this program; if you
+// did not, you can find it at http://www.gnu.org/
+//
+
+#pragma once
+
+#include "fileio.h"
+#include "grouper.h"
+#include "std/queue.h"
+
+/// runs of grouped matches that group-by sorter moves to a temporary file instead of dropping the worst groups
+/// every run is sorted by group key, so all the runs can be merged back in one pass with every group coming complete
+class GroupSpill_c : public ISphNoncopyable
+{
+public:
+					~GroupSpill_c();
+
+	/// write all the groups (must be sorted by group key) as a new run; creates the file on the first run
+	bool			AddRun ( const VecTraits_T<CSphMatch> & dMatches, const VecTraits_T<int> & dOrder, const ISphSchema & tSchema );
+	bool			IsEmpty() const { return m_dRuns.IsEmpty(); }
+	const CSphString & GetError() const { return m_sError; }
+
+	/// start merging runs back; matches returned by Next() are in group key order (by run on equal keys)
+	bool			StartMerge ( const ISphSchema & tSchema, const CSphAttrLocator & tLocGroupby );
+	const CSphMatch * Next();
+
+	/// drop all the runs and the file
+	void			Reset();
+
+private:
+	struct Run_t
+	{
+		SphOffset_t		m_iStart = 0;
+		SphOffset_t		m_iEnd = 0;
+	};
+
+	struct QueuedRun_t
+	{
+		SphGroupKey_t	m_uKey;
+		int				m_iRun;
+
+		static bool IsLess ( const QueuedRun_t & a, const QueuedRun_t & b )
+		{
+			if ( a.m_uKey!=b.m_uKey )
+				return a.m_uKey<b.m_uKey;
+
+			return a.m_iRun<b.m_iRun;
+		}
+	};
+
+	CSphAttrLocator					m_tLocGroupby;
+	CSphAutofile					m_tFile;
+	std::unique_ptr<CSphWriter>		m_pWriter;
+	CSphVector<Run_t>				m_dRuns;
+	CSphString						m_sError;
+	bool							m_bWriteFailed = false;	///< no more runs after a write error (e.g. disk full)
+
+	const ISphSchema *				m_pSchema = nullptr;
+	int								m_iDynamic = 0;
+	CSphVector<int>					m_dPtrAttrs;	///< dynamic rowitems that hold data ptrs
+	CSphFixedVector<CSphReader>		m_dReaders { 0 };
+	CSphFixedVector<CSphMatch>		m_dCurrent { 0 };
+	CSphQueue<QueuedRun_t,QueuedRun_t> m_tQueue { 1 };
+	int								m_iPopped = -1;
+
+	bool			OpenFile();
+	void			SetupPtrAttrs ( const ISphSchema & tSchema );
+	void			WriteMatch ( const CSphMatch & tMatch );
+	bool			ReadMatch ( int iRun );
+	void			FreeMatches();
+};
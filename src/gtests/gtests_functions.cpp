@@ -20,6 +20,10 @@
 #include "histogram.h"
 #include "conversion.h"
 #include "digest_sha1.h"
+#include "std/bitpack.h"
+#include "std/freqsketch.h"
+#include "std/lrucache.h"
+#include "knndist.h"
 
 // Miscelaneous short functional tests: TDigest, SpanSearch,
 // stringbuilder, CJson, TaggedHash, Log2
@@ -196,6 +200,39 @@ TEST ( functions, Log2 )
 	ASSERT_EQ ( sphLog2 ( 0x7fffffffffffffffULL ), 63 );
 }
 
+TEST ( functions, Bitpack )
+{
+	sphSrand ( 0 );
+	DWORD dValues[BITPACK_GROUP];
+	DWORD dUnpacked[BITPACK_GROUP];
+	BYTE dPacked[BitpackGroupBytes ( 32 )+1];
+
+	for ( int iWidth = 0; iWidth<=32; ++iWidth )
+	{
+		DWORD uMax = iWidth==32 ? 0xFFFFFFFFU : ( 1U << iWidth ) - 1;
+		for ( int iPass = 0; iPass<3; ++iPass )
+		{
+			// random values, all ones, and the top value only in the last slot (so that the width is exactly iWidth)
+			for ( int i = 0; i<BITPACK_GROUP; ++i )
+				dValues[i] = iPass==0 ? ( sphRand() & uMax ) : ( iPass==1 ? uMax : 0 );
+			dValues[BITPACK_GROUP-1] = uMax;
+
+			ASSERT_EQ ( BitpackWidth ( dValues, BITPACK_GROUP ), iWidth ) << "width " << iWidth;
+
+			// pack at unaligned offset, and make sure nothing is written past the group
+			memset ( dPacked, 0xAB, sizeof ( dPacked ) );
+			BitpackGroup ( dValues, dPacked+1, iWidth );
+			if ( iWidth<32 )
+				ASSERT_EQ ( dPacked[BitpackGroupBytes ( iWidth )+1], 0xAB ) << "width " << iWidth;
+
+			memset ( dUnpacked, 0, sizeof ( dUnpacked ) );
+			BitunpackGroup ( dPacked+1, dUnpacked, iWidth );
+			for ( int i = 0; i<BITPACK_GROUP; ++i )
+				ASSERT_EQ ( dUnpacked[i], dValues[i] ) << "width " << iWidth << ", value " << i;
+		}
+	}
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 TEST ( functions, sphCalcZippedLen )
@@ -2240,3 +2277,260 @@ TEST ( functions, mutate_via_ref )
 	ASSERT_EQ ( refData->GetRefcount (), 1 );
 
 }
+
+//////////////////////////////////////////////////////////////////////////
+
+TEST ( functions, FrequencySketch )
+{
+	FrequencySketch_c tSketch ( 64 );
+	const DWORD uHot = 0xDEADBEEF;
+	const DWORD uCold = 0x12345678;
+
+	for ( int i = 0; i<5; ++i )
+		tSketch.Increment ( uHot );
+
+	EXPECT_EQ ( tSketch.Estimate ( uHot ), 5 );
+	EXPECT_EQ ( tSketch.Estimate ( uCold ), 0 );
+
+	// counters saturate
+	for ( int i = 0; i<100; ++i )
+		tSketch.Increment ( uHot );
+	EXPECT_EQ ( tSketch.Estimate ( uHot ), FrequencySketch_c::MAX_COUNT );
+
+	tSketch.SetMax ( uCold );
+	EXPECT_EQ ( tSketch.Estimate ( uCold ), FrequencySketch_c::MAX_COUNT );
+}
+
+TEST ( functions, FrequencySketch_aging )
+{
+	FrequencySketch_c tSketch ( 64 );
+	const DWORD uHot = 0xDEADBEEF;
+	for ( int i = 0; i<FrequencySketch_c::MAX_COUNT; ++i )
+		tSketch.Increment ( uHot );
+
+	// many other keys make the sketch halve all the counters at some point
+	DWORD uKey = 1;
+	for ( ; uKey<100000 && tSketch.Estimate ( uHot )==FrequencySketch_c::MAX_COUNT; ++uKey )
+		tSketch.Increment ( uKey*0x9E3779B1 );
+
+	ASSERT_LT ( uKey, 100000U ) << "counters were never aged";
+	EXPECT_GE ( tSketch.Estimate ( uHot ), FrequencySketch_c::MAX_COUNT/2 );
+}
+
+TEST ( functions, FrequencySketch_concurrent )
+{
+	FrequencySketch_c tSketch ( 1024 );
+	const DWORD uHot = 0xDEADBEEF;
+
+	constexpr int NTHREADS = 4;
+	SphThread_t dThreads[NTHREADS];
+	for ( int i = 0; i<NTHREADS; ++i )
+		ASSERT_TRUE ( Threads::Create ( &dThreads[i], [&tSketch, i]
+		{
+			for ( DWORD j = 0; j<10000; ++j )
+			{
+				tSketch.Increment ( uHot );
+				tSketch.Increment ( ( j*NTHREADS+i )*0x9E3779B1 );
+				tSketch.Estimate ( j );
+			}
+		} ) );
+
+	for ( auto & tThread : dThreads )
+		ASSERT_TRUE ( Threads::Join ( &tThread ) );
+
+	// increments may get lost on races, but the hot key is still the hottest one
+	EXPECT_GT ( tSketch.Estimate ( uHot ), 0 );
+	EXPECT_LE ( tSketch.Estimate ( uHot ), FrequencySketch_c::MAX_COUNT );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// entries are ints of fixed size; the value holds the key, to check what comes back
+struct TestCacheUtil_t
+{
+	static constexpr DWORD ENTRY_SIZE = 1000;
+
+	static DWORD GetHash ( int64_t iKey ) { return (DWORD)iKey; } // deliberately poor, as the cache has to mix it anyway
+	static DWORD GetSize ( int64_t * pValue ) { return pValue ? ENTRY_SIZE : 0; }
+	static void Reset ( int64_t * & pValue ) { SafeDelete ( pValue ); }
+};
+
+using TestCache_c = LRUCache_T<int64_t, int64_t *, TestCacheUtil_t>;
+using TestShardedCache_c = ShardedLRUCache_T<int64_t, int64_t *, TestCacheUtil_t>;
+
+// Add() leaves the new entry in use, as Find() does
+template <typename CACHE>
+static bool TestCacheAdd ( CACHE & tCache, int64_t iKey )
+{
+	auto * pValue = new int64_t ( iKey );
+	if ( !tCache.Add ( iKey, pValue ) )
+	{
+		SafeDelete ( pValue );
+		return false;
+	}
+
+	tCache.Release ( iKey );
+	return true;
+}
+
+static int64_t TestCacheEntrySize()
+{
+	TestCache_c tCache ( 1000000 );
+	TestCacheAdd ( tCache, 1 );
+	return tCache.GetStats().m_iUsedBytes;
+}
+
+TEST ( functions, LRUCache_eviction )
+{
+	const int64_t iEntry = TestCacheEntrySize();
+	TestCache_c tCache ( iEntry*3, iEntry );
+
+	int64_t * pValue = nullptr;
+	for ( int64_t i = 1; i<=3; ++i )
+		ASSERT_TRUE ( TestCacheAdd ( tCache, i ) );
+
+	// touch 1, so that 2 becomes the least recently used one
+	ASSERT_TRUE ( tCache.Find ( 1, pValue ) );
+	ASSERT_EQ ( *pValue, 1 );
+	tCache.Release ( 1 );
+
+	int64_t iVictim = 0;
+	ASSERT_TRUE ( tCache.GetVictim ( TestCacheUtil_t::ENTRY_SIZE, iVictim ) );
+	ASSERT_EQ ( iVictim, 2 );
+
+	ASSERT_TRUE ( TestCacheAdd ( tCache, 4 ) );
+	ASSERT_FALSE ( tCache.Find ( 2, pValue ) );
+	ASSERT_TRUE ( tCache.Find ( 1, pValue ) );
+	tCache.Release ( 1 );
+
+	// entries in use are never swept; 3 is the LRU now, but it is held
+	ASSERT_TRUE ( tCache.Find ( 3, pValue ) );
+	ASSERT_TRUE ( TestCacheAdd ( tCache, 5 ) );
+	ASSERT_TRUE ( tCache.Find ( 3, pValue ) );
+	ASSERT_EQ ( *pValue, 3 );
+	tCache.Release ( 3 );
+	tCache.Release ( 3 );
+
+	LRUCacheStats_t tStats = tCache.GetStats();
+	ASSERT_EQ ( tStats.m_iEntries, 3 );
+	ASSERT_EQ ( tStats.m_iEvictions, 2 );
+	ASSERT_LE ( tStats.m_iUsedBytes, tStats.m_iMaxBytes );
+
+	// too large for the cache at all
+	TestCache_c tSmall ( iEntry/2 );
+	ASSERT_FALSE ( TestCacheAdd ( tSmall, 6 ) );
+}
+
+TEST ( functions, ShardedLRUCache_distribution )
+{
+	const int64_t iEntry = TestCacheEntrySize();
+	const int NKEYS = 1600;
+
+	// sequential keys with identity hash fill the shards evenly; at half of the total size, none of them overflows
+	TestShardedCache_c tCache ( iEntry*NKEYS*2 );
+	for ( int64_t i = 0; i<NKEYS; ++i )
+		ASSERT_TRUE ( TestCacheAdd ( tCache, i ) );
+
+	LRUCacheStats_t tStats = tCache.GetStats();
+	ASSERT_EQ ( tStats.m_iEntries, NKEYS );
+	ASSERT_EQ ( tStats.m_iEvictions, 0 );
+	ASSERT_EQ ( tStats.m_iMaxBytes, iEntry*NKEYS*2 );
+
+	int iFound = 0;
+	tCache.ForEach ( [&iFound] ( int64_t iKey, int64_t * pValue ) { iFound += ( *pValue==iKey ); } );
+	ASSERT_EQ ( iFound, NKEYS );
+
+	// over the total size, every shard evicts by itself
+	for ( int64_t i = NKEYS; i<NKEYS*4; ++i )
+		TestCacheAdd ( tCache, i );
+
+	tStats = tCache.GetStats();
+	ASSERT_GT ( tStats.m_iEvictions, 0 );
+	ASSERT_LE ( tStats.m_iUsedBytes, tStats.m_iMaxBytes );
+
+	tCache.Delete ( [] ( int64_t ) { return true; } );
+	ASSERT_EQ ( tCache.GetStats().m_iEntries, 0 );
+}
+
+TEST ( functions, ShardedLRUCache_concurrent )
+{
+	const int64_t iEntry = TestCacheEntrySize();
+	TestShardedCache_c tCache ( iEntry*256 );
+
+	constexpr int NTHREADS = 4;
+	std::atomic<int> iErrors { 0 };
+	SphThread_t dThreads[NTHREADS];
+	for ( int i = 0; i<NTHREADS; ++i )
+		ASSERT_TRUE ( Threads::Create ( &dThreads[i], [&tCache, &iErrors, i]
+		{
+			for ( int j = 0; j<20000; ++j )
+			{
+				int64_t iKey = ( j*7919 + i*104729 ) % 1024;
+				int64_t * pValue = nullptr;
+				if ( tCache.Find ( iKey, pValue ) )
+				{
+					if ( *pValue!=iKey )
+						iErrors.fetch_add ( 1, std::memory_order_relaxed );
+					tCache.Release ( iKey );
+					continue;
+				}
+
+				TestCacheAdd ( tCache, iKey ); // fails if somebody else was quicker, or no space
+			}
+		} ) );
+
+	for ( auto & tThread : dThreads )
+		ASSERT_TRUE ( Threads::Join ( &tThread ) );
+
+	ASSERT_EQ ( iErrors.load(), 0 );
+	LRUCacheStats_t tStats = tCache.GetStats();
+	ASSERT_GT ( tStats.m_iEntries, 0 );
+	ASSERT_LE ( tStats.m_iUsedBytes, tStats.m_iMaxBytes );
+}
+
+
+// native knn kernels must agree with plain scalar loops, including the tails past the last full simd register
+static void CheckKNNKernels ( int iDims )
+{
+	CSphVector<float> dA ( iDims ), dB ( iDims );
+	for ( int i = 0; i < iDims; ++i )
+	{
+		dA[i] = float ( sphRand() % 2001 ) / 1000.0f - 1.0f;
+		dB[i] = float ( sphRand() % 2001 ) / 1000.0f - 1.0f;
+	}
+
+	double fL2 = 0.0, fDot = 0.0, fL2Abs = 0.0, fDotAbs = 0.0;
+	for ( int i = 0; i < iDims; ++i )
+	{
+		double fDiff = double(dA[i]) - dB[i];
+		fL2 += fDiff*fDiff;
+		fL2Abs += fDiff*fDiff;
+		fDot += double(dA[i])*dB[i];
+		fDotAbs += fabs ( double(dA[i])*dB[i] );
+	}
+
+	// summation order differs between kernels, so allow for float rounding of every term
+	const double EPS = 1e-6;
+	ASSERT_NEAR ( KNNDistL2Sqr ( dA.Begin(), dB.Begin(), iDims ), fL2, EPS*( fL2Abs+1.0 ) ) << "dims " << iDims;
+	ASSERT_NEAR ( KNNDistDot ( dA.Begin(), dB.Begin(), iDims ), fDot, EPS*( fDotAbs+1.0 ) ) << "dims " << iDims;
+
+	// tail elements must be counted exactly once
+	CSphVector<float> dZero ( iDims );
+	dZero.Fill ( 0.0f );
+	CSphVector<float> dOnes ( iDims );
+	dOnes.Fill ( 1.0f );
+	ASSERT_FLOAT_EQ ( KNNDistL2Sqr ( dOnes.Begin(), dZero.Begin(), iDims ), float(iDims) ) << "dims " << iDims;
+	ASSERT_FLOAT_EQ ( KNNDistDot ( dOnes.Begin(), dOnes.Begin(), iDims ), float(iDims) ) << "dims " << iDims;
+}
+
+TEST ( functions, KNNDistKernels )
+{
+	sphSrand ( 0 );
+
+	// every remainder modulo 4, 8 and 16 lanes, and the two-accumulator loops with and without a single-register step
+	for ( int iDims = 1; iDims <= 70; ++iDims )
+		CheckKNNKernels ( iDims );
+
+	for ( int iDims : { 127, 128, 129, 383, 384, 385, 767, 768, 769, 1536, 1537 } )
+		CheckKNNKernels ( iDims );
+}
@@ -19,6 +19,16 @@
 #include "searchdaemon.h"
 #include "binlog.h"
 #include "accumulator.h"
+#include "sphinx_alter.h"
+#include "knnlib.h"
+#include "knnmisc.h"
+#include "groupspill.h"
+#include "coroutine.h"
+#include "sphinxsearch.h"
+#include "indexcheck.h"
+#include "dict/dict_entry.h"
+#include "docstore.h"
+#include "joinsorter.h"
 
 #include <gmock/gmock.h>
 
@@ -30,7 +40,8 @@ static void DeleteIndexFiles ( const char * sIndex )
 		return;
 
 	const char * sExts[] = {
-		"kill", "lock", "meta", "ram", "0.spa", "0.spd", "0.spe", "0.sph", "0.spi", "0.spk", "0.spm", "0.spp" };
+		"kill", "lock", "meta", "ram", "0.spa", "0.spd", "0.spe", "0.sph", "0.spi", "0.spk", "0.spm", "0.spp",
+		"0.spb", "0.spt", "0.sphi", "0.spds", "0.spidx", "0.spjidx" };
 
 	CSphString sName;
 	for (auto & sExt : sExts)
@@ -654,3 +665,1452 @@ TEST_F ( RT, SendVsMerge )
 	pTok = nullptr; // owned and deleted by index
 	});
 }
+
+
+static void FillKNNVector ( DocID_t tDocID, CSphVector<float> & dVec )
+{
+	// coprime moduli keep all the vectors distinct
+	dVec.Resize(0);
+	dVec.Add ( float ( tDocID % 37 ) );
+	dVec.Add ( float ( tDocID % 41 ) );
+	dVec.Add ( float ( tDocID % 43 ) );
+	dVec.Add ( float ( tDocID / 1000 ) );
+}
+
+
+TEST_F ( RT, KNNAfterAlter )
+{
+	CSphString sKNNError;
+	if ( !IsKNNLibLoaded() && !InitKNN ( sKNNError ) )
+		GTEST_SKIP() << "knn library is not available: " << sKNNError.cstr();
+
+	Threads::CallCoroutine ( [&] {
+
+	const int DOCS_PER_COMMIT = 1100;	// large enough to have hnsw graphs in every segment
+	const int COMMITS_BEFORE_ALTER = 26;	// enough segments to start merging them
+	const int COMMITS_AFTER_ALTER = 4;
+
+	auto pDict = sphCreateDictionaryCRC ( tDictSettings, NULL, pTok, "rt", false, 32, nullptr, sError );
+
+	CSphSchema tSchema;
+	for ( int i=0; i<tSrcSchema.GetFieldsCount(); i++ )
+		tSchema.AddField ( tSrcSchema.GetField(i) );
+
+	tCol.m_sName = "id";
+	tCol.m_eAttrType = SPH_ATTR_BIGINT;
+	tSchema.AddAttr ( tCol, false );
+
+	// blob attr in front of the vector; dropping it moves the vector's locator
+	tCol.m_sName = "str";
+	tCol.m_eAttrType = SPH_ATTR_STRING;
+	tSchema.AddAttr ( tCol, false );
+
+	CSphColumnInfo tVec ( "vec", SPH_ATTR_FLOAT_VECTOR );
+	tVec.m_uAttrFlags |= CSphColumnInfo::ATTR_INDEXED_KNN;
+	tVec.m_tKNN.m_iDims = 4;
+	tVec.m_tKNN.m_eHNSWSimilarity = knn::HNSWSimilarity_e::L2;
+	tSchema.AddAttr ( tVec, false );
+
+	auto pIndex = sphCreateIndexRT ( "testrt", RT_INDEX_FILE_NAME, tSchema, 256 * 1024 * 1024, false );
+	pIndex->SetTokenizer ( pTok ); // index will own this pair from now on
+	pIndex->SetDictionary ( pDict );
+	pIndex->PostSetup ();
+	StrVec_t dWarnings;
+	ASSERT_TRUE ( pIndex->Prealloc ( false, nullptr, dWarnings ) );
+
+	CSphString sFilter;
+	CSphVector<float> dVec;
+	DocID_t tNextID = 1;
+	auto fnInsert = [&] ( int iCommits )
+	{
+		InsertDocData_c tDoc ( pIndex->GetMatchSchema() );
+		bool bHaveStr = !!pIndex->GetMatchSchema().GetAttr("str");
+		RtAccum_t tAcc;
+		for ( int iCommit = 0; iCommit<iCommits; iCommit++ )
+		{
+			for ( int i = 0; i<DOCS_PER_COMMIT; i++ )
+			{
+				tDoc.SetID ( tNextID );
+				tDoc.m_dFields[0] = VecTraits_T<const char> ( "title", 5 );
+				tDoc.m_dFields[1] = VecTraits_T<const char> ( "content", 7 );
+				tDoc.m_dStrings.Resize(0);
+				if ( bHaveStr )
+					tDoc.m_dStrings.Add ( "some string" );
+
+				FillKNNVector ( tNextID, dVec );
+				tDoc.ResetMVAs();
+				tDoc.AddMVALength ( dVec.GetLength() );
+				for ( auto fValue : dVec )
+					tDoc.AddMVAValue ( sphF2DW(fValue) );
+
+				ASSERT_TRUE ( pIndex->AddDocument ( tDoc, false, sFilter, sError, sWarning, &tAcc ) ) << sError.cstr();
+				tNextID++;
+			}
+
+			pIndex->Commit ( nullptr, &tAcc );
+		}
+	};
+
+	AttrAddRemoveCtx_t tAlter;
+	tAlter.m_iBits = 0;
+	tAlter.m_uFlags = 0;
+	tAlter.m_eEngine = AttrEngine_e::DEFAULT;
+
+	// segments merged after the alter must read vectors at the new locators
+	fnInsert ( COMMITS_BEFORE_ALTER );
+	tAlter.m_sName = "str";
+	tAlter.m_eType = SPH_ATTR_STRING;
+	ASSERT_TRUE ( pIndex->AddRemoveAttribute ( false, tAlter, sError ) ) << sError.cstr();
+
+	fnInsert ( COMMITS_AFTER_ALTER );
+
+	// alter waits for running merges, so all the segments are settled after it
+	tAlter.m_sName = "tag";
+	tAlter.m_eType = SPH_ATTR_INTEGER;
+	ASSERT_TRUE ( pIndex->AddRemoveAttribute ( true, tAlter, sError ) ) << sError.cstr();
+
+	CSphQuery tQuery;
+	tQuery.m_sSelect = "*";
+	CSphQueryItem & tItem = tQuery.m_dItems.Add();
+	tItem.m_sExpr = "*";
+	tItem.m_sAlias = "*";
+	tQuery.m_eSort = SPH_SORT_EXTENDED;
+	tQuery.m_sSortBy = "knn_dist() asc";
+	tQuery.m_sKNNAttr = "vec";
+	tQuery.m_iKNNK = 5;
+	auto pParser = sphCreatePlainQueryParser();
+	tQuery.m_pQueryParser = pParser.get();
+
+	SphQueueSettings_t tQueueSettings ( pIndex->GetMatchSchema() );
+	tQueueSettings.m_bComputeItems = true;
+
+	// every document must be found as the nearest to its own vector
+	for ( DocID_t tDocID = 1; tDocID<tNextID; tDocID += 997 )
+	{
+		FillKNNVector ( tDocID, tQuery.m_dKNNVec );
+
+		AggrResult_t tResult;
+		CSphQueryResult tQueryResult;
+		tQueryResult.m_pMeta = &tResult;
+		CSphMultiQueryArgs tArgs ( 1 );
+		SphQueueRes_t tRes;
+		auto pSorter = sphCreateQueue ( tQueueSettings, tQuery, tResult.m_sError, tRes );
+		ASSERT_TRUE ( pSorter ) << tResult.m_sError.cstr();
+		ASSERT_TRUE ( pIndex->MultiQuery ( tQueryResult, tQuery, { &pSorter, 1 }, tArgs ) );
+		auto & tOneRes = tResult.m_dResults.Add();
+		tOneRes.FillFromSorter ( pSorter );
+
+		tResult.m_tSchema = *pSorter->GetSchema();
+		const CSphColumnInfo * pId = tResult.m_tSchema.GetAttr("id");
+		const CSphColumnInfo * pDist = tResult.m_tSchema.GetAttr ( GetKnnDistAttrName() );
+		ASSERT_TRUE ( pId && pDist );
+
+		const CSphMatch * pBest = nullptr;
+		for ( const auto & tMatch : tOneRes.m_dMatches )
+			if ( !pBest || tMatch.GetAttrFloat ( pDist->m_tLocator ) < pBest->GetAttrFloat ( pDist->m_tLocator ) )
+				pBest = &tMatch;
+
+		ASSERT_TRUE ( pBest );
+		ASSERT_EQ ( pBest->GetAttr ( pId->m_tLocator ), tDocID );
+		ASSERT_FLOAT_EQ ( pBest->GetAttrFloat ( pDist->m_tLocator ), 0.0f );
+
+		SafeDelete ( pSorter );
+	}
+
+	pTok = nullptr; // owned and deleted by index
+	});
+}
+
+// rt index with a 4-dim knn vector (and a 'tag' attr, if asked to); docs 1..iDocs go to one ram segment
+static std::unique_ptr<RtIndex_i> CreateKNNTestIndex ( const CSphSchema & tSrcSchema, const CSphDictSettings & tDictSettings, TokenizerRefPtr_c pTok, int iDocs, bool bTag, CSphString & sError )
+{
+	auto pDict = sphCreateDictionaryCRC ( tDictSettings, NULL, pTok, "rt", false, 32, nullptr, sError );
+
+	CSphSchema tSchema;
+	for ( int i=0; i<tSrcSchema.GetFieldsCount(); i++ )
+		tSchema.AddField ( tSrcSchema.GetField(i) );
+
+	tSchema.AddAttr ( CSphColumnInfo ( "id", SPH_ATTR_BIGINT ), false );
+	if ( bTag )
+		tSchema.AddAttr ( CSphColumnInfo ( "tag", SPH_ATTR_INTEGER ), false );
+
+	CSphColumnInfo tVec ( "vec", SPH_ATTR_FLOAT_VECTOR );
+	tVec.m_uAttrFlags |= CSphColumnInfo::ATTR_INDEXED_KNN;
+	tVec.m_tKNN.m_iDims = 4;
+	tVec.m_tKNN.m_eHNSWSimilarity = knn::HNSWSimilarity_e::L2;
+	tSchema.AddAttr ( tVec, false );
+
+	auto pIndex = sphCreateIndexRT ( "testrt", RT_INDEX_FILE_NAME, tSchema, 256 * 1024 * 1024, false );
+	pIndex->SetTokenizer ( pTok ); // index will own this pair from now on
+	pIndex->SetDictionary ( pDict );
+	pIndex->PostSetup ();
+	StrVec_t dWarnings;
+	EXPECT_TRUE ( pIndex->Prealloc ( false, nullptr, dWarnings ) );
+
+	CSphString sFilter, sWarning;
+	CSphVector<float> dVec;
+	InsertDocData_c tDoc ( pIndex->GetMatchSchema() );
+	const CSphColumnInfo * pTag = pIndex->GetMatchSchema().GetAttr("tag");
+	RtAccum_t tAcc;
+	for ( DocID_t tDocID = 1; tDocID<=iDocs; tDocID++ )
+	{
+		tDoc.SetID ( tDocID );
+		tDoc.m_dFields[0] = VecTraits_T<const char> ( "title", 5 );
+		tDoc.m_dFields[1] = VecTraits_T<const char> ( "content", 7 );
+		if ( pTag )
+			tDoc.m_tDoc.SetAttr ( pTag->m_tLocator, tDocID % 1000 );
+
+		FillKNNVector ( tDocID, dVec );
+		tDoc.ResetMVAs();
+		tDoc.AddMVALength ( dVec.GetLength() );
+		for ( auto fValue : dVec )
+			tDoc.AddMVAValue ( sphF2DW(fValue) );
+
+		EXPECT_TRUE ( pIndex->AddDocument ( tDoc, false, sFilter, sError, sWarning, &tAcc ) ) << sError.cstr();
+	}
+	pIndex->Commit ( nullptr, &tAcc );
+
+	return pIndex;
+}
+
+
+// knn query nearest to the vector of tQueryDoc
+static void SetupKNNTestQuery ( CSphQuery & tQuery, DocID_t tQueryDoc, int iK )
+{
+	tQuery.m_sSelect = "*";
+	CSphQueryItem & tItem = tQuery.m_dItems.Add();
+	tItem.m_sExpr = "*";
+	tItem.m_sAlias = "*";
+	tQuery.m_eSort = SPH_SORT_EXTENDED;
+	tQuery.m_sSortBy = "knn_dist() asc";
+	tQuery.m_sKNNAttr = "vec";
+	tQuery.m_iKNNK = iK;
+	FillKNNVector ( tQueryDoc, tQuery.m_dKNNVec );
+}
+
+
+// ids of the matches and the knn iterators reported for the query
+static CSphVector<SphAttr_t> RunKNNTestQuery ( RtIndex_i * pIndex, const CSphQuery & tQuery, IteratorStats_t * pStats = nullptr )
+{
+	SphQueueSettings_t tQueueSettings ( pIndex->GetMatchSchema() );
+	tQueueSettings.m_bComputeItems = true;
+
+	AggrResult_t tResult;
+	CSphQueryResult tQueryResult;
+	tQueryResult.m_pMeta = &tResult;
+	CSphMultiQueryArgs tArgs ( 1 );
+	SphQueueRes_t tRes;
+	std::unique_ptr<ISphMatchSorter> pSorter { sphCreateQueue ( tQueueSettings, tQuery, tResult.m_sError, tRes ) };
+	EXPECT_TRUE ( pSorter ) << tResult.m_sError.cstr();
+	if ( !pSorter )
+		return {};
+
+	ISphMatchSorter * pRawSorter = pSorter.get();
+	EXPECT_TRUE ( pIndex->MultiQuery ( tQueryResult, tQuery, { &pRawSorter, 1 }, tArgs ) ) << tResult.m_sError.cstr();
+	auto & tOneRes = tResult.m_dResults.Add();
+	tOneRes.FillFromSorter ( pRawSorter );
+
+	const CSphColumnInfo * pId = pSorter->GetSchema()->GetAttr("id");
+	EXPECT_TRUE ( pId );
+	if ( !pId )
+		return {};
+
+	if ( pStats )
+		*pStats = tResult.m_tIteratorStats;
+
+	CSphVector<SphAttr_t> dIds;
+	for ( const auto & tMatch : tOneRes.m_dMatches )
+		dIds.Add ( tMatch.GetAttr ( pId->m_tLocator ) );
+
+	return dIds;
+}
+
+
+// killed rows are still in the graph of their ram segment; knn search must look past them and still return k rows
+TEST_F ( RT, KNNKilledRows )
+{
+	CSphString sKNNError;
+	if ( !IsKNNLibLoaded() && !InitKNN ( sKNNError ) )
+		GTEST_SKIP() << "knn library is not available: " << sKNNError.cstr();
+
+	Threads::CallCoroutine ( [&] {
+
+	const int NUM_DOCS = 3000;
+	const int NUM_KILLED = 300;	// all of them around the query point
+	const int K = 10;
+	const DocID_t QUERY_DOC = 1500;
+
+	auto pIndex = CreateKNNTestIndex ( tSrcSchema, tDictSettings, pTok, NUM_DOCS, false, sError );
+
+	// kill the nearest neighbours of the query point, so that the nodes the graph search finds first are all dead
+	CSphVector<float> dQuery, dVec;
+	FillKNNVector ( QUERY_DOC, dQuery );
+
+	CSphVector<std::pair<float, DocID_t>> dByDist;
+	for ( DocID_t tDocID = 1; tDocID<=NUM_DOCS; tDocID++ )
+	{
+		FillKNNVector ( tDocID, dVec );
+		float fDist = 0.0f;
+		ARRAY_FOREACH ( i, dVec )
+			fDist += ( dVec[i]-dQuery[i] )*( dVec[i]-dQuery[i] );
+
+		dByDist.Add ( { fDist, tDocID } );
+	}
+	dByDist.Sort();
+
+	CSphVector<DocID_t> dKilled;
+	for ( int i = 0; i<NUM_KILLED; i++ )
+		dKilled.Add ( dByDist[i].second );
+
+	RtAccum_t tAcc;
+	ASSERT_TRUE ( pIndex->DeleteDocument ( dKilled, sError, &tAcc ) ) << sError.cstr();
+	pIndex->Commit ( nullptr, &tAcc );
+	dKilled.Uniq();
+
+	CSphQuery tQuery;
+	SetupKNNTestQuery ( tQuery, QUERY_DOC, K );
+	auto pParser = sphCreatePlainQueryParser();
+	tQuery.m_pQueryParser = pParser.get();
+
+	auto dIds = RunKNNTestQuery ( pIndex.get(), tQuery );
+	ASSERT_EQ ( dIds.GetLength(), K );
+	for ( auto tID : dIds )
+		ASSERT_FALSE ( dKilled.BinarySearch(tID) ) << "killed row " << tID << " returned";
+
+	pTok = nullptr; // owned and deleted by index
+	});
+}
+
+
+// ram segments count rows that pass filters (a sample first, exact counts if it rejects anything) to plan knn search;
+// disk chunks estimate them
+TEST_F ( RT, KNNFilterPlan )
+{
+	CSphString sKNNError;
+	if ( !IsKNNLibLoaded() && !InitKNN ( sKNNError ) )
+		GTEST_SKIP() << "knn library is not available: " << sKNNError.cstr();
+
+	Threads::CallCoroutine ( [&] {
+
+	const int NUM_DOCS = 3000;	// tag = id%1000, so 'tag<=N' passes 3*(N+1) docs
+	const int K = 10;
+
+	auto pIndex = CreateKNNTestIndex ( tSrcSchema, tDictSettings, pTok, NUM_DOCS, true, sError );
+	auto pParser = sphCreatePlainQueryParser();
+
+	struct Case_t
+	{
+		int			m_iMaxTag;		// -1 means no filter
+		const char * m_szRamMode;
+		const char * m_szDiskMode;	// disk chunks estimate filtered docs with histograms; nullptr to skip the check
+	};
+
+	// default hnsw settings; brute force over ~1200 docs costs about the same as a filtered graph search
+	const Case_t dCases[] = {
+		{ -1,	"KNNGraph",			"KNNGraph" },			// no filters
+		{ 999,	"KNNGraph",			nullptr },				// filter passes everything, the sample tells that
+		{ 899,	"KNNFilteredGraph",	"KNNExpandedGraph" },	// 90% pass; a wider beam is cheaper than brute force
+		{ 99,	"KNNBruteForce",	"KNNBruteForce" },		// 10% pass
+		{ 0,	"KNNBruteForce",	"KNNBruteForce" },		// 3 docs pass, less than k
+	};
+
+	auto fnCheck = [&] ( bool bDisk )
+	{
+		for ( const auto & tCase : dCases )
+		{
+			CSphQuery tQuery;
+			SetupKNNTestQuery ( tQuery, 1500, K );
+			tQuery.m_pQueryParser = pParser.get();
+			if ( tCase.m_iMaxTag>=0 )
+			{
+				CSphFilterSettings & tFilter = tQuery.m_dFilters.Add();
+				tFilter.m_sAttrName = "tag";
+				tFilter.m_eType = SPH_FILTER_RANGE;
+				tFilter.m_iMinValue = 0;
+				tFilter.m_iMaxValue = tCase.m_iMaxTag;
+			}
+
+			IteratorStats_t tStats;
+			auto dIds = RunKNNTestQuery ( pIndex.get(), tQuery, &tStats );
+
+			const char * szMode = bDisk ? tCase.m_szDiskMode : tCase.m_szRamMode;
+			ASSERT_EQ ( tStats.m_dIterators.GetLength(), 1 ) << ( bDisk ? "disk" : "ram" ) << ", tag<=" << tCase.m_iMaxTag;
+			if ( szMode )
+				ASSERT_STREQ ( tStats.m_dIterators[0].m_sType.cstr(), szMode ) << ( bDisk ? "disk" : "ram" ) << ", tag<=" << tCase.m_iMaxTag;
+
+			// k rows that pass the filter, or all of them if there are fewer
+			int iPassing = tCase.m_iMaxTag>=0 ? 3*( tCase.m_iMaxTag+1 ) : NUM_DOCS;
+			ASSERT_EQ ( dIds.GetLength(), Min ( K, iPassing ) ) << ( bDisk ? "disk" : "ram" ) << ", tag<=" << tCase.m_iMaxTag;
+			if ( tCase.m_iMaxTag>=0 )
+				for ( auto tID : dIds )
+					ASSERT_LE ( tID % 1000, tCase.m_iMaxTag ) << "id " << tID << " does not pass tag<=" << tCase.m_iMaxTag;
+		}
+	};
+
+	fnCheck ( false );
+
+	// small disk chunks always brute force filtered knn queries, unless pseudo sharding is off (as in the test suite)
+	ASSERT_TRUE ( pIndex->ForceDiskChunk() );
+	SetPseudoShardingThresh(0);
+	fnCheck ( true );
+	SetPseudoShardingThresh(8192);
+
+	pTok = nullptr; // owned and deleted by index
+	});
+}
+
+
+TEST ( KNN, FilterPlan )
+{
+	CSphQuery tQuery;
+	tQuery.m_iKNNK = 10;
+	knn::IndexSettings_t tSettings;
+	tSettings.m_iDims = 128;
+	const int64_t TOTAL = 1000000;
+
+	// nothing is filtered out: plain graph search with k and ef of the query
+	KNNFilterPlan_t tPlan = PlanFilteredKNN ( tQuery, tSettings, TOTAL, TOTAL, true );
+	ASSERT_EQ ( tPlan.m_eMode, KNNFilterMode_e::GRAPH );
+	ASSERT_EQ ( tPlan.m_iK, 10 );
+
+	// half of the rows pass: the graph either skips the rest with a wider beam, or returns more candidates to filter afterwards
+	tPlan = PlanFilteredKNN ( tQuery, tSettings, TOTAL, TOTAL/2, true );
+	ASSERT_EQ ( tPlan.m_eMode, KNNFilterMode_e::FILTERED_GRAPH );
+	ASSERT_EQ ( tPlan.m_iK, 10 );
+	ASSERT_EQ ( tPlan.m_iEf, CalcKNNExpandedK ( 10, TOTAL, TOTAL/2 ) );
+	ASSERT_GT ( tPlan.m_iEf, 10 );
+
+	tPlan = PlanFilteredKNN ( tQuery, tSettings, TOTAL, TOTAL/2, false );
+	ASSERT_EQ ( tPlan.m_eMode, KNNFilterMode_e::EXPANDED_GRAPH );
+	ASSERT_EQ ( tPlan.m_iK, CalcKNNExpandedK ( 10, TOTAL, TOTAL/2 ) );
+	ASSERT_GE ( tPlan.m_iEf, tPlan.m_iK );
+
+	// very selective filters: exact distances to the rows that pass
+	tPlan = PlanFilteredKNN ( tQuery, tSettings, TOTAL, 100, false );
+	ASSERT_EQ ( tPlan.m_eMode, KNNFilterMode_e::BRUTEFORCE );
+	ASSERT_EQ ( tPlan.m_iK, 10 );
+
+	// expanded k covers the whole table
+	tPlan = PlanFilteredKNN ( tQuery, tSettings, 100, 5, false );
+	ASSERT_EQ ( tPlan.m_eMode, KNNFilterMode_e::BRUTEFORCE );
+
+	// filter costs of either variant tip the balance
+	ASSERT_EQ ( PlanFilteredKNN ( tQuery, tSettings, TOTAL, TOTAL/2, false, 1e9f, 0.0f ).m_eMode, KNNFilterMode_e::BRUTEFORCE );
+	ASSERT_EQ ( PlanFilteredKNN ( tQuery, tSettings, TOTAL, 100, false, 0.0f, 1e9f ).m_eMode, KNNFilterMode_e::EXPANDED_GRAPH );
+
+	// there is a single switch point: once the graph wins, less selective filters never go back to brute force
+	for ( bool bFilterAware : { false, true } )
+	{
+		bool bGraph = false;
+		for ( int64_t iFiltered = 1; iFiltered<TOTAL; iFiltered *= 2 )
+		{
+			bool bBruteForce = PlanFilteredKNN ( tQuery, tSettings, TOTAL, iFiltered, bFilterAware ).m_eMode==KNNFilterMode_e::BRUTEFORCE;
+			ASSERT_FALSE ( bGraph && bBruteForce ) << iFiltered << " of " << TOTAL;
+			bGraph |= !bBruteForce;
+		}
+
+		ASSERT_TRUE ( bGraph );
+		ASSERT_EQ ( PlanFilteredKNN ( tQuery, tSettings, TOTAL, 1, bFilterAware ).m_eMode, KNNFilterMode_e::BRUTEFORCE );
+	}
+}
+
+
+// disk chunks bigger than a job are searched as several rowid ranges in parallel; strings of the matches must
+// still be taken from the blob pool of their own chunk
+TEST_F ( RT, ChunkJobsStrings )
+{
+	Threads::CallCoroutine ( [&] {
+
+	const int NUM_CHUNKS = 2;
+	const int DOCS_PER_CHUNK = 70000;	// a bit more than a single job
+	const int DOCS_PER_COMMIT = 10000;
+	const int MAX_MATCHES = 200;
+
+	auto pDict = sphCreateDictionaryCRC ( tDictSettings, NULL, pTok, "rt", false, 32, nullptr, sError );
+
+	CSphSchema tSchema;
+	for ( int i=0; i<tSrcSchema.GetFieldsCount(); i++ )
+		tSchema.AddField ( tSrcSchema.GetField(i) );
+
+	tSchema.AddAttr ( CSphColumnInfo ( "id", SPH_ATTR_BIGINT ), false );
+	tSchema.AddAttr ( CSphColumnInfo ( "str", SPH_ATTR_STRING ), false );
+	tSchema.AddAttr ( CSphColumnInfo ( "num", SPH_ATTR_INTEGER ), false );
+
+	auto pIndex = sphCreateIndexRT ( "testrt", RT_INDEX_FILE_NAME, tSchema, 256 * 1024 * 1024, false );
+	pIndex->SetTokenizer ( pTok ); // index will own this pair from now on
+	pIndex->SetDictionary ( pDict );
+	pIndex->PostSetup ();
+	StrVec_t dWarnings;
+	ASSERT_TRUE ( pIndex->Prealloc ( false, nullptr, dWarnings ) );
+
+	// num is spread over all the docs, so the top of 'num asc' comes from every chunk and every range of it
+	auto fnNum = [] ( int64_t iDoc ) { return int ( ( iDoc*7919 ) % 100003 ); };
+	auto fnStr = [] ( int64_t iDoc ) { return SphSprintf ( "str" INT64_FMT, iDoc ); };
+
+	const CSphAttrLocator & tNumLoc = pIndex->GetMatchSchema().GetAttr("num")->m_tLocator;
+	CSphString sFilter;
+	InsertDocData_c tDoc ( pIndex->GetMatchSchema() );
+	RtAccum_t tAcc;
+	int64_t iDoc = 1;
+	for ( int iChunk = 0; iChunk<NUM_CHUNKS; iChunk++ )
+	{
+		for ( int i = 0; i<DOCS_PER_CHUNK; i++, iDoc++ )
+		{
+			CSphString sStr = fnStr ( iDoc );
+			tDoc.SetID ( iDoc );
+			tDoc.m_dFields[0] = VecTraits_T<const char> ( "title", 5 );
+			tDoc.m_dFields[1] = VecTraits_T<const char> ( "content", 7 );
+			tDoc.m_tDoc.SetAttr ( tNumLoc, fnNum ( iDoc ) );
+			tDoc.m_dStrings.Resize(0);
+			tDoc.m_dStrings.Add ( sStr.cstr() );
+			ASSERT_TRUE ( pIndex->AddDocument ( tDoc, false, sFilter, sError, sWarning, &tAcc ) ) << sError.cstr();
+			if ( ( i+1 ) % DOCS_PER_COMMIT==0 )
+				pIndex->Commit ( nullptr, &tAcc );
+		}
+		pIndex->Commit ( nullptr, &tAcc );
+		ASSERT_TRUE ( pIndex->ForceDiskChunk() );
+	}
+
+	CSphQuery tQuery;
+	tQuery.m_sSelect = "*";
+	CSphQueryItem & tItem = tQuery.m_dItems.Add();
+	tItem.m_sExpr = "*";
+	tItem.m_sAlias = "*";
+	tQuery.m_eSort = SPH_SORT_EXTENDED;
+	tQuery.m_sSortBy = "num asc, id asc";
+	tQuery.m_iMaxMatches = MAX_MATCHES;
+	auto pParser = sphCreatePlainQueryParser();
+	tQuery.m_pQueryParser = pParser.get();
+
+	for ( int iThreads : { 1, 4 } )
+	{
+		AggrResult_t tResult;
+		CSphQueryResult tQueryResult;
+		tQueryResult.m_pMeta = &tResult;
+		CSphMultiQueryArgs tArgs ( 1 );
+		tArgs.m_iThreads = iThreads;
+
+		SphQueueSettings_t tQueueSettings ( pIndex->GetMatchSchema() );
+		tQueueSettings.m_bComputeItems = true;
+		tQueueSettings.m_iMaxMatches = MAX_MATCHES;
+		SphQueueRes_t tRes;
+		std::unique_ptr<ISphMatchSorter> pSorter { sphCreateQueue ( tQueueSettings, tQuery, tResult.m_sError, tRes ) };
+		ASSERT_TRUE ( pSorter ) << tResult.m_sError.cstr();
+		ISphMatchSorter * pRawSorter = pSorter.get();
+		ASSERT_TRUE ( pIndex->MultiQuery ( tQueryResult, tQuery, { &pRawSorter, 1 }, tArgs ) ) << tResult.m_sError.cstr();
+		auto & tOneRes = tResult.m_dResults.Add();
+		tOneRes.FillFromSorter ( pRawSorter );
+		ASSERT_EQ ( tResult.m_iTotalMatches, NUM_CHUNKS*DOCS_PER_CHUNK );
+		ASSERT_EQ ( tOneRes.m_dMatches.GetLength(), MAX_MATCHES );
+
+		const ISphSchema & tSorterSchema = *pSorter->GetSchema();
+		const CSphColumnInfo * pId = tSorterSchema.GetAttr("id");
+		const CSphColumnInfo * pStr = tSorterSchema.GetAttr("str");
+		ASSERT_TRUE ( pId && pStr );
+		ASSERT_EQ ( pStr->m_eAttrType, SPH_ATTR_STRINGPTR );
+
+		for ( const auto & tMatch : tOneRes.m_dMatches )
+		{
+			SphAttr_t tID = tMatch.GetAttr ( pId->m_tLocator );
+			ByteBlob_t tBlob = sphUnpackPtrAttr ( (const BYTE *)tMatch.GetAttr ( pStr->m_tLocator ) );
+			ASSERT_STREQ ( CSphString ( (const char *)tBlob.first, tBlob.second ).cstr(), fnStr ( tID ).cstr() ) << iThreads << " threads";
+		}
+	}
+
+	pTok = nullptr; // owned and deleted by index
+	});
+}
+
+
+// batched joins prefetch right table matches for many left keys at once; the output must be the same as of per-row joins
+TEST_F ( RT, JoinBatches )
+{
+	Threads::CallCoroutine ( [&] {
+
+	const char * RIGHT_INDEX_FILE_NAME = "test_temp_right";
+	DeleteIndexFiles ( RIGHT_INDEX_FILE_NAME );
+
+	const int NUM_LEFT = 300;
+	const int NUM_KEYS = 97;		// left keys repeat; 97 is not a multiple of any batch size below
+	const int NUM_RIGHT_KEYS = 90;	// keys above that have no right matches
+
+	auto fnCreate = [&] ( const char * szName, const char * szPath, bool bRight )
+	{
+		CSphSchema tSchema;
+		for ( int i=0; i<tSrcSchema.GetFieldsCount(); i++ )
+			tSchema.AddField ( tSrcSchema.GetField(i) );
+
+		tSchema.AddAttr ( CSphColumnInfo ( "id", SPH_ATTR_BIGINT ), false );
+		tSchema.AddAttr ( CSphColumnInfo ( "k", SPH_ATTR_INTEGER ), false );
+		if ( bRight )
+			tSchema.AddAttr ( CSphColumnInfo ( "val", SPH_ATTR_INTEGER ), false );
+
+		TokenizerRefPtr_c pTokenizer = Tokenizer::Detail::CreateUTF8Tokenizer();
+		auto pDict = sphCreateDictionaryCRC ( tDictSettings, NULL, pTokenizer, szName, false, 32, nullptr, sError );
+		auto pIndex = sphCreateIndexRT ( szName, szPath, tSchema, 256 * 1024 * 1024, false );
+		pIndex->SetTokenizer ( pTokenizer );
+		pIndex->SetDictionary ( pDict );
+		pIndex->PostSetup();
+		StrVec_t dWarnings;
+		EXPECT_TRUE ( pIndex->Prealloc ( false, nullptr, dWarnings ) );
+		return pIndex;
+	};
+
+	auto pLeft = fnCreate ( "l", RT_INDEX_FILE_NAME, false );
+	auto pRight = fnCreate ( "r", RIGHT_INDEX_FILE_NAME, true );
+
+	CSphString sFilter;
+	RtAccum_t tAcc;
+	{
+		InsertDocData_c tDoc ( pLeft->GetMatchSchema() );
+		const CSphAttrLocator & tKeyLoc = pLeft->GetMatchSchema().GetAttr("k")->m_tLocator;
+		for ( int iDoc = 1; iDoc<=NUM_LEFT; iDoc++ )
+		{
+			tDoc.SetID ( iDoc );
+			tDoc.m_dFields[0] = VecTraits_T<const char> ( "title", 5 );
+			tDoc.m_dFields[1] = VecTraits_T<const char> ( "content", 7 );
+			tDoc.m_tDoc.SetAttr ( tKeyLoc, ( iDoc*31 ) % NUM_KEYS );
+			ASSERT_TRUE ( pLeft->AddDocument ( tDoc, false, sFilter, sError, sWarning, &tAcc ) ) << sError.cstr();
+		}
+		pLeft->Commit ( nullptr, &tAcc );
+	}
+
+	// key k has k%4 right matches, so there are keys without matches and keys with duplicates
+	auto fnNumRight = [NUM_RIGHT_KEYS] ( int iKey ) { return iKey<NUM_RIGHT_KEYS ? iKey % 4 : 0; };
+	{
+		InsertDocData_c tDoc ( pRight->GetMatchSchema() );
+		const CSphAttrLocator & tKeyLoc = pRight->GetMatchSchema().GetAttr("k")->m_tLocator;
+		const CSphAttrLocator & tValLoc = pRight->GetMatchSchema().GetAttr("val")->m_tLocator;
+		int64_t iDoc = 1;
+		for ( int iKey = 0; iKey<NUM_KEYS; iKey++ )
+			for ( int i = 0; i<fnNumRight(iKey); i++ )
+			{
+				tDoc.SetID ( iDoc++ );
+				tDoc.m_dFields[0] = VecTraits_T<const char> ( "title", 5 );
+				tDoc.m_dFields[1] = VecTraits_T<const char> ( "content", 7 );
+				tDoc.m_tDoc.SetAttr ( tKeyLoc, iKey );
+				tDoc.m_tDoc.SetAttr ( tValLoc, iKey*100 + i );
+				ASSERT_TRUE ( pRight->AddDocument ( tDoc, false, sFilter, sError, sWarning, &tAcc ) ) << sError.cstr();
+			}
+		pRight->Commit ( nullptr, &tAcc );
+	}
+
+	auto pParser = sphCreatePlainQueryParser();
+	using Row_t = std::tuple<SphAttr_t, SphAttr_t, SphAttr_t>;
+	auto fnJoin = [&] ( JoinType_e eJoinType, int iBatchKeys )
+	{
+		SetJoinBatchKeys ( iBatchKeys );
+
+		CSphQuery tQuery;
+		tQuery.m_sSelect = "id, k, r.val";
+		for ( const char * szItem : { "id", "k", "r.val" } )
+		{
+			CSphQueryItem & tItem = tQuery.m_dItems.Add();
+			tItem.m_sExpr = tItem.m_sAlias = szItem;
+		}
+		tQuery.m_eSort = SPH_SORT_EXTENDED;
+		tQuery.m_sSortBy = "id asc";
+		tQuery.m_iLimit = tQuery.m_iMaxMatches = 4*NUM_LEFT;
+		tQuery.m_pQueryParser = pParser.get();
+		tQuery.m_sJoinIdx = "r";
+		tQuery.m_eJoinType = eJoinType;
+		OnFilter_t & tOn = tQuery.m_dOnFilters.Add();
+		tOn.m_sIdx1 = "l";
+		tOn.m_sAttr1 = "k";
+		tOn.m_sIdx2 = "r";
+		tOn.m_sAttr2 = "k";
+
+		AggrResult_t tResult;
+		CSphQueryResult tQueryResult;
+		tQueryResult.m_pMeta = &tResult;
+		CSphMultiQueryArgs tArgs ( 1 );
+
+		SphQueueSettings_t tQueueSettings ( pLeft->GetMatchSchema() );
+		tQueueSettings.m_bComputeItems = true;
+		tQueueSettings.m_iMaxMatches = tQuery.m_iMaxMatches;
+		tQueueSettings.m_pJoinArgs = std::make_unique<JoinArgs_t> ( pRight->GetMatchSchema(), pLeft->GetName(), pRight->GetName() );
+		SphQueueRes_t tRes;
+		ISphMatchSorter * pRawSorter = sphCreateQueue ( tQueueSettings, tQuery, tResult.m_sError, tRes );
+		EXPECT_TRUE ( pRawSorter ) << tResult.m_sError.cstr();
+		if ( pRawSorter )
+			pRawSorter = CreateJoinSorter ( pLeft.get(), pRight.get(), tQueueSettings, tQuery, pRawSorter, tRes.m_bJoinedGroupSort, tResult.m_sError );
+
+		std::unique_ptr<ISphMatchSorter> pSorter { pRawSorter };
+		EXPECT_TRUE ( pSorter ) << tResult.m_sError.cstr();
+		CSphVector<Row_t> dRows;
+		if ( !pSorter )
+			return dRows;
+
+		EXPECT_TRUE ( pLeft->MultiQuery ( tQueryResult, tQuery, { &pRawSorter, 1 }, tArgs ) ) << tResult.m_sError.cstr();
+		auto & tOneRes = tResult.m_dResults.Add();
+		tOneRes.FillFromSorter ( pRawSorter );
+
+		const ISphSchema & tSchema = *pSorter->GetSchema();
+		const CSphColumnInfo * pId = tSchema.GetAttr("id");
+		const CSphColumnInfo * pKey = tSchema.GetAttr("k");
+		const CSphColumnInfo * pVal = tSchema.GetAttr("r.val");
+		EXPECT_TRUE ( pId && pKey && pVal );
+		if ( !pId || !pKey || !pVal )
+			return dRows;
+
+		for ( const auto & tMatch : tOneRes.m_dMatches )
+			dRows.Add ( { tMatch.GetAttr ( pId->m_tLocator ), tMatch.GetAttr ( pKey->m_tLocator ), tMatch.GetAttr ( pVal->m_tLocator ) } );
+
+		// matches of the same left row come in no particular order
+		dRows.Sort();
+		return dRows;
+	};
+
+	int iInnerRows = 0;
+	int iLeftRows = 0;
+	for ( int iDoc = 1; iDoc<=NUM_LEFT; iDoc++ )
+	{
+		int iRight = fnNumRight ( ( iDoc*31 ) % NUM_KEYS );
+		iInnerRows += iRight;
+		iLeftRows += Max ( iRight, 1 );
+	}
+
+	for ( auto eJoinType : { JoinType_e::INNER, JoinType_e::LEFT } )
+	{
+		auto dExpected = fnJoin ( eJoinType, 0 );	// per-row joins
+		ASSERT_EQ ( dExpected.GetLength(), eJoinType==JoinType_e::INNER ? iInnerRows : iLeftRows );
+
+		// several batches with a partial last one, a single batch of exactly all keys, the default
+		for ( int iBatchKeys : { 1, 7, NUM_KEYS, 1024 } )
+		{
+			auto dBatched = fnJoin ( eJoinType, iBatchKeys );
+			ASSERT_EQ ( dExpected.GetLength(), dBatched.GetLength() ) << "batch " << iBatchKeys;
+			ARRAY_FOREACH ( i, dExpected )
+				ASSERT_TRUE ( dExpected[i]==dBatched[i] ) << "batch " << iBatchKeys << ", row " << i;
+		}
+	}
+
+	SetJoinBatchKeys ( 1024 );
+	pRight.reset();
+	DeleteIndexFiles ( RIGHT_INDEX_FILE_NAME );
+	pTok = nullptr;
+	});
+}
+
+
+// (weight, id) of top-N matches, best first
+static CSphVector<std::pair<int, SphAttr_t>> SearchTopN ( RtIndex_i * pIndex, const CSphQuery & tQuery )
+{
+	AggrResult_t tResult;
+	CSphQueryResult tQueryResult;
+	tQueryResult.m_pMeta = &tResult;
+	CSphMultiQueryArgs tArgs ( 1 );
+
+	SphQueueSettings_t tQueueSettings ( pIndex->GetMatchSchema() );
+	tQueueSettings.m_bComputeItems = true;
+	tQueueSettings.m_iMaxMatches = tQuery.m_iMaxMatches;
+	SphQueueRes_t tRes;
+	std::unique_ptr<ISphMatchSorter> pSorter { sphCreateQueue ( tQueueSettings, tQuery, tResult.m_sError, tRes ) };
+	EXPECT_TRUE ( pSorter ) << tResult.m_sError.cstr();
+	if ( !pSorter )
+		return {};
+
+	ISphMatchSorter * pRawSorter = pSorter.get();
+	EXPECT_TRUE ( pIndex->MultiQuery ( tQueryResult, tQuery, { &pRawSorter, 1 }, tArgs ) ) << tResult.m_sError.cstr();
+	auto & tOneRes = tResult.m_dResults.Add();
+	tOneRes.FillFromSorter ( pRawSorter );
+
+	const CSphColumnInfo * pId = pSorter->GetSchema()->GetAttr("id");
+	EXPECT_TRUE ( pId );
+	if ( !pId )
+		return {};
+
+	CSphVector<std::pair<int, SphAttr_t>> dRes;
+	for ( const auto & tMatch : tOneRes.m_dMatches )
+		dRes.Add ( { tMatch.m_iWeight, tMatch.GetAttr ( pId->m_tLocator ) } );
+
+	dRes.Sort ( Lesser ( [] ( const auto & a, const auto & b ) { return a.first>b.first || ( a.first==b.first && a.second<b.second ); } ) );
+	return dRes;
+}
+
+
+// index format v.67 stores per-block max hits in skiplists; pruning by them must not change the top-N
+TEST_F ( RT, WeightPruning )
+{
+	Threads::CallCoroutine ( [&] {
+
+	const int NUM_DOCS = 3000;	// plenty of skiplist blocks for every term
+	const int DOCS_PER_COMMIT = 500;
+
+	auto pDict = sphCreateDictionaryCRC ( tDictSettings, NULL, pTok, "rt", false, 32, nullptr, sError );
+
+	CSphSchema tSchema;
+	for ( int i=0; i<tSrcSchema.GetFieldsCount(); i++ )
+		tSchema.AddField ( tSrcSchema.GetField(i) );
+
+	tCol.m_sName = "id";
+	tCol.m_eAttrType = SPH_ATTR_BIGINT;
+	tSchema.AddAttr ( tCol, false );
+
+	auto pIndex = sphCreateIndexRT ( "testrt", RT_INDEX_FILE_NAME, tSchema, 256 * 1024 * 1024, false );
+	pIndex->SetTokenizer ( pTok ); // index will own this pair from now on
+	pIndex->SetDictionary ( pDict );
+	pIndex->PostSetup ();
+	StrVec_t dWarnings;
+	ASSERT_TRUE ( pIndex->Prealloc ( false, nullptr, dWarnings ) );
+
+	// hits per doc differ a lot between docs, so per-block bounds differ too
+	CSphString sFilter;
+	InsertDocData_c tDoc ( pIndex->GetMatchSchema() );
+	RtAccum_t tAcc;
+	for ( int iDoc = 1; iDoc<=NUM_DOCS; iDoc++ )
+	{
+		StringBuilder_c sTitle ( " " ), sContent ( " " );
+		for ( int i = 0, iCats = 1 + ( iDoc*7919 ) % 9; i<iCats; i++ )
+			sTitle << "cat";
+		sTitle.Appendf ( "title%d", iDoc % 50 );
+		for ( int i = 0, iDogs = ( iDoc*104729 ) % 5; i<iDogs; i++ )
+			sContent << "dog";
+		for ( int i = 0, iFiller = iDoc % 13; i<iFiller; i++ )
+			sContent << "filler";
+
+		tDoc.SetID ( iDoc );
+		tDoc.m_dFields[0] = VecTraits_T<const char> ( sTitle.cstr(), sTitle.GetLength() );
+		tDoc.m_dFields[1] = VecTraits_T<const char> ( sContent.cstr(), sContent.GetLength() );
+		ASSERT_TRUE ( pIndex->AddDocument ( tDoc, false, sFilter, sError, sWarning, &tAcc ) ) << sError.cstr();
+		if ( iDoc % DOCS_PER_COMMIT==0 )
+			pIndex->Commit ( nullptr, &tAcc );
+	}
+	pIndex->Commit ( nullptr, &tAcc );
+
+	CSphQuery tQuery;
+	tQuery.m_sSelect = "*";
+	CSphQueryItem & tItem = tQuery.m_dItems.Add();
+	tItem.m_sExpr = "*";
+	tItem.m_sAlias = "*";
+	tQuery.m_eRanker = SPH_RANK_BM25;
+	tQuery.m_iMaxMatches = 20;
+	auto pParser = sphCreatePlainQueryParser();
+	tQuery.m_pQueryParser = pParser.get();
+
+	auto fnCheck = [&] ( const char * szStage )
+	{
+		for ( const char * szQuery : { "cat", "cat | dog", "cat dog", "cat -filler", "@title cat | @content dog" } )
+		{
+			tQuery.m_sQuery = szQuery;
+			tQuery.m_bWeightPruning = false;
+			auto dExpected = SearchTopN ( pIndex.get(), tQuery );
+			tQuery.m_bWeightPruning = true;
+			auto dPruned = SearchTopN ( pIndex.get(), tQuery );
+
+			ASSERT_FALSE ( dExpected.IsEmpty() ) << szStage << ": " << szQuery;
+			ASSERT_EQ ( dExpected.GetLength(), dPruned.GetLength() ) << szStage << ": " << szQuery;
+			ARRAY_FOREACH ( i, dExpected )
+			{
+				ASSERT_EQ ( dExpected[i].first, dPruned[i].first ) << szStage << ": " << szQuery << ", match " << i;
+				ASSERT_EQ ( dExpected[i].second, dPruned[i].second ) << szStage << ": " << szQuery << ", match " << i;
+			}
+		}
+	};
+
+	// ram segments only
+	fnCheck ( "ram" );
+
+	// disk chunk is written in the new format, with max hits in skiplists
+	ASSERT_TRUE ( pIndex->ForceDiskChunk() );
+	fnCheck ( "disk" );
+
+	// index check reads the skiplists back and compares them with the doclists (max hits included)
+	std::unique_ptr<DebugCheckError_i> pReporter { MakeDebugCheckError ( stdout, nullptr ) };
+	ASSERT_EQ ( pIndex->DebugCheck ( *pReporter, nullptr ), 0 );
+	ASSERT_EQ ( pReporter->GetNumFails(), 0 );
+
+	pTok = nullptr; // owned and deleted by index
+	});
+}
+
+
+// skiplists of v.66 and older have no max hits, and no entry for the last partial block
+TEST ( Skiplist, formats )
+{
+	const int BLOCK = 32;
+	const int DOCS = 5*BLOCK + 7;
+
+	// entries as the index writers produce them: one per block, the last partial block included
+	CSphVector<SkiplistEntry_t> dEntries;
+	for ( int i = 0; i<6; i++ )
+	{
+		SkiplistEntry_t & t = dEntries.Add();
+		t.m_tBaseRowIDPlus1 = i ? dEntries[i-1].m_tBaseRowIDPlus1 + BLOCK + i*3 : 0;
+		t.m_iOffset = i ? dEntries[i-1].m_iOffset + 4*BLOCK + i*11 : 100;
+		t.m_iBaseHitlistPos = i ? dEntries[i-1].m_iBaseHitlistPos + 1000 + i : 0;
+		t.m_uMaxHits = 1 + ( i*5 ) % 7;
+	}
+
+	auto fnWrite = [&] ( bool bMaxHits, int iEntries )
+	{
+		CSphVector<BYTE> dBuf;
+		auto fnPut = [&dBuf] ( BYTE uByte ) { dBuf.Add ( uByte ); };
+		if ( bMaxHits )
+			ZipValueBE ( fnPut, dEntries[0].m_uMaxHits );
+
+		for ( int i = 1; i<iEntries; i++ )
+		{
+			ZipValueBE ( fnPut, DWORD ( dEntries[i].m_tBaseRowIDPlus1 - dEntries[i-1].m_tBaseRowIDPlus1 - BLOCK ) );
+			ZipValueBE ( fnPut, uint64_t ( dEntries[i].m_iOffset - dEntries[i-1].m_iOffset - 4*BLOCK ) );
+			ZipValueBE ( fnPut, uint64_t ( dEntries[i].m_iBaseHitlistPos - dEntries[i-1].m_iBaseHitlistPos ) );
+			if ( bMaxHits )
+				ZipValueBE ( fnPut, dEntries[i].m_uMaxHits );
+		}
+		return dBuf;
+	};
+
+	DictEntry_t tEntry;
+	tEntry.m_iDoclistOffset = dEntries[0].m_iOffset;
+	tEntry.m_iSkiplistOffset = 0;
+
+	// v.67
+	auto dNew = fnWrite ( true, dEntries.GetLength() );
+	SkipData_t tNew;
+	tNew.Read ( dNew.Begin(), tEntry, DOCS, BLOCK, true );
+	ASSERT_TRUE ( tNew.m_bHasMaxHits );
+	ASSERT_EQ ( tNew.m_dSkiplist.GetLength(), dEntries.GetLength() );
+	DWORD uMaxHits = 0;
+	ARRAY_FOREACH ( i, dEntries )
+	{
+		ASSERT_EQ ( tNew.m_dSkiplist[i].m_tBaseRowIDPlus1, dEntries[i].m_tBaseRowIDPlus1 );
+		ASSERT_EQ ( tNew.m_dSkiplist[i].m_iOffset, dEntries[i].m_iOffset );
+		ASSERT_EQ ( tNew.m_dSkiplist[i].m_iBaseHitlistPos, dEntries[i].m_iBaseHitlistPos );
+		ASSERT_EQ ( tNew.m_dSkiplist[i].m_uMaxHits, dEntries[i].m_uMaxHits );
+		uMaxHits = Max ( uMaxHits, dEntries[i].m_uMaxHits );
+	}
+	ASSERT_EQ ( tNew.m_uMaxHits, uMaxHits );
+
+	// v.66: same entries, but only the full blocks; no bounds, so weight pruning can't skip anything
+	auto dOld = fnWrite ( false, DOCS/BLOCK );
+	SkipData_t tOld;
+	tOld.Read ( dOld.Begin(), tEntry, DOCS, BLOCK, false );
+	ASSERT_FALSE ( tOld.m_bHasMaxHits );
+	ASSERT_EQ ( tOld.m_dSkiplist.GetLength(), DOCS/BLOCK );
+	ARRAY_FOREACH ( i, tOld.m_dSkiplist )
+	{
+		ASSERT_EQ ( tOld.m_dSkiplist[i].m_tBaseRowIDPlus1, dEntries[i].m_tBaseRowIDPlus1 );
+		ASSERT_EQ ( tOld.m_dSkiplist[i].m_iOffset, dEntries[i].m_iOffset );
+		ASSERT_EQ ( tOld.m_dSkiplist[i].m_iBaseHitlistPos, dEntries[i].m_iBaseHitlistPos );
+		ASSERT_EQ ( tOld.m_dSkiplist[i].m_uMaxHits, 0u );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// group-by sorters fed straight with matches: doc i has id i and gid i%iGroups
+struct GroupbyTestData_t
+{
+	CSphSchema						m_tSchema;
+	CSphQuery						m_tQuery;
+	CSphFixedVector<CSphRowitem>	m_dRows {0};
+	int								m_iDocs;
+	int								m_iGroups;
+
+	GroupbyTestData_t ( int iDocs, int iGroups, int iMaxMatches )
+		: m_iDocs ( iDocs )
+		, m_iGroups ( iGroups )
+	{
+		m_tSchema.AddAttr ( CSphColumnInfo ( "id", SPH_ATTR_BIGINT ), false );
+		m_tSchema.AddAttr ( CSphColumnInfo ( "gid", SPH_ATTR_INTEGER ), false );
+
+		int iStride = m_tSchema.GetRowSize();
+		m_dRows.Reset ( iDocs*iStride );
+		for ( int i = 0; i<iDocs; ++i )
+		{
+			sphSetRowAttr ( m_dRows.Begin()+i*iStride, m_tSchema.GetAttr(0).m_tLocator, i );
+			sphSetRowAttr ( m_dRows.Begin()+i*iStride, m_tSchema.GetAttr(1).m_tLocator, i % iGroups );
+		}
+
+		CSphQueryItem & tItem = m_tQuery.m_dItems.Add();
+		tItem.m_sExpr = "*";
+		tItem.m_sAlias = "*";
+		m_tQuery.m_sSelect = "*";
+		m_tQuery.m_sGroupBy = "gid";
+		m_tQuery.m_iMaxMatches = iMaxMatches;
+	}
+
+	ISphMatchSorter * CreateSorter() const
+	{
+		SphQueueSettings_t tQueueSettings ( m_tSchema );
+		tQueueSettings.m_bComputeItems = true;
+		tQueueSettings.m_iMaxMatches = m_tQuery.m_iMaxMatches;
+		SphQueueRes_t tRes;
+		CSphString sError;
+		ISphMatchSorter * pSorter = sphCreateQueue ( tQueueSettings, m_tQuery, sError, tRes );
+		EXPECT_TRUE ( pSorter ) << sError.cstr();
+		return pSorter;
+	}
+
+	// push docs iFirst, iFirst+iStep, ...
+	void Push ( ISphMatchSorter * pSorter, int iFirst, int iStep ) const
+	{
+		CSphMatch tMatch;
+		tMatch.Reset ( pSorter->GetSchema()->GetDynamicSize() );
+		tMatch.m_iWeight = 1;
+		for ( int i = iFirst; i<m_iDocs; i += iStep )
+		{
+			tMatch.m_tRowID = i;
+			tMatch.m_pStatic = m_dRows.Begin()+i*m_tSchema.GetRowSize();
+			pSorter->Push ( tMatch );
+		}
+	}
+
+	// count of docs in every group
+	SphAttr_t GetCount ( SphAttr_t iGroup ) const
+	{
+		return m_iDocs/m_iGroups + ( iGroup < m_iDocs%m_iGroups ? 1 : 0 );
+	}
+
+	// (@groupby, @count) of the result, in the sorter order
+	static CSphVector<std::pair<SphAttr_t,SphAttr_t>> Flatten ( ISphMatchSorter * pSorter )
+	{
+		const ISphSchema & tSchema = *pSorter->GetSchema();
+		const CSphAttrLocator & tLocGroupby = tSchema.GetAttr("@groupby")->m_tLocator;
+		const CSphAttrLocator & tLocCount = tSchema.GetAttr("@count")->m_tLocator;
+
+		CSphFixedVector<CSphMatch> dMatches ( pSorter->GetLength() );
+		int iMatches = pSorter->Flatten ( dMatches.Begin() );
+
+		CSphVector<std::pair<SphAttr_t,SphAttr_t>> dRes;
+		for ( int i = 0; i<iMatches; ++i )
+			dRes.Add ( { dMatches[i].GetAttr(tLocGroupby), dMatches[i].GetAttr(tLocCount) } );
+
+		return dRes;
+	}
+};
+
+
+#if WITH_ZSTD
+TEST ( Docstore, zstd_dict_roundtrip )
+{
+	const char * szFile = "test_docstore.spds";
+	DocstoreSettings_t tSettings;
+	tSettings.m_eCompression = Compression_e::ZSTD;
+
+	// similar docs, so that ZDICT has something to train on
+	CSphVector<CSphString> dDocs;
+	for ( int i = 0; i < 20000; ++i )
+		dDocs.Add().SetSprintf ( "document %d is about topic %d, written by author %d in year %d; body %d", i, i%37, i%101, 1990+i%31, i*7919 );
+
+	CSphString sError;
+	{
+		auto pBuilder = CreateDocstoreBuilder ( szFile, tSettings, 65536, sError );
+		ASSERT_TRUE ( pBuilder ) << sError.cstr();
+		pBuilder->AddField ( "title", DOCSTORE_TEXT );
+
+		DocstoreBuilder_i::Doc_t tDoc;
+		tDoc.m_dFields.Resize(1);
+		ARRAY_FOREACH ( i, dDocs )
+		{
+			tDoc.m_dFields[0] = VecTraits_T<BYTE> ( (BYTE *)const_cast<char *> ( dDocs[i].cstr() ), dDocs[i].Length() );
+			pBuilder->AddDoc ( i, tDoc );
+		}
+
+		pBuilder->Finalize();
+	}
+
+	// v2 header with a trained dictionary
+	CSphVector<BYTE> dFile;
+	{
+		CSphAutoreader tReader;
+		ASSERT_TRUE ( tReader.Open ( szFile, sError ) ) << sError.cstr();
+		ASSERT_EQ ( tReader.GetDword(), 2u );
+		tReader.GetDword();	// block size
+		ASSERT_EQ ( tReader.GetByte(), 3 );	// zstd
+		DWORD uDictSize = tReader.GetDword();
+		ASSERT_GT ( uDictSize, 0u );
+		ASSERT_LE ( uDictSize, 65536u );
+
+		dFile.Resize ( tReader.GetFilesize() );
+		tReader.SeekTo ( 0, 0 );
+		tReader.GetBytes ( dFile.Begin(), dFile.GetLength() );
+		ASSERT_FALSE ( tReader.GetErrorFlag() );
+	}
+
+	{
+		auto pDocstore = CreateDocstore ( 1, szFile, sError );
+		ASSERT_TRUE ( pDocstore ) << sError.cstr();
+
+		DocstoreSession_c tSession;
+		pDocstore->CreateReader ( tSession.GetUID() );
+		ARRAY_FOREACH ( i, dDocs )
+		{
+			DocstoreDoc_t tDoc = pDocstore->GetDoc ( i, nullptr, tSession.GetUID(), false );
+			ASSERT_EQ ( tDoc.m_dFields.GetLength(), 1 );
+			CSphString sDoc ( (const char *)tDoc.m_dFields[0].Begin(), tDoc.m_dFields[0].GetLength() );
+			ASSERT_STREQ ( sDoc.cstr(), dDocs[i].cstr() ) << "row " << i;
+		}
+	}
+
+	// broken dictionary size must fail the load, not allocate
+	const DWORD uBadSize = 0x7FFFFFFF;
+	memcpy ( dFile.Begin() + 9, &uBadSize, sizeof(uBadSize) );
+	{
+		CSphWriter tWriter;
+		ASSERT_TRUE ( tWriter.OpenFile ( szFile, sError ) ) << sError.cstr();
+		tWriter.PutBytes ( dFile.Begin(), dFile.GetLength() );
+		tWriter.CloseFile();
+		ASSERT_FALSE ( tWriter.IsError() );
+	}
+
+	ASSERT_FALSE ( CreateDocstore ( 2, szFile, sError ) );
+	ASSERT_TRUE ( sError.Begins ( "Unable to load docstore: zstd dictionary too big" ) ) << sError.cstr();
+
+	unlink ( szFile );
+}
+#endif
+
+
+TEST ( GroupSorter, MoveFromParallel )
+{
+	if ( Threads::NThreads()<2 )
+		GTEST_SKIP() << "partitioned merge needs several threads";
+
+	// enough groups for the partitioned merge; every group gets docs from all the sorters
+	const int NUM_GROUPS = 20001;
+	const int NUM_SORTERS = 4;
+	GroupbyTestData_t tData ( 3*NUM_GROUPS+NUM_GROUPS/2, NUM_GROUPS, NUM_GROUPS );
+
+	Threads::CallCoroutine ( [&] {
+	std::unique_ptr<ISphMatchSorter> pReference { tData.CreateSorter() };
+	ASSERT_TRUE ( pReference );
+	tData.Push ( pReference.get(), 0, 1 );
+
+	std::unique_ptr<ISphMatchSorter> pParent { tData.CreateSorter() };
+	ASSERT_TRUE ( pParent );
+	tData.Push ( pParent.get(), 0, NUM_SORTERS );
+
+	CSphVector<ISphMatchSorter *> dSources;
+	for ( int i = 1; i<NUM_SORTERS; ++i )
+	{
+		dSources.Add ( pParent->Clone() );
+		tData.Push ( dSources.Last(), i, NUM_SORTERS );
+	}
+
+	ASSERT_TRUE ( pParent->MoveFromParallel ( dSources, NUM_SORTERS ) );
+
+	// sources are fully moved
+	for ( auto * pSource : dSources )
+	{
+		ASSERT_EQ ( pSource->GetLength(), 0 );
+		SafeDelete ( pSource );
+	}
+
+	ASSERT_EQ ( pParent->GetTotalCount(), NUM_GROUPS );
+	ASSERT_EQ ( pParent->GetTotalCount(), pReference->GetTotalCount() );
+
+	auto dParallel = GroupbyTestData_t::Flatten ( pParent.get() );
+	auto dSequential = GroupbyTestData_t::Flatten ( pReference.get() );
+	ASSERT_EQ ( dParallel.GetLength(), NUM_GROUPS );
+	ASSERT_EQ ( dParallel.GetLength(), dSequential.GetLength() );
+	ARRAY_FOREACH ( i, dParallel )
+	{
+		ASSERT_EQ ( dParallel[i].first, dSequential[i].first ) << "group at " << i;
+		ASSERT_EQ ( dParallel[i].second, tData.GetCount ( dParallel[i].first ) ) << "group " << dParallel[i].first;
+	}
+	});
+}
+
+
+TEST ( GroupSorter, MoveFromParallelSmall )
+{
+	// too few groups to pay for the partitions; sources must stay intact for MoveTo()
+	GroupbyTestData_t tData ( 1000, 100, 1000 );
+
+	Threads::CallCoroutine ( [&] {
+	std::unique_ptr<ISphMatchSorter> pParent { tData.CreateSorter() };
+	ASSERT_TRUE ( pParent );
+	tData.Push ( pParent.get(), 0, 1 );
+
+	std::unique_ptr<ISphMatchSorter> pSource { pParent->Clone() };
+	tData.Push ( pSource.get(), 0, 1 );
+
+	ISphMatchSorter * pRawSource = pSource.get();
+	ASSERT_FALSE ( pParent->MoveFromParallel ( { &pRawSource, 1 }, 2 ) );
+	ASSERT_EQ ( pSource->GetLength(), 100 );
+
+	pSource->MoveTo ( pParent.get(), true );
+	auto dRes = GroupbyTestData_t::Flatten ( pParent.get() );
+	ASSERT_EQ ( dRes.GetLength(), 100 );
+	for ( const auto & tGroup : dRes )
+		ASSERT_EQ ( tGroup.second, 2*tData.GetCount ( tGroup.first ) ) << "group " << tGroup.first;
+	});
+}
+
+
+TEST ( GroupSorter, SpillExact )
+{
+	// buffer takes 4*max_matches groups, budget a few times more; there are many more groups than that
+	const int NUM_GROUPS = 5000;
+	const int MAX_MATCHES = 100;
+	GroupbyTestData_t tData ( 3*NUM_GROUPS, NUM_GROUPS, MAX_MATCHES );
+	tData.m_tQuery.m_iGroupbyMemLimit = 100000;
+	tData.m_tQuery.m_bExplicitGroupbyMemLimit = true;
+
+	Threads::CallCoroutine ( [&] {
+	std::unique_ptr<ISphMatchSorter> pSorter { tData.CreateSorter() };
+	ASSERT_TRUE ( pSorter );
+	tData.Push ( pSorter.get(), 0, 1 );
+
+	// every group has come back complete, so the total is exact, and so are the counts of the best groups
+	ASSERT_EQ ( pSorter->GetTotalCount(), NUM_GROUPS );
+	auto dRes = GroupbyTestData_t::Flatten ( pSorter.get() );
+	ASSERT_EQ ( dRes.GetLength(), MAX_MATCHES );
+	ARRAY_FOREACH ( i, dRes )
+	{
+		ASSERT_EQ ( dRes[i].first, NUM_GROUPS-1-i );
+		ASSERT_EQ ( dRes[i].second, 3 ) << "group " << dRes[i].first;
+	}
+	});
+}
+
+
+TEST ( GroupSorter, SpillAggregates )
+{
+	// docs of every group are far apart in the stream, so every group is spread over several runs
+	const int NUM_GROUPS = 5000;
+	const int MAX_MATCHES = 100;
+	GroupbyTestData_t tData ( 3*NUM_GROUPS, NUM_GROUPS, MAX_MATCHES );
+	tData.m_tQuery.m_iGroupbyMemLimit = 100000;
+	tData.m_tQuery.m_bExplicitGroupbyMemLimit = true;
+
+	const std::pair<const char *, ESphAggrFunc> dAggrs[] = { { "a", SPH_AGGR_AVG }, { "s", SPH_AGGR_SUM }, { "mn", SPH_AGGR_MIN }, { "mx", SPH_AGGR_MAX } };
+	for ( const auto & tAggr : dAggrs )
+	{
+		CSphQueryItem & tItem = tData.m_tQuery.m_dItems.Add();
+		tItem.m_sExpr = "id";
+		tItem.m_sAlias = tAggr.first;
+		tItem.m_eAggrFunc = tAggr.second;
+	}
+	tData.m_tQuery.m_sSelect = "*, avg(id) a, sum(id) s, min(id) mn, max(id) mx";
+
+	Threads::CallCoroutine ( [&] {
+	std::unique_ptr<ISphMatchSorter> pSorter { tData.CreateSorter() };
+	ASSERT_TRUE ( pSorter );
+	tData.Push ( pSorter.get(), 0, 1 );
+	ASSERT_EQ ( pSorter->GetTotalCount(), NUM_GROUPS );
+
+	const ISphSchema & tSchema = *pSorter->GetSchema();
+	const CSphAttrLocator & tLocGroupby = tSchema.GetAttr("@groupby")->m_tLocator;
+	const CSphAttrLocator & tLocAvg = tSchema.GetAttr("a")->m_tLocator;
+	const CSphAttrLocator & tLocSum = tSchema.GetAttr("s")->m_tLocator;
+	const CSphAttrLocator & tLocMin = tSchema.GetAttr("mn")->m_tLocator;
+	const CSphAttrLocator & tLocMax = tSchema.GetAttr("mx")->m_tLocator;
+
+	CSphFixedVector<CSphMatch> dMatches ( pSorter->GetLength() );
+	int iMatches = pSorter->Flatten ( dMatches.Begin() );
+	ASSERT_EQ ( iMatches, MAX_MATCHES );
+
+	// group g holds ids g, g+NUM_GROUPS, g+2*NUM_GROUPS
+	for ( int i = 0; i<iMatches; ++i )
+	{
+		const CSphMatch & tMatch = dMatches[i];
+		SphAttr_t iGroup = tMatch.GetAttr ( tLocGroupby );
+		ASSERT_EQ ( iGroup, NUM_GROUPS-1-i );
+		ASSERT_DOUBLE_EQ ( tMatch.GetAttrDouble ( tLocAvg ), double ( iGroup+NUM_GROUPS ) ) << "group " << iGroup;
+		ASSERT_EQ ( tMatch.GetAttr ( tLocSum ), 3*iGroup+3*NUM_GROUPS ) << "group " << iGroup;
+		ASSERT_EQ ( tMatch.GetAttr ( tLocMin ), iGroup ) << "group " << iGroup;
+		ASSERT_EQ ( tMatch.GetAttr ( tLocMax ), iGroup+2*NUM_GROUPS ) << "group " << iGroup;
+	}
+	});
+}
+
+TEST ( GroupSpill, WriteMerge )
+{
+	CSphSchema tSchema;
+	tSchema.AddAttr ( CSphColumnInfo ( "@groupby", SPH_ATTR_BIGINT ), true );
+	tSchema.AddAttr ( CSphColumnInfo ( "run", SPH_ATTR_INTEGER ), true );
+	tSchema.AddAttr ( CSphColumnInfo ( "str", SPH_ATTR_STRINGPTR ), true );
+	const CSphAttrLocator & tLocGroupby = tSchema.GetAttr(0).m_tLocator;
+	const CSphAttrLocator & tLocRun = tSchema.GetAttr(1).m_tLocator;
+	const CSphAttrLocator & tLocStr = tSchema.GetAttr(2).m_tLocator;
+
+	// run r holds keys r, r+3, r+6, ... (and 100 in every run); every other key gets a string
+	const int NUM_RUNS = 3;
+	const int NUM_KEYS = 30;
+	GroupSpill_c tSpill;
+	ASSERT_TRUE ( tSpill.IsEmpty() );
+	for ( int iRun = 0; iRun<NUM_RUNS; ++iRun )
+	{
+		CSphVector<SphGroupKey_t> dKeys;
+		for ( int iKey = iRun; iKey<NUM_KEYS; iKey += NUM_RUNS )
+			dKeys.Add ( iKey );
+		dKeys.Add ( 100 );
+
+		CSphFixedVector<CSphMatch> dMatches ( dKeys.GetLength() );
+		CSphFixedVector<int> dOrder ( dKeys.GetLength() );
+		ARRAY_FOREACH ( i, dMatches )
+		{
+			CSphMatch & tMatch = dMatches[i];
+			tMatch.Reset ( tSchema.GetDynamicSize() );
+			tMatch.m_tRowID = (RowID_t)dKeys[i];
+			tMatch.SetAttr ( tLocGroupby, dKeys[i] );
+			tMatch.SetAttr ( tLocRun, iRun );
+
+			CSphString sValue;
+			sValue.SetSprintf ( "key%d", (int)dKeys[i] );
+			BYTE * pPacked = ( dKeys[i] & 1 ) ? nullptr : sphPackPtrAttr ( { (const BYTE *)sValue.cstr(), sValue.Length() } );
+			tMatch.SetAttr ( tLocStr, (SphAttr_t)pPacked );
+			dOrder[i] = i;
+		}
+
+		ASSERT_TRUE ( tSpill.AddRun ( dMatches, dOrder, tSchema ) ) << tSpill.GetError().cstr();
+
+		// the spill has its own copies of the data
+		for ( auto & tMatch : dMatches )
+			tSchema.FreeDataPtrs ( tMatch );
+	}
+
+	ASSERT_FALSE ( tSpill.IsEmpty() );
+	ASSERT_TRUE ( tSpill.StartMerge ( tSchema, tLocGroupby ) ) << tSpill.GetError().cstr();
+
+	SphGroupKey_t uLastKey = 0;
+	int iLastRun = -1; // key 0 comes first, from run 0
+	int iMatches = 0;
+	for ( const CSphMatch * pMatch = tSpill.Next(); pMatch; pMatch = tSpill.Next() )
+	{
+		auto uKey = (SphGroupKey_t)pMatch->GetAttr ( tLocGroupby );
+		int iRun = (int)pMatch->GetAttr ( tLocRun );
+		ASSERT_EQ ( pMatch->m_tRowID, (RowID_t)uKey );
+
+		// key order; equal keys come in run order
+		ASSERT_TRUE ( uKey>uLastKey || ( uKey==uLastKey && iRun>iLastRun ) ) << "key " << uKey << ", run " << iRun;
+		if ( uKey!=100 )
+			ASSERT_EQ ( iRun, int ( uKey % NUM_RUNS ) );
+
+		auto pData = (const BYTE *)pMatch->GetAttr ( tLocStr );
+		if ( uKey & 1 )
+			ASSERT_FALSE ( pData );
+		else
+		{
+			ASSERT_TRUE ( pData );
+			ByteBlob_t tBlob = sphUnpackPtrAttr ( pData );
+			CSphString sExpected;
+			sExpected.SetSprintf ( "key%d", (int)uKey );
+			ASSERT_STREQ ( CSphString ( (const char *)tBlob.first, tBlob.second ).cstr(), sExpected.cstr() );
+		}
+
+		uLastKey = uKey;
+		iLastRun = iRun;
+		++iMatches;
+	}
+
+	ASSERT_TRUE ( tSpill.GetError().IsEmpty() ) << tSpill.GetError().cstr();
+	ASSERT_EQ ( iMatches, NUM_KEYS+NUM_RUNS );
+
+	tSpill.Reset();
+	ASSERT_TRUE ( tSpill.IsEmpty() );
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// group commit (binlog_flush=1)
+
+#define BINLOG_TEST_PATH "test_binlog"
+
+class BinlogGroupCommit : public ::testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		Cleanup();
+		MkDir ( BINLOG_TEST_PATH );
+
+		CSphConfigSection tConf;
+		tConf.Add ( CSphVariant ( "1" ), "binlog_flush" );
+		tConf.Add ( CSphVariant ( "100" ), "binlog_group_commit_window" );
+
+		Binlog::Init ( BINLOG_TEST_PATH );
+		Binlog::Configure ( tConf, 0 );
+
+		SmallStringHash_T<CSphIndex *> hIndexes;
+		Binlog::Replay ( hIndexes );
+	}
+
+	void TearDown() override
+	{
+		Binlog::Deinit();
+		Cleanup();
+	}
+
+	static void Cleanup()
+	{
+		for ( const auto & sFile : FindFiles ( BINLOG_TEST_PATH "/binlog.*" ) )
+			unlink ( SphSprintf ( BINLOG_TEST_PATH "/%s", sFile.cstr() ).cstr() );
+		rmdir ( BINLOG_TEST_PATH );
+	}
+
+	// commits iTxns txns to the same table concurrently; each either waits by itself, or out of (mocked) table serialization
+	static void CommitConcurrently ( int iTxns, bool bDeferSync, CSphVector<bool> & dOk, StrVec_t & dErrors )
+	{
+		dOk.Resize ( iTxns );
+		dErrors.Resize ( iTxns );
+		int64_t iTID = 0;
+		Threads::CallCoroutine ( [&] {
+			auto dWaiter = Threads::DefferedRestarter();
+			for ( int i = 0; i<iTxns; ++i )
+				Threads::Coro::Co ( [&, i] {
+					int64_t iSyncPos = 0;
+					dOk[i] = Binlog::Commit ( &iTID, "test", dErrors[i], [i] ( Writer_i & tWriter ) { tWriter.PutDword ( i ); }, bDeferSync ? &iSyncPos : nullptr );
+					if ( dOk[i] && bDeferSync )
+					{
+						EXPECT_GT ( iSyncPos, 0 );
+						Binlog::WaitSynced ( "test", iSyncPos );
+					}
+				}, dWaiter );
+			Threads::WaitForDeffered ( std::move ( dWaiter ) );
+		} );
+	}
+};
+
+
+TEST_F ( BinlogGroupCommit, concurrent_txns_share_fsync )
+{
+	const int NUM_TXNS = 8;
+	CSphVector<bool> dOk;
+	StrVec_t dErrors;
+	CommitConcurrently ( NUM_TXNS, true, dOk, dErrors );
+
+	for ( int i = 0; i<NUM_TXNS; ++i )
+		ASSERT_TRUE ( dOk[i] ) << dErrors[i].cstr();
+
+	// the first leader waits the window, so the others join its group
+	ASSERT_GE ( Binlog::GetGroupSyncs(), 1 );
+	ASSERT_LT ( Binlog::GetGroupSyncs(), NUM_TXNS );
+}
+
+
+TEST_F ( BinlogGroupCommit, failed_sync_fails_whole_group )
+{
+	const int NUM_TXNS = 4;
+	CSphVector<bool> dOk;
+	StrVec_t dErrors;
+
+	Binlog::MockSyncFailure ( true );
+	CommitConcurrently ( NUM_TXNS, false, dOk, dErrors );
+	Binlog::MockSyncFailure ( false );
+
+	for ( int i = 0; i<NUM_TXNS; ++i )
+	{
+		ASSERT_FALSE ( dOk[i] );
+		ASSERT_TRUE ( dErrors[i].Begins ( "unable to" ) ) << dErrors[i].cstr();
+	}
+
+	// failed ranges are dropped once nobody waits; next txns are synced as usual
+	CommitConcurrently ( NUM_TXNS, false, dOk, dErrors );
+	for ( int i = 0; i<NUM_TXNS; ++i )
+		ASSERT_TRUE ( dOk[i] ) << dErrors[i].cstr();
+}
+
+
+// the txn is already applied when it waits for the sync, so the failure can't be returned to the client
+TEST_F ( BinlogGroupCommit, failed_sync_of_applied_txn_is_fatal )
+{
+	::testing::FLAGS_gtest_death_test_style = "threadsafe";
+	ASSERT_DEATH ( {
+		Binlog::MockSyncFailure ( true );
+		CSphVector<bool> dOk;
+		StrVec_t dErrors;
+		CommitConcurrently ( 1, true, dOk, dErrors );
+	}, "not durable" );
+}
@@ -17,6 +17,11 @@
 #include "searchdha.h"
 #include "searchdreplication.h"
 
+#if !_WIN32
+#include <poll.h>
+#include <netinet/in.h>
+#endif
+
 
 // QueryStatElement_t uses default ctr with inline initializer;
 // this test is just to be sure it works correctly
@@ -417,6 +422,220 @@ TEST_F ( T_ConfigureMultiAgent, simple_3_hosts )
 	ASSERT_FALSE ( tThird.m_bPersistent );
 }
 
+TEST_F ( T_ConfigureMultiAgent, hedge_goes_to_fastest_other_mirror )
+{
+	// unusual ports, so that dashboards of other tests are not shared with ours
+	MultiAgentDescRefPtr_c pAgent ( ParserTestSimple ( "127.0.0.1:19401|127.0.0.1:19402|127.0.0.1:19403", true ) );
+	auto &tAgent = *pAgent;
+	ASSERT_EQ ( tAgent.GetLength (), 3 );
+
+	auto fnSetLatency = [&tAgent] ( int iAgent, int64_t iLatencyUS )
+	{
+		HostDashboard_t & tDash = *tAgent[iAgent].m_pDash;
+		ScWL_t tWguard ( tDash.m_dMetricsLock );
+		tDash.UpdateLatency ( iLatencyUS );
+	};
+	fnSetLatency ( 0, 1000 );
+	fnSetLatency ( 1, 5000 );
+	fnSetLatency ( 2, 3000 );
+
+	// the fastest one is skipped, since the query went there already
+	auto pHedge = tAgent.ChooseHedgeAgent ( tAgent[0].m_pDash );
+	ASSERT_TRUE ( pHedge );
+	ASSERT_EQ ( pHedge->m_iPort, 19403 );
+
+	pHedge = tAgent.ChooseHedgeAgent ( tAgent[2].m_pDash );
+	ASSERT_TRUE ( pHedge );
+	ASSERT_EQ ( pHedge->m_iPort, 19401 );
+
+	// busy host looks slower
+	tAgent[0].m_pDash->m_iOutstanding = 5;
+	pHedge = tAgent.ChooseHedgeAgent ( tAgent[2].m_pDash );
+	ASSERT_TRUE ( pHedge );
+	ASSERT_EQ ( pHedge->m_iPort, 19402 );
+	tAgent[0].m_pDash->m_iOutstanding = 0;
+}
+
+TEST_F ( T_ConfigureMultiAgent, no_hedge_without_other_mirror )
+{
+	MultiAgentDescRefPtr_c pAgent ( ParserTestSimple ( "127.0.0.1:19404", true ) );
+	auto &tAgent = *pAgent;
+	ASSERT_FALSE ( tAgent.ChooseHedgeAgent ( tAgent[0].m_pDash ) );
+}
+
+#if !_WIN32
+// a fake agent on a random local port. It answers with its port, or, for the first request built, waits until the
+// master drops the connection; that's the slow mirror which the hedge overtakes
+struct FakeAgent_t
+{
+	int					m_iListen = -1;
+	int					m_iPort = 0;
+	SphThread_t			m_tThread;
+
+	static bool RecvAll ( int iSock, BYTE * pBuf, int iLen )
+	{
+		while ( iLen>0 )
+		{
+			pollfd tPoll { iSock, POLLIN, 0 };
+			if ( ::poll ( &tPoll, 1, 10000 )<=0 )
+				return false;
+			auto iRes = ::recv ( iSock, pBuf, iLen, 0 );
+			if ( iRes<=0 )
+				return false;
+			pBuf += iRes;
+			iLen -= (int)iRes;
+		}
+		return true;
+	}
+
+	bool Start()
+	{
+		m_iListen = (int)::socket ( AF_INET, SOCK_STREAM, 0 );
+		sockaddr_in tAddr {};
+		tAddr.sin_family = AF_INET;
+		tAddr.sin_addr.s_addr = htonl ( INADDR_LOOPBACK );
+		socklen_t iLen = sizeof ( tAddr );
+		if ( m_iListen<0 || ::bind ( m_iListen, (sockaddr *)&tAddr, iLen )<0 || ::listen ( m_iListen, 4 )<0 )
+			return false;
+		if ( ::getsockname ( m_iListen, (sockaddr *)&tAddr, &iLen )<0 )
+			return false;
+		m_iPort = ntohs ( tAddr.sin_port );
+		return Threads::Create ( &m_tThread, [this] { Serve(); } );
+	}
+
+	void Serve()
+	{
+		pollfd tPoll { m_iListen, POLLIN, 0 };
+		if ( ::poll ( &tPoll, 1, 10000 )<=0 )
+			return;
+		int iSock = (int)::accept ( m_iListen, nullptr, nullptr );
+		if ( iSock<0 )
+			return;
+
+		// client version, then api header (command, version, length) and the body, which is the request number
+		BYTE dHead[12];
+		DWORD uRequest = 0;
+		if ( RecvAll ( iSock, dHead, sizeof ( dHead ) ) && RecvAll ( iSock, (BYTE *)&uRequest, sizeof ( uRequest ) ) )
+		{
+			if ( !ntohl ( uRequest ) )
+			{
+				BYTE uByte;
+				RecvAll ( iSock, &uByte, 1 ); // returns once the master closes the connection
+			} else
+			{
+				// handshake, then reply header (status, version, length) and the body
+				DWORD dReply[4] = { htonl ( SPHINX_SEARCHD_PROTO ), htonl ( SEARCHD_OK<<16 ), htonl ( 4 ), htonl ( m_iPort ) };
+				::send ( iSock, dReply, sizeof ( dReply ), 0 );
+			}
+		}
+		::close ( iSock );
+	}
+
+	~FakeAgent_t()
+	{
+		if ( m_iPort )
+			Threads::Join ( &m_tThread );
+		if ( m_iListen>=0 )
+			::close ( m_iListen );
+	}
+};
+
+struct HedgeTestBuilder_c : public RequestBuilder_i
+{
+	mutable std::atomic<int> m_iBuilt {0};
+
+	void BuildRequest ( const AgentConn_t &, ISphOutputBuffer & tOut ) const final
+	{
+		auto tHdr = APIHeader ( tOut, SEARCHD_COMMAND_PING, VER_COMMAND_PING );
+		tOut.SendDword ( m_iBuilt.fetch_add ( 1 ) );
+	}
+};
+
+struct HedgeTestParser_c : public ReplyParser_i
+{
+	mutable int m_iParsed = 0;
+	mutable int m_iPort = 0;
+
+	bool ParseReply ( MemInputBuffer_c & tReq, AgentConn_t & ) const final
+	{
+		++m_iParsed;
+		m_iPort = tReq.GetInt();
+		return true;
+	}
+};
+
+TEST_F ( T_ConfigureMultiAgent, hedge_overtakes_slow_mirror )
+{
+	FakeAgent_t tFirst, tSecond;
+	ASSERT_TRUE ( tFirst.Start() );
+	ASSERT_TRUE ( tSecond.Start() );
+
+	CSphString sAgent;
+	sAgent.SetSprintf ( "127.0.0.1:%d|127.0.0.1:%d", tFirst.m_iPort, tSecond.m_iPort );
+	MultiAgentDescRefPtr_c pAgent ( ParserTestSimple ( sAgent.cstr(), true ) );
+	ASSERT_TRUE ( pAgent );
+
+	// both mirrors usually answer in about 1ms, so the hedge goes after 2ms
+	for ( int i = 0; i<2; ++i )
+	{
+		HostDashboard_t & tDash = *(*pAgent)[i].m_pDash;
+		ScWL_t tWguard ( tDash.m_dMetricsLock );
+		tDash.UpdateLatency ( 1000 );
+	}
+	const int64_t iP95US = (*pAgent)[0].m_pDash->GetLatencyP95US();
+	ASSERT_EQ ( iP95US, 2000 );
+
+	bool bHedged = std::exchange ( g_bHAHedgedRequests, true );
+	HedgeTestBuilder_c tBuilder;
+	HedgeTestParser_c tParser;
+	VecRefPtrsAgentConn_t dRemotes;
+	auto * pConn = new AgentConn_t;
+	pConn->SetMultiAgent ( pAgent );
+	pConn->m_iMyQueryTimeoutMs = 5000;
+	pConn->m_bAllowHedge = true;
+	dRemotes.Add ( pConn );
+
+	// schedule: the first request goes to the slow mirror; adopt: the hedge answers and gives its reply to the original
+	// connection; commit: the reply is parsed once and the query succeeds
+	ASSERT_EQ ( PerformRemoteTasks ( dRemotes, &tBuilder, &tParser, 0 ), 1 );
+	g_bHAHedgedRequests = bHedged;
+
+	ASSERT_EQ ( tBuilder.m_iBuilt, 2 );
+	ASSERT_EQ ( tParser.m_iParsed, 1 );
+	ASSERT_EQ ( pConn->m_tDesc.m_iPort, tParser.m_iPort ) << "the connection now describes the mirror which answered";
+
+	// the losing mirror got a latency sample of at least the hedge delay, so it looks slower than before
+	int iLoser = (*pAgent)[0].m_iPort==tParser.m_iPort ? 1 : 0;
+	ASSERT_GT ( (*pAgent)[iLoser].m_pDash->GetLatencyP95US(), iP95US );
+}
+#endif
+
+TEST ( HostDashboard, latency )
+{
+	CSphRefcountedPtr<HostDashboard_t> pDash { new HostDashboard_t };
+	ASSERT_EQ ( pDash->GetLatencyP95US (), 0 ) << "no answers seen yet";
+	ASSERT_EQ ( pDash->GetLoadScore (), 1.0 );
+
+	{
+		ScWL_t tWguard ( pDash->m_dMetricsLock );
+		pDash->UpdateLatency ( 1000 );
+	}
+	// the first sample gives the average, and half of it as the deviation
+	ASSERT_EQ ( pDash->GetLatencyP95US (), 2000 );
+	ASSERT_EQ ( pDash->GetLoadScore (), 1000.0 );
+
+	{
+		ScWL_t tWguard ( pDash->m_dMetricsLock );
+		pDash->UpdateLatency ( 9000 );
+	}
+	// average moves by 1/8 of the difference, deviation by 1/4
+	ASSERT_EQ ( pDash->GetLatencyP95US (), 2000+2*2375 );
+
+	pDash->m_iOutstanding = 2;
+	ASSERT_EQ ( pDash->GetLoadScore (), 2000.0*3 );
+	pDash->m_iOutstanding = 0;
+}
+
 // staging...
 // this classes are here only for tests (to avoid recompiling of a big piece in case of experiments)
 // the most base class we protect.
@@ -825,3 +1044,274 @@ TEST_F ( DeathLogger_c, ParseListener_wrong_port )
 		EXPECT_STREQ ( "port 65536 is out of range", sFatal.cstr() );
 	}
 }
+
+static TopNCutoffKey_t MakeTopNKey ( DWORD uAttrDesc, std::initializer_list<std::pair<ESphSortKeyPart, double>> dParts )
+{
+	TopNCutoffKey_t tKey;
+	tKey.m_uAttrDesc = uAttrDesc;
+	for ( const auto & tPart : dParts )
+	{
+		int i = tKey.m_iParts++;
+		tKey.m_dTypes[i] = (BYTE)tPart.first;
+		tKey.m_dInts[i] = 0;
+		tKey.m_dFloats[i] = 0.0;
+		if ( tPart.first==SPH_KEYPART_FLOAT || tPart.first==SPH_KEYPART_DOUBLE )
+			tKey.m_dFloats[i] = tPart.second;
+		else
+			tKey.m_dInts[i] = (SphAttr_t)tPart.second;
+	}
+	return tKey;
+}
+
+TEST ( TopNCutoff, key_roundtrip )
+{
+	auto tKey = MakeTopNKey ( 5, { { SPH_KEYPART_WEIGHT, 100 }, { SPH_KEYPART_INT, -5 }, { SPH_KEYPART_DOUBLE, 1.5 } } );
+
+	ISphOutputBuffer tOut;
+	SendTopNKey ( tOut, tKey );
+
+	TopNCutoffKey_t tRead;
+	InputBuffer_c tIn ( (const BYTE *)tOut.GetBufPtr(), tOut.GetSentCount() );
+	ASSERT_TRUE ( ReadTopNKey ( tIn, tRead ) );
+	ASSERT_EQ ( tRead.m_iParts, 3 );
+	ASSERT_EQ ( tRead.m_uAttrDesc, 5 );
+	ASSERT_TRUE ( SameTopNLayout ( tKey, tRead ) );
+	ASSERT_EQ ( CmpTopNKeys ( tKey, tRead ), 0 );
+	ASSERT_EQ ( tRead.m_dInts[0], 100 );
+	ASSERT_EQ ( tRead.m_dInts[1], -5 );
+	ASSERT_EQ ( tRead.m_dFloats[2], 1.5 );
+
+	// truncated
+	InputBuffer_c tShort ( (const BYTE *)tOut.GetBufPtr(), tOut.GetSentCount()-1 );
+	ASSERT_FALSE ( ReadTopNKey ( tShort, tRead ) );
+
+	// unknown key part
+	ISphOutputBuffer tBad;
+	tBad.SendDword ( 1 );
+	tBad.SendInt ( 1 );
+	tBad.SendByte ( SPH_KEYPART_STRING );
+	tBad.SendUint64 ( (uint64_t)0 );
+	InputBuffer_c tBadIn ( (const BYTE *)tBad.GetBufPtr(), tBad.GetSentCount() );
+	ASSERT_FALSE ( ReadTopNKey ( tBadIn, tRead ) );
+}
+
+TEST ( TopNCutoff, compare_keys )
+{
+	// weight desc
+	auto a = MakeTopNKey ( 1, { { SPH_KEYPART_WEIGHT, 10 } } );
+	auto b = MakeTopNKey ( 1, { { SPH_KEYPART_WEIGHT, 9 } } );
+	ASSERT_GT ( CmpTopNKeys ( a, b ), 0 );
+	ASSERT_LT ( CmpTopNKeys ( b, a ), 0 );
+	ASSERT_EQ ( CmpTopNKeys ( a, a ), 0 );
+
+	// weight desc, then int asc; equal weights are ordered by the second part
+	a = MakeTopNKey ( 1, { { SPH_KEYPART_WEIGHT, 10 }, { SPH_KEYPART_INT, 5 } } );
+	b = MakeTopNKey ( 1, { { SPH_KEYPART_WEIGHT, 10 }, { SPH_KEYPART_INT, 7 } } );
+	ASSERT_GT ( CmpTopNKeys ( a, b ), 0 );
+
+	// the first part decides
+	b = MakeTopNKey ( 1, { { SPH_KEYPART_WEIGHT, 11 }, { SPH_KEYPART_INT, 100 } } );
+	ASSERT_LT ( CmpTopNKeys ( a, b ), 0 );
+
+	// float asc
+	a = MakeTopNKey ( 0, { { SPH_KEYPART_FLOAT, -1.5 } } );
+	b = MakeTopNKey ( 0, { { SPH_KEYPART_FLOAT, 0.25 } } );
+	ASSERT_GT ( CmpTopNKeys ( a, b ), 0 );
+
+	ASSERT_FALSE ( SameTopNLayout ( a, MakeTopNKey ( 1, { { SPH_KEYPART_FLOAT, -1.5 } } ) ) );
+	ASSERT_FALSE ( SameTopNLayout ( a, MakeTopNKey ( 0, { { SPH_KEYPART_DOUBLE, -1.5 } } ) ) );
+}
+
+TEST ( TopNCutoff, agent_drops_worse_matches )
+{
+	const uint64_t uToken = 0x746F706E74657374ULL;
+	TopNCutoffListener_c tListener;
+	tListener.Listen ( uToken );
+
+	// cutoff comes from master as a separate command
+	ISphOutputBuffer tCmd;
+	tCmd.SendUint64 ( uToken );
+	SendTopNKey ( tCmd, MakeTopNKey ( 1, { { SPH_KEYPART_WEIGHT, 50 } } ) );
+	InputBuffer_c tIn ( (const BYTE *)tCmd.GetBufPtr(), tCmd.GetSentCount() );
+	ISphOutputBuffer tReply;
+	HandleCommandTopNCutoff ( tReply, VER_COMMAND_TOPNCUTOFF, tIn );
+
+	InputBuffer_c tAnswer ( (const BYTE *)tReply.GetBufPtr(), tReply.GetSentCount() );
+	ASSERT_EQ ( tAnswer.GetWord(), SEARCHD_OK );
+	tAnswer.GetWord();
+	tAnswer.GetInt();
+	ASSERT_EQ ( tAnswer.GetInt(), 1 ) << "the query listens to the token";
+
+	CSphQuery tQuery;
+	tQuery.m_eSort = SPH_SORT_RELEVANCE;
+
+	// agent sends one result set, best first
+	AggrResult_t tRes;
+	auto & dMatches = tRes.m_dResults.Add().m_dMatches;
+	for ( int iWeight : { 90, 70, 50, 50, 30, 10 } )
+		dMatches.Add().m_iWeight = iWeight;
+
+	// matches worse than the cutoff go away; ties stay
+	tRes.m_iOffset = 0;
+	tRes.m_iCount = 6;
+	tListener.Apply ( tRes, tQuery );
+	ASSERT_EQ ( tRes.m_iCount, 4 );
+
+	tRes.m_iOffset = 1;
+	tRes.m_iCount = 5;
+	tListener.Apply ( tRes, tQuery );
+	ASSERT_EQ ( tRes.m_iCount, 3 );
+
+	// grouped queries are never cut
+	tQuery.m_sGroupBy = "gid";
+	tRes.m_iCount = 5;
+	tListener.Apply ( tRes, tQuery );
+	ASSERT_EQ ( tRes.m_iCount, 5 );
+
+	// the query which doesn't listen knows no cutoff
+	tQuery.m_sGroupBy = "";
+	TopNCutoffListener_c tDeaf;
+	tDeaf.Apply ( tRes, tQuery );
+	ASSERT_EQ ( tRes.m_iCount, 5 );
+}
+
+// remote result set of (docid, weight) pairs, best first; tagged by its position
+static void AddTopNResult ( AggrResult_t & tRes, std::initializer_list<std::pair<DocID_t, int>> dDocs )
+{
+	auto & tChunk = tRes.m_dResults.Add();
+	tChunk.m_iTag = tRes.m_dResults.GetLength()-1;
+	tChunk.m_bTag = true;
+	tChunk.m_tSchema.AddAttr ( CSphColumnInfo ( sphGetDocidName(), SPH_ATTR_BIGINT ), true );
+	const auto & tLocator = tChunk.m_tSchema.GetAttr ( 0 ).m_tLocator;
+	for ( const auto & tDoc : dDocs )
+	{
+		CSphMatch & tMatch = tChunk.m_dMatches.Add();
+		tMatch.Reset ( tChunk.m_tSchema.GetDynamicSize() );
+		tMatch.SetAttr ( tLocator, tDoc.first );
+		tMatch.m_iWeight = tDoc.second;
+	}
+}
+
+class TopNFold : public ::testing::Test
+{
+protected:
+	CSphQuery m_tQuery;
+	AggrResult_t m_tRes;
+
+	void SetUp () override
+	{
+		m_tQuery.m_eSort = SPH_SORT_RELEVANCE;
+		m_tQuery.m_iLimit = 2;
+		m_tQuery.m_iMaxMatches = 2;
+	}
+
+	int Matches ( int iResult ) const { return m_tRes.m_dResults[iResult].m_dMatches.GetLength(); }
+
+	const CSphMatch * FindDoc ( int iResult, DocID_t tDocID ) const
+	{
+		for ( const CSphMatch & tMatch : m_tRes.m_dResults[iResult].m_dMatches )
+			if ( sphGetDocID ( tMatch.m_pDynamic )==tDocID )
+				return &tMatch;
+		return nullptr;
+	}
+};
+
+TEST_F ( TopNFold, holds_one_sorter )
+{
+	RemoteTopN_c tTopN ( m_tQuery, true, true, false );
+
+	for ( int i = 0; i<10; ++i )
+	{
+		AddTopNResult ( m_tRes, { { 2*i+1, 100+i }, { 2*i+2, 50+i } } );
+		tTopN.AddResult ( m_tRes, i );
+		ASSERT_EQ ( Matches ( 0 ), 2 );
+		for ( int j = 1; j<=i; ++j )
+			ASSERT_EQ ( Matches ( j ), 0 ) << "reply " << j;
+	}
+
+	// the best two are the first documents of the last two replies, tagged by their replies
+	ASSERT_TRUE ( m_tRes.m_dResults[0].m_bTagsAssigned );
+	ASSERT_EQ ( FindDoc ( 0, 19 )->m_iTag, 9 );
+	ASSERT_EQ ( FindDoc ( 0, 17 )->m_iTag, 8 );
+}
+
+TEST_F ( TopNFold, counts_documents_once )
+{
+	RemoteTopN_c tTopN ( m_tQuery, true, true, false );
+
+	AddTopNResult ( m_tRes, { { 1, 10 }, { 2, 9 } } );
+	tTopN.AddResult ( m_tRes, 0 );
+
+	// doc 1 is here again; the copy of the higher tag stays, as in the final merge
+	AddTopNResult ( m_tRes, { { 1, 10 }, { 3, 8 } } );
+	tTopN.AddResult ( m_tRes, 1 );
+	ASSERT_EQ ( Matches ( 0 ), 2 );
+	ASSERT_EQ ( Matches ( 1 ), 0 );
+	ASSERT_EQ ( FindDoc ( 0, 1 )->m_iTag, 1 );
+	ASSERT_EQ ( FindDoc ( 0, 2 )->m_iTag, 0 );
+	ASSERT_EQ ( m_tRes.m_iTotalMatches, -1 ) << "the final merge won't see the dupe";
+}
+
+TEST_F ( TopNFold, keeps_ties )
+{
+	RemoteTopN_c tTopN ( m_tQuery, true, true, false );
+
+	AddTopNResult ( m_tRes, { { 1, 10 }, { 2, 9 } } );
+	tTopN.AddResult ( m_tRes, 0 );
+	AddTopNResult ( m_tRes, { { 3, 9 }, { 4, 8 } } );
+	tTopN.AddResult ( m_tRes, 1 );
+	ASSERT_EQ ( Matches ( 0 ), 3 );
+	ASSERT_EQ ( Matches ( 1 ), 0 );
+}
+
+TEST_F ( TopNFold, stops_on_copies_sorted_differently )
+{
+	RemoteTopN_c tTopN ( m_tQuery, true, true, false );
+
+	AddTopNResult ( m_tRes, { { 1, 10 }, { 2, 9 } } );
+	tTopN.AddResult ( m_tRes, 0 );
+
+	// which copy of doc 1 survives the final merge decides whether doc 3 gets into the result
+	AddTopNResult ( m_tRes, { { 3, 8 }, { 1, 5 } } );
+	tTopN.AddResult ( m_tRes, 1 );
+	ASSERT_EQ ( Matches ( 0 ), 2 );
+	ASSERT_EQ ( Matches ( 1 ), 2 );
+
+	AddTopNResult ( m_tRes, { { 4, 7 } } );
+	tTopN.AddResult ( m_tRes, 2 );
+	ASSERT_EQ ( Matches ( 2 ), 1 );
+}
+
+TEST_F ( TopNFold, grouped_query_not_folded )
+{
+	m_tQuery.m_sGroupBy = "gid";
+	RemoteTopN_c tTopN ( m_tQuery, true, true, false );
+
+	AddTopNResult ( m_tRes, { { 1, 10 }, { 2, 9 } } );
+	tTopN.AddResult ( m_tRes, 0 );
+	AddTopNResult ( m_tRes, { { 3, 8 }, { 4, 7 } } );
+	tTopN.AddResult ( m_tRes, 1 );
+	ASSERT_EQ ( Matches ( 1 ), 2 );
+}
+
+TEST_F ( TopNFold, needs_option )
+{
+	// pushdown alone only tracks the keys; the replies stay as they are
+	RemoteTopN_c tTopN ( m_tQuery, true, false, true );
+	ASSERT_NE ( tTopN.GetToken(), 0u );
+
+	AddTopNResult ( m_tRes, { { 1, 10 }, { 2, 9 } } );
+	tTopN.AddResult ( m_tRes, 0 );
+	AddTopNResult ( m_tRes, { { 1, 10 }, { 3, 8 } } );
+	tTopN.AddResult ( m_tRes, 1 );
+	ASSERT_EQ ( Matches ( 0 ), 2 );
+	ASSERT_EQ ( Matches ( 1 ), 2 );
+	ASSERT_FALSE ( m_tRes.m_dResults[0].m_bTagsAssigned );
+	ASSERT_EQ ( m_tRes.m_iTotalMatches, 0 );
+
+	RemoteTopN_c tOff ( m_tQuery, true, false, false );
+	ASSERT_EQ ( tOff.GetToken(), 0u );
+	AddTopNResult ( m_tRes, { { 4, 7 } } );
+	tOff.AddResult ( m_tRes, 2 );
+	ASSERT_EQ ( Matches ( 2 ), 1 );
+}
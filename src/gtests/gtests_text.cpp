@@ -17,6 +17,7 @@
 #include "sphinxutils.h"
 #include "sphinxstem.h"
 #include "stripper/html_stripper.h"
+#include "querycontext.h"
 #include <cmath>
 
 
@@ -519,6 +520,244 @@ TEST ( Text, expression_parser_many )
 }
 
 
+// id, 3 integer attrs and a float one; row i holds 1000+i, i, i%7, 50-i and i*0.5, with a match pointing to it
+struct ExprTestRows_t
+{
+	CSphSchema						m_tSchema;
+	CSphFixedVector<CSphRowitem>	m_dRows {0};
+	CSphFixedVector<CSphMatch>		m_dMatches {0};
+	CSphVector<CSphMatch *>			m_dMatchPtrs;
+
+	explicit ExprTestRows_t ( int iRows )
+	{
+		CSphColumnInfo tCol;
+		tCol.m_sName = "id";
+		tCol.m_eAttrType = SPH_ATTR_BIGINT;
+		m_tSchema.AddAttr ( tCol, false );
+
+		tCol.m_eAttrType = SPH_ATTR_INTEGER;
+		for ( const char * szName : { "aaa", "bbb", "ccc" } )
+		{
+			tCol.m_sName = szName;
+			m_tSchema.AddAttr ( tCol, false );
+		}
+
+		tCol.m_sName = "fff";
+		tCol.m_eAttrType = SPH_ATTR_FLOAT;
+		m_tSchema.AddAttr ( tCol, false );
+
+		int iStride = m_tSchema.GetRowSize();
+		m_dRows.Reset ( iRows*iStride );
+		m_dMatches.Reset(iRows);
+		ARRAY_FOREACH ( i, m_dMatches )
+		{
+			CSphRowitem * pRow = m_dRows.Begin() + i*iStride;
+			sphSetRowAttr ( pRow, m_tSchema.GetAttr(0).m_tLocator, 1000+i );
+			sphSetRowAttr ( pRow, m_tSchema.GetAttr(1).m_tLocator, i );
+			sphSetRowAttr ( pRow, m_tSchema.GetAttr(2).m_tLocator, i % 7 );
+			sphSetRowAttr ( pRow, m_tSchema.GetAttr(3).m_tLocator, 50-i );
+			sphSetRowAttr ( pRow, m_tSchema.GetAttr(4).m_tLocator, sphF2DW ( i*0.5f ) );
+
+			m_dMatches[i].m_tRowID = i;
+			m_dMatches[i].m_pStatic = pRow;
+			m_dMatchPtrs.Add ( &m_dMatches[i] );
+		}
+	}
+};
+
+
+TEST ( Text, expression_batch )
+{
+	const int NUM_MATCHES = 100;
+	ExprTestRows_t tData ( NUM_MATCHES );
+	const CSphSchema & tSchema = tData.m_tSchema;
+	const CSphVector<CSphMatch *> & dMatchPtrs = tData.m_dMatchPtrs;
+
+	struct ExprTest_t
+	{
+		const char *	m_szExpr;
+		bool			m_bBatchable;
+	};
+
+	ExprTest_t dTests[] =
+	{
+		{ "aaa+bbb*ccc-1",				true },
+		{ "(aaa+bbb)/bbb",				true },		// includes division by zero
+		{ "min(aaa,ccc)-max(bbb,2)",	true },
+		{ "fff*2-aaa+1.5",				true },
+		{ "id*3+aaa",					true },
+		{ "aaa+sin(bbb)",				false },	// per-match fallback inside the batch
+	};
+
+	for ( const auto & tTest : dTests )
+	{
+		CSphString sError;
+		ESphAttr eAttrType = SPH_ATTR_NONE;
+		ExprParseArgs_t tExprArgs;
+		tExprArgs.m_pAttrType = &eAttrType;
+		ISphExprRefPtr_c pExpr ( sphExprParse ( tTest.m_szExpr, tSchema, nullptr, sError, tExprArgs ) );
+		ASSERT_TRUE ( pExpr.Ptr () ) << "parsing " << tTest.m_szExpr << ":" << sError.cstr ();
+		ASSERT_EQ ( pExpr->IsBatchable(), tTest.m_bBatchable ) << tTest.m_szExpr;
+
+		CSphFixedVector<float> dFloats ( NUM_MATCHES );
+		pExpr->EvalBatch ( dMatchPtrs, dFloats.Begin() );
+		ARRAY_FOREACH ( i, dMatchPtrs )
+			ASSERT_FLOAT_EQ ( pExpr->Eval ( *dMatchPtrs[i] ), dFloats[i] ) << tTest.m_szExpr << ", match " << i;
+
+		if ( eAttrType!=SPH_ATTR_INTEGER && eAttrType!=SPH_ATTR_BIGINT )
+			continue;
+
+		CSphFixedVector<int64_t> dInts ( NUM_MATCHES );
+		pExpr->Int64EvalBatch ( dMatchPtrs, dInts.Begin() );
+		ARRAY_FOREACH ( i, dMatchPtrs )
+			ASSERT_EQ ( pExpr->Int64Eval ( *dMatchPtrs[i] ), dInts[i] ) << tTest.m_szExpr << ", match " << i;
+	}
+}
+
+
+TEST ( Text, expression_fused )
+{
+	const int NUM_MATCHES = 50;
+	ExprTestRows_t tData ( NUM_MATCHES );
+	const CSphSchema & tSchema = tData.m_tSchema;
+	const CSphVector<CSphMatch *> & dMatchPtrs = tData.m_dMatchPtrs;
+
+	// expected values are calculated from match number
+	struct ExprTest_t
+	{
+		const char *	m_szExpr;
+		bool			m_bBatchable;	// IF() is only batchable when fused
+		double			(*m_fnExpected)( int i );
+	};
+
+	ExprTest_t dTests[] =
+	{
+		{ "aaa*3",						true,	[]( int i ) { return double ( i*3 ); } },
+		{ "aaa+bbb",					true,	[]( int i ) { return double ( i + i % 7 ); } },
+		{ "10-ccc",						true,	[]( int i ) { return double ( 10-(50-i) ); } },
+		{ "fff*2",						true,	[]( int i ) { return double ( i*0.5f*2.0f ); } },
+		{ "aaa/bbb",					true,	[]( int i ) { return i % 7 ? double ( float(i)/float(i % 7) ) : 0.0; } },
+		{ "id+aaa",						true,	[]( int i ) { return double ( 1000+i+i ); } },
+		{ "if(aaa>20,bbb,ccc)",			true,	[]( int i ) { return double ( i>20 ? i % 7 : 50-i ); } },
+		{ "if(aaa<=20,1,ccc)",			true,	[]( int i ) { return double ( i<=20 ? 1 : 50-i ); } },
+		{ "if(30<aaa,fff,2.5)",			true,	[]( int i ) { return i>30 ? double ( i*0.5f ) : 2.5; } },
+		{ "if(aaa=7,id,0)",				true,	[]( int i ) { return double ( i==7 ? 1000+i : 0 ); } },
+		{ "if(id>1020,2,3)",			true,	[]( int i ) { return double ( 1000+i>1020 ? 2 : 3 ); } },
+		{ "if(fff>=10,1,2)",			false,	[]( int i ) { return double ( i*0.5f>=10.0f ? 1 : 2 ); } },	// float >= stays generic
+		{ "if(aaa>bbb,1,2)",			false,	[]( int i ) { return double ( i>i % 7 ? 1 : 2 ); } },			// no attr vs attr kernel
+	};
+
+	for ( const auto & tTest : dTests )
+	{
+		CSphString sError;
+		ESphAttr eAttrType = SPH_ATTR_NONE;
+		ExprParseArgs_t tExprArgs;
+		tExprArgs.m_pAttrType = &eAttrType;
+		ISphExprRefPtr_c pExpr ( sphExprParse ( tTest.m_szExpr, tSchema, nullptr, sError, tExprArgs ) );
+		ASSERT_TRUE ( pExpr.Ptr () ) << "parsing " << tTest.m_szExpr << ":" << sError.cstr ();
+		ASSERT_EQ ( pExpr->IsBatchable(), tTest.m_bBatchable ) << tTest.m_szExpr;
+
+		ISphExprRefPtr_c pClone ( pExpr->Clone() );
+		CSphFixedVector<float> dFloats ( NUM_MATCHES );
+		pExpr->EvalBatch ( dMatchPtrs, dFloats.Begin() );
+		ARRAY_FOREACH ( i, dMatchPtrs )
+		{
+			auto fExpected = (float)tTest.m_fnExpected(i);
+			ASSERT_FLOAT_EQ ( fExpected, pExpr->Eval ( *dMatchPtrs[i] ) ) << tTest.m_szExpr << ", match " << i;
+			ASSERT_FLOAT_EQ ( fExpected, pClone->Eval ( *dMatchPtrs[i] ) ) << tTest.m_szExpr << ", match " << i;
+			ASSERT_FLOAT_EQ ( fExpected, dFloats[i] ) << tTest.m_szExpr << ", match " << i;
+		}
+
+		if ( eAttrType!=SPH_ATTR_INTEGER && eAttrType!=SPH_ATTR_BIGINT )
+			continue;
+
+		ARRAY_FOREACH ( i, dMatchPtrs )
+			ASSERT_EQ ( (int64_t)tTest.m_fnExpected(i), pExpr->Int64Eval ( *dMatchPtrs[i] ) ) << tTest.m_szExpr << ", match " << i;
+	}
+}
+
+
+TEST ( Text, expression_scan_block )
+{
+	const int NUM_ROWS = 100;
+	ExprTestRows_t tData ( NUM_ROWS );
+	CSphSchema & tSchema = tData.m_tSchema;
+	int iStride = tSchema.GetRowSize();
+	const CSphFixedVector<CSphRowitem> & dRows = tData.m_dRows;
+	CSphColumnInfo tCol;
+
+	// filter stage items: batchable ones around a per-match one, results go to the dynamic part
+	struct ItemTest_t
+	{
+		const char *	m_szExpr;
+		ESphAttr		m_eType;
+		double			(*m_fnExpected)( int i );
+	};
+
+	ItemTest_t dTests[] =
+	{
+		{ "aaa+bbb*ccc",	SPH_ATTR_INTEGER,	[]( int i ) { return double ( i + (i % 7)*(50-i) ); } },
+		{ "sin(aaa)",		SPH_ATTR_FLOAT,		[]( int i ) { return double ( (float)sin ( (float)i ) ); } },
+		{ "fff*2-ccc",		SPH_ATTR_FLOAT,		[]( int i ) { return double ( i*0.5f*2.0f - float(50-i) ); } },
+		{ "id*3",			SPH_ATTR_BIGINT,	[]( int i ) { return double ( (1000+i)*3 ); } },
+	};
+
+	CSphQuery tQuery;
+	CSphQueryContext tCtx ( tQuery );
+	ARRAY_FOREACH ( i, dTests )
+	{
+		CSphString sError;
+		ExprParseArgs_t tExprArgs;
+		ISphExprRefPtr_c pExpr ( sphExprParse ( dTests[i].m_szExpr, tSchema, nullptr, sError, tExprArgs ) );
+		ASSERT_TRUE ( pExpr.Ptr () ) << "parsing " << dTests[i].m_szExpr << ":" << sError.cstr ();
+
+		tCol.m_sName.SetSprintf ( "res%d", i );
+		tCol.m_eAttrType = dTests[i].m_eType;
+		tSchema.AddAttr ( tCol, true );
+
+		ContextCalcItem_t & tCalc = tCtx.m_dCalcFilter.Add();
+		tCalc.m_tLoc = tSchema.GetAttr ( tCol.m_sName.cstr() )->m_tLocator;
+		tCalc.m_eType = dTests[i].m_eType;
+		tCalc.m_pExpr = pExpr;
+	}
+
+	ASSERT_TRUE ( tCtx.IsScanBatchable() );
+
+	CSphMatch tMatch;
+	tMatch.Reset ( tSchema.GetDynamicSize() );
+	ScanBlock_c tBlock ( tMatch, tSchema.GetDynamicSize() );
+
+	// every other row, in two blocks of different sizes
+	CSphVector<RowID_t> dRowIDs;
+	for ( RowID_t tRowID = 0; tRowID < NUM_ROWS; tRowID += 2 )
+		dRowIDs.Add(tRowID);
+
+	auto fnToStatic = [&dRows, iStride]( RowID_t tRowID ){ return dRows.Begin() + (int64_t)tRowID*iStride; };
+	for ( const auto & dBlock : { dRowIDs.Slice ( 0, 10 ), dRowIDs.Slice(10) } )
+	{
+		auto dPassed = tBlock.Process ( tCtx, dBlock, fnToStatic, false, 1 );
+		ASSERT_EQ ( dPassed.GetLength(), dBlock.GetLength() );
+		ARRAY_FOREACH ( iMatch, dPassed )
+		{
+			const CSphMatch & tRes = *dPassed[iMatch];
+			int iRow = (int)dBlock[iMatch];
+			ASSERT_EQ ( tRes.m_tRowID, dBlock[iMatch] );
+
+			ARRAY_FOREACH ( i, dTests )
+			{
+				const ContextCalcItem_t & tCalc = tCtx.m_dCalcFilter[i];
+				if ( dTests[i].m_eType==SPH_ATTR_FLOAT )
+					ASSERT_FLOAT_EQ ( (float)dTests[i].m_fnExpected(iRow), tRes.GetAttrFloat ( tCalc.m_tLoc ) ) << dTests[i].m_szExpr << ", row " << iRow;
+				else
+					ASSERT_EQ ( (int64_t)dTests[i].m_fnExpected(iRow), tRes.GetAttr ( tCalc.m_tLoc ) ) << dTests[i].m_szExpr << ", row " << iRow;
+			}
+		}
+
+		tBlock.FreeData(tCtx);
+	}
+}
+
+
 //////////////////////////////////////////////////////////////////////////
 
 TEST ( Text, ArabicStemmer )
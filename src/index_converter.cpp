@@ -1189,6 +1189,7 @@ bool ConverterPlain_t::ConvertDoclist ( Index_t & tIndex, CSphString & sError )
 				{
 					 tWriterDocs.ZipInt ( uMatchHits );
 					 tWriterDocs.ZipInt ( uFirst );
+					 dSkiplist.Last().m_uMaxHits = Max ( dSkiplist.Last().m_uMaxHits, uMatchHits );
 				}
 				if ( uMatchHits==1 )
 				{
@@ -1213,12 +1214,16 @@ bool ConverterPlain_t::ConvertDoclist ( Index_t & tIndex, CSphString & sError )
 				{
 					tWriterDocs.ZipOffset ( uHitPosDelta );
 					tWriterDocs.ZipInt ( uMatchHits );
+					dSkiplist.Last().m_uMaxHits = Max ( dSkiplist.Last().m_uMaxHits, uMatchHits );
 				}
 			}
 		}
 
 		// write skiplist
 		SphOffset_t uSkip = (int)tWriterSkips.GetPos();
+		if ( dSkiplist.GetLength()>1 )
+			tWriterSkips.ZipInt ( dSkiplist[0].m_uMaxHits );
+
 		for ( int i=1; i<dSkiplist.GetLength(); i++ )
 		{
 			const SkiplistEntry_t & tPrev = dSkiplist[i-1];
@@ -1228,6 +1233,7 @@ bool ConverterPlain_t::ConvertDoclist ( Index_t & tIndex, CSphString & sError )
 			tWriterSkips.ZipInt ( tCur.m_tBaseRowIDPlus1 - tPrev.m_tBaseRowIDPlus1 - uSkiplistBlock );
 			tWriterSkips.ZipOffset ( tCur.m_iOffset - tPrev.m_iOffset - 4*uSkiplistBlock );
 			tWriterSkips.ZipOffset ( tCur.m_iBaseHitlistPos - tPrev.m_iBaseHitlistPos );
+			tWriterSkips.ZipInt ( tCur.m_uMaxHits );
 		}
 
 		DoclistOffsets_t tOffsets;
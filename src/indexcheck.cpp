@@ -1118,6 +1118,7 @@ void DiskIndexChecker_c::Impl_c::CheckDocs( cbWordidFn&& fnCbWordid )
 
 			++iDoclistDocs;
 			iDoclistHits += pQword->m_uMatchHits;
+			dDoclistSkips.Last().m_uMaxHits = Max ( dDoclistSkips.Last().m_uMaxHits, pQword->m_uMatchHits );
 
 			// check position in case of regular (not-inline) hit
 			if (!( pQword->m_iHitlistPos>>63 ))
@@ -1216,6 +1217,15 @@ void DiskIndexChecker_c::Impl_c::CheckDocs( cbWordidFn&& fnCbWordid )
 
 			// hint is: dDoclistSkips * ZIPPED( sizeof(int64_t) * 3 ) == dDoclistSkips * 8
 			m_tSkipsReader.SeekTo ( iSkipsOffset, dDoclistSkips.GetLength ()*8 );
+
+			const bool bHasMaxHits = m_uVersion>=67;
+			if ( bHasMaxHits )
+			{
+				DWORD uMaxHits = m_tSkipsReader.UnzipInt();
+				if ( uMaxHits!=dDoclistSkips[0].m_uMaxHits )
+					m_tReporter.Fail ( "skiplist entry 0 max hits mismatch (wordid=" UINT64_FMT "(%s), exp=%u, got=%u)", UINT64 ( uWordid ), sWord, dDoclistSkips[0].m_uMaxHits, uMaxHits );
+			}
+
 			int i = 0;
 			while ( ++i<dDoclistSkips.GetLength() )
 			{
@@ -1224,6 +1234,7 @@ void DiskIndexChecker_c::Impl_c::CheckDocs( cbWordidFn&& fnCbWordid )
 				RowID_t tRowIDDelta = m_tSkipsReader.UnzipRowid();
 				uint64_t uOff = m_tSkipsReader.UnzipOffset();
 				uint64_t uPosDelta = m_tSkipsReader.UnzipOffset();
+				t.m_uMaxHits = bHasMaxHits ? m_tSkipsReader.UnzipInt() : r.m_uMaxHits;
 
 				if ( m_tSkipsReader.GetErrorFlag () )
 				{
@@ -1235,7 +1246,7 @@ void DiskIndexChecker_c::Impl_c::CheckDocs( cbWordidFn&& fnCbWordid )
 				t.m_tBaseRowIDPlus1 += tIndexSettings.m_iSkiplistBlockSize + tRowIDDelta;
 				t.m_iOffset += 4*tIndexSettings.m_iSkiplistBlockSize + uOff;
 				t.m_iBaseHitlistPos += uPosDelta;
-				if ( t.m_tBaseRowIDPlus1!=r.m_tBaseRowIDPlus1 || t.m_iOffset!=r.m_iOffset || t.m_iBaseHitlistPos!=r.m_iBaseHitlistPos )
+				if ( t.m_tBaseRowIDPlus1!=r.m_tBaseRowIDPlus1 || t.m_iOffset!=r.m_iOffset || t.m_iBaseHitlistPos!=r.m_iBaseHitlistPos || t.m_uMaxHits!=r.m_uMaxHits )
 				{
 					m_tReporter.Fail ( "skiplist entry %d mismatch (wordid=" UINT64_FMT "(%s), exp={%u, " UINT64_FMT ", " UINT64_FMT "}, got={%u, " UINT64_FMT ", " UINT64_FMT "})",
 						i, UINT64 ( uWordid ), sWord,
@@ -81,6 +81,9 @@ CSphString CompressionToStr ( Compression_e eComp )
 	case Compression_e::LZ4HC:
 		return "lz4hc";
 
+	case Compression_e::ZSTD:
+		return "zstd";
+
 	case Compression_e::NONE:
 	default:
 		return "none";
@@ -844,14 +847,23 @@ bool CSphIndexSettings::ParseDocstoreSettings ( const CSphConfigSection & hIndex
 		m_eCompression = Compression_e::LZ4;
 	else if ( sCompression=="lz4hc" )
 		m_eCompression = Compression_e::LZ4HC;
+	else if ( sCompression=="zstd" )
+	{
+#if WITH_ZSTD
+		m_eCompression = Compression_e::ZSTD;
+#else
+		sError = "'docstore_compression = zstd' is not available: built without zstd support";
+		return false;
+#endif
+	}
 	else
 	{
 		sError.SetSprintf ( "unknown compression specified in 'docstore_compression': '%s'\n", sCompression.cstr() ); 
 		return false;
 	}
 
-	if ( hIndex.Exists("docstore_compression_level") && m_eCompression!=Compression_e::LZ4HC )
-		sWarning.SetSprintf ( "docstore_compression_level works only with LZ4HC compression" ); 
+	if ( hIndex.Exists("docstore_compression_level") && m_eCompression!=Compression_e::LZ4HC && m_eCompression!=Compression_e::ZSTD )
+		sWarning.SetSprintf ( "docstore_compression_level works only with LZ4HC and ZSTD compression" ); 
 
 	return true;
 }
@@ -2376,6 +2388,7 @@ const char * GetMutableName ( MutableName_e eName )
 		case MutableName_e::READ_BUFFER_DOCS: return "read_buffer_docs";
 		case MutableName_e::READ_BUFFER_HITS: return "read_buffer_hits";
 		case MutableName_e::OPTIMIZE_CUTOFF: return "optimize_cutoff";
+		case MutableName_e::RT_DOCLIST_FORMAT: return "rt_doclist_format";
 		default: assert ( 0 && "Invalid mutable option" ); return "";
 	}
 }
@@ -2442,6 +2455,26 @@ static void GetFileAccess (  const CSphConfigSection & hIndex, MutableName_e eNa
 	dLoaded.BitSet ( (int)eName );
 }
 
+static const char * DocFormatName ( RtDocFormat_e eFormat )
+{
+	return eFormat==RtDocFormat_e::PACKED ? "packed" : "varint";
+}
+
+static bool GetDocFormat ( const CSphString & sVal, RtDocFormat_e & eRes )
+{
+	if ( sVal=="varint" )
+		eRes = RtDocFormat_e::VARINT;
+	else if ( sVal=="packed" )
+		eRes = RtDocFormat_e::PACKED;
+	else
+	{
+		sphWarning ( "rt_doclist_format unknown value %s, use %s", sVal.cstr(), DocFormatName ( eRes ) );
+		return false;
+	}
+
+	return true;
+}
+
 static const int g_iOptimizeCutoff = 1;
 
 MutableIndexSettings_c::MutableIndexSettings_c()
@@ -2576,6 +2609,17 @@ bool MutableIndexSettings_c::Load ( const char * sFileName, const char * sIndexN
 		sError = "";
 	}
 
+	JsonObj_c tDocFormat = tParser.GetStrItem ( "rt_doclist_format", sError, true );
+	if ( tDocFormat )
+	{
+		if ( GetDocFormat ( tDocFormat.StrVal(), m_eDocFormat ) )
+			m_dLoaded.BitSet ( (int)MutableName_e::RT_DOCLIST_FORMAT );
+	} else if ( !sError.IsEmpty() )
+	{
+		sphWarning ( "table %s: %s", sIndexName, sError.cstr() );
+		sError = "";
+	}
+
 	m_bNeedSave = true;
 
 	return true;
@@ -2654,6 +2698,9 @@ void MutableIndexSettings_c::Load ( const CSphConfigSection & hIndex, bool bNeed
 		m_iOptimizeCutoff = Max ( m_iOptimizeCutoff, 1 );
 		m_dLoaded.BitSet ( (int)MutableName_e::OPTIMIZE_CUTOFF );
 	}
+
+	if ( hIndex.Exists ( "rt_doclist_format" ) && GetDocFormat ( hIndex.GetStr ( "rt_doclist_format" ), m_eDocFormat ) )
+		m_dLoaded.BitSet ( (int)MutableName_e::RT_DOCLIST_FORMAT );
 }
 
 static void AddStr ( const CSphBitvec & dLoaded, MutableName_e eName, JsonObj_c & tRoot, const char * sVal )
@@ -2709,6 +2756,7 @@ bool MutableIndexSettings_c::Save ( CSphString & sBuf ) const
 	AddInt ( m_dLoaded, MutableName_e::READ_BUFFER_HITS, tRoot, m_tFileAccess.m_iReadBufferHitList );
 
 	AddInt ( m_dLoaded, MutableName_e::OPTIMIZE_CUTOFF, tRoot, m_iOptimizeCutoff );
+	AddStr ( m_dLoaded, MutableName_e::RT_DOCLIST_FORMAT, tRoot, DocFormatName ( m_eDocFormat ) );
 
 	sBuf = tRoot.AsString ( true );
 
@@ -2776,6 +2824,11 @@ void MutableIndexSettings_c::Combine ( const MutableIndexSettings_c & tOther )
 		m_iOptimizeCutoff = tOther.m_iOptimizeCutoff;
 		m_dLoaded.BitSet ( (int)MutableName_e::OPTIMIZE_CUTOFF );
 	}
+	if ( tOther.m_dLoaded.BitGet ( (int)MutableName_e::RT_DOCLIST_FORMAT ) )
+	{
+		m_eDocFormat = tOther.m_eDocFormat;
+		m_dLoaded.BitSet ( (int)MutableName_e::RT_DOCLIST_FORMAT );
+	}
 }
 
 MutableIndexSettings_c & MutableIndexSettings_c::GetDefaults ()
@@ -2818,6 +2871,8 @@ void MutableIndexSettings_c::Format ( SettingsFormatter_c & tOut, FilenameBuilde
 
 	tOut.Add ( GetMutableName ( MutableName_e::OPTIMIZE_CUTOFF ), m_iOptimizeCutoff,
 		FormatCond ( m_bNeedSave, m_dLoaded, MutableName_e::OPTIMIZE_CUTOFF, HasSettings() && m_dLoaded.BitGet ( (int)MutableName_e::OPTIMIZE_CUTOFF ) ) );
+	tOut.Add ( GetMutableName ( MutableName_e::RT_DOCLIST_FORMAT ), DocFormatName ( m_eDocFormat ),
+		FormatCond ( m_bNeedSave, m_dLoaded, MutableName_e::RT_DOCLIST_FORMAT, m_eDocFormat!=tDefaults.m_eDocFormat ) );
 }
 
 
@@ -201,7 +201,8 @@ enum class Compression_e
 {
 	NONE,
 	LZ4,
-	LZ4HC
+	LZ4HC,
+	ZSTD
 };
 
 
@@ -305,12 +306,21 @@ enum class MutableName_e
 	READ_BUFFER_DOCS,
 	READ_BUFFER_HITS,
 	OPTIMIZE_CUTOFF,
+	RT_DOCLIST_FORMAT,
 
 	TOTAL
 };
 
+/// RAM segments doclist encoding
+enum class RtDocFormat_e : BYTE
+{
+	VARINT,		///< variable length bytes, doc by doc
+	PACKED		///< blocks of docs, every doc field bit-packed with fixed width
+};
+
 const int DEFAULT_READ_BUFFER = 256*1024;
 const int DEFAULT_READ_UNHINTED = 32768;
+const int DEFAULT_READ_PREFETCH = 262144;
 
 struct FileAccessSettings_t : public SettingsWriter_c
 {
@@ -336,6 +346,7 @@ public:
 	bool		m_bPreopen = false;
 	FileAccessSettings_t m_tFileAccess;
 	int			m_iOptimizeCutoff;
+	RtDocFormat_e m_eDocFormat = RtDocFormat_e::VARINT;
 	
 	MutableIndexSettings_c();
 
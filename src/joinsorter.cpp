@@ -20,6 +20,11 @@
 
 static int64_t g_iJoinCacheSize = 20971520;
 
+// batched (hash) join: prefill the join cache with one right table query per batch of distinct left keys
+static const int HASH_JOIN_MIN_ROWS			= 64;		// don't bother with smaller left result sets
+static const int HASH_JOIN_BATCH_MATCHES	= 65536;	// right matches per batch; larger batches are split in halves
+static int g_iJoinBatchKeys = 1024;						// distinct left keys per right table query; 0 disables batching
+
 
 void SetJoinCacheSize ( int64_t iSize )
 {
@@ -33,6 +38,12 @@ int64_t GetJoinCacheSize()
 }
 
 
+void SetJoinBatchKeys ( int iKeys )
+{
+	g_iJoinBatchKeys = iKeys;
+}
+
+
 static bool GetJoinAttrName ( const CSphString & sAttr, const CSphString & sJoinedIndex, CSphString * pModified = nullptr )
 {
 	CSphString sPrefix;
@@ -284,6 +295,50 @@ private:
 };
 
 
+/// collects distinct ON key tuples (and their hashes) of left table matches
+class JoinKeyCollector_c : public MatchProcessor_i
+{
+public:
+			JoinKeyCollector_c ( const CSphVector<CSphAttrLocator> & dLocators ) : m_dLocators ( dLocators ) {}
+
+	void	Process ( CSphMatch * pMatch ) override;
+	bool	ProcessInRowIdOrder() const override	{ return false; }
+	void	Process ( VecTraits_T<CSphMatch *> & dMatches ) override
+	{
+		for ( auto & i : dMatches )
+			Process(i);
+	}
+
+	const CSphVector<uint64_t> &	GetHashes() const	{ return m_dHashes; }
+	const CSphVector<SphAttr_t> &	GetValues() const	{ return m_dValues; }
+
+private:
+	const CSphVector<CSphAttrLocator> &	m_dLocators;
+	OpenHashSet_T<uint64_t>		m_hSeen;
+	CSphVector<uint64_t>		m_dHashes;
+	CSphVector<SphAttr_t>		m_dValues;	// m_dLocators.GetLength() values per key
+};
+
+
+void JoinKeyCollector_c::Process ( CSphMatch * pMatch )
+{
+	// same hash as in JoinSorter_c::SetupJoinFilters
+	uint64_t uHash = 0;
+	for ( const auto & tLocator : m_dLocators )
+	{
+		SphAttr_t tValue = pMatch->GetAttr(tLocator);
+		uHash = HashWithSeed ( &tValue, sizeof(tValue), uHash );
+	}
+
+	if ( !m_hSeen.Add(uHash) )
+		return;
+
+	m_dHashes.Add(uHash);
+	for ( const auto & tLocator : m_dLocators )
+		m_dValues.Add ( pMatch->GetAttr(tLocator) );
+}
+
+
 class StoredFetch_c : public MatchProcessor_i
 {
 public:
@@ -440,6 +495,7 @@ public:
 	bool		CanBeCloned() const override										{ return m_pSorter->CanBeCloned(); }
 	ISphMatchSorter * Clone() const override;
 	void		MoveTo ( ISphMatchSorter * pRhs, bool bCopyMeta ) override			{ m_pSorter->MoveTo ( ((JoinSorter_c *)pRhs)->m_pSorter.get(), bCopyMeta ); }
+	bool		MoveFromParallel ( const VecTraits_T<ISphMatchSorter *> & dSources, int iThreads ) override;
 	void		CloneTo ( ISphMatchSorter * pTrg ) const override					{ m_pSorter->CloneTo(pTrg); }
 	void		SetFilteredAttrs ( const sph::StringSet & hAttrs, bool bAddDocid ) override	{ m_pSorter->SetFilteredAttrs(hAttrs, bAddDocid); }
 	void		TransformPooled2StandalonePtrs ( GetBlobPoolFromMatch_fn fnBlobPoolFromMatch, GetColumnarFromMatch_fn fnGetColumnarFromMatch, bool bFinalizeSorters ) override { m_pSorter->TransformPooled2StandalonePtrs(fnBlobPoolFromMatch, fnGetColumnarFromMatch, bFinalizeSorters); }
@@ -481,6 +537,7 @@ private:
 		int				m_iFilterId = -1;
 		CSphAttrLocator	m_tLocator;
 		bool			m_bBlob = false;
+		CSphString		m_sRightAttr;
 	};
 
 	CSphQuery						m_tJoinQuery;
@@ -502,6 +559,7 @@ private:
 	CSphVector<JoinAttrRemap_t>		m_dJoinRemap;
 	bool							m_bNeedToSetupRemap = true;
 	CSphVector<FilterRemap_t>		m_dFilterRemap;
+	bool							m_bHashJoinKeys = false;
 	int								m_iDynamicSize = 0;
 	bool							m_bFinalCalcOnly = false;
 	const ISphSchema *				m_pSorterSchema = nullptr;
@@ -520,7 +578,7 @@ private:
 
 	bool		SetupJoinQuery ( int iDynamicSize, CSphString & sError );
 	bool		SetupJoinSorter ( CSphString & sError );
-	void		SetupJoinAttrRemap();
+	void		SetupJoinAttrRemap ( const ISphSchema & tRightSchema );
 	void		SetupDependentAttrCalc ( const IntVec_t & dJoinedAttrs );
 	void		SetupSorterSchema();
 	void		SetupNullMask();
@@ -547,6 +605,8 @@ private:
 	void		RepackJsonFieldAsStr ( const CSphMatch & tSrcMatch, const CSphAttrLocator & tLocSrc, const CSphAttrLocator & tLocDst );
 	void		ProduceCacheSizeWarning ( CSphString & sWarning );
 	void		PopulateStoredFields();
+	void		PrefetchJoinedMatches();
+	void		RunJoinBatch ( const VecTraits_T<uint64_t> & dHashes, const VecTraits_T<SphAttr_t> & dValues );
 };
 
 
@@ -753,16 +813,15 @@ void JoinSorter_c::SetupDependentAttrCalc ( const IntVec_t & dJoinedAttrs )
 }
 
 
-void JoinSorter_c::SetupJoinAttrRemap()
+void JoinSorter_c::SetupJoinAttrRemap ( const ISphSchema & tRightSchema )
 {
 	m_dJoinRemap.Resize(0);
 
 	IntVec_t dJoinedAttrs;
 	auto * pSorterSchema = m_pSorter->GetSchema();
-	auto * pJoinSorterSchema = m_pRightSorter->GetSchema();
-	for ( int i = 0; i < pJoinSorterSchema->GetAttrsCount(); i++ )
+	for ( int i = 0; i < tRightSchema.GetAttrsCount(); i++ )
 	{
-		auto & tAttrSrc = pJoinSorterSchema->GetAttr(i);
+		auto & tAttrSrc = tRightSchema.GetAttr(i);
 		const JoinAttrNameRemap_t * pFound = nullptr;
 		for ( const auto & tRemap : m_dAttrRemap )
 			if ( tRemap.m_sFrom==tAttrSrc.m_sName )
@@ -905,7 +964,7 @@ bool JoinSorter_c::Push_T ( const CSphMatch & tEntry, PUSH && fnPush )
 		// setup join attr remap, but do it only once
 		// we can't do that before because we need to remap from the standalone schema and we get it only after the first query
 		if ( m_bNeedToSetupRemap )
-			SetupJoinAttrRemap();
+			SetupJoinAttrRemap ( *m_pRightSorter->GetSchema() );
 
 		if ( pSorter->GetLength() )
 		{
@@ -971,6 +1030,169 @@ void JoinSorter_c::PopulateStoredFields()
 }
 
 
+void JoinSorter_c::RunJoinBatch ( const VecTraits_T<uint64_t> & dHashes, const VecTraits_T<SphAttr_t> & dValues )
+{
+	int iNumKeys = dHashes.GetLength();
+	int iTupleLen = m_dFilterRemap.GetLength();
+
+	// one query for the whole batch; ON filters get all the batch values instead of a single value
+	CSphQuery tBatchQuery = m_tJoinQuery;
+	tBatchQuery.m_iLimit = tBatchQuery.m_iMaxMatches = HASH_JOIN_BATCH_MATCHES;
+	ARRAY_FOREACH ( i, m_dFilterRemap )
+	{
+		auto & dFilterValues = tBatchQuery.m_dFilters[m_dFilterRemap[i].m_iFilterId].m_dValues;
+		dFilterValues.Resize(iNumKeys);
+		for ( int iKey = 0; iKey < iNumKeys; iKey++ )
+			dFilterValues[iKey] = dValues[iKey*iTupleLen + i];
+
+		dFilterValues.Uniq();
+	}
+
+	// any errors here are not fatal; per-row queries will handle (and report) them
+	SphQueueSettings_t tQueueSettings ( m_pJoinedIndex->GetMatchSchema() );
+	tQueueSettings.m_bComputeItems = true;
+	SphQueueRes_t tRes;
+	CSphString sError;
+	std::unique_ptr<ISphMatchSorter> pBatchSorter ( sphCreateQueue ( tQueueSettings, tBatchQuery, sError, tRes ) );
+	if ( !pBatchSorter )
+		return;
+
+	CSphQueryResultMeta tMeta;
+	CSphQueryResult tQueryResult;
+	tQueryResult.m_pMeta = &tMeta;
+
+	CSphMultiQueryArgs tArgs(1);
+	ISphMatchSorter * pSorter = pBatchSorter.get();
+	if ( !m_pJoinedIndex->MultiQuery ( tQueryResult, tBatchQuery, { &pSorter, 1 }, tArgs ) )
+		return;
+
+	// batch result was truncated; retry with smaller batches
+	if ( pSorter->GetTotalCount() > pSorter->GetLength() )
+	{
+		if ( iNumKeys < 2 )
+			return;
+
+		int iHalf = iNumKeys/2;
+		RunJoinBatch ( dHashes.Slice ( 0, iHalf ), dValues.Slice ( 0, iHalf*iTupleLen ) );
+		RunJoinBatch ( dHashes.Slice(iHalf), dValues.Slice ( iHalf*iTupleLen ) );
+		return;
+	}
+
+	CSphSwapVector<CSphMatch> dRightMatches;
+	if ( pSorter->GetLength() )
+	{
+		int iCopied = pSorter->Flatten ( dRightMatches.AddN ( pSorter->GetLength() ) );
+		dRightMatches.Resize(iCopied);
+	}
+
+	const ISphSchema & tRightSchema = *pSorter->GetSchema();
+	auto tScopedFree = AtScopeExit ( [&dRightMatches, &tRightSchema]
+	{
+		for ( auto & i : dRightMatches )
+		{
+			tRightSchema.FreeDataPtrs(i);
+			i.ResetDynamic();
+		}
+	} );
+
+	CSphVector<CSphAttrLocator> dRightLocators;
+	for ( const auto & i : m_dFilterRemap )
+	{
+		const CSphColumnInfo * pAttr = tRightSchema.GetAttr ( i.m_sRightAttr.cstr() );
+		if ( !pAttr )
+			return;
+
+		dRightLocators.Add ( pAttr->m_tLocator );
+	}
+
+	if ( m_bNeedToSetupRemap )
+		SetupJoinAttrRemap(tRightSchema);
+
+	m_tCache.SetSchema(&tRightSchema);
+
+	// group right matches by their ON values, hashed the same way as left keys
+	OpenHashTable_T<uint64_t, int> hKeys ( iNumKeys*2 );
+	ARRAY_FOREACH ( i, dHashes )
+		hKeys.Add ( dHashes[i], i );
+
+	CSphFixedVector<IntVec_t> dGroups(iNumKeys);
+	ARRAY_FOREACH ( iMatch, dRightMatches )
+	{
+		uint64_t uHash = 0;
+		for ( const auto & tLocator : dRightLocators )
+		{
+			SphAttr_t tValue = dRightMatches[iMatch].GetAttr(tLocator);
+			uHash = HashWithSeed ( &tValue, sizeof(tValue), uHash );
+		}
+
+		int * pKey = hKeys.Find(uHash);
+		if ( pKey )
+			dGroups[*pKey].Add(iMatch);
+	}
+
+	// keys without matches are cached too (as empty lists); that is what LEFT JOIN needs
+	// keys with more matches than a single right table query returns are left to per-row queries
+	CSphSwapVector<CSphMatch> dKeyMatches;
+	ARRAY_FOREACH ( iKey, dGroups )
+	{
+		const IntVec_t & dGroup = dGroups[iKey];
+		if ( dGroup.GetLength() > m_tJoinQuery.m_iLimit )
+			continue;
+
+		dKeyMatches.Resize ( dGroup.GetLength() );
+		ARRAY_FOREACH ( i, dGroup )
+			dKeyMatches[i].m_pDynamic = dRightMatches[dGroup[i]].m_pDynamic;
+
+		bool bAdded = m_tCache.Add ( dHashes[iKey], dKeyMatches );
+		for ( auto & i : dKeyMatches )
+			i.m_pDynamic = nullptr;
+
+		if ( !bAdded )
+		{
+			m_bCacheOk = false;
+			return;
+		}
+
+		// the cache owns these matches now
+		for ( auto i : dGroup )
+			dRightMatches[i].m_pDynamic = nullptr;
+	}
+}
+
+
+void JoinSorter_c::PrefetchJoinedMatches()
+{
+	if ( !m_bHashJoinKeys || m_bErrorFlag || m_pOriginalSorter->GetLength() < HASH_JOIN_MIN_ROWS )
+		return;
+
+	CSphVector<CSphAttrLocator> dLocators;
+	for ( const auto & i : m_dFilterRemap )
+		dLocators.Add ( i.m_tLocator );
+
+	JoinKeyCollector_c tCollector(dLocators);
+	m_pOriginalSorter->Finalize ( tCollector, false, false );
+
+	const auto & dHashes = tCollector.GetHashes();
+	const auto & dValues = tCollector.GetValues();
+	int iTupleLen = dLocators.GetLength();
+	for ( int iStart = 0; iStart < dHashes.GetLength() && m_bCacheOk; iStart += g_iJoinBatchKeys )
+	{
+		int iNumKeys = Min ( g_iJoinBatchKeys, dHashes.GetLength()-iStart );
+		RunJoinBatch ( dHashes.Slice ( iStart, iNumKeys ), dValues.Slice ( iStart*iTupleLen, iNumKeys*iTupleLen ) );
+	}
+}
+
+
+bool JoinSorter_c::MoveFromParallel ( const VecTraits_T<ISphMatchSorter *> & dSources, int iThreads )
+{
+	CSphVector<ISphMatchSorter *> dWrapped;
+	for ( auto * pSource : dSources )
+		dWrapped.Add ( ((JoinSorter_c *)pSource)->m_pSorter.get() );
+
+	return m_pSorter->MoveFromParallel ( dWrapped, iThreads );
+}
+
+
 ISphMatchSorter * JoinSorter_c::Clone() const
 {
 	ISphMatchSorter * pSourceSorter = m_pOriginalSorter ? m_pOriginalSorter.get() : m_pSorter.get();
@@ -1003,6 +1225,10 @@ bool JoinSorter_c::FinalizeJoin ( CSphString & sError, CSphString & sWarning )
 	SetupSorterSchema();
 
 	m_bFinalCalcOnly = false;
+
+	// fetch right table matches for all left matches in batches; the per-match joins below will hit the cache
+	PrefetchJoinedMatches();
+
 	if ( m_pOriginalSorter->IsGroupby() )
 	{
 		MatchCalcGrouped_c tCalc(this);
@@ -1100,8 +1326,30 @@ void JoinSorter_c::AddOnFilterToFilterTree ( int iFilterId )
 }
 
 
+static bool IsHashJoinKey ( const CSphColumnInfo * pAttr )
+{
+	if ( !pAttr )
+		return false;
+
+	switch ( pAttr->m_eAttrType )
+	{
+	case SPH_ATTR_INTEGER:
+	case SPH_ATTR_BIGINT:
+	case SPH_ATTR_TIMESTAMP:
+	case SPH_ATTR_BOOL:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+
 bool JoinSorter_c::SetupOnFilters ( CSphString & sError )
 {
+	m_dFilterRemap.Resize(0);
+	m_bHashJoinKeys = m_tQuery.m_dOnFilters.GetLength()>0 && g_iJoinBatchKeys>0;
+
 	for ( auto & tOnFilter : m_tQuery.m_dOnFilters )
 	{
 		CSphFilterSettings & tFilter = m_tJoinQuery.m_dFilters.Add();
@@ -1150,7 +1398,9 @@ bool JoinSorter_c::SetupOnFilters ( CSphString & sError )
 		tFilter.m_eType		= bStringFilter ? SPH_FILTER_STRING : SPH_FILTER_VALUES;
 
 		int iFilterId = m_tJoinQuery.m_dFilters.GetLength()-1;
-		m_dFilterRemap.Add ( { iFilterId, pAttr1->m_tLocator, bStringFilter } );
+		m_dFilterRemap.Add ( { iFilterId, pAttr1->m_tLocator, bStringFilter, sAttrIdx2 } );
+
+		m_bHashJoinKeys &= IsHashJoinKey(pAttr1) && IsHashJoinKey(pAttr2);
 
 		if ( bStringFilter )
 			tFilter.m_dStrings.Resize(1);
@@ -1160,6 +1410,19 @@ bool JoinSorter_c::SetupOnFilters ( CSphString & sError )
 		AddOnFilterToFilterTree(iFilterId);
 	}
 
+	// batching is only done on final calc (see FinalizeJoin); grouped sorters are not finalized twice, it is not safe with distinct
+	m_bHashJoinKeys &= m_bFinalCalcOnly && !m_pSorter->IsGroupby();
+	if ( !m_bHashJoinKeys )
+		return true;
+
+	// batched joins need ON values of right matches to find out which left key they belong to
+	for ( const auto & i : m_dFilterRemap )
+		if ( !m_tJoinQuery.m_dItems.any_of ( [&i]( const CSphQueryItem & tItem ){ return tItem.m_sAlias==i.m_sRightAttr; } ) )
+		{
+			auto & tItem = m_tJoinQuery.m_dItems.Add();
+			tItem.m_sExpr = tItem.m_sAlias = i.m_sRightAttr;
+		}
+
 	return true;
 }
 
@@ -1488,6 +1751,7 @@ public:
 	bool		CanBeCloned() const override										{ return m_pSorter->CanBeCloned(); }
 	ISphMatchSorter * Clone() const override										{ return new SorterWrapperNoPush_c ( m_pSorter->Clone() ); }
 	void		MoveTo ( ISphMatchSorter * pRhs, bool bCopyMeta ) override			{ m_pSorter->MoveTo ( ((SorterWrapperNoPush_c *)pRhs)->m_pSorter.get(), bCopyMeta ); }
+	bool		MoveFromParallel ( const VecTraits_T<ISphMatchSorter *> & dSources, int iThreads ) override;
 	void		CloneTo ( ISphMatchSorter * pTrg ) const override					{ m_pSorter->CloneTo(pTrg); }
 	void		SetFilteredAttrs ( const sph::StringSet & hAttrs, bool bAddDocid ) override	{ m_pSorter->SetFilteredAttrs(hAttrs, bAddDocid); }
 	void		TransformPooled2StandalonePtrs ( GetBlobPoolFromMatch_fn fnBlobPoolFromMatch, GetColumnarFromMatch_fn fnGetColumnarFromMatch, bool bFinalizeSorters ) override { m_pSorter->TransformPooled2StandalonePtrs(fnBlobPoolFromMatch, fnGetColumnarFromMatch, bFinalizeSorters); }
@@ -1504,6 +1768,16 @@ private:
 	std::unique_ptr<ISphMatchSorter> m_pSorter;
 };
 
+
+bool SorterWrapperNoPush_c::MoveFromParallel ( const VecTraits_T<ISphMatchSorter *> & dSources, int iThreads )
+{
+	CSphVector<ISphMatchSorter *> dWrapped;
+	for ( auto * pSource : dSources )
+		dWrapped.Add ( ((SorterWrapperNoPush_c *)pSource)->m_pSorter.get() );
+
+	return m_pSorter->MoveFromParallel ( dWrapped, iThreads );
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 bool CheckJoinOnFilters ( const CSphIndex * pIndex, const CSphIndex * pJoinedIndex, const CSphQuery & tQuery, CSphString & sError )
@@ -0,0 +1,244 @@
+//
+// Copyright (c) 2024, Manticore Software LTD (https://manticoresearch.com)
+// All rights reserved
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License. You should have
+// received a copy of the GPL license along with this program; if you
+// did not, you can find it at http://www.gnu.org/
+//
+
+#include "knndist.h"
+
+#include "knnlib.h"
+#include "knnmisc.h"
+#include <cmath>
+
+#if defined(__AVX2__) && defined(__FMA__)
+	#include <immintrin.h>
+	#define KNN_DIST_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64)
+	#include <emmintrin.h>
+	#define KNN_DIST_SSE 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	#include <arm_neon.h>
+	#define KNN_DIST_NEON 1
+#endif
+
+#if KNN_DIST_AVX2
+static FORCE_INLINE float HorizontalSum ( __m256 tSum )
+{
+	__m128 tRes = _mm_add_ps ( _mm256_castps256_ps128(tSum), _mm256_extractf128_ps ( tSum, 1 ) );
+	tRes = _mm_add_ps ( tRes, _mm_movehl_ps ( tRes, tRes ) );
+	tRes = _mm_add_ss ( tRes, _mm_shuffle_ps ( tRes, tRes, 1 ) );
+	return _mm_cvtss_f32(tRes);
+}
+#elif KNN_DIST_SSE
+static FORCE_INLINE float HorizontalSum ( __m128 tSum )
+{
+	tSum = _mm_add_ps ( tSum, _mm_movehl_ps ( tSum, tSum ) );
+	tSum = _mm_add_ss ( tSum, _mm_shuffle_ps ( tSum, tSum, 1 ) );
+	return _mm_cvtss_f32(tSum);
+}
+#endif
+
+
+float KNNDistL2Sqr ( const float * pA, const float * pB, int iDims )
+{
+	int i = 0;
+	float fRes = 0.0f;
+
+	// two accumulators to hide add latency
+#if KNN_DIST_AVX2
+	__m256 tSum0 = _mm256_setzero_ps();
+	__m256 tSum1 = _mm256_setzero_ps();
+	for ( ; i+16<=iDims; i+=16 )
+	{
+		__m256 tDiff0 = _mm256_sub_ps ( _mm256_loadu_ps(pA+i), _mm256_loadu_ps(pB+i) );
+		__m256 tDiff1 = _mm256_sub_ps ( _mm256_loadu_ps(pA+i+8), _mm256_loadu_ps(pB+i+8) );
+		tSum0 = _mm256_fmadd_ps ( tDiff0, tDiff0, tSum0 );
+		tSum1 = _mm256_fmadd_ps ( tDiff1, tDiff1, tSum1 );
+	}
+
+	for ( ; i+8<=iDims; i+=8 )
+	{
+		__m256 tDiff = _mm256_sub_ps ( _mm256_loadu_ps(pA+i), _mm256_loadu_ps(pB+i) );
+		tSum0 = _mm256_fmadd_ps ( tDiff, tDiff, tSum0 );
+	}
+
+	fRes = HorizontalSum ( _mm256_add_ps ( tSum0, tSum1 ) );
+#elif KNN_DIST_SSE
+	__m128 tSum0 = _mm_setzero_ps();
+	__m128 tSum1 = _mm_setzero_ps();
+	for ( ; i+8<=iDims; i+=8 )
+	{
+		__m128 tDiff0 = _mm_sub_ps ( _mm_loadu_ps(pA+i), _mm_loadu_ps(pB+i) );
+		__m128 tDiff1 = _mm_sub_ps ( _mm_loadu_ps(pA+i+4), _mm_loadu_ps(pB+i+4) );
+		tSum0 = _mm_add_ps ( tSum0, _mm_mul_ps ( tDiff0, tDiff0 ) );
+		tSum1 = _mm_add_ps ( tSum1, _mm_mul_ps ( tDiff1, tDiff1 ) );
+	}
+
+	for ( ; i+4<=iDims; i+=4 )
+	{
+		__m128 tDiff = _mm_sub_ps ( _mm_loadu_ps(pA+i), _mm_loadu_ps(pB+i) );
+		tSum0 = _mm_add_ps ( tSum0, _mm_mul_ps ( tDiff, tDiff ) );
+	}
+
+	fRes = HorizontalSum ( _mm_add_ps ( tSum0, tSum1 ) );
+#elif KNN_DIST_NEON
+	float32x4_t tSum0 = vdupq_n_f32(0.0f);
+	float32x4_t tSum1 = vdupq_n_f32(0.0f);
+	for ( ; i+8<=iDims; i+=8 )
+	{
+		float32x4_t tDiff0 = vsubq_f32 ( vld1q_f32(pA+i), vld1q_f32(pB+i) );
+		float32x4_t tDiff1 = vsubq_f32 ( vld1q_f32(pA+i+4), vld1q_f32(pB+i+4) );
+		tSum0 = vfmaq_f32 ( tSum0, tDiff0, tDiff0 );
+		tSum1 = vfmaq_f32 ( tSum1, tDiff1, tDiff1 );
+	}
+
+	for ( ; i+4<=iDims; i+=4 )
+	{
+		float32x4_t tDiff = vsubq_f32 ( vld1q_f32(pA+i), vld1q_f32(pB+i) );
+		tSum0 = vfmaq_f32 ( tSum0, tDiff, tDiff );
+	}
+
+	fRes = vaddvq_f32 ( vaddq_f32 ( tSum0, tSum1 ) );
+#endif
+
+	for ( ; i<iDims; i++ )
+	{
+		float fDiff = pA[i]-pB[i];
+		fRes += fDiff*fDiff;
+	}
+
+	return fRes;
+}
+
+
+float KNNDistDot ( const float * pA, const float * pB, int iDims )
+{
+	int i = 0;
+	float fRes = 0.0f;
+
+#if KNN_DIST_AVX2
+	__m256 tSum0 = _mm256_setzero_ps();
+	__m256 tSum1 = _mm256_setzero_ps();
+	for ( ; i+16<=iDims; i+=16 )
+	{
+		tSum0 = _mm256_fmadd_ps ( _mm256_loadu_ps(pA+i), _mm256_loadu_ps(pB+i), tSum0 );
+		tSum1 = _mm256_fmadd_ps ( _mm256_loadu_ps(pA+i+8), _mm256_loadu_ps(pB+i+8), tSum1 );
+	}
+
+	for ( ; i+8<=iDims; i+=8 )
+		tSum0 = _mm256_fmadd_ps ( _mm256_loadu_ps(pA+i), _mm256_loadu_ps(pB+i), tSum0 );
+
+	fRes = HorizontalSum ( _mm256_add_ps ( tSum0, tSum1 ) );
+#elif KNN_DIST_SSE
+	__m128 tSum0 = _mm_setzero_ps();
+	__m128 tSum1 = _mm_setzero_ps();
+	for ( ; i+8<=iDims; i+=8 )
+	{
+		tSum0 = _mm_add_ps ( tSum0, _mm_mul_ps ( _mm_loadu_ps(pA+i), _mm_loadu_ps(pB+i) ) );
+		tSum1 = _mm_add_ps ( tSum1, _mm_mul_ps ( _mm_loadu_ps(pA+i+4), _mm_loadu_ps(pB+i+4) ) );
+	}
+
+	for ( ; i+4<=iDims; i+=4 )
+		tSum0 = _mm_add_ps ( tSum0, _mm_mul_ps ( _mm_loadu_ps(pA+i), _mm_loadu_ps(pB+i) ) );
+
+	fRes = HorizontalSum ( _mm_add_ps ( tSum0, tSum1 ) );
+#elif KNN_DIST_NEON
+	float32x4_t tSum0 = vdupq_n_f32(0.0f);
+	float32x4_t tSum1 = vdupq_n_f32(0.0f);
+	for ( ; i+8<=iDims; i+=8 )
+	{
+		tSum0 = vfmaq_f32 ( tSum0, vld1q_f32(pA+i), vld1q_f32(pB+i) );
+		tSum1 = vfmaq_f32 ( tSum1, vld1q_f32(pA+i+4), vld1q_f32(pB+i+4) );
+	}
+
+	for ( ; i+4<=iDims; i+=4 )
+		tSum0 = vfmaq_f32 ( tSum0, vld1q_f32(pA+i), vld1q_f32(pB+i) );
+
+	fRes = vaddvq_f32 ( vaddq_f32 ( tSum0, tSum1 ) );
+#endif
+
+	for ( ; i<iDims; i++ )
+		fRes += pA[i]*pB[i];
+
+	return fRes;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+KNNDistance_c::KNNDistance_c ( const knn::IndexSettings_t & tSettings )
+	: m_iDims ( tSettings.m_iDims )
+	, m_eKernel ( tSettings.m_eHNSWSimilarity==knn::HNSWSimilarity_e::L2 ? Kernel_e::L2 : Kernel_e::DOT )
+{
+	if ( !IsKNNLibLoaded() || m_iDims<=0 )
+		return;
+
+	m_pLibDist = CreateKNNDistanceCalc(tSettings);
+	if ( !m_pLibDist )
+		return;
+
+	// make sure that native kernels give the same distances as the library (e.g. on library updates)
+	CSphVector<float> dA ( m_iDims );
+	CSphVector<float> dB ( m_iDims );
+	ARRAY_FOREACH ( i, dA )
+	{
+		dA[i] = sinf ( 0.37f*i + 0.1f );
+		dB[i] = cosf ( 0.11f*i );
+	}
+
+	if ( tSettings.m_eHNSWSimilarity==knn::HNSWSimilarity_e::COSINE )
+	{
+		NormalizeVec(dA);
+		NormalizeVec(dB);
+	}
+
+	float fLib = m_pLibDist->CalcDist ( { dA.Begin(), (size_t)m_iDims }, { dB.Begin(), (size_t)m_iDims } );
+	float fNative = CalcNative ( dA.Begin(), dB.Begin() );
+	if ( fabsf ( fLib-fNative ) <= 1e-3f*Max ( 1.0f, fabsf(fLib) ) )
+		m_pLibDist.reset();
+}
+
+
+float KNNDistance_c::CalcNative ( const float * pA, const float * pB ) const
+{
+	if ( m_eKernel==Kernel_e::L2 )
+		return KNNDistL2Sqr ( pA, pB, m_iDims );
+
+	return 1.0f - KNNDistDot ( pA, pB, m_iDims );
+}
+
+
+float KNNDistance_c::CalcDist ( const float * pA, const float * pB ) const
+{
+	if ( m_pLibDist )
+		return m_pLibDist->CalcDist ( { (float*)pA, (size_t)m_iDims }, { (float*)pB, (size_t)m_iDims } );
+
+	return CalcNative ( pA, pB );
+}
+
+
+void KNNDistance_c::CalcDists ( const float * pPoint, const VecTraits_T<const float *> & dVectors, float * pDists ) const
+{
+	if ( m_pLibDist )
+	{
+		ARRAY_FOREACH ( i, dVectors )
+			pDists[i] = m_pLibDist->CalcDist ( { (float*)dVectors[i], (size_t)m_iDims }, { (float*)pPoint, (size_t)m_iDims } );
+
+		return;
+	}
+
+	// one kernel dispatch per block; the point stays in L1 while the vectors are streamed
+	if ( m_eKernel==Kernel_e::L2 )
+	{
+		ARRAY_FOREACH ( i, dVectors )
+			pDists[i] = KNNDistL2Sqr ( dVectors[i], pPoint, m_iDims );
+	}
+	else
+	{
+		ARRAY_FOREACH ( i, dVectors )
+			pDists[i] = 1.0f - KNNDistDot ( dVectors[i], pPoint, m_iDims );
+	}
+}
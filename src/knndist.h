@@ -0,0 +1,47 @@
+//
+// Copyright (c) 2024, Manticore Software LTD (https://manticoresearch.com)
+// All rights reserved
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License. You should have
+// received a copy of the GPL license along with this program; if you
+// did not, you can find it at http://www.gnu.org/
+//
+
+#pragma once
+
+#include "sphinxstd.h"
+
+#include "knn/knn.h"
+
+// native distance kernels (SSE/AVX2+FMA/NEON, depending on what the daemon is compiled for)
+float	KNNDistL2Sqr ( const float * pA, const float * pB, int iDims );
+float	KNNDistDot ( const float * pA, const float * pB, int iDims );
+
+/// vector distance calculator with the same results as the knn library one (squared L2, or 1-dot for IP and COSINE)
+/// native kernels are used when they agree with the library; otherwise it just forwards to the library
+class KNNDistance_c
+{
+public:
+	explicit	KNNDistance_c ( const knn::IndexSettings_t & tSettings );
+
+	float		CalcDist ( const float * pA, const float * pB ) const;
+
+	/// scores a block of vectors against one point; pDists should have room for dVectors.GetLength() values
+	void		CalcDists ( const float * pPoint, const VecTraits_T<const float *> & dVectors, float * pDists ) const;
+
+	bool		IsNative() const	{ return !m_pLibDist; }
+
+private:
+	enum class Kernel_e
+	{
+		L2,
+		DOT
+	};
+
+	int			m_iDims = 0;
+	Kernel_e	m_eKernel = Kernel_e::L2;
+	std::unique_ptr<knn::Distance_i> m_pLibDist;
+
+	float		CalcNative ( const float * pA, const float * pB ) const;
+};
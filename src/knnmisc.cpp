@@ -10,13 +10,15 @@
 
 #include "knnmisc.h"
 #include "knnlib.h"
+#include "knndist.h"
 #include "exprtraits.h"
 #include "sphinxint.h"
 #include "fileio.h"
 #include "sphinxjson.h"
+#include <cmath>
 
 
-static void NormalizeVec ( VecTraits_T<float> & dData )
+void NormalizeVec ( VecTraits_T<float> & dData )
 {
 	float fNorm = 0.0f;
 	for ( auto i : dData )
@@ -44,7 +46,7 @@ public:
 	void		SetData ( const util::Span_T<const knn::DocDist_t> & dData );
 
 private:
-	std::unique_ptr<knn::Distance_i>	m_pDistCalc;
+	KNNDistance_c						m_tDistCalc;
 	CSphVector<float>					m_dAnchor;
 	CSphColumnInfo						m_tAttr;
 	const BYTE *						m_pBlobPool = nullptr;
@@ -57,7 +59,7 @@ private:
 
 
 Expr_KNNDist_c::Expr_KNNDist_c ( const CSphVector<float> & dAnchor, const CSphColumnInfo & tAttr )
-	: m_pDistCalc ( CreateKNNDistanceCalc ( tAttr.m_tKNN ) )
+	: m_tDistCalc ( tAttr.m_tKNN )
 	, m_dAnchor ( dAnchor )
 	, m_tAttr ( tAttr )
 {
@@ -78,8 +80,7 @@ float Expr_KNNDist_c::Eval ( const CSphMatch & tMatch ) const
 	}
 	else // calculate distance
 	{
-		// this code path is used when no iterator is available, i.e. in ram chunk
-		// so performance is not critical
+		// this code path is used when no iterator is available, i.e. in ram chunk or in brute force knn search
 		ByteBlob_t tRes;
 		if ( m_tAttr.IsColumnar() )
 			tRes.second = m_pIterator->Get ( tMatch.m_tRowID, tRes.first );
@@ -98,7 +99,7 @@ float Expr_KNNDist_c::Eval ( const CSphMatch & tMatch ) const
 		if ( dData.GetLength()!=m_tAttr.m_tKNN.m_iDims )
 			return FLT_MAX;
 
-		return m_pDistCalc->CalcDist ( { dData.Begin(), (size_t)dData.GetLength() }, { m_dAnchor.Begin(), (size_t)m_dAnchor.GetLength() } );
+		return m_tDistCalc.CalcDist ( dData.Begin(), m_dAnchor.Begin() );
 	}
 }
 
@@ -162,6 +163,17 @@ ISphExpr * CreateExpr_KNNDist ( const CSphVector<float> & dAnchor, const CSphCol
 }
 
 
+void SetKNNDistData ( const ISphSchema & tSorterSchema, const util::Span_T<const knn::DocDist_t> & dData )
+{
+	const auto pAttr = tSorterSchema.GetAttr ( GetKnnDistAttrName() );
+	if ( !pAttr || !pAttr->m_pExpr )
+		return;
+
+	ISphExpr * pExpr = pAttr->m_pExpr;
+	((Expr_KNNDist_c*)pExpr)->SetData(dData);
+}
+
+
 static const char * HNSWSimilarity2Str ( knn::HNSWSimilarity_e eSim )
 {
 	switch ( eSim )
@@ -347,7 +359,7 @@ bool BuildStoreKNN ( RowID_t tRowID, const CSphRowitem * pRow, const BYTE * pPoo
 }
 
 
-std::pair<RowidIterator_i *, bool> CreateKNNIterator ( knn::KNN_i * pKNN, const CSphQuery & tQuery, const ISphSchema & tIndexSchema, const ISphSchema & tSorterSchema, CSphString & sError )
+std::pair<RowidIterator_i *, bool> CreateKNNIterator ( knn::KNN_i * pKNN, const CSphQuery & tQuery, const KNNFilterPlan_t & tPlan, const ISphSchema & tIndexSchema, const ISphSchema & tSorterSchema, CSphString & sError )
 {
 	if ( tQuery.m_sKNNAttr.IsEmpty() )
 		return { nullptr, false };
@@ -371,6 +383,10 @@ std::pair<RowidIterator_i *, bool> CreateKNNIterator ( knn::KNN_i * pKNN, const
 		return { nullptr, true };
 	}
 
+	// distances will be calculated for every row that passes filters
+	if ( tPlan.m_eMode==KNNFilterMode_e::BRUTEFORCE )
+		return { nullptr, false };
+
 	const auto pAttr = tSorterSchema.GetAttr ( GetKnnDistAttrName() );
 	assert(pAttr);
 
@@ -384,7 +400,7 @@ std::pair<RowidIterator_i *, bool> CreateKNNIterator ( knn::KNN_i * pKNN, const
 		NormalizeVec(dPoint);
 
 	std::string sErrorSTL;
-	knn::Iterator_i * pIterator = pKNN->CreateIterator ( pKNNAttr->m_sName.cstr(), { dPoint.Begin(), (size_t)dPoint.GetLength() }, tQuery.m_iKNNK, tQuery.m_iKnnEf, sErrorSTL );
+	knn::Iterator_i * pIterator = pKNN->CreateIterator ( pKNNAttr->m_sName.cstr(), { dPoint.Begin(), (size_t)dPoint.GetLength() }, tPlan.m_iK, tPlan.m_iEf, sErrorSTL );
 	if ( !pIterator )
 	{
 		sError = sErrorSTL.c_str();
@@ -397,11 +413,11 @@ std::pair<RowidIterator_i *, bool> CreateKNNIterator ( knn::KNN_i * pKNN, const
 }
 
 
-RowIteratorsWithEstimates_t	CreateKNNIterators ( knn::KNN_i * pKNN, const CSphQuery & tQuery, const ISphSchema & tIndexSchema, const ISphSchema & tSorterSchema, bool & bError, CSphString & sError )
+RowIteratorsWithEstimates_t	CreateKNNIterators ( knn::KNN_i * pKNN, const CSphQuery & tQuery, const KNNFilterPlan_t & tPlan, const ISphSchema & tIndexSchema, const ISphSchema & tSorterSchema, bool & bError, CSphString & sError )
 {
 	RowIteratorsWithEstimates_t dIterators;
 
-	auto tRes = CreateKNNIterator ( pKNN, tQuery, tIndexSchema, tSorterSchema, sError );
+	auto tRes = CreateKNNIterator ( pKNN, tQuery, tPlan, tIndexSchema, tSorterSchema, sError );
 	if ( tRes.second )
 	{
 		bError = true;
@@ -411,6 +427,98 @@ RowIteratorsWithEstimates_t	CreateKNNIterators ( knn::KNN_i * pKNN, const CSphQu
 	if ( !tRes.first )
 		return dIterators;
 
-	dIterators.Add ( { tRes.first, tQuery.m_iKNNK } );
+	dIterators.Add ( { tRes.first, tPlan.m_iK } );
 	return dIterators;
 }
+
+/////////////////////////////////////////////////////////////////////
+
+// same units as in CostEstimate_c
+static const float KNN_COST_SCALE			= 1.0f/1000000.0f;
+static const float KNN_COST_DIST			= 10.0f;	// fetching a vector, heap updates etc
+static const float KNN_COST_DIST_PER_DIM	= 0.25f;
+static const float KNN_EXPAND_MARGIN		= 1.2f;		// filter estimates are not exact, so ask for some extra candidates
+
+static float CalcKNNDistCost ( int64_t iDists, int iDims )
+{
+	return ( KNN_COST_DIST + KNN_COST_DIST_PER_DIM*iDims )*iDists*KNN_COST_SCALE;
+}
+
+
+static float CalcKNNGraphCost ( int iEf, int64_t iTotalDocs, const knn::IndexSettings_t & tSettings )
+{
+	// greedy search on upper levels is ~M distances per level; level 0 expands ~ef nodes with up to 2*M links each
+	int iM = Max ( tSettings.m_iHNSWM, 2 );
+	int64_t iDists = int64_t(iEf)*iM*2 + int64_t ( log2 ( (double)Max ( iTotalDocs, (int64_t)2 ) ) )*iM;
+	return CalcKNNDistCost ( iDists, tSettings.m_iDims );
+}
+
+
+const char * KNNFilterMode2Str ( KNNFilterMode_e eMode )
+{
+	switch ( eMode )
+	{
+	case KNNFilterMode_e::GRAPH:			return "KNNGraph";
+	case KNNFilterMode_e::FILTERED_GRAPH:	return "KNNFilteredGraph";
+	case KNNFilterMode_e::EXPANDED_GRAPH:	return "KNNExpandedGraph";
+	case KNNFilterMode_e::BRUTEFORCE:		return "KNNBruteForce";
+	default:								return nullptr;
+	}
+}
+
+
+KNNFilterPlan_t GetDefaultKNNPlan ( const CSphQuery & tQuery )
+{
+	KNNFilterPlan_t tPlan;
+	tPlan.m_iK = tQuery.m_iKNNK;
+	tPlan.m_iEf = tQuery.m_iKnnEf;
+	return tPlan;
+}
+
+
+int CalcKNNExpandedK ( int iK, int64_t iTotalDocs, int64_t iFilteredDocs )
+{
+	if ( iFilteredDocs>=iTotalDocs )
+		return iK;
+
+	double fExpanded = double(iK) * iTotalDocs / Max ( iFilteredDocs, (int64_t)1 ) * KNN_EXPAND_MARGIN;
+	return (int)Min ( fExpanded, (double)Min ( iTotalDocs, (int64_t)INT_MAX ) );
+}
+
+
+KNNFilterPlan_t PlanFilteredKNN ( const CSphQuery & tQuery, const knn::IndexSettings_t & tSettings, int64_t iTotalDocs, int64_t iFilteredDocs, bool bFilterAware, float fGraphFilterCost, float fBruteForceFilterCost )
+{
+	KNNFilterPlan_t tPlan = GetDefaultKNNPlan(tQuery);
+	if ( iTotalDocs<=0 || iFilteredDocs>=iTotalDocs )
+		return tPlan;
+
+	int iEf = Max ( tQuery.m_iKnnEf, tQuery.m_iKNNK );
+	int iExpandedK = CalcKNNExpandedK ( tQuery.m_iKNNK, iTotalDocs, iFilteredDocs );
+
+	// filter-aware traversal returns k rows, but needs a wider beam to collect enough allowed ones
+	// otherwise we need more candidates (and a beam that fits them) and filter them afterwards
+	KNNFilterPlan_t tGraphPlan = tPlan;
+	if ( bFilterAware )
+	{
+		tGraphPlan.m_eMode = KNNFilterMode_e::FILTERED_GRAPH;
+		tGraphPlan.m_iEf = CalcKNNExpandedK ( iEf, iTotalDocs, iFilteredDocs );
+	}
+	else
+	{
+		tGraphPlan.m_eMode = KNNFilterMode_e::EXPANDED_GRAPH;
+		tGraphPlan.m_iK = iExpandedK;
+		tGraphPlan.m_iEf = Max ( iEf, iExpandedK );
+	}
+
+	float fGraphCost = CalcKNNGraphCost ( tGraphPlan.m_iEf, iTotalDocs, tSettings ) + fGraphFilterCost;
+	float fBruteForceCost = CalcKNNDistCost ( iFilteredDocs, tSettings.m_iDims ) + fBruteForceFilterCost;
+
+	// no point in graph search that returns (almost) everything
+	if ( fBruteForceCost<=fGraphCost || iExpandedK>=iTotalDocs )
+	{
+		tPlan.m_eMode = KNNFilterMode_e::BRUTEFORCE;
+		return tPlan;
+	}
+
+	return tGraphPlan;
+}
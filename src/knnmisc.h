@@ -16,8 +16,26 @@
 #include "indexsettings.h"
 #include "secondaryindex.h"
 
+/// how KNN search deals with attribute filters
+enum class KNNFilterMode_e
+{
+	GRAPH,			///< plain graph search (no filters or filters are not selective)
+	FILTERED_GRAPH,	///< graph traversal that only returns rows allowed by filters
+	EXPANDED_GRAPH,	///< graph search for more candidates; filters are applied afterwards
+	BRUTEFORCE		///< exact distances to all rows that pass filters
+};
+
+struct KNNFilterPlan_t
+{
+	KNNFilterMode_e	m_eMode = KNNFilterMode_e::GRAPH;
+	int				m_iK = 0;
+	int				m_iEf = 0;
+};
+
 const char *					GetKnnDistAttrName();
 ISphExpr *						CreateExpr_KNNDist ( const CSphVector<float> & dAnchor, const CSphColumnInfo & tAttr );
+void							SetKNNDistData ( const ISphSchema & tSorterSchema, const util::Span_T<const knn::DocDist_t> & dData );
+void							NormalizeVec ( VecTraits_T<float> & dData );
 
 void							operator << ( JsonEscapedBuilder & tOut, const knn::IndexSettings_t & tSettings );
 void							AddKNNSettings ( StringBuilder_c & sRes, const CSphColumnInfo & tAttr );
@@ -27,5 +45,13 @@ bool							ParseKNNConfigStr ( const CSphString & sStr, CSphVector<NamedKNNSetti
 
 std::unique_ptr<knn::Builder_i>	BuildCreateKNN ( const ISphSchema & tSchema, int64_t iNumElements, CSphVector<PlainOrColumnar_t> & dAttrs, CSphString & sError );
 bool							BuildStoreKNN ( RowID_t tRowID, const CSphRowitem * pRow, const BYTE * pPool, CSphVector<ScopedTypedIterator_t> & dIterators, const CSphVector<PlainOrColumnar_t> & dAttrs, knn::Builder_i & tBuilder );
-std::pair<RowidIterator_i *, bool> CreateKNNIterator ( knn::KNN_i * pKNN, const CSphQuery & tQuery, const ISphSchema & tIndexSchema, const ISphSchema & tSorterSchema, CSphString & sError );
-RowIteratorsWithEstimates_t		CreateKNNIterators ( knn::KNN_i * pKNN, const CSphQuery & tQuery, const ISphSchema & tIndexSchema, const ISphSchema & tSorterSchema, bool & bError, CSphString & sError );
+std::pair<RowidIterator_i *, bool> CreateKNNIterator ( knn::KNN_i * pKNN, const CSphQuery & tQuery, const KNNFilterPlan_t & tPlan, const ISphSchema & tIndexSchema, const ISphSchema & tSorterSchema, CSphString & sError );
+RowIteratorsWithEstimates_t		CreateKNNIterators ( knn::KNN_i * pKNN, const CSphQuery & tQuery, const KNNFilterPlan_t & tPlan, const ISphSchema & tIndexSchema, const ISphSchema & tSorterSchema, bool & bError, CSphString & sError );
+
+const char *					KNNFilterMode2Str ( KNNFilterMode_e eMode );
+KNNFilterPlan_t					GetDefaultKNNPlan ( const CSphQuery & tQuery );
+int								CalcKNNExpandedK ( int iK, int64_t iTotalDocs, int64_t iFilteredDocs );
+
+/// picks the cheapest way to run a KNN search with filters; iFilteredDocs is an estimate (or exact count) of rows that pass filters
+/// bFilterAware means the graph can skip filtered-out rows by itself; extra costs are the costs of evaluating filters in both cases
+KNNFilterPlan_t					PlanFilteredKNN ( const CSphQuery & tQuery, const knn::IndexSettings_t & tSettings, int64_t iTotalDocs, int64_t iFilteredDocs, bool bFilterAware, float fGraphFilterCost = 0.0f, float fBruteForceFilterCost = 0.0f );
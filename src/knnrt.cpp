@@ -0,0 +1,610 @@
+//
+// Copyright (c) 2024, Manticore Software LTD (https://manticoresearch.com)
+// All rights reserved
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License. You should have
+// received a copy of the GPL license along with this program; if you
+// did not, you can find it at http://www.gnu.org/
+//
+
+#include "knnrt.h"
+
+#include "knndist.h"
+#include "knnlib.h"
+#include "knnmisc.h"
+#include "killlist.h"
+#include "sphinxint.h"
+#include <algorithm>
+#include <cmath>
+
+
+class HNSWGraph_c
+{
+public:
+	explicit	HNSWGraph_c ( const knn::IndexSettings_t & tSettings );
+				HNSWGraph_c ( const HNSWGraph_c & tSrc );
+
+	void		Add ( RowID_t tRowID, const VecTraits_T<float> & dData );
+	void		Search ( const VecTraits_T<float> & dPoint, const KNNFilterPlan_t & tPlan, const DeadRowMap_Ram_c & tDeadRowMap, const BitVec_T<uint64_t> * pAllowed, CSphVector<knn::DocDist_t> & dRes ) const;
+	void		RemapRows ( const VecTraits_T<RowID_t> & dRowMap );
+	float		GetDeletedRatio() const;
+	int64_t		AllocatedBytes() const;
+	int			GetDims() const		{ return m_tSettings.m_iDims; }
+
+private:
+	using Candidate_t = std::pair<float,DWORD>;
+	static constexpr int MAX_LEVEL = 15;
+
+	knn::IndexSettings_t	m_tSettings;
+	KNNDistance_c			m_tDist;			// used when adding; searches reuse it only if it is thread-safe (native)
+	int						m_iM = 0;
+	int						m_iM0 = 0;
+	double					m_fLevelMult = 0.0;
+	DWORD					m_uSeed = 1;
+
+	CSphVector<float>		m_dVectors;			// m_iDims floats per node
+	CSphVector<RowID_t>		m_dRowIDs;			// INVALID_ROWID means the node is deleted
+	CSphVector<BYTE>		m_dLevels;
+	CSphVector<DWORD>		m_dLinks0;			// ( m_iM0+1 ) per node: number of links, then links
+	CSphVector<DWORD>		m_dLinks;			// ( m_iM+1 ) per node per level above 0
+	CSphVector<int64_t>		m_dLinksOffset;		// offset of node links in m_dLinks
+	DWORD					m_uEntry = 0;
+	int						m_iMaxLevel = -1;
+	int						m_iDeleted = 0;
+
+	int			GetNumNodes() const { return m_dRowIDs.GetLength(); }
+	float *		GetVector ( DWORD uNode ) const { return m_dVectors.Begin() + (int64_t)uNode*m_tSettings.m_iDims; }
+	DWORD *		GetLinks ( DWORD uNode, int iLevel ) const;
+	float		CalcDist ( const KNNDistance_c & tDist, DWORD uNode, const float * pPoint ) const { return tDist.CalcDist ( GetVector(uNode), pPoint ); }
+	bool		IsAllowed ( DWORD uNode, const BitVec_T<uint64_t> * pAllowed ) const { return m_dRowIDs[uNode]!=INVALID_ROWID && ( !pAllowed || pAllowed->BitGet ( m_dRowIDs[uNode] ) ); }
+	bool		IsAlive ( DWORD uNode, const DeadRowMap_Ram_c & tDeadRowMap ) const { return m_dRowIDs[uNode]!=INVALID_ROWID && !tDeadRowMap.IsSet ( m_dRowIDs[uNode] ); }
+	int			CountAlive ( const VecTraits_T<Candidate_t> & dFound, const DeadRowMap_Ram_c & tDeadRowMap ) const;
+	int			GetRandomLevel();
+
+	void		SearchGreedy ( const KNNDistance_c & tDist, const float * pPoint, int iLevel, DWORD & uCur, float & fCurDist ) const;
+	void		SearchLayer ( const KNNDistance_c & tDist, const float * pPoint, DWORD uEntry, float fEntryDist, int iEf, int iLevel, const BitVec_T<uint64_t> * pAllowed, CSphVector<Candidate_t> & dRes ) const;
+	void		SearchAll ( const KNNDistance_c & tDist, const float * pPoint, int iK, const BitVec_T<uint64_t> * pAllowed, CSphVector<Candidate_t> & dRes ) const;
+	void		SelectNeighbors ( CSphVector<Candidate_t> & dCandidates, int iMaxLinks ) const;
+	void		Connect ( DWORD uNode, DWORD uNeighbor, int iLevel );
+};
+
+
+HNSWGraph_c::HNSWGraph_c ( const knn::IndexSettings_t & tSettings )
+	: m_tSettings ( tSettings )
+	, m_tDist ( tSettings )
+	, m_iM ( Max ( tSettings.m_iHNSWM, 2 ) )
+	, m_iM0 ( m_iM*2 )
+	, m_fLevelMult ( 1.0 / log ( (double)m_iM ) )
+{}
+
+
+HNSWGraph_c::HNSWGraph_c ( const HNSWGraph_c & tSrc )
+	: m_tSettings ( tSrc.m_tSettings )
+	, m_tDist ( tSrc.m_tSettings )
+	, m_iM ( tSrc.m_iM )
+	, m_iM0 ( tSrc.m_iM0 )
+	, m_fLevelMult ( tSrc.m_fLevelMult )
+	, m_uSeed ( tSrc.m_uSeed )
+	, m_dVectors ( tSrc.m_dVectors )
+	, m_dRowIDs ( tSrc.m_dRowIDs )
+	, m_dLevels ( tSrc.m_dLevels )
+	, m_dLinks0 ( tSrc.m_dLinks0 )
+	, m_dLinks ( tSrc.m_dLinks )
+	, m_dLinksOffset ( tSrc.m_dLinksOffset )
+	, m_uEntry ( tSrc.m_uEntry )
+	, m_iMaxLevel ( tSrc.m_iMaxLevel )
+	, m_iDeleted ( tSrc.m_iDeleted )
+{}
+
+
+DWORD * HNSWGraph_c::GetLinks ( DWORD uNode, int iLevel ) const
+{
+	if ( !iLevel )
+		return m_dLinks0.Begin() + (int64_t)uNode*( m_iM0+1 );
+
+	return m_dLinks.Begin() + m_dLinksOffset[uNode] + (int64_t)( iLevel-1 )*( m_iM+1 );
+}
+
+
+int HNSWGraph_c::GetRandomLevel()
+{
+	m_uSeed = m_uSeed*1664525 + 1013904223;
+	double fRand = double ( ( m_uSeed>>8 ) + 1 ) / double ( ( 1<<24 ) + 1 );
+	return Min ( int ( -log(fRand)*m_fLevelMult ), MAX_LEVEL );
+}
+
+
+void HNSWGraph_c::SearchGreedy ( const KNNDistance_c & tDist, const float * pPoint, int iLevel, DWORD & uCur, float & fCurDist ) const
+{
+	bool bChanged = true;
+	while ( bChanged )
+	{
+		bChanged = false;
+		const DWORD * pLinks = GetLinks ( uCur, iLevel );
+		for ( DWORD i = 1; i <= pLinks[0]; i++ )
+		{
+			float fDist = CalcDist ( tDist, pLinks[i], pPoint );
+			if ( fDist < fCurDist )
+			{
+				fCurDist = fDist;
+				uCur = pLinks[i];
+				bChanged = true;
+			}
+		}
+	}
+}
+
+
+// if pAllowed is set, all nodes are traversed, but only allowed ones get to results
+void HNSWGraph_c::SearchLayer ( const KNNDistance_c & tDist, const float * pPoint, DWORD uEntry, float fEntryDist, int iEf, int iLevel, const BitVec_T<uint64_t> * pAllowed, CSphVector<Candidate_t> & dRes ) const
+{
+	auto fnNearestFirst = []( const Candidate_t & a, const Candidate_t & b ){ return a.first > b.first; };
+	auto fnFarthestFirst = []( const Candidate_t & a, const Candidate_t & b ){ return a.first < b.first; };
+
+	BitVec_T<uint64_t> tVisited ( GetNumNodes() );
+	CSphVector<Candidate_t> dCandidates;
+	CSphVector<DWORD> dBatch;
+	CSphVector<const float *> dBatchVectors;
+	CSphVector<float> dBatchDists;
+
+	tVisited.BitSet(uEntry);
+	dCandidates.Add ( { fEntryDist, uEntry } );
+	dRes.Resize(0);
+	if ( !pAllowed || IsAllowed ( uEntry, pAllowed ) )
+		dRes.Add ( { fEntryDist, uEntry } );
+
+	while ( !dCandidates.IsEmpty() )
+	{
+		std::pop_heap ( dCandidates.begin(), dCandidates.end(), fnNearestFirst );
+		Candidate_t tCur = dCandidates.Pop();
+		if ( dRes.GetLength()>=iEf && tCur.first > dRes[0].first )
+			break;
+
+		// score all unvisited neighbors in one batch
+		const DWORD * pLinks = GetLinks ( tCur.second, iLevel );
+		dBatch.Resize(0);
+		dBatchVectors.Resize(0);
+		for ( DWORD i = 1; i <= pLinks[0]; i++ )
+		{
+			DWORD uNeighbor = pLinks[i];
+			if ( tVisited.BitGet(uNeighbor) )
+				continue;
+
+			tVisited.BitSet(uNeighbor);
+			dBatch.Add(uNeighbor);
+			dBatchVectors.Add ( GetVector(uNeighbor) );
+		}
+
+		dBatchDists.Resize ( dBatch.GetLength() );
+		tDist.CalcDists ( pPoint, dBatchVectors, dBatchDists.Begin() );
+
+		ARRAY_FOREACH ( i, dBatch )
+		{
+			DWORD uNeighbor = dBatch[i];
+			float fDist = dBatchDists[i];
+			if ( dRes.GetLength()>=iEf && fDist>=dRes[0].first )
+				continue;
+
+			dCandidates.Add ( { fDist, uNeighbor } );
+			std::push_heap ( dCandidates.begin(), dCandidates.end(), fnNearestFirst );
+
+			if ( pAllowed && !IsAllowed ( uNeighbor, pAllowed ) )
+				continue;
+
+			dRes.Add ( { fDist, uNeighbor } );
+			std::push_heap ( dRes.begin(), dRes.end(), fnFarthestFirst );
+			if ( dRes.GetLength()>iEf )
+			{
+				std::pop_heap ( dRes.begin(), dRes.end(), fnFarthestFirst );
+				dRes.Pop();
+			}
+		}
+	}
+
+	dRes.Sort ( Lesser ( fnFarthestFirst ) );
+}
+
+
+void HNSWGraph_c::SearchAll ( const KNNDistance_c & tDist, const float * pPoint, int iK, const BitVec_T<uint64_t> * pAllowed, CSphVector<Candidate_t> & dRes ) const
+{
+	auto fnFarthestFirst = []( const Candidate_t & a, const Candidate_t & b ){ return a.first < b.first; };
+
+	const int BATCH_SIZE = 256;
+	CSphVector<DWORD> dBatch;
+	CSphVector<const float *> dBatchVectors;
+	CSphVector<float> dBatchDists;
+
+	dRes.Resize(0);
+	auto uNumNodes = (DWORD)GetNumNodes();
+	DWORD uNode = 0;
+	while ( uNode<uNumNodes )
+	{
+		dBatch.Resize(0);
+		dBatchVectors.Resize(0);
+		for ( ; uNode<uNumNodes && dBatch.GetLength()<BATCH_SIZE; uNode++ )
+			if ( IsAllowed ( uNode, pAllowed ) )
+			{
+				dBatch.Add(uNode);
+				dBatchVectors.Add ( GetVector(uNode) );
+			}
+
+		dBatchDists.Resize ( dBatch.GetLength() );
+		tDist.CalcDists ( pPoint, dBatchVectors, dBatchDists.Begin() );
+
+		ARRAY_FOREACH ( i, dBatch )
+		{
+			if ( dRes.GetLength()>=iK && dBatchDists[i]>=dRes[0].first )
+				continue;
+
+			dRes.Add ( { dBatchDists[i], dBatch[i] } );
+			std::push_heap ( dRes.begin(), dRes.end(), fnFarthestFirst );
+			if ( dRes.GetLength()>iK )
+			{
+				std::pop_heap ( dRes.begin(), dRes.end(), fnFarthestFirst );
+				dRes.Pop();
+			}
+		}
+	}
+
+	dRes.Sort ( Lesser ( fnFarthestFirst ) );
+}
+
+
+void HNSWGraph_c::SelectNeighbors ( CSphVector<Candidate_t> & dCandidates, int iMaxLinks ) const
+{
+	// heuristic from the HNSW paper: skip candidates that are closer to an already selected neighbor than to the node
+	// candidates are sorted by distance to the node
+	if ( dCandidates.GetLength()<=iMaxLinks )
+		return;
+
+	CSphVector<Candidate_t> dSelected;
+	for ( const auto & tCandidate : dCandidates )
+	{
+		if ( dSelected.GetLength()>=iMaxLinks )
+			break;
+
+		bool bGood = true;
+		for ( const auto & tSelected : dSelected )
+			if ( CalcDist ( m_tDist, tCandidate.second, GetVector ( tSelected.second ) ) < tCandidate.first )
+			{
+				bGood = false;
+				break;
+			}
+
+		if ( bGood )
+			dSelected.Add(tCandidate);
+	}
+
+	dCandidates.SwapData(dSelected);
+}
+
+
+void HNSWGraph_c::Connect ( DWORD uNode, DWORD uNeighbor, int iLevel )
+{
+	int iMaxLinks = iLevel ? m_iM : m_iM0;
+	DWORD * pLinks = GetLinks ( uNode, iLevel );
+	if ( (int)pLinks[0] < iMaxLinks )
+	{
+		pLinks[++pLinks[0]] = uNeighbor;
+		return;
+	}
+
+	// no room; keep the best ones
+	CSphVector<Candidate_t> dCandidates;
+	const float * pNode = GetVector(uNode);
+	for ( DWORD i = 1; i <= pLinks[0]; i++ )
+		dCandidates.Add ( { CalcDist ( m_tDist, pLinks[i], pNode ), pLinks[i] } );
+
+	dCandidates.Add ( { CalcDist ( m_tDist, uNeighbor, pNode ), uNeighbor } );
+	dCandidates.Sort ( Lesser ( []( const Candidate_t & a, const Candidate_t & b ){ return a.first < b.first; } ) );
+	SelectNeighbors ( dCandidates, iMaxLinks );
+
+	pLinks[0] = dCandidates.GetLength();
+	ARRAY_FOREACH ( i, dCandidates )
+		pLinks[i+1] = dCandidates[i].second;
+}
+
+
+void HNSWGraph_c::Add ( RowID_t tRowID, const VecTraits_T<float> & dData )
+{
+	assert ( dData.GetLength()==m_tSettings.m_iDims );
+
+	auto uNode = (DWORD)GetNumNodes();
+	float * pVector = m_dVectors.AddN ( m_tSettings.m_iDims );
+	memcpy ( pVector, dData.Begin(), dData.GetLengthBytes() );
+	if ( m_tSettings.m_eHNSWSimilarity==knn::HNSWSimilarity_e::COSINE )
+	{
+		VecTraits_T<float> dStored ( pVector, m_tSettings.m_iDims );
+		NormalizeVec(dStored);
+	}
+
+	int iLevel = GetRandomLevel();
+	m_dRowIDs.Add(tRowID);
+	m_dLevels.Add ( (BYTE)iLevel );
+	m_dLinks0.AddN ( m_iM0+1 )[0] = 0;
+	m_dLinksOffset.Add ( m_dLinks.GetLength() );
+	for ( int i = 0; i < iLevel; i++ )
+		m_dLinks.AddN ( m_iM+1 )[0] = 0;
+
+	if ( m_iMaxLevel<0 )
+	{
+		m_uEntry = uNode;
+		m_iMaxLevel = iLevel;
+		return;
+	}
+
+	DWORD uCur = m_uEntry;
+	float fCurDist = CalcDist ( m_tDist, uCur, pVector );
+	for ( int iCurLevel = m_iMaxLevel; iCurLevel > iLevel; iCurLevel-- )
+		SearchGreedy ( m_tDist, pVector, iCurLevel, uCur, fCurDist );
+
+	CSphVector<Candidate_t> dNeighbors;
+	for ( int iCurLevel = Min ( iLevel, m_iMaxLevel ); iCurLevel>=0; iCurLevel-- )
+	{
+		SearchLayer ( m_tDist, pVector, uCur, fCurDist, Max ( m_tSettings.m_iHNSWEFConstruction, m_iM ), iCurLevel, nullptr, dNeighbors );
+		uCur = dNeighbors[0].second;
+		fCurDist = dNeighbors[0].first;
+
+		SelectNeighbors ( dNeighbors, iCurLevel ? m_iM : m_iM0 );
+		for ( const auto & i : dNeighbors )
+		{
+			Connect ( uNode, i.second, iCurLevel );
+			Connect ( i.second, uNode, iCurLevel );
+		}
+	}
+
+	if ( iLevel > m_iMaxLevel )
+	{
+		m_uEntry = uNode;
+		m_iMaxLevel = iLevel;
+	}
+}
+
+
+int HNSWGraph_c::CountAlive ( const VecTraits_T<Candidate_t> & dFound, const DeadRowMap_Ram_c & tDeadRowMap ) const
+{
+	int iAlive = 0;
+	for ( const auto & i : dFound )
+		iAlive += IsAlive ( i.second, tDeadRowMap ) ? 1 : 0;
+
+	return iAlive;
+}
+
+
+void HNSWGraph_c::Search ( const VecTraits_T<float> & dPoint, const KNNFilterPlan_t & tPlan, const DeadRowMap_Ram_c & tDeadRowMap, const BitVec_T<uint64_t> * pAllowed, CSphVector<knn::DocDist_t> & dRes ) const
+{
+	if ( m_iMaxLevel<0 || dPoint.GetLength()!=m_tSettings.m_iDims )
+		return;
+
+	CSphVector<float> dQuery(dPoint);
+	if ( m_tSettings.m_eHNSWSimilarity==knn::HNSWSimilarity_e::COSINE )
+		NormalizeVec(dQuery);
+
+	// library distance calculators are not shared between threads; native ones are stateless
+	std::unique_ptr<KNNDistance_c> pOwnDist;
+	if ( !m_tDist.IsNative() )
+		pOwnDist = std::make_unique<KNNDistance_c>(m_tSettings);
+
+	const KNNDistance_c & tDist = pOwnDist ? *pOwnDist : m_tDist;
+
+	int iK = tPlan.m_iK;
+	CSphVector<Candidate_t> dFound;
+	if ( tPlan.m_eMode==KNNFilterMode_e::BRUTEFORCE )
+		SearchAll ( tDist, dQuery.Begin(), iK, pAllowed, dFound );
+	else
+	{
+		DWORD uCur = m_uEntry;
+		float fCurDist = CalcDist ( tDist, uCur, dQuery.Begin() );
+		for ( int iLevel = m_iMaxLevel; iLevel > 0; iLevel-- )
+			SearchGreedy ( tDist, dQuery.Begin(), iLevel, uCur, fCurDist );
+
+		// deleted and killed nodes are still traversed, so look a bit further to have enough alive ones
+		// killed rows are not spread evenly over the graph, so if that was not enough, widen the search until it is
+		const BitVec_T<uint64_t> * pFilter = tPlan.m_eMode==KNNFilterMode_e::FILTERED_GRAPH ? pAllowed : nullptr;
+		int iEf = Max ( tPlan.m_iEf, iK ) + int ( ( m_iDeleted + (int64_t)tDeadRowMap.GetNumDeads() )*iK/Max ( GetNumNodes(), 1 ) );
+		while ( true )
+		{
+			SearchLayer ( tDist, dQuery.Begin(), uCur, fCurDist, iEf, 0, pFilter, dFound );
+			if ( iEf>=GetNumNodes() || CountAlive ( dFound, tDeadRowMap )>=iK )
+				break;
+
+			iEf *= 2;
+		}
+	}
+
+	for ( const auto & i : dFound )
+	{
+		if ( dRes.GetLength()>=iK )
+			break;
+
+		if ( !IsAlive ( i.second, tDeadRowMap ) )
+			continue;
+
+		auto & tRes = dRes.Add();
+		tRes.m_tRowID = m_dRowIDs[i.second];
+		tRes.m_fDist = i.first;
+	}
+
+	dRes.Sort ( Lesser ( []( const knn::DocDist_t & a, const knn::DocDist_t & b ){ return a.m_tRowID < b.m_tRowID; } ) );
+}
+
+
+void HNSWGraph_c::RemapRows ( const VecTraits_T<RowID_t> & dRowMap )
+{
+	for ( auto & tRowID : m_dRowIDs )
+	{
+		if ( tRowID==INVALID_ROWID )
+			continue;
+
+		tRowID = dRowMap[tRowID];
+		if ( tRowID==INVALID_ROWID )
+			m_iDeleted++;
+	}
+}
+
+
+float HNSWGraph_c::GetDeletedRatio() const
+{
+	return GetNumNodes() ? float(m_iDeleted)/GetNumNodes() : 0.0f;
+}
+
+
+int64_t HNSWGraph_c::AllocatedBytes() const
+{
+	return m_dVectors.AllocatedBytes() + m_dRowIDs.AllocatedBytes() + m_dLevels.AllocatedBytes() + m_dLinks0.AllocatedBytes() + m_dLinks.AllocatedBytes() + m_dLinksOffset.AllocatedBytes();
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+class KNNRT_c : public KNNRT_i
+{
+public:
+				KNNRT_c() = default;
+	explicit	KNNRT_c ( const ISphSchema & tSchema );
+
+	void		AddDoc ( RowID_t tRowID, const CSphRowitem * pRow, const BYTE * pPool, CSphVector<ScopedTypedIterator_t> & dIterators ) override;
+	bool		Search ( const CSphString & sAttr, const VecTraits_T<float> & dPoint, const KNNFilterPlan_t & tPlan, const DeadRowMap_Ram_c & tDeadRowMap, const BitVec_T<uint64_t> * pAllowed, CSphVector<knn::DocDist_t> & dRes ) const override;
+	void		RemapRows ( const VecTraits_T<RowID_t> & dRowMap ) override;
+	float		GetDeletedRatio() const override;
+	bool		Relocate ( const ISphSchema & tSchema ) override;
+	std::unique_ptr<KNNRT_i> Clone() const override;
+	int64_t		AllocatedBytes() const override;
+
+	bool		IsEmpty() const { return m_dGraphs.IsEmpty(); }
+
+private:
+	CSphVector<PlainOrColumnar_t>	m_dAttrs;
+	StrVec_t						m_dNames;
+	CSphVector<std::unique_ptr<HNSWGraph_c>> m_dGraphs;
+};
+
+
+KNNRT_c::KNNRT_c ( const ISphSchema & tSchema )
+{
+	int iColumnar = 0;
+	for ( int i = 0; i < tSchema.GetAttrsCount(); i++ )
+	{
+		const CSphColumnInfo & tAttr = tSchema.GetAttr(i);
+		if ( tAttr.IsIndexedKNN() )
+		{
+			m_dAttrs.Add ( PlainOrColumnar_t ( tAttr, iColumnar ) );
+			m_dNames.Add ( tAttr.m_sName );
+			m_dGraphs.Add ( std::make_unique<HNSWGraph_c> ( tAttr.m_tKNN ) );
+		}
+
+		if ( tAttr.IsColumnar() )
+			iColumnar++;
+	}
+}
+
+
+void KNNRT_c::AddDoc ( RowID_t tRowID, const CSphRowitem * pRow, const BYTE * pPool, CSphVector<ScopedTypedIterator_t> & dIterators )
+{
+	ARRAY_FOREACH ( i, m_dAttrs )
+	{
+		const BYTE * pSrc = nullptr;
+		int iBytes = m_dAttrs[i].Get ( tRowID, pRow, pPool, dIterators, pSrc );
+		VecTraits_T<float> dData ( (float*)pSrc, iBytes / sizeof(float) );
+
+		// vectors of other sizes (e.g. empty ones) can't be found by knn search anyway
+		if ( dData.GetLength()==m_dGraphs[i]->GetDims() )
+			m_dGraphs[i]->Add ( tRowID, dData );
+	}
+}
+
+
+bool KNNRT_c::Search ( const CSphString & sAttr, const VecTraits_T<float> & dPoint, const KNNFilterPlan_t & tPlan, const DeadRowMap_Ram_c & tDeadRowMap, const BitVec_T<uint64_t> * pAllowed, CSphVector<knn::DocDist_t> & dRes ) const
+{
+	ARRAY_FOREACH ( i, m_dNames )
+		if ( m_dNames[i]==sAttr )
+		{
+			m_dGraphs[i]->Search ( dPoint, tPlan, tDeadRowMap, pAllowed, dRes );
+			return true;
+		}
+
+	return false;
+}
+
+
+void KNNRT_c::RemapRows ( const VecTraits_T<RowID_t> & dRowMap )
+{
+	for ( auto & i : m_dGraphs )
+		i->RemapRows(dRowMap);
+}
+
+
+float KNNRT_c::GetDeletedRatio() const
+{
+	float fRatio = 0.0f;
+	for ( const auto & i : m_dGraphs )
+		fRatio = Max ( fRatio, i->GetDeletedRatio() );
+
+	return fRatio;
+}
+
+
+bool KNNRT_c::Relocate ( const ISphSchema & tSchema )
+{
+	// alter keeps the order of the remaining attributes, so the graphs should match knn attrs one by one
+	CSphVector<PlainOrColumnar_t> dAttrs;
+	int iColumnar = 0;
+	for ( int i = 0; i < tSchema.GetAttrsCount(); i++ )
+	{
+		const CSphColumnInfo & tAttr = tSchema.GetAttr(i);
+		if ( tAttr.IsIndexedKNN() )
+		{
+			int iGraph = dAttrs.GetLength();
+			if ( iGraph>=m_dNames.GetLength() || m_dNames[iGraph]!=tAttr.m_sName || m_dGraphs[iGraph]->GetDims()!=tAttr.m_tKNN.m_iDims )
+				return false;
+
+			dAttrs.Add ( PlainOrColumnar_t ( tAttr, iColumnar ) );
+		}
+
+		if ( tAttr.IsColumnar() )
+			iColumnar++;
+	}
+
+	if ( dAttrs.GetLength()!=m_dNames.GetLength() )
+		return false;
+
+	m_dAttrs.SwapData(dAttrs);
+	return true;
+}
+
+
+std::unique_ptr<KNNRT_i> KNNRT_c::Clone() const
+{
+	auto pClone = std::make_unique<KNNRT_c>();
+	pClone->m_dAttrs = m_dAttrs;
+	pClone->m_dNames = m_dNames;
+	for ( const auto & i : m_dGraphs )
+		pClone->m_dGraphs.Add ( std::make_unique<HNSWGraph_c>(*i) );
+
+	return pClone;
+}
+
+
+int64_t KNNRT_c::AllocatedBytes() const
+{
+	int64_t iTotal = 0;
+	for ( const auto & i : m_dGraphs )
+		iTotal += i->AllocatedBytes();
+
+	return iTotal;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+std::unique_ptr<KNNRT_i> CreateKNNRT ( const ISphSchema & tSchema )
+{
+	// distances should be the same as in disk chunks, i.e. as in the knn library
+	if ( !IsKNNLibLoaded() )
+		return nullptr;
+
+	auto pKNN = std::make_unique<KNNRT_c>(tSchema);
+	if ( pKNN->IsEmpty() )
+		return nullptr;
+
+	return pKNN;
+}
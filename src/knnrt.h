@@ -0,0 +1,48 @@
+//
+// Copyright (c) 2024, Manticore Software LTD (https://manticoresearch.com)
+// All rights reserved
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License. You should have
+// received a copy of the GPL license along with this program; if you
+// did not, you can find it at http://www.gnu.org/
+//
+
+#pragma once
+
+#include "sphinxstd.h"
+#include "sphinxdefs.h"
+#include "columnarmisc.h"
+#include "knnmisc.h"
+
+#include "knn/knn.h"
+
+class ISphSchema;
+class DeadRowMap_Ram_c;
+
+/// in-memory HNSW graphs (one per KNN-indexed attribute) of a RAM segment
+/// graphs are filled row by row; a merged segment can reuse the graphs of one of its sources
+class KNNRT_i
+{
+public:
+	virtual			~KNNRT_i() = default;
+
+	virtual void	AddDoc ( RowID_t tRowID, const CSphRowitem * pRow, const BYTE * pPool, CSphVector<ScopedTypedIterator_t> & dIterators ) = 0;
+
+	/// returns false if there's no graph for this attribute; results are sorted by rowid
+	/// pAllowed (rows that pass filters) is used by filter-aware and brute force searches
+	virtual bool	Search ( const CSphString & sAttr, const VecTraits_T<float> & dPoint, const KNNFilterPlan_t & tPlan, const DeadRowMap_Ram_c & tDeadRowMap, const BitVec_T<uint64_t> * pAllowed, CSphVector<knn::DocDist_t> & dRes ) const = 0;
+
+	/// change rowids of all stored vectors; vectors mapped to INVALID_ROWID stay in the graph but are never returned
+	virtual void	RemapRows ( const VecTraits_T<RowID_t> & dRowMap ) = 0;
+	virtual float	GetDeletedRatio() const = 0;
+
+	/// re-read attribute locators from an altered schema; returns false if the set of KNN attributes changed and graphs need a rebuild
+	virtual bool	Relocate ( const ISphSchema & tSchema ) = 0;
+
+	virtual std::unique_ptr<KNNRT_i> Clone() const = 0;
+	virtual int64_t	AllocatedBytes() const = 0;
+};
+
+/// returns nullptr if the schema has no KNN-indexed attributes (or KNN library is not loaded)
+std::unique_ptr<KNNRT_i> CreateKNNRT ( const ISphSchema & tSchema );
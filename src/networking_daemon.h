@@ -30,6 +30,7 @@ struct Listener_t
 	Proto_e				m_eProto;
 	bool				m_bVIP;
 	bool 				m_bReadOnly;
+	int					m_iNetLoop = -1;	///< net loop that polls this socket; -1 means all of them
 };
 
 class CSphNetLoop;
@@ -197,6 +197,8 @@ bool CSphQueryContext::SetupCalc ( CSphQueryResultMeta & tMeta, const ISphSchema
 		}
 	}
 
+	m_iMatchDynamic = tInSchema.GetDynamicSize();
+
 	// ok, we can emit matches in this schema (incoming for sorter, outgoing for index/searcher)
 	return true;
 }
@@ -224,6 +226,105 @@ void CSphQueryContext::AddToFilterCalc ( const ContextCalcItem_t & tCalc )
 }
 
 
+template <typename T, typename EVAL, typename STORE>
+static void CalcItemBatch ( const VecTraits_T<CSphMatch *> & dMatches, EVAL && fnEval, STORE && fnStore )
+{
+	// evaluate in chunks that keep the intermediate values of the whole expression tree in cache
+	const int BATCH_SIZE = 1024;
+	CSphFixedVector<T> dValues ( Min ( dMatches.GetLength(), BATCH_SIZE ) );
+	for ( int iStart = 0; iStart < dMatches.GetLength(); iStart += BATCH_SIZE )
+	{
+		auto dChunk = dMatches.Slice ( iStart, BATCH_SIZE );
+		fnEval ( dChunk, dValues.Begin() );
+		ARRAY_FOREACH ( i, dChunk )
+			fnStore ( *dChunk[i], dValues[i] );
+	}
+}
+
+
+void CalcContextItemBatch ( const VecTraits_T<CSphMatch *> & dMatches, const ContextCalcItem_t & tCalc )
+{
+	const ISphExpr & tExpr = *tCalc.m_pExpr;
+	const CSphAttrLocator & tLoc = tCalc.m_tLoc;
+
+	switch ( tCalc.m_eType )
+	{
+	case SPH_ATTR_BOOL:
+	case SPH_ATTR_INTEGER:
+	case SPH_ATTR_TIMESTAMP:
+		CalcItemBatch<int> ( dMatches, [&tExpr]( const VecTraits_T<CSphMatch *> & dChunk, int * pRes ){ tExpr.IntEvalBatch ( dChunk, pRes ); }, [&tLoc]( CSphMatch & tMatch, int iValue ){ tMatch.SetAttr ( tLoc, iValue ); } );
+		break;
+
+	case SPH_ATTR_BIGINT:
+	case SPH_ATTR_UINT64:
+		CalcItemBatch<int64_t> ( dMatches, [&tExpr]( const VecTraits_T<CSphMatch *> & dChunk, int64_t * pRes ){ tExpr.Int64EvalBatch ( dChunk, pRes ); }, [&tLoc]( CSphMatch & tMatch, int64_t iValue ){ tMatch.SetAttr ( tLoc, iValue ); } );
+		break;
+
+	case SPH_ATTR_FLOAT:
+		CalcItemBatch<float> ( dMatches, [&tExpr]( const VecTraits_T<CSphMatch *> & dChunk, float * pRes ){ tExpr.EvalBatch ( dChunk, pRes ); }, [&tLoc]( CSphMatch & tMatch, float fValue ){ tMatch.SetAttrFloat ( tLoc, fValue ); } );
+		break;
+
+	case SPH_ATTR_DOUBLE:
+		CalcItemBatch<float> ( dMatches, [&tExpr]( const VecTraits_T<CSphMatch *> & dChunk, float * pRes ){ tExpr.EvalBatch ( dChunk, pRes ); }, [&tLoc]( CSphMatch & tMatch, float fValue ){ tMatch.SetAttrDouble ( tLoc, fValue ); } );
+		break;
+
+	default:
+		for ( auto & pMatch : dMatches )
+			CalcContextItem ( *pMatch, tCalc );
+		break;
+	}
+}
+
+
+static bool IsBatchableItem ( const ContextCalcItem_t & tCalc )
+{
+	switch ( tCalc.m_eType )
+	{
+	case SPH_ATTR_BOOL:
+	case SPH_ATTR_INTEGER:
+	case SPH_ATTR_TIMESTAMP:
+	case SPH_ATTR_BIGINT:
+	case SPH_ATTR_UINT64:
+	case SPH_ATTR_FLOAT:
+	case SPH_ATTR_DOUBLE:
+		return tCalc.m_pExpr->IsBatchable();
+
+	default:
+		return false;
+	}
+}
+
+
+bool HasBatchableItems ( const VecTraits_T<ContextCalcItem_t> & dItems )
+{
+	return dItems.any_of ( []( const ContextCalcItem_t & tCalc ){ return IsBatchableItem(tCalc); } );
+}
+
+
+void CalcContextItemsBatch ( const VecTraits_T<CSphMatch *> & dMatches, const VecTraits_T<ContextCalcItem_t> & dItems )
+{
+	int iItem = 0;
+	while ( iItem<dItems.GetLength() )
+	{
+		if ( IsBatchableItem ( dItems[iItem] ) )
+		{
+			CalcContextItemBatch ( dMatches, dItems[iItem++] );
+			continue;
+		}
+
+		int iEnd = iItem;
+		while ( iEnd<dItems.GetLength() && !IsBatchableItem ( dItems[iEnd] ) )
+			iEnd++;
+
+		auto dRun = dItems.Slice ( iItem, iEnd-iItem );
+		for ( auto & pMatch : dMatches )
+			CalcContextItems ( *pMatch, dRun );
+
+		iItem = iEnd;
+	}
+}
+
+
 void CSphQueryContext::AddToSortCalc ( const ContextCalcItem_t & tCalc )
 {
 	m_dCalcSort.Add(tCalc);
@@ -244,6 +345,16 @@ void CSphQueryContext::FreeDataSort ( CSphMatch & tMatch ) const
 }
 
 
+void ScanBlock_c::FreeData ( const CSphQueryContext & tCtx )
+{
+	for ( auto * pMatch : m_dPassed )
+	{
+		tCtx.FreeDataFilter(*pMatch);
+		tCtx.FreeDataSort(*pMatch);
+	}
+}
+
+
 void CSphQueryContext::ExprCommand ( ESphExprCommand eCmd, void * pArg )
 {
 	ARRAY_FOREACH ( i, m_dCalcFilter )
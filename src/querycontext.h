@@ -71,6 +71,14 @@ FORCE_INLINE void CalcContextItems ( CSphMatch & tMatch, const VecTraits_T<Conte
 		CalcContextItem ( tMatch, i );
 }
 
+/// calculate one item over a block of matches; numeric items go through ISphExpr batch evaluation
+void CalcContextItemBatch ( const VecTraits_T<CSphMatch *> & dMatches, const ContextCalcItem_t & tCalc );
+
+/// calculate items over a block of matches in their order (items might use each other's results)
+/// batchable items are calculated for the whole block, runs of the others match by match
+void CalcContextItemsBatch ( const VecTraits_T<CSphMatch *> & dMatches, const VecTraits_T<ContextCalcItem_t> & dItems );
+bool HasBatchableItems ( const VecTraits_T<ContextCalcItem_t> & dItems );
+
 
 class ISphRanker;
 class Docstore_i;
@@ -95,6 +103,7 @@ public:
 	std::unique_ptr<ISphFilter>		m_pWeightFilter;
 
 	bool							m_bSkipQCache = false;			///< whether do not cache this query
+	QcacheCollector_c *				m_pQcacheCollector = nullptr;	///< if set, qcache entries are collected there instead of adding directly
 
 	CSphVector<ContextCalcItem_t>	m_dCalcFilter;			///< items to compute for filtering
 	CSphVector<ContextCalcItem_t>	m_dCalcSort;			///< items to compute for sorting/grouping
@@ -102,6 +111,7 @@ public:
 
 	IntVec_t						m_dCalcFilterPtrAttrs;	///< items to free after computing filter stage
 	IntVec_t						m_dCalcSortPtrAttrs;	///< items to free after computing sort stage
+	int								m_iMatchDynamic = 0;	///< dynamic part size of the matches the items are calculated for
 
 	const void *					m_pIndexData = nullptr;	///< backend specific data
 	QueryProfile_c *				m_pProfile = nullptr;
@@ -120,6 +130,10 @@ public:
 	void	CalcSort ( CSphMatch & tMatch )	const									{ CalcContextItems ( tMatch, m_dCalcSort ); }
 	void	CalcFinal ( CSphMatch & tMatch ) const									{ CalcContextItems ( tMatch, m_dCalcFinal ); }
 	void	CalcItem ( CSphMatch & tMatch, const ContextCalcItem_t & tCalc ) const	{ CalcContextItem ( tMatch, tCalc ); }
+	void	CalcItemBatch ( const VecTraits_T<CSphMatch *> & dMatches, const ContextCalcItem_t & tCalc ) const { CalcContextItemBatch ( dMatches, tCalc ); }
+	void	CalcFilterBatch ( const VecTraits_T<CSphMatch *> & dMatches ) const	{ CalcContextItemsBatch ( dMatches, m_dCalcFilter ); }
+	void	CalcSortBatch ( const VecTraits_T<CSphMatch *> & dMatches ) const		{ CalcContextItemsBatch ( dMatches, m_dCalcSort ); }
+	bool	IsScanBatchable() const { return HasBatchableItems(m_dCalcFilter) || HasBatchableItems(m_dCalcSort); }
 
 	void	FreeDataFilter ( CSphMatch & tMatch ) const;
 	void	FreeDataSort ( CSphMatch & tMatch ) const;
@@ -139,3 +153,64 @@ private:
 	void	AddToFilterCalc ( const ContextCalcItem_t & tCalc );
 	void	AddToSortCalc ( const ContextCalcItem_t & tCalc );
 };
+
+/// matches for a block of scanned rows, so that filter and sort stage items are calculated for the whole block at once
+/// rows should come in ascending order, then columnar attributes are fetched by blocks too
+class ScanBlock_c : public ISphNoncopyable
+{
+public:
+				ScanBlock_c ( const CSphMatch & tMatch, int iDynamic ) : m_tMatch ( tMatch ), m_iDynamic ( iDynamic ) {}
+
+	/// returns the matches that pass filters, with filter and sort stage items calculated
+	template <typename TO_STATIC>
+	VecTraits_T<CSphMatch *> Process ( const CSphQueryContext & tCtx, const VecTraits_T<RowID_t> & dRowIDs, TO_STATIC && fnToStatic, bool bRandomize, int iIndexWeight );
+
+	/// frees stringptr items of the passed matches; call after they were pushed to sorters
+	void		FreeData ( const CSphQueryContext & tCtx );
+
+private:
+	const CSphMatch &			m_tMatch;
+	int							m_iDynamic = 0;
+	CSphFixedVector<CSphMatch>	m_dMatches {0};
+	CSphVector<CSphMatch *>		m_dAll;
+	CSphVector<CSphMatch *>		m_dPassed;
+};
+
+
+template <typename TO_STATIC>
+VecTraits_T<CSphMatch *> ScanBlock_c::Process ( const CSphQueryContext & tCtx, const VecTraits_T<RowID_t> & dRowIDs, TO_STATIC && fnToStatic, bool bRandomize, int iIndexWeight )
+{
+	if ( dRowIDs.GetLength()>m_dMatches.GetLength() )
+	{
+		m_dMatches.Reset ( dRowIDs.GetLength() );
+		for ( auto & tMatch : m_dMatches )
+			tMatch.Combine ( m_tMatch, m_iDynamic );
+	}
+
+	m_dAll.Resize(0);
+	ARRAY_FOREACH ( i, dRowIDs )
+	{
+		CSphMatch & tMatch = m_dMatches[i];
+		tMatch.m_tRowID = dRowIDs[i];
+		tMatch.m_pStatic = fnToStatic ( dRowIDs[i] );
+		m_dAll.Add ( &tMatch );
+	}
+
+	// early filter only (no late filters in full-scan because of no @weight)
+	tCtx.CalcFilterBatch(m_dAll);
+	m_dPassed.Resize(0);
+	for ( auto * pMatch : m_dAll )
+	{
+		if ( !tCtx.m_pFilter || tCtx.m_pFilter->Eval(*pMatch) )
+			m_dPassed.Add(pMatch);
+		else
+			tCtx.FreeDataFilter(*pMatch);
+	}
+
+	if ( bRandomize )
+		for ( auto * pMatch : m_dPassed )
+			pMatch->m_iWeight = ( sphRand() & 0xffff ) * iIndexWeight;
+
+	tCtx.CalcSortBatch(m_dPassed);
+	return m_dPassed;
+}
@@ -336,6 +336,7 @@ private:
 	bool	ReplaceWithColumnarItem ( const CSphString & sAttr, ESphEvalStage eStage );
 	int		ReduceMaxMatches() const;
 	int		AdjustMaxMatches ( int iMaxMatches ) const;
+	int		CalcSpillGroups() const;
 	bool	ConvertColumnarToDocstore();
 	CSphString GetAliasedColumnarAttrName ( const CSphColumnInfo & tAttr ) const;
 	bool	SetupAggregateExpr ( CSphColumnInfo & tExprCol, const CSphString & sExpr, DWORD uQueryPackedFactorFlags );
@@ -2283,6 +2284,19 @@ int QueueCreator_c::AdjustMaxMatches ( int iMaxMatches ) const
 }
 
 
+int QueueCreator_c::CalcSpillGroups() const
+{
+	// pre-grouped matches come from other sorters (or agents), which already cut their groups
+	int64_t iMemLimit = GetGroupbyMemLimit(m_tQuery);
+	if ( iMemLimit<=0 || m_tSettings.m_bGrouped || m_tGroupSorterSettings.m_bImplicit || m_tGroupSorterSettings.m_bDistinct )
+		return 0;
+
+	// match, its dynamic row, its index and its hash entry; data ptr attrs (like group_concat) are not accounted
+	int64_t iGroupBytes = sizeof(CSphMatch) + m_pSorterSchema->GetDynamicSize()*sizeof(CSphRowitem) + sizeof(int) + 2*sizeof(SphGroupKey_t);
+	return (int)Min ( iMemLimit/iGroupBytes, INT_MAX/2 );
+}
+
+
 bool QueueCreator_c::CanCalcFastCountDistinct() const
 {
 	bool bHasAggregates = PredictAggregates();
@@ -2332,6 +2346,7 @@ ISphMatchSorter * QueueCreator_c::SpawnQueue()
 	{
 		m_tGroupSorterSettings.m_bGrouped = m_tSettings.m_bGrouped;
 		m_tGroupSorterSettings.m_iMaxMatches = AdjustMaxMatches ( m_tGroupSorterSettings.m_iMaxMatches );
+		m_tGroupSorterSettings.m_iSpillGroups = CalcSpillGroups();
 		if ( m_pProfile )
 			m_pProfile->m_iMaxMatches = m_tGroupSorterSettings.m_iMaxMatches;
 
@@ -32,6 +32,7 @@ struct CSphGroupSorterSettings
 	int					m_iMaxMatches = 0;
 	bool				m_bGrouped = false;	///< are we going to push already grouped matches to it?
 	int					m_iDistinctAccuracy = 16;	///< HyperLogLog accuracy. 0 means "don't use HLL"
+	int					m_iSpillGroups = 0;	///< groups to keep in memory before spilling them to disk; 0 means cut the worst groups instead
 
 	void FixupLocators ( const ISphSchema * pOldSchema, const ISphSchema * pNewSchema );
 	void SetupDistinctAccuracy ( int iThresh );
@@ -176,6 +176,7 @@ static constexpr bool	AUTOOPTIMIZE_NEEDS_VIP = false; // whether non-VIP can iss
 static constexpr bool	THREAD_EX_NEEDS_VIP = false; // whether non-VIP can issue 'SET GLOBAL auto_optimize = X'
 
 static CSphVector<Listener_t>	g_dListeners;
+static int						g_iNetWorkers = 1;
 
 static int				g_iQueryLogFile	= -1;
 static CSphString		g_sQueryLogFile;
@@ -193,6 +194,7 @@ static int				g_iMaxBatchQueries	= 32;
 
 static int64_t			g_iDocstoreCache = 0;
 static int64_t			g_iSkipCache = 0;
+static CSphString		g_sSkipCacheHotlist;
 
 static auto &	g_iDistThreads		= getDistThreads();
 
@@ -297,7 +299,7 @@ int64_t g_iNextExpMeterTimestamp = sphMicroTimer() + g_iExpMeterPeriod;
 static const char * g_dApiCommands[] =
 {
 	"search", "excerpt", "update", "keywords", "persist", "status", "query", "flushattrs", "query", "ping", "delete", "set",  "insert", "replace", "commit", "suggest", "json",
-	"callpq", "clusterpq", "getfield"
+	"callpq", "clusterpq", "getfield", "topncutoff"
 };
 
 STATIC_ASSERT ( sizeof(g_dApiCommands)/sizeof(g_dApiCommands[0])==SEARCHD_COMMAND_TOTAL, SEARCHD_COMMAND_SHOULD_BE_SAME_AS_SEARCHD_COMMAND_TOTAL );
@@ -776,6 +778,10 @@ void Shutdown () REQUIRES ( MainThread ) NO_THREAD_SAFETY_ANALYSIS
 			RWIdx_c ( tIt.second )->Unlock();
 	}
 
+	// tables drop their skiplists from the cache as they go, so save what was hot before that
+	SHUTINFO << "Save skip cache hotlist ...";
+	SkipCache::SaveHotlist();
+
 	Threads::CallCoroutine ( [] {
 		SHUTINFO << "Abandon local tables list ...";
 		g_pLocalIndexes->ReleaseAndClear();
@@ -1317,6 +1323,33 @@ int sphCreateUnixSocket ( const char * sPath ) REQUIRES ( MainThread )
 #endif // !_WIN32
 
 
+static void MakeInetAddr ( sockaddr_in & tAddr, const ListenerDesc_t & tDesc )
+{
+	memset ( &tAddr, 0, sizeof(tAddr) );
+	tAddr.sin_family = AF_INET;
+	tAddr.sin_addr.s_addr = tDesc.m_uIP;
+	tAddr.sin_port = htons ( (short)tDesc.m_iPort );
+}
+
+
+// SO_REUSEPORT spreads connections between the sockets bound to the same address only on Linux; FreeBSD has SO_REUSEPORT_LB for that.
+// Elsewhere (e.g. on macOS) one socket gets all the connections, so the net loops keep sharing one listener there
+#if HAVE_SO_REUSEPORT && ( defined ( __linux__ ) || defined ( SO_REUSEPORT_LB ) )
+#define LISTENER_SHARDS 1
+#else
+#define LISTENER_SHARDS 0
+#endif
+
+static void SetSockReusePortLB ( int iSock )
+{
+#if defined ( SO_REUSEPORT_LB )
+	int iOn = 1;
+	if ( setsockopt ( iSock, SOL_SOCKET, SO_REUSEPORT_LB, (char *) &iOn, sizeof ( iOn ) ) )
+		sphWarning ( "setsockopt(SO_REUSEPORT_LB) failed: %s", sphSockError () );
+#endif
+}
+
+
 int sphCreateInetSocket ( const ListenerDesc_t & tDesc ) REQUIRES ( MainThread )
 {
 	auto uAddr = tDesc.m_uIP;
@@ -1332,10 +1365,7 @@ int sphCreateInetSocket ( const ListenerDesc_t & tDesc ) REQUIRES ( MainThread )
 		sphInfo ( "listening on %s:%d for %s%s%s", sAddress, iPort, sVip, sRO, RelaxedProtoName ( tDesc.m_eProto ) );
 
 	static struct sockaddr_in iaddr;
-	memset ( &iaddr, 0, sizeof(iaddr) );
-	iaddr.sin_family = AF_INET;
-	iaddr.sin_addr.s_addr = uAddr;
-	iaddr.sin_port = htons ( (short)iPort );
+	MakeInetAddr ( iaddr, tDesc );
 
 	int iSock = socket ( AF_INET, SOCK_STREAM, 0 );
 	if ( iSock==-1 )
@@ -1343,6 +1373,7 @@ int sphCreateInetSocket ( const ListenerDesc_t & tDesc ) REQUIRES ( MainThread )
 
 	sphSetSockReuseAddr ( iSock );
 	sphSetSockReusePort ( iSock );
+	SetSockReusePortLB ( iSock );
 	sphSetSockNodelay ( iSock );
 
 	int iTries = 12;
@@ -1387,6 +1418,63 @@ ListenerDesc_t MakeLocalhostListener ( int iPort, Proto_e eProto )
 	return tDesc;
 }
 
+#if LISTENER_SHARDS
+// one more socket on the same address; no retries, since the first one is bound already
+static int CreateInetSocketShard ( const ListenerDesc_t & tDesc ) REQUIRES ( MainThread )
+{
+	sockaddr_in iaddr;
+	MakeInetAddr ( iaddr, tDesc );
+
+	int iSock = socket ( AF_INET, SOCK_STREAM, 0 );
+	if ( iSock==-1 )
+		return -1;
+
+	sphSetSockReuseAddr ( iSock );
+	sphSetSockReusePort ( iSock );
+	SetSockReusePortLB ( iSock );
+	sphSetSockNodelay ( iSock );
+
+	if ( bind ( iSock, (struct sockaddr *)&iaddr, sizeof(iaddr) )==0 )
+		return iSock;
+
+	sphSockClose ( iSock );
+	return -1;
+}
+#endif
+
+
+// with several net loops, every loop gets its own socket for the last added tcp listener.
+// SO_REUSEPORT makes the kernel spread incoming connections between them, so an accept wakes up only one loop,
+// and the connection stays in that loop. If a copy can't be bound, all the loops share the listener, as before.
+static void AddListenerShards ( const ListenerDesc_t & tDesc ) REQUIRES ( MainThread )
+{
+#if LISTENER_SHARDS
+	if ( g_iNetWorkers<2 )
+		return;
+
+	CSphVector<Listener_t> dShards;
+	for ( int iLoop = 1; iLoop<g_iNetWorkers; ++iLoop )
+	{
+		int iSock = CreateInetSocketShard ( tDesc );
+		if ( iSock<0 )
+		{
+			sphWarning ( "failed to bind listener for net loop %d, all net loops will share it: %s", iLoop, sphSockError() );
+			for ( const auto & tShard : dShards )
+				sphSockClose ( tShard.m_iSock );
+			return;
+		}
+
+		auto & tShard = dShards.Add ( g_dListeners.Last() );
+		tShard.m_iSock = iSock;
+		tShard.m_iNetLoop = iLoop;
+	}
+
+	g_dListeners.Last().m_iNetLoop = 0;
+	g_dListeners.Append ( dShards );
+#endif
+}
+
+
 // add any listener we will serve by our own (i.e. NO galera's since it is not our deal)
 bool AddGlobalListener ( const ListenerDesc_t& tDesc ) REQUIRES ( MainThread )
 {
@@ -1409,6 +1497,9 @@ bool AddGlobalListener ( const ListenerDesc_t& tDesc ) REQUIRES ( MainThread )
 		tListener.m_iSock = sphCreateInetSocket ( tDesc );
 
 	g_dListeners.Add ( tListener );
+	if ( tListener.m_bTcp )
+		AddListenerShards ( tDesc );
+
 	return true;
 }
 
@@ -1717,7 +1808,8 @@ enum
 	QFLAG_FACET_HEAD			= 1UL << 10,
 	QFLAG_JSON_QUERY			= 1UL << 11,
 	QFLAG_NOT_ONLY_ALLOWED		= 1UL << 12,
-	QFLAG_LOCAL_DF_SET			= 1UL << 13
+	QFLAG_LOCAL_DF_SET			= 1UL << 13,
+	QFLAG_WEIGHT_PRUNING		= 1UL << 14
 };
 
 void operator<< ( ISphOutputBuffer & tOut, const CSphNamedInt & tValue )
@@ -1750,6 +1842,7 @@ void SearchRequestBuilder_c::SendQuery ( const char * sIndexes, ISphOutputBuffer
 	uFlags |= QFLAG_FACET_HEAD * q.m_bFacetHead;
 	uFlags |= QFLAG_NOT_ONLY_ALLOWED * q.m_bNotOnlyAllowed;
 	uFlags |= QFLAG_LOCAL_DF_SET * q.m_bLocalDF.has_value();
+	uFlags |= QFLAG_WEIGHT_PRUNING * q.m_bWeightPruning;
 
 	if ( q.m_eQueryType==QUERY_JSON )
 		uFlags |= QFLAG_JSON_QUERY;
@@ -1959,6 +2052,12 @@ void SearchRequestBuilder_c::SendQuery ( const char * sIndexes, ISphOutputBuffer
 		for ( const auto & i : q.m_dKNNVec )
 			tOut.SendFloat(i);
 	}
+
+	tOut.SendUint64 ( q.m_uTopNToken );
+
+	// v.24
+	tOut.SendInt ( q.m_bExplicitGroupbyMemLimit );
+	tOut.SendUint64 ( q.m_iGroupbyMemLimit );
 }
 
 
@@ -2717,6 +2816,7 @@ bool ParseSearchQuery ( InputBuffer_c & tReq, ISphOutputBuffer & tOut, CSphQuery
 		tQuery.m_bFacetHead = !!( uFlags & QFLAG_FACET_HEAD );
 		tQuery.m_eQueryType = (uFlags & QFLAG_JSON_QUERY) ? QUERY_JSON : QUERY_API;
 		tQuery.m_bNotOnlyAllowed = !!( uFlags & QFLAG_NOT_ONLY_ALLOWED );
+		tQuery.m_bWeightPruning = !!( uFlags & QFLAG_WEIGHT_PRUNING );
 
 		if ( uMasterVer>0 || uVer==0x11E )
 			tQuery.m_bNormalizedTFIDF = !!( uFlags & QFLAG_NORMALIZED_TF );
@@ -2846,6 +2946,15 @@ bool ParseSearchQuery ( InputBuffer_c & tReq, ISphOutputBuffer & tOut, CSphQuery
 		}
 	}
 
+	if ( uMasterVer>=23 )
+		tQuery.m_uTopNToken = tReq.GetUint64();
+
+	if ( uMasterVer>=24 )
+	{
+		tQuery.m_bExplicitGroupbyMemLimit = !!tReq.GetInt();
+		tQuery.m_iGroupbyMemLimit = (int64_t)tReq.GetUint64();
+	}
+
 	/////////////////////
 	// additional checks
 	/////////////////////
@@ -3151,6 +3260,12 @@ static void FormatOption ( const CSphQuery & tQuery, StringBuilder_c & tBuf )
 		tBuf.Appendf ( "morphology=none" );
 	if ( tQuery.m_iExpansionLimit!=DEFAULT_QUERY_EXPANSION_LIMIT )
 		tBuf.Appendf ( "expansion_limit=%d", tQuery.m_iExpansionLimit );
+
+	if ( tQuery.m_bWeightPruning )
+		tBuf << "weight_pruning=1";
+
+	if ( tQuery.m_bExplicitGroupbyMemLimit )
+		tBuf.Appendf ( "groupby_mem_limit=" INT64_FMT, tQuery.m_iGroupbyMemLimit );
 }
 
 
@@ -4014,6 +4129,7 @@ void RemapResult ( AggrResult_t & dResult )
 			tNewMatch.Reset ( tSchema.GetDynamicSize () );
 			tNewMatch.m_tRowID = tMatch.m_tRowID;
 			tNewMatch.m_iWeight = tMatch.m_iWeight;
+			tNewMatch.m_iTag = tMatch.m_iTag; // results with assigned tags need them later
 
 			// remap attrs
 			for ( int j = 0; j<iAttrsCount; ++j )
@@ -4294,6 +4410,10 @@ public:
 		auto& dMatches = tResult.m_dMatches;
 		m_iLimit = dMatches.GetLength();
 
+		// tags of such matches link them to docstores, so UseTags must not overwrite them; make room for the order instead
+		if ( tResult.m_bTagsAssigned )
+			dMatches.Reserve ( m_iLimit + ( m_iLimit*sizeof ( DWORD )+sizeof ( CSphMatch )-1 ) / sizeof ( CSphMatch ) );
+
 		if ( MaybeUseWordOrder ( dMatches ) )
 			m_fnOrder = [pData = (WORD *) m_tResult.m_dMatches.end ()] ( int i ) { return pData[i]; };
 		else if ( MaybeUseDwordOrder ( dMatches ) )
@@ -4444,8 +4564,21 @@ int KillDupesAndFlatten ( ISphMatchSorter * pSorter, AggrResult_t & tRes )
 	dOrd.Sort ( Lesser ( [&tRes] ( int l, int r ) { return tRes.m_dResults[r].m_iTag<tRes.m_dResults[l].m_iTag; } ) );
 
 	// remap to compact (non-fragmented) range of tags
+	int iMaxTag = tRes.m_dResults.IsEmpty() ? 0 : tRes.m_dResults[dOrd[0]].m_iTag;
+	CSphFixedVector<int> dNewTags ( Max ( iMaxTag, 0 )+1 );
 	for ( int iRes : dOrd )
-		tRes.m_dResults[iRes].m_iTag = --iTags;
+	{
+		auto & tResult = tRes.m_dResults[iRes];
+		if ( tResult.m_iTag>=0 )
+			dNewTags[tResult.m_iTag] = iTags-1;
+		tResult.m_iTag = --iTags;
+	}
+
+	// matches with assigned tags point to other results; make them follow
+	for ( auto & tResult : tRes.m_dResults )
+		if ( tResult.m_bTagsAssigned )
+			for ( auto & tMatch : tResult.m_dMatches )
+				tMatch.m_iTag = dNewTags[tMatch.m_iTag];
 	Debug ( tRes.m_bTagsCompacted = true );
 
 	// do actual deduplication
@@ -6986,6 +7119,7 @@ bool SearchHandler_c::BuildIndexList ( int & iDivideLimits, VecRefPtrsAgentConn_
 				pConn->m_iWeight = iWeight;
 				pConn->m_iMyConnectTimeoutMs = pDist->GetAgentConnectTimeoutMs();
 				pConn->m_iMyQueryTimeoutMs = ( tQuery.m_iAgentQueryTimeoutMs!=DEFAULT_QUERY_TIMEOUT ? tQuery.m_iAgentQueryTimeoutMs : pDist->GetAgentQueryTimeoutMs() );
+				pConn->m_bAllowHedge = true;
 				dRemotes.Add ( pConn );
 			}
 
@@ -7170,6 +7304,12 @@ void SearchHandler_c::RunSubset ( int iStart, int iEnd )
 	std::unique_ptr<SearchRequestBuilder_c> tReqBuilder;
 	CSphRefcountedPtr<RemoteAgentsObserver_i> tReporter { nullptr };
 	std::unique_ptr<ReplyParser_i> tParser;
+
+	// plain top-N over several agents; replies may be folded into one as they come, and the slow agents may be told what they needn't send back
+	RemoteTopN_c tTopN ( tFirst, iQueries==1 && dRemotes.GetLength()>1, g_bAgentStreamingMerge, g_bAgentTopNPushdown );
+	for ( auto & tQuery : m_dNQueries )
+		tQuery.m_uTopNToken = tTopN.GetToken();
+
 	if ( !dRemotes.IsEmpty() )
 	{
 		SwitchProfile(m_pProfile, SPH_QSTATE_DIST_CONNECT);
@@ -7210,6 +7350,11 @@ void SearchHandler_c::RunSubset ( int iStart, int iEnd )
 	{
 		SwitchProfile ( m_pProfile, SPH_QSTATE_DIST_WAIT );
 
+		// agents which haven't answered yet (blackholes are already gone)
+		CSphVector<AgentConn_t *> dPending;
+		if ( tTopN.GetToken() )
+			dPending.Append ( dRemotes );
+
 		bool bDistDone = false;
 		while ( !bDistDone )
 		{
@@ -7265,6 +7410,7 @@ void SearchHandler_c::RunSubset ( int iStart, int iEnd )
 					assert ( tRemoteResult.m_dResults.GetLength() == 1 ); // by design remotes return one chunk
 					auto & dRemoteChunk = tRes.m_dResults.Add ();
 					::Swap ( dRemoteChunk, *tRemoteResult.m_dResults.begin () );
+					tTopN.AddResult ( tRes, tRes.m_dResults.GetLength()-1 );
 
 					// note how we do NOT add per-index weight here
 
@@ -7296,7 +7442,11 @@ void SearchHandler_c::RunSubset ( int iStart, int iEnd )
 					pAgent->m_pResult->Reset ();
 				pAgent->m_bSuccess = false;
 				pAgent->m_sFailure = "";
+				dPending.RemoveValue ( pAgent );
 			}
+
+			if ( !bDistDone )
+				tTopN.Publish ( dPending );
 		} // while ( !bDistDone )
 
 		// submit failures from failed agents
@@ -7565,12 +7715,20 @@ void HandleCommandSearch ( ISphOutputBuffer & tOut, WORD uVer, InputBuffer_c & t
 		myinfo::SetTaskInfo ( R"(api-search query="%s" comment="%s" table="%s")", q.m_sQuery.scstr (), q.m_sComment.scstr (), q.m_sIndexes.scstr () );
 	}
 
+	// master may tell us meanwhile which matches it doesn't need anyway
+	CSphFixedVector<TopNCutoffListener_c> dCutoffs { tHandler.m_dQueries.GetLength() };
+	ARRAY_FOREACH ( i, tHandler.m_dQueries )
+		dCutoffs[i].Listen ( tHandler.m_dQueries[i].m_uTopNToken );
+
 	// run queries, send response
 	tHandler.RunQueries();
 
 	auto tReply = APIAnswer ( tOut, VER_COMMAND_SEARCH );
 	ARRAY_FOREACH ( i, tHandler.m_dQueries )
+	{
+		dCutoffs[i].Apply ( tHandler.m_dAggrResults[i], tHandler.m_dQueries[i] );
 		SendResult ( uVer, tOut, tHandler.m_dAggrResults[i], bAgentMode, tHandler.m_dQueries[i], uMasterVer );
+	}
 
 	int64_t iTotalPredictedTime = 0;
 	int64_t iTotalAgentPredictedTime = 0;
@@ -9120,6 +9278,23 @@ void BuildStatus ( VectorLike & dStatus )
 	dStatus.MatchTupletf ( "qcache_used_bytes", "%l", s.m_iUsedBytes );
 	dStatus.MatchTupletf ( "qcache_hits", "%l", s.m_iHits );
 
+	SkipCacheStats_t tSkipCache = SkipCache::GetStats();
+	dStatus.MatchTupletf ( "skiplist_cache_max_bytes", "%l", tSkipCache.m_iMaxBytes );
+	dStatus.MatchTupletf ( "skiplist_cache_used_bytes", "%l", tSkipCache.m_iUsedBytes );
+	dStatus.MatchTupletf ( "skiplist_cache_entries", "%l", tSkipCache.m_iEntries );
+	dStatus.MatchTupletf ( "skiplist_cache_hits", "%l", tSkipCache.m_iHits );
+	dStatus.MatchTupletf ( "skiplist_cache_misses", "%l", tSkipCache.m_iMisses );
+	dStatus.MatchTupletf ( "skiplist_cache_evictions", "%l", tSkipCache.m_iEvictions );
+	dStatus.MatchTupletf ( "skiplist_cache_rejected", "%l", tSkipCache.m_iRejected );
+	dStatus.MatchTupletf ( "skiplist_cache_lock_contended", "%l", tSkipCache.m_iContended );
+
+	DocstoreCacheStats_t tDocstoreCache = GetDocstoreCacheStats();
+	dStatus.MatchTupletf ( "docstore_cache_max_bytes", "%l", tDocstoreCache.m_iMaxBytes );
+	dStatus.MatchTupletf ( "docstore_cache_used_bytes", "%l", tDocstoreCache.m_iUsedBytes );
+	dStatus.MatchTupletf ( "docstore_cache_entries", "%l", tDocstoreCache.m_iEntries );
+	dStatus.MatchTupletf ( "docstore_cache_evictions", "%l", tDocstoreCache.m_iEvictions );
+	dStatus.MatchTupletf ( "docstore_cache_lock_contended", "%l", tDocstoreCache.m_iContended );
+
 	// clusters
 	ReplicateClustersStatus ( dStatus );
 }
@@ -9489,6 +9664,7 @@ void ExecuteApiCommand ( SearchdCommand_e eCommand, WORD uCommandVer, int iLengt
 		case SEARCHD_COMMAND_CALLPQ:	HandleCommandCallPq ( tOut, uCommandVer, tBuf ); break;
 		case SEARCHD_COMMAND_CLUSTER:	HandleAPICommandCluster ( tOut, uCommandVer, tBuf, tSess.szClientName() ); break;
 		case SEARCHD_COMMAND_GETFIELD:	HandleCommandGetField ( tOut, uCommandVer, tBuf ); break;
+		case SEARCHD_COMMAND_TOPNCUTOFF:HandleCommandTopNCutoff ( tOut, uCommandVer, tBuf ); break;
 		case SEARCHD_COMMAND_PERSIST: break; // already processes, here just for stat
 		default:						assert ( 0 && "internal error: unhandled command" ); break;
 	}
@@ -14433,6 +14609,12 @@ static bool HandleSetGlobal ( CSphString& sError, const CSphString& sName, int64
 		return true;
 	}
 
+	if ( sName == "groupby_mem_limit" )
+	{
+		SetGroupbyMemLimitDefault ( iSetValue );
+		return true;
+	}
+
 	if ( sName == "threads_ex" )
 	{
 		if ( !THREAD_EX_NEEDS_VIP || tSess.GetVip() )
@@ -15651,6 +15833,7 @@ void HandleMysqlShowVariables ( RowBuffer_i & dRows, const SqlStmt_t & tStmt )
 
 	dTable.MatchTuplet ( "accurate_aggregation", GetAccurateAggregationDefault() ? "1" : "0" );
 	dTable.MatchTupletf ( "distinct_precision_threshold", "%d", GetDistinctThreshDefault() );
+	dTable.MatchTupletf ( "groupby_mem_limit", "%l", GetGroupbyMemLimitDefault() );
 	dTable.MatchTupletFn ( "threads_ex_effective", [] {
 		StringBuilder_c tBuf;
 		auto x = GetEffectiveBaseDispatcherTemplate();
@@ -19759,8 +19942,6 @@ void TickHead () REQUIRES ( MainThread )
 bool g_bVtune = false;
 int64_t g_tmStarted = 0;
 
-static int	g_iNetWorkers = 1;
-
 /////////////////////////////////////////////////////////////////////////////
 // DAEMON OPTIONS
 /////////////////////////////////////////////////////////////////////////////
@@ -19967,6 +20148,7 @@ void ConfigureSearchd ( const CSphConfig & hConf, bool bOptPIDFile, bool bTestMo
 	g_iThdQueueMax = hSearchd.GetInt ( "jobs_queue_size", g_iThdQueueMax );
 
 	g_iPersistentPoolSize = hSearchd.GetInt ("persistent_connections_limit");
+	g_iPersistentPoolWaitMs = hSearchd.GetMsTimeMs ( "persistent_connections_wait", g_iPersistentPoolWaitMs );
 
 	// FIXME!!! remove depricated preopen_indexes
 	if ( hSearchd.Exists ( "preopen_tables" ) )
@@ -19983,6 +20165,7 @@ void ConfigureSearchd ( const CSphConfig & hConf, bool bOptPIDFile, bool bTestMo
 
 	// initialize buffering settings
 	SetUnhintedBuffer ( hSearchd.GetSize( "read_unhinted", DEFAULT_READ_UNHINTED ) );
+	SetReadPrefetch ( hSearchd.GetSize ( "read_prefetch", DEFAULT_READ_PREFETCH ) );
 	int iReadBuffer = hSearchd.GetSize ( "read_buffer", DEFAULT_READ_BUFFER );
 	FileAccessSettings_t & tDefaultFA = MutableIndexSettings_c::GetDefaults().m_tFileAccess;
 	tDefaultFA.m_iReadBufferDocList = hSearchd.GetSize ( "read_buffer_docs", iReadBuffer );
@@ -20045,6 +20228,9 @@ void ConfigureSearchd ( const CSphConfig & hConf, bool bOptPIDFile, bool bTestMo
 	sphSetThrottling ( hSearchd.GetInt ( "rt_merge_iops", 0 ), hSearchd.GetSize ( "rt_merge_maxiosize", 0 ) );
 	g_iPingIntervalUs = hSearchd.GetUsTime64Ms ( "ha_ping_interval", 1000000 );
 	g_uHAPeriodKarmaS = hSearchd.GetSTimeS ( "ha_period_karma", 60 );
+	g_bHAHedgedRequests = hSearchd.GetBool ( "ha_hedged_requests" );
+	g_bAgentStreamingMerge = hSearchd.GetBool ( "agent_streaming_merge" );
+	g_bAgentTopNPushdown = hSearchd.GetBool ( "agent_topn_pushdown" );
 	g_iQueryLogMinMs = hSearchd.GetMsTimeMs ( "query_log_min_msec", g_iQueryLogMinMs );
 
 	g_iAgentConnectTimeoutMs = hSearchd.GetMsTimeMs ( "agent_connect_timeout", g_iAgentConnectTimeoutMs );
@@ -20112,6 +20298,7 @@ void ConfigureSearchd ( const CSphConfig & hConf, bool bOptPIDFile, bool bTestMo
 
 	g_iDocstoreCache = hSearchd.GetSize64 ( "docstore_cache_size", 16777216 );
 	g_iSkipCache = hSearchd.GetSize64 ( "skiplist_cache_size", 67108864 );
+	g_sSkipCacheHotlist = hSearchd.GetStr ( "skiplist_cache_hotlist" );
 
 	if ( hSearchd.Exists ( "max_open_files" ) )
 	{
@@ -20203,6 +20390,7 @@ void ConfigureSearchd ( const CSphConfig & hConf, bool bOptPIDFile, bool bTestMo
 
 	SetAccurateAggregationDefault ( hSearchd.GetInt ( "accurate_aggregation", GetAccurateAggregationDefault() )!=0 );
 	SetDistinctThreshDefault ( hSearchd.GetInt ( "distinct_precision_threshold", GetDistinctThreshDefault() ) );
+	SetGroupbyMemLimitDefault ( hSearchd.GetSize64 ( "groupby_mem_limit", GetGroupbyMemLimitDefault() ) );
 
 	ConfigureMerge(hSearchd);
 }
@@ -21353,7 +21541,7 @@ int WINAPI ServiceMain ( int argc, char **argv ) EXCLUDES (MainThread)
 	Binlog::Configure ( hSearchd, uReplayFlags );
 	SetUidShort ( bTestMode );
 	InitDocstore ( g_iDocstoreCache );
-	InitSkipCache ( g_iSkipCache );
+	InitSkipCache ( g_iSkipCache, g_sSkipCacheHotlist.scstr() );
 	InitParserOption();
 
 	if ( bOptPIDFile )
@@ -21510,10 +21698,17 @@ int WINAPI ServiceMain ( int argc, char **argv ) EXCLUDES (MainThread)
 	PrepareClustersOnStartup ( dListenerDescs, bNewClusterForce );
 
 	g_dNetLoops.Resize ( g_iNetWorkers );
-	for ( auto & pNetLoop : g_dNetLoops )
+	ARRAY_FOREACH ( iLoop, g_dNetLoops )
 	{
+		auto & pNetLoop = g_dNetLoops[iLoop];
 		pNetLoop = new CSphNetLoop;
-		pNetLoop->SetListeners ( g_dListeners );
+
+		CSphVector<Listener_t> dLoopListeners;
+		for ( const auto & tListener : g_dListeners )
+			if ( tListener.m_iNetLoop<0 || tListener.m_iNetLoop==iLoop )
+				dLoopListeners.Add ( tListener );
+
+		pNetLoop->SetListeners ( dLoopListeners );
 		if ( !GetAvailableNetLoop() )
 			SetAvailableNetLoop ( pNetLoop );
 		g_pTickPoolThread->Schedule ( [pNetLoop] { ScopedRole_c thPoll ( NetPoollingThread ); pNetLoop->LoopNetPoll (); }, false );
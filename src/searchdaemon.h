@@ -152,6 +152,7 @@ enum SearchdCommand_e : WORD
 	SEARCHD_COMMAND_CALLPQ 		= 17,
 	SEARCHD_COMMAND_CLUSTER		= 18,
 	SEARCHD_COMMAND_GETFIELD	= 19,
+	SEARCHD_COMMAND_TOPNCUTOFF	= 20,
 
 	SEARCHD_COMMAND_TOTAL,
 	SEARCHD_COMMAND_WRONG = SEARCHD_COMMAND_TOTAL,
@@ -162,7 +163,7 @@ const char* szCommand ( int );
 /// master-agent API SEARCH command protocol extensions version
 enum
 {
-	VER_COMMAND_SEARCH_MASTER = 22
+	VER_COMMAND_SEARCH_MASTER = 24
 };
 
 
@@ -183,6 +184,7 @@ enum SearchdCommandV_e : WORD
 	VER_COMMAND_CALLPQ		= 0x100,
 	VER_COMMAND_CLUSTER		= 0x109,
 	VER_COMMAND_GETFIELD	= 0x100,
+	VER_COMMAND_TOPNCUTOFF	= 0x100,
 
 	VER_COMMAND_WRONG = 0,
 };
@@ -45,6 +45,10 @@
 int64_t			g_iPingIntervalUs		= 0;		// by default ping HA agents every 1 second
 DWORD			g_uHAPeriodKarmaS	= 60;		// by default use the last 1 minute statistic to determine the best HA agent
 int				g_iPersistentPoolSize	= 0;
+int				g_iPersistentPoolWaitMs	= 0;
+bool			g_bHAHedgedRequests		= false;
+bool			g_bAgentStreamingMerge	= false;
+bool			g_bAgentTopNPushdown	= false;
 
 static auto& g_iTFO = sphGetTFO ();
 
@@ -128,6 +132,40 @@ MetricsAndCounters_t& HostDashboard_t::GetCurrentMetrics ()
 	return dCurrentMetrics.m_dMetrics;
 }
 
+// same smoothing as tcp does for rtt: 1/8 for the average, 1/4 for the deviation
+void HostDashboard_t::UpdateLatency ( int64_t iTimeUS )
+{
+	if ( !m_iLatencyUS )
+	{
+		m_iLatencyUS = iTimeUS;
+		m_iLatencyDevUS = iTimeUS / 2;
+		return;
+	}
+
+	int64_t iDelta = iTimeUS - m_iLatencyUS;
+	m_iLatencyDevUS += ( ( iDelta<0 ? -iDelta : iDelta ) - m_iLatencyDevUS ) / 4;
+	m_iLatencyUS += iDelta / 8;
+}
+
+// average + 2 deviations is close to 95th percentile for the bell-shaped distribution
+int64_t HostDashboard_t::GetLatencyP95US () const
+{
+	ScRL_t tRguard ( m_dMetricsLock );
+	return m_iLatencyUS ? m_iLatencyUS + 2 * m_iLatencyDevUS : 0;
+}
+
+// expected time to get an answer if we send one more query right now.
+// Never queried host looks the fastest one, but its outstanding queries still count.
+double HostDashboard_t::GetLoadScore () const
+{
+	int64_t iLatencyUS;
+	{
+		ScRL_t tRguard ( m_dMetricsLock );
+		iLatencyUS = Max ( m_iLatencyUS, (int64_t)1 );
+	}
+	return double ( iLatencyUS ) * ( m_iOutstanding.load ( std::memory_order_relaxed ) + 1 );
+}
+
 void HostDashboard_t::GetCollectedMetrics ( HostMetricsSnapshot_t& dResult, int iPeriods ) const
 {
 	DWORD uSeconds = GetCurSeconds();
@@ -189,9 +227,12 @@ int PersistentConnectionsPool_c::Step ( int* pVar )
 	return iRes;
 }
 
+static void ResumePoolWaiter ( AgentConn_t * pWaiter ); // forward definition
+
 // Rent first try to return the sockets which already were in work (i.e. which are connected)
 // If no such socket available and the limit is not reached, it will add the new one.
-int PersistentConnectionsPool_c::RentConnection ()
+// If the limit is reached, pWaiter (if any) is queued to get the next returned socket, and -3 is returned.
+int PersistentConnectionsPool_c::RentConnection ( AgentConn_t * pWaiter )
 {
 	ScopedMutex_t tGuard ( m_dDataLock );
 	if ( m_iFreeWindow>0 )
@@ -200,18 +241,35 @@ int PersistentConnectionsPool_c::RentConnection ()
 		return m_dSockets[Step ( &m_iRit )];
 	}
 	if ( m_dSockets.GetLength () >= m_iLimit )
-		return -2; // no more slots available;
+	{
+		if ( !pWaiter || m_bShutdown )
+			return -2; // no more slots available;
+
+		SafeAddRef ( pWaiter );
+		m_dWaiters.Add ( pWaiter );
+		return -3;
+	}
 
 	// this branch will be executed only during initial 'heating'
 	m_dSockets.Add ( -1 );
 	return -1;
 }
 
-// write given socket into the pool.
+// write given socket into the pool, or give it to the first waiter.
 void PersistentConnectionsPool_c::ReturnConnection ( int iSocket )
 {
 	ScopedMutex_t tGuard ( m_dDataLock );
 
+	// the slot stays rented, just by another query
+	if ( !m_dWaiters.IsEmpty() )
+	{
+		auto * pWaiter = m_dWaiters[0];
+		m_dWaiters.Remove ( 0 );
+		m_dHanded.Add ( { pWaiter, iSocket } );
+		ResumePoolWaiter ( pWaiter );
+		return;
+	}
+
 	// overloaded pool
 	if ( m_iFreeWindow >= m_dSockets.GetLength () )
 	{
@@ -238,20 +296,58 @@ void PersistentConnectionsPool_c::ReturnConnection ( int iSocket )
 	m_dSockets[Step ( &m_iWit )] = iSocket;
 }
 
+// the waiter doesn't wait anymore (got resumed, timed out or orphaned).
+// returns the socket handed to it, or -2 if there was none (then it is just removed from the queue).
+int PersistentConnectionsPool_c::StopWaiting ( AgentConn_t * pWaiter )
+{
+	ScopedMutex_t tGuard ( m_dDataLock );
+	ARRAY_FOREACH ( i, m_dHanded )
+		if ( m_dHanded[i].m_pWaiter==pWaiter )
+		{
+			int iSock = m_dHanded[i].m_iSock;
+			m_dHanded.RemoveFast ( i );
+			return iSock;
+		}
+
+	ARRAY_FOREACH ( i, m_dWaiters )
+		if ( m_dWaiters[i]==pWaiter )
+		{
+			m_dWaiters.Remove ( i );
+			pWaiter->Release(); // caller holds its own ref
+			break;
+		}
+
+	return -2;
+}
+
 // close all the sockets in the pool.
 void PersistentConnectionsPool_c::Shutdown ()
 {
-	ScopedMutex_t tGuard ( m_dDataLock );
-	m_bShutdown = true;
-	for ( int i = 0; i<m_iFreeWindow; ++i )
+	CSphVector<AgentConn_t *> dWaiters;
 	{
-		int& iSock = m_dSockets[Step ( &m_iRit )];
-		if ( iSock>=0 )
+		ScopedMutex_t tGuard ( m_dDataLock );
+		m_bShutdown = true;
+		for ( int i = 0; i<m_iFreeWindow; ++i )
 		{
-			sphSockClose ( iSock );
-			iSock = -1;
+			int& iSock = m_dSockets[Step ( &m_iRit )];
+			if ( iSock>=0 )
+			{
+				sphSockClose ( iSock );
+				iSock = -1;
+			}
 		}
+
+		for ( const auto & tHanded : m_dHanded )
+			if ( tHanded.m_iSock>=0 )
+				sphSockClose ( tHanded.m_iSock );
+		m_dHanded.Reset();
+
+		// queued ones will time out and connect on their own
+		dWaiters.SwapData ( m_dWaiters );
 	}
+
+	for ( auto * pWaiter : dWaiters )
+		pWaiter->Release();
 }
 
 void ClosePersistentSockets()
@@ -926,6 +1022,72 @@ const AgentDesc_t &MultiAgentDesc_c::StLowErrors ()
 }
 
 
+// pick the mirror with the least expected answer time, i.e. moving average of its latency
+// scaled by the number of queries it is already busy with. Never queried mirrors go first,
+// dead ones (see StDiscardDead) only when all the mirrors are dead.
+static int BestLatencyAgent ( const VecTraits_T<AgentDesc_t> & dAgents, const HostDashboard_t * pSkip )
+{
+	const int64_t iDeadThr = 3;
+
+	int iBestAgent = -1;
+	bool bBestDead = true;
+	double fBestScore = 0.0;
+	CSphVector<int> dCandidates;
+
+	ARRAY_CONSTFOREACH ( i, dAgents )
+	{
+		const auto & tAgent = dAgents[i];
+		if ( tAgent.m_bBlackhole || tAgent.m_pDash.Ptr()==pSkip )
+			continue;
+
+		bool bDead;
+		{
+			ScRL_t tRguard ( tAgent.m_pDash->m_dMetricsLock );
+			bDead = tAgent.m_pDash->m_iErrorsARow>iDeadThr;
+		}
+		double fScore = tAgent.m_pDash->GetLoadScore ();
+
+		if ( iBestAgent<0 || ( bBestDead && !bDead ) || ( bBestDead==bDead && fScore<fBestScore ) )
+		{
+			dCandidates.Resize ( 0 );
+			iBestAgent = i;
+			bBestDead = bDead;
+			fBestScore = fScore;
+		} else if ( bBestDead==bDead && fScore==fBestScore )
+			dCandidates.Add ( i );
+	}
+
+	// ties (mostly never queried mirrors) are resolved randomly
+	if ( !dCandidates.IsEmpty () )
+	{
+		dCandidates.Add ( iBestAgent );
+		iBestAgent = dCandidates[sphRand () % dCandidates.GetLength ()];
+	}
+
+	return iBestAgent;
+}
+
+const AgentDesc_t &MultiAgentDesc_c::StLowLatency ()
+{
+	if ( !IsHA() )
+		return *m_pData;
+
+	int iBestAgent = BestLatencyAgent ( *this, nullptr );
+	if ( iBestAgent<0 )
+		return RandAgent();
+
+	sphLogDebugv ( "client=%s, HA selected %d node with best latency score", m_pData[iBestAgent].GetMyUrl().cstr(), iBestAgent );
+	return m_pData[iBestAgent];
+}
+
+// the mirror for a duplicate of the query which already went to pSkip host; nullptr if there is no other one
+const AgentDesc_t * MultiAgentDesc_c::ChooseHedgeAgent ( const HostDashboard_t * pSkip ) const
+{
+	int iBestAgent = BestLatencyAgent ( *this, pSkip );
+	return iBestAgent<0 ? nullptr : m_pData + iBestAgent;
+}
+
+
 const AgentDesc_t &MultiAgentDesc_c::ChooseAgent ()
 {
 	if ( !IsHA() )
@@ -946,6 +1108,8 @@ const AgentDesc_t &MultiAgentDesc_c::ChooseAgent ()
 		return StLowErrors();
 	case HA_ROUNDROBIN:
 		return RRAgent();
+	case HA_LATENCY:
+		return StLowLatency();
 	default:
 		return RandAgent();
 	}
@@ -1028,6 +1192,11 @@ static void agent_stats_inc ( AgentConn_t &tAgent, AgentStats_e iCountID )
 	{
 		tAgentMetrics.m_dMetrics[ehTotalMsecs] += tAgent.m_iEndQuery - tAgent.m_iStartQuery;
 		tAgent.m_tDesc.m_pMetrics->m_dMetrics[ehTotalMsecs] += tAgent.m_iEndQuery - tAgent.m_iStartQuery;
+
+		// a failure never makes the host look faster (say, 'connection refused' comes at once)
+		int64_t iLatencyUS = tAgent.m_iEndQuery - tAgent.m_iStartQuery;
+		if ( tAgent.m_iStartQuery && ( iCountID>=eNetworkCritical || iLatencyUS>tIndexDash.m_iLatencyUS ) )
+			tIndexDash.UpdateLatency ( iLatencyUS );
 	}
 }
 
@@ -1144,6 +1313,8 @@ bool ParseStrategyHA ( const char * sName, HAStrategies_e & eStrategy )
 		eStrategy = HA_AVOIDDEAD;
 	else if ( sphStrMatchStatic ( "noerrors", sName ) )
 		eStrategy = HA_AVOIDERRORS;
+	else if ( sphStrMatchStatic ( "latency", sName ) )
+		eStrategy = HA_LATENCY;
 	else
 		return false;
 
@@ -1158,6 +1329,7 @@ CSphString HAStrategyToStr ( HAStrategies_e eStrategy )
 	case HA_ROUNDROBIN:		return "roundrobin";
 	case HA_AVOIDDEAD:		return "nodeads";
 	case HA_AVOIDERRORS:	return "noerrors";
+	case HA_LATENCY:		return "latency";
 	}
 
 	return "";
@@ -1570,6 +1742,7 @@ AgentConn_t::~AgentConn_t ()
 	sphLogDebugv ( "AgentConn %p destroyed", this );
 	if ( m_iSock>=0 )
 		Finish ();
+	ReleaseHost ();
 }
 
 void AgentConn_t::State ( Agent_e eState )
@@ -1639,6 +1812,7 @@ void AgentConn_t::Finish ( bool bFail )
 	m_pPollerTask = nullptr;
 
 	ReturnPersist ();
+	ReleaseHost ();
 	if ( m_iStartQuery )
 		m_iWall += sphMicroTimer () - m_iStartQuery; // imitated old behaviour
 }
@@ -1664,7 +1838,14 @@ bool AgentConn_t::BadResult ( int iError )
 void AgentConn_t::ReportFinish ( bool bSuccess )
 {
 	if ( m_pReporter )
+	{
+		// once reported, the caller may dispose the builder; so wait for the hedge which may be using it right now
+		{
+			ScopedMutex_t tLock ( m_tReportLock );
+			m_bReported = true;
+		}
 		m_pReporter->Report ( bSuccess );
+	}
 	m_iRetries = -1; // avoid any accidental retry in future. fixme! better investigate why such accident may happen
 	m_bManyTries = false; // avoid report message because of it.
 }
@@ -1692,6 +1873,7 @@ bool AgentConn_t::StartNextRetry ()
 
 	if ( m_pMultiAgent && !IsBlackhole () && m_iRetries>=0 )
 	{
+		ReleaseHost ();
 		m_tDesc.CloneFrom ( m_pMultiAgent->ChooseAgent () );
 		SwitchBlackhole ();
 	}
@@ -1699,12 +1881,20 @@ bool AgentConn_t::StartNextRetry ()
 	if ( m_iRetries--<0 )
 		return m_bManyTries && Fail ( "retries limit exceeded" );
 
+	EngageHost ();
+
 	sphLogDebugA ( "%d Connection %p, host %s, pers=%d", m_iStoreTag, this, m_tDesc.GetMyUrl().cstr(), m_tDesc.m_bPersistent );
 
 	if ( IsPersistent() )
 	{
 		assert ( m_iSock==-1 );
 		m_iSock = m_tDesc.m_pDash->m_pPersPool->RentConnection ();
+		// blackholes don't wait: their builder is gone once the query is sent off, and the request can't be built
+		// before we know whether it goes over a fresh connection (which needs the handshake in front) or a pooled one.
+		// Hedges don't wait either: they are there to be fast
+		m_bWaitPool = ( m_iSock==-2 && g_iPersistentPoolWaitMs>0 && !IsBlackhole () && !m_pHedgeOf );
+		if ( m_bWaitPool )
+			m_iSock = -1;
 		m_tDesc.m_bPersistent = m_iSock!=-2;
 		if ( m_iSock>=0 && sphNBSockEof ( m_iSock ) )
 			SafeCloseSocket ( m_iSock );
@@ -1713,6 +1903,183 @@ bool AgentConn_t::StartNextRetry ()
 	return true;
 }
 
+// count the query as outstanding for the host (used by latency-aware mirror selection). Pings are not counted.
+void AgentConn_t::EngageHost ()
+{
+	if ( m_bEngaged || !m_tDesc.m_pDash || !m_tDesc.m_pMetrics )
+		return;
+
+	m_tDesc.m_pDash->m_iOutstanding.fetch_add ( 1, std::memory_order_relaxed );
+	m_bEngaged = true;
+}
+
+void AgentConn_t::ReleaseHost ()
+{
+	if ( !m_bEngaged )
+		return;
+
+	m_tDesc.m_pDash->m_iOutstanding.fetch_sub ( 1, std::memory_order_relaxed );
+	m_bEngaged = false;
+}
+
+// if the mirror doesn't answer in its usual time (95th percentile of its latency), the same query goes to
+// another mirror. The duplicate (hedge) is a separate connection without reporter; whichever answers first wins.
+void AgentConn_t::ScheduleHedge ()
+{
+	if ( !std::exchange ( m_bAllowHedge, false ) || !g_bHAHedgedRequests )
+		return;
+
+	if ( !m_pMultiAgent || !m_pMultiAgent->IsHA () || IsBlackhole () || !m_pReporter )
+		return;
+
+	int64_t iDelayUS = m_tDesc.m_pDash->GetLatencyP95US ();
+	if ( !iDelayUS || iDelayUS>=m_iMyQueryTimeoutMs*1000 )
+		return; // no answers seen yet, or the query times out earlier anyway
+
+	// the mirror is chosen right now; the request is built only when the timer fires, as most of the hedges never go
+	const AgentDesc_t * pMirror = m_pMultiAgent->ChooseHedgeAgent ( m_tDesc.m_pDash );
+	if ( !pMirror )
+		return;
+
+	auto * pHedge = new AgentConn_t;
+	SafeAddRef ( this );
+	pHedge->m_pHedgeOf = this;
+	pHedge->m_tDesc.CloneFrom ( *pMirror );
+	pHedge->m_iStoreTag = m_iStoreTag;
+	pHedge->m_iWeight = m_iWeight;
+	pHedge->m_iMyConnectTimeoutMs = m_iMyConnectTimeoutMs;
+	pHedge->m_iMyQueryTimeoutMs = m_iMyQueryTimeoutMs;
+	pHedge->m_bReplyLimitSize = m_bReplyLimitSize;
+	pHedge->SetNetLoop ( InNetLoop () );
+
+	sphLogDebugA ( "%d hedge %p to %s scheduled in " INT64_FMT " us", m_iStoreTag, pHedge, pHedge->m_tDesc.GetMyUrl ().cstr (), iDelayUS );
+	pHedge->LazyTask ( MonoMicroTimer () + iDelayUS, iDelayUS, TIMEOUT_HEDGE );
+	m_bNeedKick |= pHedge->FireKick ();
+	pHedge->Release (); // the poller owns it now
+}
+
+// hedge timer fired; build the request with the builder of the original connection. The builder is alive
+// until that connection reports its finish, and the report waits for us, so it can't be disposed in the middle
+bool AgentConn_t::BuildHedgeRequest ()
+{
+	AgentConn_t & tOrigin = *m_pHedgeOf;
+	ScopedMutex_t tLock ( tOrigin.m_tReportLock );
+	if ( tOrigin.m_bReported || !tOrigin.m_pBuilder )
+		return false;
+
+	ISphOutputBuffer tRequest;
+	tOrigin.m_pBuilder->BuildRequest ( *this, tRequest );
+	tRequest.SwapData ( m_dHedgeRequest );
+	return true;
+}
+
+// whether the original connection still needs an answer from a hedge
+bool AgentConn_t::WantsHedge () const
+{
+	return m_pPollerTask && !m_bSuccess && !( m_pReporter && m_pReporter->IsDone () );
+}
+
+// the hedge got the whole answer; hand it over to the original connection, unless that one is done already
+bool AgentConn_t::CommitHedge ()
+{
+	Finish ();
+	CSphRefcountedPtr<AgentConn_t> pOrigin { m_pHedgeOf.Leak () };
+	if ( pOrigin->WantsHedge () )
+		pOrigin->AdoptHedge ( *this );
+	return true;
+}
+
+// drop whatever we're doing now and commit the answer received by the hedge, as if it was ours
+void AgentConn_t::AdoptHedge ( AgentConn_t & tHedge )
+{
+	sphLogDebugA ( "%d hedge from %s answered first, ref=%d", m_iStoreTag, tHedge.m_tDesc.GetMyUrl ().cstr (), ( int ) GetRefcount () );
+	SetNetLoop ();
+
+	// we may wait in the pool queue without any slot rented
+	if ( m_eTimeoutKind==TIMEOUT_POOL && IsPersistent () )
+	{
+		int iSock = m_tDesc.m_pDash->m_pPersPool->StopWaiting ( this );
+		if ( iSock!=-2 )
+			m_tDesc.m_pDash->m_pPersPool->ReturnConnection ( iSock );
+		m_tDesc.m_bPersistent = false;
+	}
+	m_eTimeoutKind = TIMEOUT_UNKNOWN;
+
+	// our query is in the middle, so the socket can't be reused
+	Finish ( true );
+
+	// the slow host won't answer this query, but it has taken at least that long; don't let it look faster than it is
+	int64_t iStartQuery = m_iStartQuery ? m_iStartQuery : tHedge.m_iStartQuery;
+	if ( iStartQuery )
+	{
+		ScWL_t tWguard ( m_tDesc.m_pDash->m_dMetricsLock );
+		m_tDesc.m_pDash->UpdateLatency ( sphMicroTimer ()-iStartQuery );
+	}
+
+	// the hedge has already given its socket back to the pool of its host
+	m_tDesc.CloneFrom ( tHedge.m_tDesc );
+	m_tDesc.m_bPersistent = false;
+	m_iStartQuery = tHedge.m_iStartQuery;
+	m_eReplyStatus = tHedge.m_eReplyStatus;
+	m_iReplySize = tHedge.m_iReplySize;
+	m_dReplyBuf.SwapData ( tHedge.m_dReplyBuf );
+
+	if ( CommitResult () )
+		ReportFinish ( true );
+	else
+		StartRemoteLoopTry ();
+}
+
+// all the persistent connections to the host are busy; wait for one to be returned instead of connecting a one-off one.
+// the timer is set before queueing, so that the pool always finds the waiter parked.
+bool AgentConn_t::WaitPooledConnection ()
+{
+	m_bWaitPool = false;
+	int64_t iWaitUS = 1000 * g_iPersistentPoolWaitMs;
+	LazyTask ( MonoMicroTimer () + iWaitUS, iWaitUS, TIMEOUT_POOL );
+
+	int iSock = m_tDesc.m_pDash->m_pPersPool->RentConnection ( this );
+	if ( iSock==-3 )
+	{
+		sphLogDebugA ( "%d waiting for persistent connection ref=%d", m_iStoreTag, ( int ) GetRefcount () );
+		return true;
+	}
+
+	// something was returned meanwhile
+	LazyDeleteOrChange ();
+	return UsePooledConnection ( iSock );
+}
+
+// continue with socket from the pool, or with a one-off connection if iSock==-2
+bool AgentConn_t::UsePooledConnection ( int iSock )
+{
+	m_tDesc.m_bPersistent = iSock!=-2;
+	m_iSock = Max ( iSock, -1 );
+	if ( m_iSock>=0 && sphNBSockEof ( m_iSock ) )
+		SafeCloseSocket ( m_iSock );
+
+	return DoQuery ();
+}
+
+// invoked by poller when the pool handed a socket to us
+void AgentConn_t::ResumeWaiting ()
+{
+	SetNetLoop ();
+	if ( m_pPollerTask && m_eTimeoutKind==TIMEOUT_POOL )
+	{
+		LazyDeleteOrChange ( MonoMicroTimer () ); // fire the timer right now
+		return;
+	}
+
+	// we don't wait anymore, so give the socket back
+	if ( !IsPersistent () )
+		return;
+
+	int iSock = m_tDesc.m_pDash->m_pPersPool->StopWaiting ( this );
+	if ( iSock!=-2 )
+		m_tDesc.m_pDash->m_pPersPool->ReturnConnection ( iSock );
+}
+
 // if we're blackhole, drop retries, parser, reporter and return true
 bool AgentConn_t::SwitchBlackhole ()
 {
@@ -1733,7 +2100,7 @@ bool AgentConn_t::SwitchBlackhole ()
 // initialize read/write task
 void AgentConn_t::ScheduleCallbacks ()
 {
-	LazyTask ( m_iPoolerTimeoutUS, m_iPoolerTimeoutPeriodUS, true, BYTE ( m_dIOVec.HasUnsent () ? 1 : 2 ) );
+	LazyTask ( m_iPoolerTimeoutUS, m_iPoolerTimeoutPeriodUS, TIMEOUT_HARD, BYTE ( m_dIOVec.HasUnsent () ? 1 : 2 ) );
 }
 
 void FirePoller (); // forward definition
@@ -1748,10 +2115,40 @@ void AgentConn_t::TimeoutCallback ()
 
 	// check if we accidentally orphaned (that is bug!)
 	if ( CheckOrphaned() )
+	{
+		if ( ePrevKind==TIMEOUT_POOL )
+			ResumeWaiting (); // leave the queue, or give back what we've got
+		else if ( m_pHedgeOf )
+			Finish ( true ); // the hedge is not needed anymore; its query may be in the middle
 		return;
+	}
 
 	switch ( ePrevKind )
 	{
+		case TIMEOUT_POOL:
+		{
+			// either the pool gave us a socket, or we've waited enough and go with a one-off connection
+			int iSock = IsPersistent () ? m_tDesc.m_pDash->m_pPersPool->StopWaiting ( this ) : -2;
+			if ( !UsePooledConnection ( iSock ) )
+				StartRemoteLoopTry ();
+			FirePoller ();
+			sphLogDebugA ( "%d finished pool wait ref=%d", m_iStoreTag, ( int ) GetRefcount () );
+			break;
+		}
+		case TIMEOUT_HEDGE:
+			// the original connection still waits for the answer; duplicate its query to another mirror.
+			// The request is built here, not in the resolver callback, which may come when the builder is gone
+			if ( !BuildHedgeRequest () )
+			{
+				sphLogDebugA ( "%d hedge is late, dropped", m_iStoreTag );
+				Finish ( true );
+				break;
+			}
+			sphLogDebugA ( "%d hedge goes to %s", m_iStoreTag, m_tDesc.GetMyUrl ().cstr () );
+			StartRemoteLoopTry ();
+			FirePoller ();
+			sphLogDebugA ( "%d finished hedge timeout ref=%d", m_iStoreTag, ( int ) GetRefcount () );
+			break;
 		case TIMEOUT_RETRY:
 			if ( !DoQuery () )
 				StartRemoteLoopTry ();
@@ -1775,6 +2172,10 @@ void AgentConn_t::TimeoutCallback ()
 // the reason for orphanes is suggested to be combined write, then read in netloop with epoll
 bool AgentConn_t::CheckOrphaned()
 {
+	// hedge is owned by poller only; it is orphaned when the original connection is done
+	if ( m_pHedgeOf )
+		return !m_pHedgeOf->WantsHedge ();
+
 	// check if we accidentally orphaned (that is bug!)
 	if ( IsLast () && !IsBlackhole () )
 	{
@@ -1844,6 +2245,12 @@ void AgentConn_t::BuildData ()
 		// prepare our data to send.
 		m_pBuilder->BuildRequest ( *this, m_tOutput );
 		m_dIOVec.BuildFrom ( m_tOutput );
+	} else if ( m_pHedgeOf && m_dIOVec.IsEmpty () )
+	{
+		sphLogDebugA ( "%d BuildData for hedge this=%p", m_iStoreTag, this );
+		// hedge has no builder; its request is built when its timer fires
+		m_tOutput.SendBytes ( m_dHedgeRequest );
+		m_dIOVec.BuildFrom ( m_tOutput );
 	} else
 		sphLogDebugA ( "%d BuildData, already done", m_iStoreTag );
 }
@@ -2231,6 +2638,7 @@ void AgentConn_t::GenericInit ( RequestBuilder_i * pQuery, ReplyParser_i * pPars
 		m_iDelay = iQueryDelay;
 
 	m_pBuilder = pQuery;
+	m_bReported = false;
 	m_iWall = 0;
 	m_iWaited = 0;
 	m_bNeedKick = false;
@@ -2276,11 +2684,12 @@ void AgentConn_t::StartRemoteLoopTry ()
 			{
 				// can't start right now; need to postpone until timeout
 				sphLogDebugA ( "%d postpone DoQuery() for %d msecs", m_iStoreTag, m_iDelay );
-				LazyTask ( MonoMicroTimer () + 1000 * m_iDelay, 1000*m_iDelay, false );
+				LazyTask ( MonoMicroTimer () + 1000 * m_iDelay, 1000*m_iDelay, TIMEOUT_RETRY );
 				return;
 			}
 		}
 
+		ScheduleHedge ();
 		if ( DoQuery () )
 			return;
 	};
@@ -2292,6 +2701,9 @@ void AgentConn_t::StartRemoteLoopTry ()
 bool AgentConn_t::DoQuery()
 {
 	sphLogDebugA ( "%d DoQuery() ref=%d", m_iStoreTag, ( int ) GetRefcount () );
+	if ( m_bWaitPool )
+		return WaitPooledConnection ();
+
 	auto iNow = sphMicroTimer ();
 	auto iMonoNow = MonoMicroTimer();
 	if ( m_iSock>=0 )
@@ -2325,24 +2737,28 @@ bool AgentConn_t::DoQuery()
 
 	// here we're in case agent's remote addr need to be resolved (DNS required)
 	assert ( m_tDesc.m_iFamily==AF_INET );
+
+	// for blackholes we parse query immediately (before the resolver may call back from another thread),
+	// since builder will be disposed outside once we returned from the function
+	if ( IsBlackhole () )
+		BuildData ();
 	AddRef ();
 	sphLogDebugA ( "%d -> async GetAddress_a scheduled() ref=%d", m_iStoreTag, ( int ) GetRefcount () );
 	DNSResolver_c::GetAddress_a ( m_tDesc.m_sAddr.cstr (), [this] ( DWORD uIP )
 	{
 		sphLogDebugA ( "%d :- async GetAddress_a callback (ip is %u) ref=%d", m_iStoreTag, uIP, ( int ) GetRefcount () );
 		m_tDesc.m_uAddr = uIP;
-		if ( !EstablishConnection () )
+		if ( m_pHedgeOf && CheckOrphaned () )
+		{
+			sphLogDebugA ( "%d hedge orphaned while resolving, dropped", m_iStoreTag );
+			Finish ( true );
+		} else if ( !EstablishConnection () )
 			StartRemoteLoopTry ();
 		sphLogDebugA ( "%d <- async GetAddress_a returned() ref=%d", m_iStoreTag, ( int ) GetRefcount () );
 		if ( FireKick () )
 			FirePoller ();
 		Release ();
 	} );
-
-	// for blackholes we parse query immediately, since builder will be disposed
-	// outside once we returned from the function
-	if ( IsBlackhole () )
-		BuildData ();
 	return true;
 }
 
@@ -2536,6 +2952,9 @@ void AgentConn_t::SetNoLimitReplySize()
 bool AgentConn_t::CommitResult ()
 {
 	sphLogDebugA ( "%d CommitResult() ref=%d, parser %p", m_iStoreTag, ( int ) GetRefcount (), m_pParser );
+	if ( m_pHedgeOf )
+		return CommitHedge ();
+
 	if ( !m_pParser )
 	{
 		Finish();
@@ -3243,6 +3662,35 @@ protected:
 };
 
 /// Like ISphNetEvents, but most syscalls optimized out
+// waiters which got a socket from a persistent pool; they're resumed from the poller, as their timers live there
+static CSphMutex g_tResumedWaitersLock;
+static CSphVector<AgentConn_t *> g_dResumedWaiters GUARDED_BY ( g_tResumedWaitersLock );
+
+// takes the ref of pWaiter
+static void ResumePoolWaiter ( AgentConn_t * pWaiter )
+{
+	{
+		ScopedMutex_t tLock ( g_tResumedWaitersLock );
+		g_dResumedWaiters.Add ( pWaiter );
+	}
+	FirePoller ();
+}
+
+static void ProcessResumedWaiters () REQUIRES ( LazyThread )
+{
+	CSphVector<AgentConn_t *> dResumed;
+	{
+		ScopedMutex_t tLock ( g_tResumedWaitersLock );
+		dResumed.SwapData ( g_dResumedWaiters );
+	}
+
+	for ( auto * pWaiter : dResumed )
+	{
+		pWaiter->ResumeWaiting ();
+		pWaiter->Release ();
+	}
+}
+
 class LazyNetEvents_c : ISphNoncopyable, protected NetEventsFlavour_c
 {
 	using VectorTask_c = CSphVector<TaskNet_t*>;
@@ -3459,8 +3907,10 @@ private:
 	{
 		sphLogDebugL ( "L ---------------------------- EventTick(%d)", m_iTickNo );
 		do
+		{
+			ProcessResumedWaiters ();
 			ProcessEnqueuedTasks ();
-		while ( HasTimeoutActions () );
+		} while ( HasTimeoutActions () );
 
 
 		sphLogDebugL ( "L calculated timeout is " INT64_FMT " useconds", m_iNextTimeoutUS );
@@ -3703,12 +4153,12 @@ LazyNetEvents_c & LazyPoller ()
 }
 
 //! Add or change task for poller.
-void AgentConn_t::LazyTask ( int64_t iTimeoutUS, int64_t iTimeoutPeriodUS, bool bHardTimeout, BYTE uActivateIO )
+void AgentConn_t::LazyTask ( int64_t iTimeoutUS, int64_t iTimeoutPeriodUS, ETimeoutKind eKind, BYTE uActivateIO )
 {
 	assert ( iTimeoutUS>0 );
 
 	m_bNeedKick = !InNetLoop();
-	m_eTimeoutKind = bHardTimeout ? TIMEOUT_HARD : TIMEOUT_RETRY;
+	m_eTimeoutKind = eKind;
 	LazyPoller ().EnqueueNewTask ( this, iTimeoutUS, iTimeoutPeriodUS, uActivateIO );
 }
 
@@ -27,6 +27,7 @@ bool LoadExFunctions ();
 #include "sphinxutils.h"
 #include "searchdaemon.h"
 #include "timeout_queue.h"
+#include "std/openhash.h"
 
 /////////////////////////////////////////////////////////////////////////////
 // SOME SHARED GLOBAL VARIABLES
@@ -35,6 +36,10 @@ bool LoadExFunctions ();
 extern int64_t			g_iPingIntervalUs;
 extern DWORD			g_uHAPeriodKarmaS;		// by default use the last 1 minute statistic to determine the best HA agent
 extern int				g_iPersistentPoolSize;
+extern int				g_iPersistentPoolWaitMs;	// how long a query waits for a busy persistent connection; 0 means connect a one-off one at once
+extern bool				g_bHAHedgedRequests;	// send a duplicate query to another mirror when the chosen one is slower than usual
+extern bool				g_bAgentStreamingMerge;	// fold the replies of plain top-N queries into one running result as they come
+extern bool				g_bAgentTopNPushdown;	// send the k-th best merged sort key to the agents still searching, so they send less
 
 extern int				g_iAgentConnectTimeoutMs;
 extern int				g_iAgentQueryTimeoutMs;	// global (default). May be override by index-scope values, if one specified
@@ -103,10 +108,13 @@ enum HAStrategies_e
 	HA_ROUNDROBIN,
 	HA_AVOIDDEAD,
 	HA_AVOIDERRORS,
+	HA_LATENCY,
 
 	HA_DEFAULT = HA_RANDOM
 };
 
+struct AgentConn_t;
+
 // manages persistent connections to a host
 // serves a FIFO queue.
 // I.e. if we have 2 connections to a host, and one task rent the connection,
@@ -123,13 +131,23 @@ class PersistentConnectionsPool_c
 	int				m_iFreeWindow GUARDED_BY ( m_dDataLock ) = 0; // # of free sockets in the existing ring
 	int				m_iLimit GUARDED_BY ( m_dDataLock ) = 0; // exact limit (embedded vector's limit is not exact)
 
+	// when all the sockets are rented, renters may queue up; a returned socket goes to the first of them
+	struct Handed_t
+	{
+		AgentConn_t *	m_pWaiter;
+		int				m_iSock;
+	};
+	CSphVector<AgentConn_t *>	m_dWaiters GUARDED_BY ( m_dDataLock );	// FIFO, holds refs
+	CSphVector<Handed_t>		m_dHanded GUARDED_BY ( m_dDataLock );	// sockets given to waiters, but not yet taken by them
+
 	int Step ( int* ) REQUIRES ( m_dDataLock ); // step over the ring
 
 public:
 	~PersistentConnectionsPool_c ()	{ Shutdown (); }
 	void	ReInit ( int iPoolSize ) REQUIRES ( !m_dDataLock );
-	int		RentConnection () REQUIRES ( !m_dDataLock );
+	int		RentConnection ( AgentConn_t * pWaiter = nullptr ) REQUIRES ( !m_dDataLock );
 	void	ReturnConnection ( int iSocket ) REQUIRES ( !m_dDataLock );
+	int		StopWaiting ( AgentConn_t * pWaiter ) REQUIRES ( !m_dDataLock );
 	void	Shutdown () REQUIRES ( !m_dDataLock );
 };
 
@@ -233,10 +251,16 @@ struct HostDashboard_t : public ISphRefcountedMT
 	int64_t m_iLastQueryTime GUARDED_BY ( m_dMetricsLock ) = sphMicroTimer();    // updated when we send a query to a host
 	int64_t m_iErrorsARow GUARDED_BY ( m_dMetricsLock ) = 0;        // num of errors a row, updated when we update the general statistic.
 	DWORD m_uPingTripUS = 0;		// round-trip in uS. We send ping with current time, on receive answer compare with current time and fix that difference
+	int64_t m_iLatencyUS GUARDED_BY ( m_dMetricsLock ) = 0;	// moving average of query response time, 0 until the first answer
+	int64_t m_iLatencyDevUS GUARDED_BY ( m_dMetricsLock ) = 0;	// moving average of the response time deviation
+	std::atomic<int> m_iOutstanding { 0 };	// queries sent to the host and not finished yet
 
 public:
 	explicit HostDashboard_t ( const HostDesc_t &tAgent = {});
 	int64_t EngageTime () const;
+	void UpdateLatency ( int64_t iTimeUS ) REQUIRES ( m_dMetricsLock );
+	int64_t GetLatencyP95US () const REQUIRES ( !m_dMetricsLock );
+	double GetLoadScore () const REQUIRES ( !m_dMetricsLock );
 	MetricsAndCounters_t &GetCurrentMetrics () REQUIRES ( m_dMetricsLock );
 	void GetCollectedMetrics ( HostMetricsSnapshot_t &dResult, int iPeriods = 1 ) const REQUIRES ( !m_dMetricsLock );
 
@@ -314,6 +338,7 @@ public:
 	static void CleanupOrphaned();
 
 	const AgentDesc_t & ChooseAgent() REQUIRES ( !m_dWeightLock );
+	const AgentDesc_t * ChooseHedgeAgent ( const HostDashboard_t * pSkip ) const;
 
 	inline bool IsHA () const
 	{
@@ -341,6 +366,7 @@ private:
 	const AgentDesc_t &RandAgent ();
 	const AgentDesc_t &StDiscardDead () REQUIRES ( !m_dWeightLock );
 	const AgentDesc_t &StLowErrors () REQUIRES ( !m_dWeightLock );
+	const AgentDesc_t &StLowLatency ();
 
 	void ChooseWeightedRandAgent ( int * pBestAgent, CSphVector<int> &dCandidates ) REQUIRES ( !m_dWeightLock );
 	void CheckRecalculateWeights ( const CSphFixedVector<int64_t> &dTimers ) REQUIRES ( !m_dWeightLock );
@@ -472,7 +498,7 @@ struct DefaultQueryResult_t : public iQueryResult
 /// remote agent connection (local per-query state)
 struct AgentConn_t : public ISphRefcountedMT
 {
-	enum ETimeoutKind { TIMEOUT_UNKNOWN, TIMEOUT_RETRY, TIMEOUT_HARD, };
+	enum ETimeoutKind { TIMEOUT_UNKNOWN, TIMEOUT_RETRY, TIMEOUT_HARD, TIMEOUT_POOL, TIMEOUT_HEDGE, };
 public:
 	AgentDesc_t		m_tDesc;			///< desc of my host // fixme! turn to ref to MultiAgent mirror?
 	int				m_iSock = -1;
@@ -494,11 +520,13 @@ public:
 	CSphRefcountedPtr<Reporter_i>	m_pReporter { nullptr };	///< used to report back when we're finished
 	LPKEY			m_pPollerTask = nullptr; ///< internal for poller. fixme! privatize?
 	volatile bool	m_bSuccess {false};	///< agent got processed, no need to retry
+	bool			m_bAllowHedge = false;	///< request is read-only, so a duplicate may go to another mirror
 
 public:
 	AgentConn_t () = default;
 
 	void SetMultiAgent ( MultiAgentDescRefPtr_c pMirror );
+	inline const MultiAgentDesc_c * GetMultiAgent () const { return m_pMultiAgent.Ptr(); }
 	inline bool IsBlackhole () const { return m_tDesc.m_bBlackhole; }
 	inline bool InNetLoop() const { return m_bInNetLoop; }
 	inline void SetNetLoop ( bool bInNetLoop = true ) { m_bInNetLoop = bInNetLoop; }
@@ -512,6 +540,7 @@ public:
 	void RecvCallback ( int64_t iWaited, DWORD uReceived );
 	void TimeoutCallback ();
 	void AbortCallback();
+	void ResumeWaiting();
 	bool CheckOrphaned();
 	void SetNoLimitReplySize();
 
@@ -535,6 +564,10 @@ private:
 	int			m_iRetries = 0;						///< initialized to max num of tries. 0 mean 1 try, no re-tries.
 	int			m_iMirrorsCount = 1;
 	int			m_iDelay { g_iAgentRetryDelayMs };	///< delay between retries
+	CSphRefcountedPtr<AgentConn_t> m_pHedgeOf { nullptr };	///< for a hedge: the slow connection we duplicate
+	CSphVector<BYTE> m_dHedgeRequest;	///< for a hedge: the request, built once the hedge timer fires
+	CSphMutex		m_tReportLock;		///< reporting finish waits while a hedge builds its request with our builder
+	bool			m_bReported = false;	///< finish is reported, so the builder may be gone
 
 	// active timeout (directly used by poller)
 	int64_t			m_iPoolerTimeoutPeriodUS = -1;
@@ -558,6 +591,8 @@ private:
 	bool m_bInNetLoop	= false;		///< if we're inside netloop (1-thread work with schedule)
 	bool m_bNeedKick	= false;		///< if we've installed callback from outside th and need to kick netloop
 	bool m_bManyTries = false;			///< to avoid report 'retries limit esceeded' if we have ONLY one retry
+	bool m_bWaitPool = false;			///< all the persistent connections are busy, need to wait for one
+	bool m_bEngaged = false;			///< counted in outstanding queries of the host
 
 	Agent_e			m_eConnState { Agent_e::HEALTHY };	///< current state
 	SearchdStatus_e m_eReplyStatus { SEARCHD_ERROR };    ///< reply status code
@@ -580,8 +615,16 @@ private:
 	void SendingState (); ///< from CONNECTING state go to HEALTHY and switch timer to QUERY timeout.
 
 	bool StartNextRetry ();
+	void EngageHost ();
+	void ReleaseHost ();
 
-	void LazyTask ( int64_t iTimeoutMS, int64_t iTimeoutPeriodUS, bool bHardTimeout = false, BYTE ActivateIO = 0 ); // 1=RW, 2=RO.
+	void ScheduleHedge ();
+	bool BuildHedgeRequest ();
+	bool WantsHedge () const;
+	bool CommitHedge ();
+	void AdoptHedge ( AgentConn_t & tHedge );
+
+	void LazyTask ( int64_t iTimeoutMS, int64_t iTimeoutPeriodUS, ETimeoutKind eKind = TIMEOUT_RETRY, BYTE ActivateIO = 0 ); // 1=RW, 2=RO.
 	void LazyDeleteOrChange ( int64_t iTimeoutMS = -1, int64_t iTimeoutPeriodUS = -1 );
 	void ScheduleCallbacks ();
 	void DisableWrite();
@@ -597,6 +640,8 @@ private:
 	int DoTFO ( struct sockaddr * pSs, int iLen );
 
 	bool DoQuery ();
+	bool WaitPooledConnection ();
+	bool UsePooledConnection ( int iSock );
 	bool EstablishConnection ();
 	bool SendQuery (DWORD uSent = 0);
 	bool ReceiveAnswer (DWORD uReceived = 0);
@@ -804,4 +849,75 @@ protected:
 void RemotesGetField ( AggrResult_t & tRes, const CSphQuery & tQuery );
 void HandleCommandGetField ( ISphOutputBuffer & tOut, WORD uVer, InputBuffer_c & tReq );
 
+/// sort key of the k-th best match merged by master so far.
+/// An agent drops the matches which are strictly worse, as these can't make it into the final top-N anyway.
+struct TopNCutoffKey_t
+{
+	static const int MAX_PARTS = 5;
+
+	int				m_iParts = 0;			///< 0 means no key
+	DWORD			m_uAttrDesc = 0;		///< sort order mask, as in CSphMatchComparatorState
+	BYTE			m_dTypes[MAX_PARTS];	///< ESphSortKeyPart of every part
+	SphAttr_t		m_dInts[MAX_PARTS];		///< values of weight and int parts
+	double			m_dFloats[MAX_PARTS];	///< values of float and double parts
+};
+
+bool	SameTopNLayout ( const TopNCutoffKey_t & a, const TopNCutoffKey_t & b );
+int		CmpTopNKeys ( const TopNCutoffKey_t & a, const TopNCutoffKey_t & b );	///< >0 if a goes first in the result
+void	SendTopNKey ( ISphOutputBuffer & tOut, const TopNCutoffKey_t & tKey );
+bool	ReadTopNKey ( InputBuffer_c & tReq, TopNCutoffKey_t & tKey );
+
+/// master side of plain top-N queries over several agents. With folding, every remote reply is merged into one running
+/// result as it comes, which keeps the max_matches best documents (plus ties), one copy each; so the remote matches take
+/// one sorter's worth of memory, however many agents answer. With pushdown, the offset+limit-th best key is also sent
+/// to the hosts of the agents which are still searching, once per host.
+class RemoteTopN_c : public ISphNoncopyable
+{
+public:
+					RemoteTopN_c ( const CSphQuery & tQuery, bool bEnabled, bool bFold, bool bPushdown );
+
+	uint64_t		GetToken() const { return m_uToken; }
+	void			AddResult ( AggrResult_t & tRes, int iResult );
+	void			Publish ( const VecTraits_T<AgentConn_t *> & dAgents );
+
+private:
+	struct Entry_t
+	{
+		TopNCutoffKey_t	m_tKey;
+		DocID_t			m_tDocID = 0;
+		int				m_iTag = 0;		///< tag of the result the copy came from
+		int				m_iMatch = -1;	///< match index in the running result (or in the new one, while merging)
+		bool			m_bNew = false;
+	};
+
+	const CSphQuery &			m_tQuery;
+	uint64_t					m_uToken = 0;		///< 0 means no pushdown
+	bool						m_bActive = false;
+	bool						m_bFold = false;
+	int							m_iTopN = 0;		///< offset+limit
+	int							m_iMaxMatches = 0;
+	int							m_iRunning = -1;	///< result which holds the folded matches, index in AggrResult_t::m_dResults
+	CSphVector<Entry_t>			m_dTop;				///< best documents so far, best first; max_matches of them plus ties
+	TopNCutoffKey_t				m_tPublished;
+	CSphVector<const HostDashboard_t *>	m_dNotified;	///< hosts which got the cutoff already
+
+	bool			Merge ( AggrResult_t & tRes, int iResult );
+	void			Fold ( AggrResult_t & tRes, int iResult, VecTraits_T<Entry_t> & dKeep );
+};
+
+/// agent side of the top-N cutoff: receives the keys for one query while it runs
+class TopNCutoffListener_c : public ISphNoncopyable
+{
+public:
+					~TopNCutoffListener_c();
+
+	void			Listen ( uint64_t uToken );
+	void			Apply ( AggrResult_t & tRes, const CSphQuery & tQuery ) const;
+
+private:
+	uint64_t		m_uToken = 0;
+};
+
+void HandleCommandTopNCutoff ( ISphOutputBuffer & tOut, WORD uVer, InputBuffer_c & tReq );
+
 #endif // _searchdha_
@@ -0,0 +1,532 @@
+//
+// Copyright (c) 2017-2024, Manticore Software LTD (https://manticoresearch.com)
+// All rights reserved
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License. You should have
+// received a copy of the GPL license along with this program; if you
+// did not, you can find it at http://www.gnu.org/
+//
+
+#include "sphinxstd.h"
+#include "searchdha.h"
+#include "sortsetup.h"
+#include "queuecreator.h"
+
+STATIC_ASSERT ( TopNCutoffKey_t::MAX_PARTS==CSphMatchComparatorState::MAX_ATTRS, TOPN_CUTOFF_KEY_SHOULD_FIT_SORT_CLAUSE );
+
+static inline bool IsFloatPart ( BYTE uType )
+{
+	return uType==SPH_KEYPART_FLOAT || uType==SPH_KEYPART_DOUBLE;
+}
+
+bool SameTopNLayout ( const TopNCutoffKey_t & a, const TopNCutoffKey_t & b )
+{
+	if ( a.m_iParts!=b.m_iParts || a.m_uAttrDesc!=b.m_uAttrDesc )
+		return false;
+
+	for ( int i = 0; i<a.m_iParts; ++i )
+		if ( a.m_dTypes[i]!=b.m_dTypes[i] )
+			return false;
+
+	return true;
+}
+
+// >0 if a goes before b in the final result, <0 if after, 0 on equal keys. Same as match comparators, minus the rowid tie-break
+int CmpTopNKeys ( const TopNCutoffKey_t & a, const TopNCutoffKey_t & b )
+{
+	assert ( SameTopNLayout ( a, b ) );
+	for ( int i = 0; i<a.m_iParts; ++i )
+	{
+		bool bGreater;
+		if ( IsFloatPart ( a.m_dTypes[i] ) )
+		{
+			if ( a.m_dFloats[i]==b.m_dFloats[i] )
+				continue;
+			bGreater = a.m_dFloats[i]>b.m_dFloats[i];
+		} else
+		{
+			if ( a.m_dInts[i]==b.m_dInts[i] )
+				continue;
+			bGreater = a.m_dInts[i]>b.m_dInts[i];
+		}
+
+		bool bDesc = ( a.m_uAttrDesc>>i ) & 1;
+		return ( bGreater==bDesc ) ? 1 : -1;
+	}
+
+	return 0;
+}
+
+void SendTopNKey ( ISphOutputBuffer & tOut, const TopNCutoffKey_t & tKey )
+{
+	tOut.SendDword ( tKey.m_uAttrDesc );
+	tOut.SendInt ( tKey.m_iParts );
+	for ( int i = 0; i<tKey.m_iParts; ++i )
+	{
+		tOut.SendByte ( tKey.m_dTypes[i] );
+		if ( IsFloatPart ( tKey.m_dTypes[i] ) )
+			tOut.SendDouble ( tKey.m_dFloats[i] );
+		else
+			tOut.SendUint64 ( tKey.m_dInts[i] );
+	}
+}
+
+bool ReadTopNKey ( InputBuffer_c & tReq, TopNCutoffKey_t & tKey )
+{
+	tKey.m_uAttrDesc = tReq.GetDword();
+	tKey.m_iParts = tReq.GetInt();
+	if ( tKey.m_iParts<=0 || tKey.m_iParts>TopNCutoffKey_t::MAX_PARTS )
+		return false;
+
+	for ( int i = 0; i<tKey.m_iParts; ++i )
+	{
+		BYTE uType = tReq.GetByte();
+		if ( uType!=SPH_KEYPART_WEIGHT && uType!=SPH_KEYPART_INT && !IsFloatPart ( uType ) )
+			return false;
+
+		tKey.m_dTypes[i] = uType;
+		tKey.m_dInts[i] = 0;
+		tKey.m_dFloats[i] = 0.0;
+		if ( IsFloatPart ( uType ) )
+			tKey.m_dFloats[i] = sphQW2D ( tReq.GetUint64() );
+		else
+			tKey.m_dInts[i] = (SphAttr_t)tReq.GetUint64();
+	}
+
+	return !tReq.GetError();
+}
+
+namespace { // static
+
+// plain top-N queries only: their final result is just the best matches of all the agents taken together
+bool IsCutoffQuery ( const CSphQuery & tQuery )
+{
+	if ( tQuery.m_eSort!=SPH_SORT_RELEVANCE && tQuery.m_eSort!=SPH_SORT_EXTENDED )
+		return false;
+
+	return tQuery.m_iLimit>0 && tQuery.m_sGroupBy.IsEmpty() && !HasImplicitGrouping ( tQuery ) && !tQuery.m_bHasOuter
+		&& !tQuery.m_bFacet && !tQuery.m_bFacetHead && tQuery.m_sKNNAttr.IsEmpty() && tQuery.m_sJoinIdx.IsEmpty();
+}
+
+// sort key layout of the query over the given schema; false if some key part can't be read from a match as is
+bool SetupCutoffState ( const CSphQuery & tQuery, const ISphSchema & tSchema, CSphMatchComparatorState & tState, int & iParts )
+{
+	if ( tQuery.m_eSort==SPH_SORT_RELEVANCE )
+	{
+		tState.m_eKeypart[0] = SPH_KEYPART_WEIGHT;
+		tState.m_uAttrDesc = 1;
+		iParts = 1;
+		return true;
+	}
+
+	ESphSortFunc eFunc = FUNC_REL_DESC;
+	CSphVector<ExtraSortExpr_t> dExtraExprs;
+	CSphString sError;
+	if ( sphParseSortClause ( tQuery, tQuery.m_sSortBy.cstr(), tSchema, eFunc, tState, dExtraExprs, false, nullptr, sError )!=SORT_CLAUSE_OK )
+		return false;
+
+	iParts = eFunc-FUNC_GENERIC1+1;
+	assert ( iParts>0 && iParts<=TopNCutoffKey_t::MAX_PARTS );
+	for ( int i = 0; i<iParts; ++i )
+	{
+		switch ( tState.m_eKeypart[i] )
+		{
+		case SPH_KEYPART_WEIGHT:
+			break;
+
+		case SPH_KEYPART_INT:
+		case SPH_KEYPART_FLOAT:
+		case SPH_KEYPART_DOUBLE:
+			if ( dExtraExprs[i].m_pExpr || tState.m_dAttrs[i]<0 || tSchema.GetAttr ( tState.m_dAttrs[i] ).IsColumnar() )
+				return false;
+			break;
+
+		default: // strings, json, rowids
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void GetKey ( const CSphMatch & tMatch, const CSphMatchComparatorState & tState, int iParts, TopNCutoffKey_t & tKey )
+{
+	tKey.m_iParts = iParts;
+	tKey.m_uAttrDesc = tState.m_uAttrDesc;
+	for ( int i = 0; i<iParts; ++i )
+	{
+		tKey.m_dTypes[i] = (BYTE)tState.m_eKeypart[i];
+		tKey.m_dInts[i] = 0;
+		tKey.m_dFloats[i] = 0.0;
+		switch ( tState.m_eKeypart[i] )
+		{
+		case SPH_KEYPART_WEIGHT:	tKey.m_dInts[i] = tMatch.m_iWeight; break;
+		case SPH_KEYPART_INT:		tKey.m_dInts[i] = tMatch.GetAttr ( tState.m_tLocator[i] ); break;
+		case SPH_KEYPART_FLOAT:		tKey.m_dFloats[i] = tMatch.GetAttrFloat ( tState.m_tLocator[i] ); break;
+		default:					tKey.m_dFloats[i] = tMatch.GetAttrDouble ( tState.m_tLocator[i] ); break;
+		}
+	}
+}
+
+// how many leading matches to keep; the tail which is strictly worse than the cutoff goes away.
+// Equal keys stay, as the final merge breaks ties itself
+int CountNotWorse ( const VecTraits_T<CSphMatch> & dMatches, const CSphMatchComparatorState & tState, int iParts, const TopNCutoffKey_t & tCutoff )
+{
+	int iKeep = dMatches.GetLength();
+	TopNCutoffKey_t tKey;
+	while ( iKeep>0 )
+	{
+		GetKey ( dMatches[iKeep-1], tState, iParts, tKey );
+		if ( !SameTopNLayout ( tKey, tCutoff ) || CmpTopNKeys ( tKey, tCutoff )>=0 )
+			break;
+
+		--iKeep;
+	}
+
+	return iKeep;
+}
+
+class TopNCutoffBuilder_c : public RequestBuilder_i
+{
+public:
+	TopNCutoffBuilder_c ( uint64_t uToken, const TopNCutoffKey_t & tKey )
+		: m_uToken ( uToken )
+		, m_tKey ( tKey )
+	{}
+
+	void BuildRequest ( const AgentConn_t &, ISphOutputBuffer & tOut ) const final
+	{
+		auto tHdr = APIHeader ( tOut, SEARCHD_COMMAND_TOPNCUTOFF, VER_COMMAND_TOPNCUTOFF );
+		tOut.SendUint64 ( m_uToken );
+		SendTopNKey ( tOut, m_tKey );
+	}
+
+private:
+	const uint64_t			m_uToken;
+	const TopNCutoffKey_t &	m_tKey;
+};
+
+/// cutoffs of the queries this daemon runs as an agent right now, by master-assigned token.
+/// Several local queries may share a token (several shards of one distributed query served by this host)
+class TopNCutoffs_c
+{
+	struct Slot_t
+	{
+		int				m_iListeners = 0;
+		TopNCutoffKey_t	m_tKey;
+	};
+
+	CSphMutex m_tLock;
+	CSphOrderedHash<Slot_t, uint64_t, IdentityHash_fn, 256> m_hSlots GUARDED_BY ( m_tLock );
+
+public:
+	void Listen ( uint64_t uToken ) EXCLUDES ( m_tLock )
+	{
+		ScopedMutex_t tLock ( m_tLock );
+		++m_hSlots.AddUnique ( uToken ).m_iListeners;
+	}
+
+	void Forget ( uint64_t uToken ) EXCLUDES ( m_tLock )
+	{
+		ScopedMutex_t tLock ( m_tLock );
+		Slot_t * pSlot = m_hSlots ( uToken );
+		if ( pSlot && !--pSlot->m_iListeners )
+			m_hSlots.Delete ( uToken );
+	}
+
+	// keys may come out of order (every one goes on its own connection), so keep the tightest one
+	bool Store ( uint64_t uToken, const TopNCutoffKey_t & tKey ) EXCLUDES ( m_tLock )
+	{
+		ScopedMutex_t tLock ( m_tLock );
+		Slot_t * pSlot = m_hSlots ( uToken );
+		if ( !pSlot )
+			return false;
+
+		TopNCutoffKey_t & tStored = pSlot->m_tKey;
+		if ( !tStored.m_iParts || !SameTopNLayout ( tKey, tStored ) || CmpTopNKeys ( tKey, tStored )>0 )
+			tStored = tKey;
+
+		return true;
+	}
+
+	bool Get ( uint64_t uToken, TopNCutoffKey_t & tKey ) EXCLUDES ( m_tLock )
+	{
+		ScopedMutex_t tLock ( m_tLock );
+		const Slot_t * pSlot = m_hSlots ( uToken );
+		if ( !pSlot || !pSlot->m_tKey.m_iParts )
+			return false;
+
+		tKey = pSlot->m_tKey;
+		return true;
+	}
+};
+
+TopNCutoffs_c g_tTopNCutoffs;
+
+} // static namespace
+
+/////////////////////////////////////////////////////////////////////////////
+// master side
+/////////////////////////////////////////////////////////////////////////////
+
+RemoteTopN_c::RemoteTopN_c ( const CSphQuery & tQuery, bool bEnabled, bool bFold, bool bPushdown )
+	: m_tQuery ( tQuery )
+	, m_bFold ( bFold )
+{
+	if ( !bEnabled || !( bFold || bPushdown ) || !IsCutoffQuery ( tQuery ) )
+		return;
+
+	m_iMaxMatches = tQuery.m_iMaxMatches;
+	m_iTopN = Min ( tQuery.m_iOffset+tQuery.m_iLimit, m_iMaxMatches );
+	if ( m_iTopN<=0 )
+		return;
+
+	while ( bPushdown && !m_uToken )
+		m_uToken = ( (uint64_t)sphRand()<<32 ) | sphRand();
+
+	m_bActive = true;
+}
+
+
+void RemoteTopN_c::AddResult ( AggrResult_t & tRes, int iResult )
+{
+	if ( !m_bActive )
+		return;
+
+	OneResultset_t & tChunk = tRes.m_dResults[iResult];
+	if ( tChunk.m_dMatches.IsEmpty() )
+		return;
+
+	// the running result has one schema for all its matches; a reply of another layout stays on its own
+	if ( m_bFold && m_iRunning>=0 )
+	{
+		CSphString sError;
+		if ( !tRes.m_dResults[m_iRunning].m_tSchema.CompareTo ( tChunk.m_tSchema, sError, false ) )
+			return;
+	}
+
+	m_bActive = Merge ( tRes, iResult );
+}
+
+
+// the final merge leaves one copy of every document (see KillPlainDupes), the one from the result of the highest tag,
+// and keeps max_matches best of them. Whatever is worse than the max_matches-th best document can't get there, so
+// it is dropped right away. Copies of a document must sort alike: otherwise the order depends on which copy survives
+bool RemoteTopN_c::Merge ( AggrResult_t & tRes, int iResult )
+{
+	OneResultset_t & tChunk = tRes.m_dResults[iResult];
+	if ( !tChunk.m_tSchema.GetAttr ( sphGetDocidName() ) )
+		return false;
+
+	CSphMatchComparatorState tState;
+	int iParts = 0;
+	if ( !SetupCutoffState ( m_tQuery, tChunk.m_tSchema, tState, iParts ) )
+		return false;
+
+	// the running set and the reply, one copy of a document each; never more than max_matches plus ties and one reply
+	int iCandidates = m_dTop.GetLength()+tChunk.m_dMatches.GetLength();
+	CSphVector<Entry_t> dAll;
+	dAll.Reserve ( iCandidates );
+	OpenHashTable_T<DocID_t, int> hDocs ( iCandidates );
+	for ( const Entry_t & tEntry : m_dTop )
+	{
+		hDocs.Add ( tEntry.m_tDocID, dAll.GetLength() );
+		dAll.Add ( tEntry );
+	}
+
+	int iDupes = 0;
+	ARRAY_CONSTFOREACH ( i, tChunk.m_dMatches )
+	{
+		Entry_t tNew;
+		GetKey ( tChunk.m_dMatches[i], tState, iParts, tNew.m_tKey );
+		tNew.m_tDocID = sphGetDocID ( tChunk.m_dMatches[i].m_pDynamic );
+		tNew.m_iTag = tChunk.m_iTag;
+		tNew.m_iMatch = i;
+		tNew.m_bNew = true;
+
+		// every agent has its own schema; make sure the keys are still comparable
+		if ( !dAll.IsEmpty() && !SameTopNLayout ( dAll.First().m_tKey, tNew.m_tKey ) )
+			return false;
+
+		int * pOld = hDocs.Find ( tNew.m_tDocID );
+		if ( !pOld )
+		{
+			hDocs.Add ( tNew.m_tDocID, dAll.GetLength() );
+			dAll.Add ( tNew );
+			continue;
+		}
+
+		Entry_t & tOld = dAll[*pOld];
+		if ( CmpTopNKeys ( tOld.m_tKey, tNew.m_tKey )!=0 )
+			return false;
+
+		++iDupes;
+		if ( tNew.m_iTag>tOld.m_iTag )
+			tOld = tNew;
+	}
+
+	dAll.Sort ( Lesser ( [] ( const Entry_t & a, const Entry_t & b ) { return CmpTopNKeys ( a.m_tKey, b.m_tKey )>0; } ) );
+
+	// equal keys stay, as the final merge breaks ties itself
+	if ( dAll.GetLength()>m_iMaxMatches )
+	{
+		int iKeep = m_iMaxMatches;
+		while ( iKeep<dAll.GetLength() && !CmpTopNKeys ( dAll[iKeep].m_tKey, dAll[m_iMaxMatches-1].m_tKey ) )
+			++iKeep;
+
+		dAll.Resize ( iKeep );
+	}
+
+	if ( m_bFold )
+	{
+		Fold ( tRes, iResult, dAll );
+
+		// the final merge subtracts the dupes it sees from total; these ones it won't see
+		tRes.m_iTotalMatches -= iDupes;
+	}
+
+	m_dTop.SwapData ( dAll );
+	return true;
+}
+
+
+// the kept matches move to the running result, each with the tag of the result it came from, as the global sorter
+// does with local ones. The emptied results stay in place, to link the tags back to their agents
+void RemoteTopN_c::Fold ( AggrResult_t & tRes, int iResult, VecTraits_T<Entry_t> & dKeep )
+{
+	if ( m_iRunning<0 )
+	{
+		m_iRunning = iResult;
+		tRes.m_dResults[m_iRunning].m_bTagsAssigned = true;
+	}
+
+	OneResultset_t & tRunning = tRes.m_dResults[m_iRunning];
+	OneResultset_t & tChunk = tRes.m_dResults[iResult];
+
+	CSphSwapVector<CSphMatch> dFolded;
+	dFolded.Reserve ( dKeep.GetLength() );
+	for ( Entry_t & tEntry : dKeep )
+	{
+		CSphMatch & tMatch = dFolded.Add();
+		Swap ( tMatch, ( tEntry.m_bNew ? tChunk : tRunning ).m_dMatches[tEntry.m_iMatch] );
+		tMatch.m_iTag = tEntry.m_iTag;
+		tEntry.m_iMatch = dFolded.GetLength()-1;
+		tEntry.m_bNew = false;
+	}
+
+	// what is left is either worse than the cutoff or a dupe
+	tRunning.ClampAllMatches();
+	if ( iResult!=m_iRunning )
+		tChunk.ClampAllMatches();
+
+	tRunning.m_dMatches.SwapData ( dFolded );
+}
+
+
+void RemoteTopN_c::Publish ( const VecTraits_T<AgentConn_t *> & dAgents )
+{
+	if ( !m_uToken || !m_bActive || m_dTop.GetLength()<m_iTopN || dAgents.IsEmpty() )
+		return;
+
+	// agents look the cutoff up by the token, so every host needs it once, whatever mirror or table it serves.
+	// Mirrors are not known for sure while the retries go on, so all of them get it. A host gets the cutoff only
+	// once per query, even though it may tighten later: that keeps the traffic linear in the number of hosts
+	VecRefPtrsAgentConn_t dCutoffs;
+	for ( const AgentConn_t * pAgent : dAgents )
+	{
+		const MultiAgentDesc_c * pMirrors = pAgent->GetMultiAgent();
+		if ( !pMirrors )
+			continue;
+
+		for ( const AgentDesc_t & tMirror : *pMirrors )
+		{
+			if ( tMirror.m_bBlackhole || m_dNotified.Contains ( tMirror.m_pDash.Ptr() ) )
+				continue;
+
+			m_dNotified.Add ( tMirror.m_pDash.Ptr() );
+
+			// fire and forget, as to a blackhole; the cutoff is only a hint, and an agent which is done ignores it.
+			// Persistent hosts take a free pooled connection if there is one, and get it back once the answer is read
+			auto * pConn = new AgentConn_t;
+			pConn->m_tDesc.CloneFrom ( tMirror );
+			pConn->m_tDesc.m_bBlackhole = true;
+			pConn->m_tDesc.m_pMetrics = nullptr;
+			pConn->m_iMyConnectTimeoutMs = pAgent->m_iMyConnectTimeoutMs;
+			pConn->m_iMyQueryTimeoutMs = pAgent->m_iMyQueryTimeoutMs;
+			dCutoffs.Add ( pConn );
+		}
+	}
+
+	if ( dCutoffs.IsEmpty() )
+		return;
+
+	m_tPublished = m_dTop[m_iTopN-1].m_tKey;
+
+	// blackholes build their request right away, so the builder may live on stack
+	TopNCutoffBuilder_c tBuilder ( m_uToken, m_tPublished );
+	CSphRefcountedPtr<RemoteAgentsObserver_i> tReporter { GetObserver() };
+	ScheduleDistrJobs ( dCutoffs, &tBuilder, nullptr, tReporter, 0, 0 );
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// agent side
+/////////////////////////////////////////////////////////////////////////////
+
+TopNCutoffListener_c::~TopNCutoffListener_c()
+{
+	if ( m_uToken )
+		g_tTopNCutoffs.Forget ( m_uToken );
+}
+
+
+void TopNCutoffListener_c::Listen ( uint64_t uToken )
+{
+	assert ( !m_uToken );
+	if ( !uToken )
+		return;
+
+	m_uToken = uToken;
+	g_tTopNCutoffs.Listen ( uToken );
+}
+
+
+// don't send the matches which are strictly worse than the cutoff
+void TopNCutoffListener_c::Apply ( AggrResult_t & tRes, const CSphQuery & tQuery ) const
+{
+	if ( !m_uToken || !tRes.m_sError.IsEmpty() || tRes.m_iCount<=0 || !IsCutoffQuery ( tQuery ) )
+		return;
+
+	TopNCutoffKey_t tCutoff;
+	if ( !g_tTopNCutoffs.Get ( m_uToken, tCutoff ) )
+		return;
+
+	CSphMatchComparatorState tState;
+	int iParts = 0;
+	if ( !SetupCutoffState ( tQuery, tRes.m_tSchema, tState, iParts ) )
+		return;
+
+	auto dMatches = tRes.m_dResults.First().m_dMatches.Slice ( tRes.m_iOffset, tRes.m_iCount );
+	tRes.m_iCount = CountNotWorse ( dMatches, tState, iParts, tCutoff );
+}
+
+
+void HandleCommandTopNCutoff ( ISphOutputBuffer & tOut, WORD uVer, InputBuffer_c & tReq )
+{
+	if ( !CheckCommandVersion ( uVer, VER_COMMAND_TOPNCUTOFF, tOut ) )
+		return;
+
+	uint64_t uToken = tReq.GetUint64();
+	TopNCutoffKey_t tKey;
+	if ( !ReadTopNKey ( tReq, tKey ) )
+	{
+		SendErrorReply ( tOut, "invalid or truncated request" );
+		return;
+	}
+
+	// the query might be already over, or not started yet; that's fine, cutoff is just a hint
+	bool bKnown = g_tTopNCutoffs.Store ( uToken, tKey );
+
+	auto tReply = APIAnswer ( tOut, VER_COMMAND_TOPNCUTOFF );
+	tOut.SendInt ( bKnown ? 1 : 0 );
+}
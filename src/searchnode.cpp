@@ -47,6 +47,16 @@ int g_iPredictorCostMatch	= 64;
 
 static const float COST_SCALE = 1.0f/1000000.0f;
 
+/// upper bound of a term tf-idf given the max hits per doc
+/// terms with negative idf lower the weight of their docs, so we never bound (and never skip) them
+static FORCE_INLINE float TermMaxTFIDF ( DWORD uMaxHits, float fIDF )
+{
+	if ( fIDF<0.0f )
+		return FLT_MAX;
+
+	return float(uMaxHits) / float(uMaxHits+SPH_BM25_K1) * fIDF;
+}
+
 static volatile bool g_bInterruptNow = false;
 
 
@@ -193,6 +203,7 @@ public:
 	bool				GotHitless() override { return false; }
 	NodeEstimate_t		Estimate ( int64_t iTotalDocs ) const override { return { 0.0f, 0, 0 }; }
 	void				SetRowidBoundaries ( const RowIdBoundaries_t & tBoundaries ) override {}	// no need for filtering as iterators should output already filtered rowids
+	float				GetMaxTFIDF() const override { return 0.0f; }
 
 protected:
 	RowidIterator_i *	m_pIterator = nullptr;	// not owned by the node
@@ -257,6 +268,8 @@ public:
 	void				SetCollectHits() override { m_bCollectHits = true; }
 	NodeEstimate_t		Estimate ( int64_t iTotalDocs ) const override { return { float(m_pQword->m_iDocs)*COST_SCALE*60.0f, m_pQword->m_iDocs, 1 }; }
 	void				SetRowidBoundaries ( const RowIdBoundaries_t & tBoundaries ) override;
+	float				GetMaxTFIDF() const override;
+	void				SetMinTFIDF ( float fMinTFIDF ) override;
 
 	void				DebugDump ( int iLevel ) override;
 
@@ -277,6 +290,8 @@ protected:
 	int64_t *			m_pNanoBudget = nullptr;
 	bool				m_bCollectHits = false;
 	RowIdBoundaries_t	m_tBoundaries;
+	float				m_fMinTFIDF = -FLT_MAX;		///< docs below this can't make it to the results
+	RowID_t				m_tNextBlock = 0;			///< first rowid of the next skiplist block
 
 	CSphVector<StoredHit_t> m_dStoredHits;
 };
@@ -440,6 +455,8 @@ public:
 	void				CollectHits ( const ExtDoc_t * pDocs ) override;
 	NodeEstimate_t		Estimate ( int64_t iTotalDocs ) const override;
 	int					GetDocsCount() const override { return m_bEmpty ? 0 : ExtTwofer_c::GetDocsCount(); }
+	float				GetMaxTFIDF() const override { return m_pLeft->GetMaxTFIDF() + m_pRight->GetMaxTFIDF(); }
+	void				SetMinTFIDF ( float fMinTFIDF ) override;
 	void				DebugDump ( int iLevel ) override;
 
 private:
@@ -488,6 +505,8 @@ public:
 	void				DebugDump ( int iLevel ) override;
 	NodeEstimate_t		Estimate ( int64_t iTotalDocs ) const override;
 	void				SetRowidBoundaries ( const RowIdBoundaries_t & tBoundaries ) override { m_tBoundaries = tBoundaries; }
+	float				GetMaxTFIDF() const override;
+	void				SetMinTFIDF ( float fMinTFIDF ) override;
 
 private:
 	struct NodeInfo_t
@@ -548,6 +567,7 @@ private:
 	CSphVector<StoredMultiHit_t>	m_dStoredHits;
 	int								m_iNodesSet {0};
 	RowIdBoundaries_t				m_tBoundaries;
+	float							m_fMinTFIDF {-FLT_MAX};
 
 	CSphString *					m_pWarning {nullptr};
 	CSphQueryStats *				m_pStats {nullptr};
@@ -617,6 +637,11 @@ public:
 	void				CollectHits ( const ExtDoc_t * pDocs ) override;
 	void				DebugDump ( int iLevel ) override;
 	NodeEstimate_t		Estimate ( int64_t iTotalDocs ) const override;
+	float				GetMaxTFIDF() const override { return m_pLeft->GetMaxTFIDF() + m_pRight->GetMaxTFIDF(); }
+	void				SetMinTFIDF ( float fMinTFIDF ) override;
+
+protected:
+	float				m_fMinTFIDF = -FLT_MAX;
 };
 
 
@@ -642,6 +667,8 @@ public:
 	void				Reset ( const ISphQwordSetup & tSetup ) override;
 	void				SetCollectHits() override;
 	void				DebugDump ( int iLevel ) override;
+	float				GetMaxTFIDF() const override { return m_pLeft->GetMaxTFIDF(); }
+	void				SetMinTFIDF ( float fMinTFIDF ) override { m_pLeft->SetMinTFIDF(fMinTFIDF); } // rejected docs must never be skipped
 
 protected:
 	bool				m_bPassthrough {false};
@@ -2105,6 +2132,7 @@ void ExtTerm_T<USE_BM25,ROWID_LIMITS,STATS>::Reset ( const ISphQwordSetup & tSet
 	m_pQword->Reset ();
 	tSetup.QwordSetup ( m_pQword );
 	m_dStoredHits.Resize(0);
+	m_tNextBlock = 0;
 }
 
 template<bool USE_BM25, bool ROWID_LIMITS, bool STATS>
@@ -2183,6 +2211,27 @@ const ExtDoc_t * ExtTerm_T<USE_BM25,ROWID_LIMITS,STATS>::GetDocsChunk()
 			break;
 		}
 
+		// weight pruning; skip the whole skiplist block if none of its docs can make it
+		if constexpr ( USE_BM25 )
+		{
+			if ( m_fMinTFIDF>-FLT_MAX && tMatch.m_tRowID>=m_tNextBlock )
+			{
+				float fBlockMaxTFIDF = TermMaxTFIDF ( m_pQword->GetBlockMaxHits ( tMatch.m_tRowID, m_tNextBlock ), m_fIDF );
+				if ( fBlockMaxTFIDF<m_fMinTFIDF )
+				{
+					// no next block means the bound holds for all the remaining docs
+					if ( m_tNextBlock==INVALID_ROWID )
+					{
+						m_pQword->m_iDocs = 0;
+						break;
+					}
+
+					HintRowID ( m_tNextBlock );
+					continue;
+				}
+			}
+		}
+
 		if ( !m_bHasWideFields )
 		{
 			// fields 0-31 can be quickly checked right here, right now
@@ -2199,12 +2248,20 @@ const ExtDoc_t * ExtTerm_T<USE_BM25,ROWID_LIMITS,STATS>::GetDocsChunk()
 				continue;
 		}
 
+		float fTFIDF = 0.0f;
+		if constexpr ( USE_BM25 )
+		{
+			fTFIDF = float(m_pQword->m_uMatchHits) / float(m_pQword->m_uMatchHits+SPH_BM25_K1) * m_fIDF;
+			if ( fTFIDF<m_fMinTFIDF )
+				continue;
+		}
+
 		ExtDoc_t & tDoc = m_dDocs[iDoc++];
 		tDoc.m_tRowID = tMatch.m_tRowID;
 		tDoc.m_uDocFields = m_pQword->m_dQwordFields.GetMask32() & m_dQueriedFields.GetMask32(); // OPTIMIZE: only needed for phrase node
 
 		if_const ( USE_BM25 )
-			tDoc.m_fTFIDF = float(m_pQword->m_uMatchHits) / float(m_pQword->m_uMatchHits+SPH_BM25_K1) * m_fIDF;
+			tDoc.m_fTFIDF = fTFIDF;
 
 		// store some hit info here, we can't reuse m_dDocs in CollectHits
 		// but only if the ranker uses hits
@@ -2372,6 +2429,24 @@ void ExtTerm_T<USE_BM25,ROWID_LIMITS,STATS>::SetRowidBoundaries ( const RowIdBou
 	HintRowID ( tBoundaries.m_tMinRowID );
 }
 
+template<bool USE_BM25, bool ROWID_LIMITS, bool STATS>
+float ExtTerm_T<USE_BM25,ROWID_LIMITS,STATS>::GetMaxTFIDF() const
+{
+	if constexpr ( USE_BM25 )
+		return TermMaxTFIDF ( m_pQword->GetMaxHits(), m_fIDF );
+	else
+		return FLT_MAX;
+}
+
+template<bool USE_BM25, bool ROWID_LIMITS, bool STATS>
+void ExtTerm_T<USE_BM25,ROWID_LIMITS,STATS>::SetMinTFIDF ( float fMinTFIDF )
+{
+	if ( !USE_BM25 || m_fIDF<0.0f )
+		return;
+
+	m_fMinTFIDF = Max ( m_fMinTFIDF, fMinTFIDF );
+}
+
 template<bool USE_BM25, bool ROWID_LIMITS, bool STATS>
 void ExtTerm_T<USE_BM25,ROWID_LIMITS,STATS>::DebugDump ( int iLevel )
 {
@@ -2910,6 +2985,14 @@ const ExtDoc_t * ExtAnd_c::GetDocsChunk()
 }
 
 
+void ExtAnd_c::SetMinTFIDF ( float fMinTFIDF )
+{
+	// a doc should score at least that much on one side to make it with the best possible score on the other side
+	m_pLeft->SetMinTFIDF ( fMinTFIDF - m_pRight->GetMaxTFIDF() );
+	m_pRight->SetMinTFIDF ( fMinTFIDF - m_pLeft->GetMaxTFIDF() );
+}
+
+
 static inline bool IsHitLess ( const ExtHit_t * pHit1, const ExtHit_t * pHit2 )
 {
 	assert ( pHit1 && pHit2 );
@@ -3132,6 +3215,30 @@ float ExtMultiAnd_T<USE_BM25,TEST_FIELDS,ROWID_LIMITS>::GetTFIDF() const
 }
 
 
+template <bool USE_BM25,bool TEST_FIELDS,bool ROWID_LIMITS>
+float ExtMultiAnd_T<USE_BM25,TEST_FIELDS,ROWID_LIMITS>::GetMaxTFIDF() const
+{
+	if constexpr ( !USE_BM25 )
+		return FLT_MAX;
+
+	float fMaxTFIDF = 0.0f;
+	for ( const auto & i : m_dNodes )
+		fMaxTFIDF += TermMaxTFIDF ( i.m_pQword->GetMaxHits(), i.m_fIDF );
+
+	return fMaxTFIDF;
+}
+
+
+template <bool USE_BM25,bool TEST_FIELDS,bool ROWID_LIMITS>
+void ExtMultiAnd_T<USE_BM25,TEST_FIELDS,ROWID_LIMITS>::SetMinTFIDF ( float fMinTFIDF )
+{
+	if ( !USE_BM25 || m_dNodes.any_of ( []( const auto & i ){ return i.m_fIDF<0.0f; } ) )
+		return;
+
+	m_fMinTFIDF = Max ( m_fMinTFIDF, fMinTFIDF );
+}
+
+
 template <bool USE_BM25,bool TEST_FIELDS,bool ROWID_LIMITS>
 RowID_t ExtMultiAnd_T<USE_BM25,TEST_FIELDS,ROWID_LIMITS>::Advance ( int iNode )
 {
@@ -3279,11 +3386,17 @@ const ExtDoc_t * ExtMultiAnd_T<USE_BM25,TEST_FIELDS,ROWID_LIMITS>::GetDocsChunk(
 		}
 
 		RowID_t tMatchedRowID = m_dNodes[0].m_tRowID;
+		float fTFIDF = GetTFIDF();
+		if ( fTFIDF<m_fMinTFIDF )
+		{
+			Advance(0);
+			continue;
+		}
 
 		ExtDoc_t & tDoc = m_dDocs[iDoc++];
 		tDoc.m_tRowID = tMatchedRowID;
 		tDoc.m_uDocFields = GetDocFieldsMask();
-		tDoc.m_fTFIDF = GetTFIDF();
+		tDoc.m_fTFIDF = fTFIDF;
 
 		if ( m_bCollectHits )
 		{
@@ -3811,6 +3924,14 @@ ExtOr_c::ExtOr_c ( ExtNode_i * pLeft, ExtNode_i * pRight )
 	: ExtTwofer_c ( pLeft, pRight )
 {}
 
+void ExtOr_c::SetMinTFIDF ( float fMinTFIDF )
+{
+	m_fMinTFIDF = Max ( m_fMinTFIDF, fMinTFIDF );
+	m_pLeft->SetMinTFIDF ( fMinTFIDF - m_pRight->GetMaxTFIDF() );
+	m_pRight->SetMinTFIDF ( fMinTFIDF - m_pLeft->GetMaxTFIDF() );
+}
+
+
 const ExtDoc_t * ExtOr_c::GetDocsChunk()
 {
 	int iDoc = 0;
@@ -3818,10 +3939,27 @@ const ExtDoc_t * ExtOr_c::GetDocsChunk()
 	const ExtDoc_t * pDocL = m_pDocL;
 	const ExtDoc_t * pDocR = m_pDocR;
 
+	// weight pruning; docs that only match a side whose best score is below the threshold can't make it
+	bool bSkipLeftOnly = false;
+	bool bSkipRightOnly = false;
+	if ( m_fMinTFIDF>-FLT_MAX )
+	{
+		float fMaxL = m_pLeft->GetMaxTFIDF();
+		float fMaxR = m_pRight->GetMaxTFIDF();
+		if ( fMaxL+fMaxR<m_fMinTFIDF )
+			return ReturnDocsChunk ( 0, "or" );
+
+		bSkipLeftOnly = fMaxL<m_fMinTFIDF;
+		bSkipRightOnly = fMaxR<m_fMinTFIDF;
+	}
+
 	while ( iDoc<MAX_BLOCK_DOCS-1 )
 	{
 		if ( !HasDocs(pDocL) )
 		{
+			if ( bSkipLeftOnly && HasDocs(pDocR) )
+				m_pLeft->HintRowID ( pDocR->m_tRowID );
+
 			pDocL = m_pLeft->GetDocsChunk();
 			if ( !pDocL && TimeExceeded() )
 				break;
@@ -3829,6 +3967,9 @@ const ExtDoc_t * ExtOr_c::GetDocsChunk()
 
 		if ( !HasDocs(pDocR) )
 		{
+			if ( bSkipRightOnly && HasDocs(pDocL) )
+				m_pRight->HintRowID ( pDocL->m_tRowID );
+
 			pDocR = m_pRight->GetDocsChunk();
 			if ( !pDocR && TimeExceeded() )
 				break;
@@ -3837,6 +3978,10 @@ const ExtDoc_t * ExtOr_c::GetDocsChunk()
 		if ( !HasDocs(pDocL) && !HasDocs(pDocR) )
 			break;
 
+		// one side is over, and the tail of the other one can't make it
+		if ( ( bSkipLeftOnly && !HasDocs(pDocR) ) || ( bSkipRightOnly && !HasDocs(pDocL) ) )
+			break;
+
 		ExtDoc_t & tNewDoc = m_dDocs[iDoc];
 
 		// merge lists while we can, copy tail while if we can not
@@ -3851,9 +3996,23 @@ const ExtDoc_t * ExtOr_c::GetDocsChunk()
 				pDocR++;
 			}
 			else if ( pDocL->m_tRowID<pDocR->m_tRowID )
+			{
+				if ( bSkipLeftOnly )
+				{
+					pDocL++;
+					continue;
+				}
 				tNewDoc = *pDocL++;
+			}
 			else
+			{
+				if ( bSkipRightOnly )
+				{
+					pDocR++;
+					continue;
+				}
 				tNewDoc = *pDocR++;
+			}
 		}
 		else if ( HasDocs(pDocL) )
 			tNewDoc = *pDocL++;
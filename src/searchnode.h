@@ -88,6 +88,8 @@ public:
 	virtual void				SetCollectHits() {}				// call this if ranker needs hits
 	virtual NodeEstimate_t		Estimate ( int64_t iTotalDocs ) const = 0;
 	virtual void				SetRowidBoundaries ( const RowIdBoundaries_t & tBoundaries ) = 0;
+	virtual float				GetMaxTFIDF() const { return FLT_MAX; }	///< upper bound of m_fTFIDF over the docs that are yet to be returned
+	virtual void				SetMinTFIDF ( float fMinTFIDF ) {}			///< docs with a lesser m_fTFIDF can't make it to the results, and might be skipped
 
 	virtual void				DebugDump ( int iLevel ) = 0;
 	virtual bool				TimeExceeded() const = 0;
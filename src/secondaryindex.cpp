@@ -1058,6 +1058,25 @@ CSphVector<SecondaryIndexInfo_t> SelectIterators ( const SelectIteratorCtx_t & t
 }
 
 
+int64_t EstimateFilteredDocs ( const SelectIteratorCtx_t & tCtx )
+{
+	// same limitations as with iterators: no estimates without histograms or with OR between filters
+	if ( !tCtx.m_pHistograms || !tCtx.m_tQuery.m_dFilterTree.IsEmpty() || !tCtx.m_iTotalDocs )
+		return tCtx.m_iTotalDocs;
+
+	CSphVector<SecondaryIndexInfo_t> dSIInfo ( tCtx.m_dFilters.GetLength() );
+	FetchHistogramInfo ( dSIInfo, tCtx );
+
+	// assume that filters are independent
+	double fSelectivity = 1.0;
+	for ( const auto & i : dSIInfo )
+		if ( i.m_bHasHistograms && i.m_bUsable )
+			fSelectivity *= Min ( double(i.m_iRsetEstimate) / tCtx.m_iTotalDocs, 1.0 );
+
+	return int64_t ( fSelectivity*tCtx.m_iTotalDocs );
+}
+
+
 const CSphFilterSettings * GetRowIdFilter ( const CSphVector<CSphFilterSettings> & dFilters, RowID_t uTotalDocs, RowIdBoundaries_t & tRowidBounds )
 {
 	const CSphFilterSettings * pRowIdFilter = nullptr;
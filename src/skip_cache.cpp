@@ -15,7 +15,12 @@
 #include "std/ints.h"
 #include "std/crc32.h"
 #include "std/lrucache.h"
+#include "std/freqsketch.h"
 #include "sphinxsearch.h"
+#include "fileio.h"
+#include "fileutils.h"
+
+#include <atomic>
 
 
 bool operator== ( const SkipCacheKey_t& lhs, const SkipCacheKey_t& rhs ) noexcept
@@ -23,6 +28,16 @@ bool operator== ( const SkipCacheKey_t& lhs, const SkipCacheKey_t& rhs ) noexcep
 	return lhs.m_iIndexId == rhs.m_iIndexId && lhs.m_tWordId == rhs.m_tWordId;
 }
 
+/// cached skiplist, and what we need to find it again after restart
+struct SkipCacheEntry_t
+{
+	SkipData_t *	m_pData = nullptr;
+	CSphString		m_sIndex;
+	CSphString		m_sWord;
+
+	~SkipCacheEntry_t() { SafeDelete ( m_pData ); }
+};
+
 struct SkipCacheUtil_t
 {
 	static DWORD GetHash ( SkipCacheKey_t tKey )
@@ -31,44 +46,277 @@ struct SkipCacheUtil_t
 		return sphCRC32 ( &tKey.m_tWordId, sizeof ( tKey.m_tWordId ), uCRC32 );
 	}
 
-	static DWORD GetSize ( SkipData_t* pValue ) { return pValue ? pValue->m_dSkiplist.GetLengthBytes() : 0; }
-	static void Reset ( SkipData_t*& pValue ) { SafeDelete ( pValue ); }
+	static DWORD GetSize ( SkipCacheEntry_t * pValue ) { return pValue && pValue->m_pData ? pValue->m_pData->m_dSkiplist.GetLengthBytes() : 0; }
+	static void Reset ( SkipCacheEntry_t * & pValue ) { SafeDelete ( pValue ); }
 };
 
+//////////////////////////////////////////////////////////////////////////
 
-class SkipCache_c: public LRUCache_T<SkipCacheKey_t, SkipData_t*, SkipCacheUtil_t>
+class SkipCache_c: public ShardedLRUCache_T<SkipCacheKey_t, SkipCacheEntry_t*, SkipCacheUtil_t>
 {
-	using BASE = LRUCache_T<SkipCacheKey_t, SkipData_t*, SkipCacheUtil_t>;
-	using BASE::BASE;
+	using BASE = ShardedLRUCache_T<SkipCacheKey_t, SkipCacheEntry_t*, SkipCacheUtil_t>;
 
 public:
-	void DeleteAll ( int64_t iIndexId )
-	{
-		BASE::Delete ( [iIndexId] ( const SkipCacheKey_t& tKey ) { return tKey.m_iIndexId == iIndexId; } );
-	}
+				SkipCache_c ( int64_t iCacheSize, const char * szHotlist );
 
-	static void Init ( int64_t iCacheSize );
+	bool		Find ( SkipCacheKey_t tKey, SkipData_t * & pData );
+	bool		Add ( SkipCacheKey_t tKey, SkipData_t * pData, const char * szIndex, const CSphString & sWord );
+	void		DeleteAll ( int64_t iIndexId );
+	void		GetHotWords ( const char * szIndex, int64_t iIndexId, CSphVector<SkipCacheHotWord_t> & dWords );
+	void		SaveHotlist();
+	SkipCacheStats_t GetStats();
+
+	static void Init ( int64_t iCacheSize, const char * szHotlist );
 	static void Done() { SafeDelete ( m_pSkipCache ); }
 	static SkipCache_c* Get() { return m_pSkipCache; }
 
 private:
 	static SkipCache_c* m_pSkipCache;
+
+	static constexpr DWORD HOTLIST_MAGIC = 0x544F4853;	// 'SHOT'
+	static constexpr DWORD HOTLIST_VERSION = 1;
+
+	FrequencySketch_c	m_tSketch;
+
+	std::atomic<int64_t> m_iHits {0};
+	std::atomic<int64_t> m_iMisses {0};
+	std::atomic<int64_t> m_iRejected {0};
+
+	CSphString			m_sHotlist;
+	CSphMutex			m_tHotlistLock;
+	SmallStringHash_T<CSphVector<SkipCacheHotWord_t>> m_hSavedHotWords GUARDED_BY ( m_tHotlistLock );	///< loaded on startup, handed out to indexes as they load
+
+	bool		Admit ( SkipCacheKey_t tKey, DWORD uSize );
+	void		LoadHotlist();
 };
 
 SkipCache_c* SkipCache_c::m_pSkipCache = nullptr;
 
 
-void SkipCache_c::Init ( int64_t iCacheSize )
+SkipCache_c::SkipCache_c ( int64_t iCacheSize, const char * szHotlist )
+	: BASE ( iCacheSize )
+	, m_tSketch ( iCacheSize/1024 )	// skiplists are cached from 256 entries, so that's several counters per entry
+	, m_sHotlist ( szHotlist )
+{
+	LoadHotlist();
+}
+
+
+bool SkipCache_c::Find ( SkipCacheKey_t tKey, SkipData_t * & pData )
+{
+	m_tSketch.Increment ( SkipCacheUtil_t::GetHash(tKey) );
+
+	SkipCacheEntry_t * pEntry = nullptr;
+	if ( !BASE::Find ( tKey, pEntry ) )
+	{
+		m_iMisses.fetch_add ( 1, std::memory_order_relaxed );
+		return false;
+	}
+
+	m_iHits.fetch_add ( 1, std::memory_order_relaxed );
+	pData = pEntry->m_pData;
+	return true;
+}
+
+// TinyLFU admission: when the cache is full, a new skiplist gets in only if its term is more frequent than the one it would push out
+bool SkipCache_c::Admit ( SkipCacheKey_t tKey, DWORD uSize )
+{
+	// fits, or nothing to push out anyway; let the cache decide
+	SkipCacheKey_t tVictim;
+	if ( !BASE::GetVictim ( tKey, uSize, tVictim ) )
+		return true;
+
+	return m_tSketch.Estimate ( SkipCacheUtil_t::GetHash(tKey) ) > m_tSketch.Estimate ( SkipCacheUtil_t::GetHash(tVictim) );
+}
+
+
+bool SkipCache_c::Add ( SkipCacheKey_t tKey, SkipData_t * pData, const char * szIndex, const CSphString & sWord )
+{
+	assert ( pData );
+	if ( !Admit ( tKey, pData->m_dSkiplist.GetLengthBytes() ) )
+	{
+		m_iRejected.fetch_add ( 1, std::memory_order_relaxed );
+		return false;
+	}
+
+	auto * pEntry = new SkipCacheEntry_t { pData, szIndex, sWord };
+	if ( BASE::Add ( tKey, pEntry ) )
+		return true;
+
+	// not added; the data still belongs to the caller
+	pEntry->m_pData = nullptr;
+	SafeDelete ( pEntry );
+	return false;
+}
+
+
+void SkipCache_c::DeleteAll ( int64_t iIndexId )
+{
+	BASE::Delete ( [iIndexId] ( const SkipCacheKey_t& tKey ) { return tKey.m_iIndexId == iIndexId; } );
+}
+
+
+void SkipCache_c::GetHotWords ( const char * szIndex, int64_t iIndexId, CSphVector<SkipCacheHotWord_t> & dWords )
+{
+	dWords.Resize(0);
+
+	// what was hot on last shutdown; only the first incarnation of the index needs it
+	{
+		ScopedMutex_t tLock ( m_tHotlistLock );
+		auto * pSaved = m_hSavedHotWords ( szIndex );
+		if ( pSaved )
+		{
+			dWords.Append ( *pSaved );
+			m_hSavedHotWords.Delete ( szIndex );
+		}
+	}
+
+	// what is hot right now in the previous incarnation of the index (it is still alive during rotation)
+	BASE::ForEach ( [iIndexId, szIndex, &dWords] ( const SkipCacheKey_t & tKey, const SkipCacheEntry_t * pEntry )
+	{
+		if ( tKey.m_iIndexId!=iIndexId && pEntry->m_sIndex==szIndex )
+			dWords.Add ( { tKey.m_tWordId, pEntry->m_sWord } );
+	});
+
+	dWords.Sort ( bind ( &SkipCacheHotWord_t::m_tWordId ) );
+	int iUniq = 0;
+	ARRAY_FOREACH ( i, dWords )
+		if ( !i || dWords[i].m_tWordId!=dWords[iUniq-1].m_tWordId )
+			dWords[iUniq++] = dWords[i];
+
+	dWords.Resize(iUniq);
+
+	// these were hot before, so let them in regardless of what the sketch says now
+	for ( const auto & i : dWords )
+		m_tSketch.SetMax ( SkipCacheUtil_t::GetHash ( { iIndexId, i.m_tWordId } ) );
+}
+
+
+void SkipCache_c::LoadHotlist()
+{
+	if ( m_sHotlist.IsEmpty() || !sphIsReadable ( m_sHotlist ) )
+		return;
+
+	CSphString sError;
+	CSphAutoreader tReader;
+	if ( !tReader.Open ( m_sHotlist, sError ) )
+	{
+		sphWarning ( "skiplist cache: %s", sError.cstr() );
+		return;
+	}
+
+	if ( tReader.GetDword()!=HOTLIST_MAGIC || tReader.GetDword()!=HOTLIST_VERSION )
+	{
+		sphWarning ( "skiplist cache: %s is not a hotlist file or has unsupported version; ignored", m_sHotlist.cstr() );
+		return;
+	}
+
+	SmallStringHash_T<CSphVector<SkipCacheHotWord_t>> hWords;
+	int iWords = tReader.GetDword();
+	for ( int i = 0; i < iWords && !tReader.GetErrorFlag(); ++i )
+	{
+		CSphString sIndex = tReader.GetString();
+		SkipCacheHotWord_t tWord;
+		tWord.m_tWordId = tReader.UnzipWordid();
+		tWord.m_sWord = tReader.GetString();
+		hWords.AddUnique ( sIndex ).Add ( tWord );
+	}
+
+	if ( tReader.GetErrorFlag() )
+	{
+		sphWarning ( "skiplist cache: error reading %s: %s; ignored", m_sHotlist.cstr(), tReader.GetErrorMessage().cstr() );
+		return;
+	}
+
+	ScopedMutex_t tLock ( m_tHotlistLock );
+	m_hSavedHotWords = std::move ( hWords );
+	sphInfo ( "skiplist cache: loaded %d hot words from %s", iWords, m_sHotlist.cstr() );
+}
+
+
+void SkipCache_c::SaveHotlist()
+{
+	if ( m_sHotlist.IsEmpty() )
+		return;
+
+	struct HotEntry_t
+	{
+		CSphString	m_sIndex;
+		SphWordID_t	m_tWordId;
+		CSphString	m_sWord;
+	};
+
+	// the sharded cache is walked shard by shard, so this is not a global MRU order. That's fine: the hotlist is a set,
+	// GetHotWords() sorts it by wordid anyway, and all of it fit into the cache when it was saved
+	CSphVector<HotEntry_t> dEntries;
+	BASE::ForEach ( [&dEntries] ( const SkipCacheKey_t & tKey, const SkipCacheEntry_t * pEntry )
+	{
+		dEntries.Add ( { pEntry->m_sIndex, tKey.m_tWordId, pEntry->m_sWord } );
+	});
+
+	CSphString sNew;
+	sNew.SetSprintf ( "%s.new", m_sHotlist.cstr() );
+
+	CSphString sError;
+	CSphWriter tWriter;
+	if ( !tWriter.OpenFile ( sNew, sError ) )
+	{
+		sphWarning ( "skiplist cache: %s", sError.cstr() );
+		return;
+	}
+
+	tWriter.PutDword ( HOTLIST_MAGIC );
+	tWriter.PutDword ( HOTLIST_VERSION );
+	tWriter.PutDword ( dEntries.GetLength() );
+	for ( const auto & i : dEntries )
+	{
+		tWriter.PutString ( i.m_sIndex );
+		tWriter.ZipOffset ( i.m_tWordId );
+		tWriter.PutString ( i.m_sWord );
+	}
+
+	tWriter.CloseFile();
+	if ( tWriter.IsError() )
+	{
+		// the failed .new is unlinked by the writer on destroy
+		sphWarning ( "skiplist cache: error writing %s: %s", sNew.cstr(), tWriter.GetErrorMessage().cstr() );
+		return;
+	}
+
+	if ( sph::rename ( sNew.cstr(), m_sHotlist.cstr() ) )
+		sphWarning ( "skiplist cache: failed to rename %s to %s: %s", sNew.cstr(), m_sHotlist.cstr(), strerrorm(errno) );
+}
+
+
+SkipCacheStats_t SkipCache_c::GetStats()
+{
+	SkipCacheStats_t tStats;
+	tStats.m_iHits = m_iHits.load ( std::memory_order_relaxed );
+	tStats.m_iMisses = m_iMisses.load ( std::memory_order_relaxed );
+	tStats.m_iRejected = m_iRejected.load ( std::memory_order_relaxed );
+
+	LRUCacheStats_t tCache = BASE::GetStats();
+	tStats.m_iMaxBytes = tCache.m_iMaxBytes;
+	tStats.m_iUsedBytes = tCache.m_iUsedBytes;
+	tStats.m_iEntries = tCache.m_iEntries;
+	tStats.m_iEvictions = tCache.m_iEvictions;
+	tStats.m_iContended = tCache.m_iContended;
+	return tStats;
+}
+
+
+void SkipCache_c::Init ( int64_t iCacheSize, const char * szHotlist )
 {
 	assert ( !m_pSkipCache );
 	if ( iCacheSize > 0 )
-		m_pSkipCache = new SkipCache_c ( iCacheSize );
+		m_pSkipCache = new SkipCache_c ( iCacheSize, szHotlist );
 }
 
+//////////////////////////////////////////////////////////////////////////
 
-void InitSkipCache ( int64_t iCacheSize )
+void InitSkipCache ( int64_t iCacheSize, const char * szHotlist )
 {
-	SkipCache_c::Init ( iCacheSize );
+	SkipCache_c::Init ( iCacheSize, szHotlist );
 }
 
 
@@ -99,10 +347,33 @@ bool SkipCache::Find ( SkipCacheKey_t tKey, SkipData_t * & pData )
 	return false;
 }
 
-bool SkipCache::Add ( SkipCacheKey_t tKey, SkipData_t* pData )
+bool SkipCache::Add ( SkipCacheKey_t tKey, SkipData_t* pData, const char * szIndex, const CSphString & sWord )
 {
 	SkipCache_c* pSkipCache = SkipCache_c::Get();
 	if ( pSkipCache )
-		return pSkipCache->Add ( std::move ( tKey ), pData );
+		return pSkipCache->Add ( std::move ( tKey ), pData, szIndex, sWord );
 	return false;
 }
+
+void SkipCache::GetHotWords ( const char * szIndex, int64_t iIndexId, CSphVector<SkipCacheHotWord_t> & dWords )
+{
+	dWords.Resize(0);
+	SkipCache_c* pSkipCache = SkipCache_c::Get();
+	if ( pSkipCache )
+		pSkipCache->GetHotWords ( szIndex, iIndexId, dWords );
+}
+
+void SkipCache::SaveHotlist()
+{
+	SkipCache_c* pSkipCache = SkipCache_c::Get();
+	if ( pSkipCache )
+		pSkipCache->SaveHotlist();
+}
+
+SkipCacheStats_t SkipCache::GetStats()
+{
+	SkipCache_c* pSkipCache = SkipCache_c::Get();
+	if ( pSkipCache )
+		return pSkipCache->GetStats();
+	return {};
+}
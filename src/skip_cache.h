@@ -14,6 +14,8 @@
 
 #include "std/ints.h"
 #include "sphinxdefs.h"
+#include "std/string.h"
+#include "std/vector.h"
 
 struct SkipCacheKey_t
 {
@@ -23,7 +25,27 @@ struct SkipCacheKey_t
 
 struct SkipData_t;
 
-void InitSkipCache ( int64_t iCacheSize );
+struct SkipCacheStats_t
+{
+	int64_t	m_iMaxBytes = 0;
+	int64_t	m_iUsedBytes = 0;
+	int64_t	m_iEntries = 0;
+	int64_t	m_iHits = 0;
+	int64_t	m_iMisses = 0;
+	int64_t	m_iEvictions = 0;
+	int64_t	m_iRejected = 0;	///< not admitted to the cache as not frequent enough
+	int64_t	m_iContended = 0;	///< lookups which had to wait for the lock of their cache shard
+};
+
+struct SkipCacheHotWord_t
+{
+	SphWordID_t	m_tWordId;
+	CSphString	m_sWord;
+};
+
+/// iCacheSize==0 disables the cache
+/// if szHotlist is set, the words that were cached at the last shutdown are read from it, and saved back there on shutdown
+void InitSkipCache ( int64_t iCacheSize, const char * szHotlist = nullptr );
 void ShutdownSkipCache();
 
 namespace SkipCache
@@ -31,5 +53,12 @@ namespace SkipCache
 	void DeleteAll ( int64_t iIndexId );
 	void Release ( SkipCacheKey_t tKey );
 	bool Find ( SkipCacheKey_t tKey, SkipData_t * & pData );
-	bool Add ( SkipCacheKey_t tKey, SkipData_t* pData );
+	bool Add ( SkipCacheKey_t tKey, SkipData_t* pData, const char * szIndex, const CSphString & sWord );
+
+	/// words of the index (by name) which were hot in the saved hotlist or in its previous incarnation (before rotation);
+	/// they are then admitted to the cache of index iIndexId regardless of their frequency
+	void GetHotWords ( const char * szIndex, int64_t iIndexId, CSphVector<SkipCacheHotWord_t> & dWords );
+	void SaveHotlist();
+
+	SkipCacheStats_t GetStats();
 }
\ No newline at end of file
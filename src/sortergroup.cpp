@@ -19,6 +19,26 @@
 #include "sphinxint.h"
 #include "sortcomp.h"
 #include "distinct.h"
+#include "coroutine.h"
+#include "groupspill.h"
+
+// partition by high bits of the mixed key, as the low ones are used by the group hashes inside the sorters
+static FORCE_INLINE int GetGroupPartition ( SphGroupKey_t uGroupKey, int iPartitions )
+{
+	return int ( ( sphFNV64 ( (uint64_t)uGroupKey ) >> 32 ) % iPartitions );
+}
+
+// run fnJob for every job in [0,iJobs) over up to iThreads workers
+template <typename FN>
+static void ParallelJobs ( int iJobs, int iThreads, FN && fnJob )
+{
+	std::atomic<int> iCurJob { 0 };
+	Threads::Coro::ExecuteN ( Min ( iJobs, iThreads ), [&]
+	{
+		for ( int iJob = iCurJob.fetch_add ( 1, std::memory_order_relaxed ); iJob<iJobs; iJob = iCurJob.fetch_add ( 1, std::memory_order_relaxed ) )
+			fnJob(iJob);
+	});
+}
 
 /// group sorting functor
 template < typename COMPGROUP >
@@ -360,7 +380,11 @@ public:
 	CSphKBufferGroupSorter ( const ISphMatchComparator * pComp, const CSphQuery * pQuery, const CSphGroupSorterSettings & tSettings )
 		: KBufferGroupSorter ( pComp, pQuery, tSettings )
 		, m_hGroup2Match ( tSettings.m_iMaxMatches*GROUPBY_FACTOR )
-	{}
+	{
+		// uniq counters live aside of the groups, so they can't be spilled
+		if ( !DISTINCT && !NOTIFICATIONS && tSettings.m_iSpillGroups )
+			m_pSpill = std::make_unique<GroupSpill_c>();
+	}
 
 	bool	Push ( const CSphMatch & tEntry ) override						{ return PushEx<false> ( tEntry, m_pGrouper->KeyFromMatch(tEntry), false, false, true, nullptr ); }
 	void	Push ( const VecTraits_T<const CSphMatch> & dMatches ) override	{ assert ( 0 && "Not supported in grouping"); }
@@ -409,6 +433,8 @@ public:
 		if ( !Used () )
 			return;
 
+		MergeSpilled();
+
 		auto& dRhs = *(MYTYPE *) pRhs;
 		if ( dRhs.IsEmpty () )
 		{
@@ -461,11 +487,86 @@ public:
 		m_iMaxUsed = ResetDynamicFreeData ( m_iMaxUsed );
 	}
 
+	bool MoveFromParallel ( const VecTraits_T<ISphMatchSorter *> & dSources, int iThreads ) final
+	{
+		// uniq counters can't be split by group key; notifications are only used by non-clonable sorters
+		if constexpr ( DISTINCT || NOTIFICATIONS )
+			return false;
+
+		int iPartitions = Min ( iThreads, Threads::NThreads() );
+		int iGroups = Used();
+		for ( auto * pSource : dSources )
+			iGroups += ( (MYTYPE *)pSource )->Used();
+
+		if ( iPartitions<2 || iGroups<PARALLEL_MERGE_MIN_GROUPS )
+			return false;
+
+		// this sorter goes first, as with sequential MoveTo() of the sources into it
+		CSphVector<MYTYPE *> dAll;
+		dAll.Add ( this );
+		for ( auto * pSource : dSources )
+			if ( !( (MYTYPE *)pSource )->IsEmpty() )
+				dAll.Add ( (MYTYPE *)pSource );
+
+		// 1. bring back spilled groups, cut every sorter to the limit (as MoveTo does) and arrange its groups by partition
+		int iStride = iPartitions+1;
+		CSphFixedVector<int> dBounds ( dAll.GetLength()*iStride );
+		ParallelJobs ( dAll.GetLength(), iPartitions, [&dAll, &dBounds, iPartitions, iStride] ( int iSorter )
+		{
+			dAll[iSorter]->MergeSpilled();
+			dAll[iSorter]->FinalizeMatches();
+			dAll[iSorter]->SplitByPartition ( iPartitions, dBounds.Slice ( iSorter*iStride, iStride ) );
+		});
+
+		int64_t iTotal = m_iTotal - Used();
+
+		// 2. every partition is merged from all the sorters into its own clone; group keys do not intersect between partitions
+		CSphFixedVector<MYTYPE *> dParts ( iPartitions );
+		for ( auto & pPart : dParts )
+			pPart = (MYTYPE *)Clone();
+
+		ParallelJobs ( iPartitions, iPartitions, [&dAll, &dBounds, &dParts, iStride] ( int iPart )
+		{
+			MYTYPE & tPart = *dParts[iPart];
+			tPart.SetMerge ( true );
+			ARRAY_FOREACH ( iSorter, dAll )
+			{
+				const MYTYPE & tSorter = *dAll[iSorter];
+				const int * pBounds = &dBounds[iSorter*iStride+iPart];
+				for ( int i = pBounds[0]; i<pBounds[1]; ++i )
+					tPart.PushGrouped ( tSorter.Get(i), false );
+			}
+			tPart.SetMerge ( false );
+			tPart.FinalizeMatches();
+		});
+
+		// 3. sources are fully moved; drop their groups
+		ParallelJobs ( dAll.GetLength(), iPartitions, [&dAll] ( int iSorter ) { dAll[iSorter]->ResetGroups(); } );
+
+		// 4. gather partitions back; the first one just swaps into the (now empty) sorter
+		for ( auto * pPart : dParts )
+		{
+			iTotal += pPart->m_iTotal;
+			bool bAvgFinal = pPart->m_bAvgFinal;
+			bool bWasEmpty = IsEmpty();
+			pPart->MoveTo ( this, false );
+			if ( bWasEmpty )
+				m_bAvgFinal = bAvgFinal;
+
+			SafeDelete ( pPart );
+		}
+
+		m_iTotal = iTotal;
+		return true;
+	}
+
 	void Finalize ( MatchProcessor_i & tProcessor, bool, bool bFinalizeMatches ) override
 	{
 		if ( !Used() )
 			return;
 
+		MergeSpilled();
+
 		if ( bFinalizeMatches )
 			FinalizeMatches();
 		else if constexpr ( DISTINCT )
@@ -566,8 +667,8 @@ protected:
 		if constexpr ( DISTINCT )
 			KBufferGroupSorter::template UpdateDistinct<GROUPED> ( tEntry, uGroupKey );
 
-		// if we're full, let's cut off some worst groups
-		if ( Used()==m_iSize )
+		// if we're full, let's grow up to the spill budget, move all the groups to disk, or cut off some worst ones
+		if ( Used()==m_iSize && !GrowGroups() && !SpillGroups() )
 			CutWorst ( m_iLimit * (int)(GROUPBY_FACTOR/2) );
 
 		// do add
@@ -607,6 +708,137 @@ private:
 	bool	m_bUpdateDistinct = true;
 	bool	m_bMerge = false;
 	CSphVector<SphGroupKey_t> m_dRemove;
+	std::unique_ptr<GroupSpill_c> m_pSpill;	///< runs of groups moved to disk when the buffer got full
+	bool	m_bSpillMerge = false;
+	static const int PARALLEL_MERGE_MIN_GROUPS = 16384; ///< below that, cloning sorters for partitions costs more than sequential MoveTo
+
+	/// reorder groups so that every partition is contiguous; dBounds receive partition offsets (iPartitions+1 values)
+	void SplitByPartition ( int iPartitions, VecTraits_T<int> dBounds )
+	{
+		assert ( !m_pSpill || m_pSpill->IsEmpty() );
+		int iUsed = Used();
+		CSphFixedVector<int> dPartition ( iUsed );
+		dBounds.Fill ( 0 );
+		for ( int i = 0; i<iUsed; ++i )
+		{
+			dPartition[i] = GetGroupPartition ( Get(i).GetAttr ( m_tLocGroupby ), iPartitions );
+			++dBounds[dPartition[i]+1];
+		}
+
+		for ( int i = 1; i<=iPartitions; ++i )
+			dBounds[i] += dBounds[i-1];
+
+		// only first Used() indexes are permuted; the rest of m_dIData is the free list
+		CSphFixedVector<int> dSorted ( iUsed );
+		CSphFixedVector<int> dPos ( iPartitions );
+		memcpy ( dPos.Begin(), dBounds.Begin(), dPos.GetLengthBytes() );
+		for ( int i = 0; i<iUsed; ++i )
+			dSorted[dPos[dPartition[i]]++] = this->m_dIData[i];
+
+		memcpy ( this->m_dIData.Begin(), dSorted.Begin(), dSorted.GetLengthBytes() );
+	}
+
+	/// double the buffer, up to the spill budget; that way only queries that really have many groups take the whole budget
+	bool GrowGroups()
+	{
+		if ( !m_pSpill || m_bSpillMerge || m_iSize>=this->m_iSpillGroups )
+			return false;
+
+		int iNewSize = (int)Min ( (int64_t)m_iSize*2, (int64_t)this->m_iSpillGroups );
+		CSphFixedVector<CSphMatch> dData ( iNewSize );
+		for ( int i = 0; i<m_iSize; ++i )
+			Swap ( dData[i], m_dData[i] );
+
+		m_dData.SwapData ( dData );
+
+		// slots past Used() are the free list; expose it, then append the new slots
+		int iUsed = Used();
+		this->m_dIData.Resize ( m_iSize );
+		this->m_dIData.Resize ( iNewSize );
+		for ( int i = m_iSize; i<iNewSize; ++i )
+			this->m_dIData[i] = i;
+
+		this->m_dIData.Resize ( iUsed );
+		m_iSize = iNewSize;
+		this->m_iMatchCapacity = iNewSize;
+
+		// matches have moved
+		m_hGroup2Match.Clear();
+		RebuildHash();
+		return true;
+	}
+
+	/// move all the groups to a new run on disk (sorted by group key); they're merged back before finalizing
+	bool SpillGroups()
+	{
+		if ( !m_pSpill || m_bSpillMerge )
+			return false;
+
+		// spilled groups are pushed back as grouped, i.e. with final averages
+		bool bAvgFinal = m_bAvgFinal;
+		if ( !bAvgFinal )
+			CalcAvg ( Avg_e::FINALIZE );
+
+		this->m_dIData.Sort ( Lesser ( [this] ( int a, int b ) { return m_dData[a].GetAttr ( m_tLocGroupby ) < m_dData[b].GetAttr ( m_tLocGroupby ); } ) );
+		if ( !m_pSpill->AddRun ( m_dData, this->m_dIData, *m_pSchema ) )
+		{
+			if ( !bAvgFinal )
+				CalcAvg ( Avg_e::UNGROUP );
+			return false;
+		}
+
+		for ( auto iMatch : this->m_dIData )
+			m_pSchema->FreeDataPtrs ( m_dData[iMatch] );
+
+		m_iMaxUsed = Max ( m_iMaxUsed, m_iSize ); // all the slots have dynamic rows now
+		m_iTotal -= Used(); // groups will be counted again when merged back
+		ResetAfterFlatten();
+		m_hGroup2Match.Clear();
+		m_bAvgFinal = false;
+		return true;
+	}
+
+	/// push spilled groups back in group key order; each one comes complete, so cutting the worst groups is exact now
+	void MergeSpilled()
+	{
+		if ( !m_pSpill || m_pSpill->IsEmpty() )
+			return;
+
+		// groups still in memory go as the last run
+		SpillGroups();
+
+		bool bMerge = m_bMerge;
+		m_bMerge = true;
+		m_bSpillMerge = true;
+
+		if ( m_pSpill->StartMerge ( *m_pSchema, m_tLocGroupby ) )
+			for ( const CSphMatch * pGroup = m_pSpill->Next(); pGroup; pGroup = m_pSpill->Next() )
+				PushEx<true> ( *pGroup, pGroup->GetAttr ( m_tLocGroupby ), false, false, false, nullptr );
+
+		if ( !m_pSpill->GetError().IsEmpty() )
+			sphWarning ( "failed to merge spilled groups back, result may be incomplete: %s", m_pSpill->GetError().cstr() );
+
+		m_bSpillMerge = false;
+		m_bMerge = bMerge;
+		m_pSpill->Reset();
+	}
+
+	/// drop all groups, same cleanup as Flatten() does
+	void ResetGroups()
+	{
+		for ( auto iMatch : this->m_dIData )
+			FreeMatchPtrs ( iMatch, false );
+
+		ResetAfterFlatten();
+		m_iMaxUsed = ResetDynamic ( m_iMaxUsed );
+		m_hGroup2Match.Clear();
+		m_bMatchesFinalized = false;
+		m_bAvgFinal = false;
+		m_iTotal = 0;
+
+		if ( m_pSpill )
+			m_pSpill->Reset();
+	}
 
 	void CalcAvg ( Avg_e eGroup )
 	{
@@ -639,6 +871,7 @@ private:
 		if ( m_bMatchesFinalized )
 			return;
 
+		MergeSpilled();
 		m_bMatchesFinalized = true;
 
 		if ( Used() > m_iLimit )
@@ -154,7 +154,10 @@ void CSphMatchQueueTraits::SwapMatchQueueTraits ( CSphMatchQueueTraits& rhs )
 	// CSphMatchQueueTraits
 	m_dData.SwapData ( rhs.m_dData );
 	m_dIData.SwapData ( rhs.m_dIData );
-	assert ( m_iSize==rhs.m_iSize );
+
+	// group-by sorters with a spill budget grow their buffers on demand
+	::Swap ( m_iSize, rhs.m_iSize );
+	::Swap ( m_iMatchCapacity, rhs.m_iMatchCapacity );
 }
 
 
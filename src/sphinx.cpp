@@ -131,6 +131,7 @@ static const int	MIN_READ_BUFFER			= 8192;
 static const int	MIN_READ_UNHINTED		= 1024;
 
 static int 			g_iReadUnhinted 		= DEFAULT_READ_UNHINTED;
+static int			g_iReadPrefetch			= DEFAULT_READ_PREFETCH;
 
 static bool			g_bPseudoSharding		= true;
 static int			g_iPseudoShardingThresh	= 8192;
@@ -1222,6 +1223,7 @@ public:
 	bool				PreallocColumnar();
 	bool				PreallocKNN();
 	bool				PreallocSkiplist();
+	void				WarmupSkipCache();
 
 	bool				LoadSecondaryIndex ( const CSphString & sFile );
 	bool				PreallocSecondaryIndex();
@@ -1357,7 +1359,8 @@ private:
 
 	template<typename RUN>
 	bool						SplitQuery ( RUN && tRun, CSphQueryResult & tResult, const CSphQuery & tQuery, const VecTraits_T<ISphMatchSorter *> & dAllSorters, const CSphMultiQueryArgs & tArgs, int64_t tmMaxTimer ) const;
-	bool						ChooseIterators ( CSphVector<SecondaryIndexInfo_t> & dSIInfo, const CSphQuery & tQuery, const CSphVector<CSphFilterSettings> & dFilters, CSphQueryContext & tCtx, CreateFilterContext_t & tFlx, const ISphSchema & tMaxSorterSchema, CSphQueryResultMeta & tMeta, int iCutoff, int iThreads, CSphVector<CSphFilterSettings> & dModifiedFilters, ISphRanker * pRanker ) const;
+	bool						ChooseIterators ( CSphVector<SecondaryIndexInfo_t> & dSIInfo, KNNFilterPlan_t & tKNNPlan, const CSphQuery & tQuery, const CSphVector<CSphFilterSettings> & dFilters, CSphQueryContext & tCtx, CreateFilterContext_t & tFlx, const ISphSchema & tMaxSorterSchema, CSphQueryResultMeta & tMeta, int iCutoff, int iThreads, CSphVector<CSphFilterSettings> & dModifiedFilters, ISphRanker * pRanker ) const;
+	KNNFilterPlan_t				ChooseKNNIterators ( CSphVector<SecondaryIndexInfo_t> & dSIInfo, const CSphQuery & tQuery, const CSphVector<CSphFilterSettings> & dFilters, const ISphSchema & tMaxSorterSchema, int iCutoff, StrVec_t & dWarnings ) const;
 	std::pair<RowidIterator_i *, bool> SpawnIterators ( const CSphQuery & tQuery, const CSphVector<CSphFilterSettings> & dFilters, CSphQueryContext & tCtx, CreateFilterContext_t & tFlx, const ISphSchema & tMaxSorterSchema, CSphQueryResultMeta & tMeta, int iCutoff, int iThreads, CSphVector<CSphFilterSettings> & dModifiedFilters, ISphRanker * pRanker ) const;
 	bool						SelectIteratorsFT ( const CSphQuery & tQuery, const CSphVector<CSphFilterSettings> & dFilters, const ISphSchema & tSorterSchema, ISphRanker * pRanker, CSphVector<SecondaryIndexInfo_t> & dSIInfo, int iCutoff, int iThreads, StrVec_t & dWarnings ) const;
 
@@ -1414,6 +1417,18 @@ int GetUnhintedBuffer()
 }
 
 
+void SetReadPrefetch ( int iReadPrefetch )
+{
+	g_iReadPrefetch = Max ( iReadPrefetch, 0 );
+}
+
+
+int GetReadPrefetch()
+{
+	return g_iReadPrefetch;
+}
+
+
 // returns correct size even if iBuf is 0
 int GetReadBuffer ( int iBuf )
 {
@@ -2086,6 +2101,32 @@ bool CSphIndex::MustRunInSingleThread ( const VecTraits_T<const CSphQuery> & dQu
 		if ( DetectPrecalcSorters ( tQuery, m_tSchema, bHasSI ) )
 			return true;
 
+		// groups spilled to disk are exact only if a single sorter sees all the matches, as per-thread sorters get cut to max_matches on merge
+		// nothing gets cut (or spilled) if there can't be more groups than max_matches
+		if ( GetGroupbyMemLimit(tQuery)>0 )
+		{
+			int64_t iMaxGroups = GetStats().m_iTotalDocuments;
+			int iGroupby = GetAliasedAttrIndex ( tQuery.m_sGroupBy, tQuery, m_tSchema );
+			if ( iGroupby>=0 )
+			{
+				int64_t iCountDistinct = dMaxCountDistinct[i];
+				if ( iCountDistinct==-1 )
+				{
+					CSphString sModifiedAttr;
+					iCountDistinct = GetCountDistinct ( tQuery.m_sGroupBy, sModifiedAttr );
+				}
+
+				if ( iCountDistinct!=-1 )
+					iMaxGroups = Min ( iMaxGroups, iCountDistinct );
+			}
+
+			if ( iMaxGroups>tQuery.m_iMaxMatches )
+			{
+				bForceSingleThread = true;
+				return true;
+			}
+		}
+
 		// at this point we are trying to decide how many threads this index gets
 		// we did not correct max_matches yet (to achieve max grouping accuracy)
 		// but if increasing max_matches would be enough to achieve max accuracy, there's no need to turn off multithreading
@@ -2519,6 +2560,8 @@ int CSphIndex_VLN::CheckThenUpdateAttributes ( AttrUpdateInc_t& tUpd, bool& bCri
 		CommitUpdateAttributes ( &m_iTID, GetName(), *tUpd.m_pUpdate );
 
 	m_uAttrsStatus |= tCtx.m_uUpdateMask; // FIXME! add lock/atomic?
+	if ( tCtx.m_uUpdateMask )
+		m_iUpdateGeneration.fetch_add ( 1, std::memory_order_relaxed );
 
 	if ( ( tCtx.m_uUpdateMask & IndexSegment_c::ATTRS_UPDATED ) || ( tCtx.m_uUpdateMask & IndexSegment_c::ATTRS_BLOB_UPDATED ) )
 	{
@@ -2554,6 +2597,7 @@ void CSphIndex_VLN::UpdateAttributesOffline ( VecTraits_T<PostponedUpdate_t> & d
 			break;
 		}
 		m_uAttrsStatus |= tCtx.m_uUpdateMask; // FIXME! add lock/atomic?
+		m_iUpdateGeneration.fetch_add ( 1, std::memory_order_relaxed );
 	}
 }
 
@@ -3549,6 +3593,10 @@ void CSphHitBuilder::DoclistEndEntry ( Hitpos_t uLastPos )
 		m_wrDoclist.ZipInt ( m_dLastDocFields.GetMask32() );
 		m_wrDoclist.ZipInt ( m_uLastDocHits );
 	}
+
+	SkiplistEntry_t & tBlock = m_dSkiplist.Last();
+	tBlock.m_uMaxHits = Max ( tBlock.m_uMaxHits, m_uLastDocHits );
+
 	m_dLastDocFields.UnsetAll();
 	m_uLastDocHits = 0;
 
@@ -3584,7 +3632,9 @@ void CSphHitBuilder::DoclistEndList ()
 		// so we additionally subtract that to improve delta coding
 		// 3) zero deltas are allowed and *not* used as any markers,
 		// as we know the exact skiplist entry count anyway
+		// 4) max hits per doc are stored as is, first entry included
 		SkiplistEntry_t tLast = m_dSkiplist[0];
+		m_wrSkiplist.ZipInt ( tLast.m_uMaxHits );
 		for ( int i=1; i<m_dSkiplist.GetLength(); i++ )
 		{
 			const SkiplistEntry_t & t = m_dSkiplist[i];
@@ -3593,6 +3643,7 @@ void CSphHitBuilder::DoclistEndList ()
 			m_wrSkiplist.ZipInt ( t.m_tBaseRowIDPlus1 - tLast.m_tBaseRowIDPlus1 - m_iSkiplistBlockSize );
 			m_wrSkiplist.ZipOffset ( t.m_iOffset - tLast.m_iOffset - 4*m_iSkiplistBlockSize );
 			m_wrSkiplist.ZipOffset ( t.m_iBaseHitlistPos - tLast.m_iBaseHitlistPos );
+			m_wrSkiplist.ZipInt ( t.m_uMaxHits );
 			tLast = t;
 		}
 	}
@@ -7220,6 +7271,16 @@ void CSphIndex_VLN::MatchExtended ( CSphQueryContext& tCtx, const CSphQuery & tQ
 	if constexpr ( USE_FACTORS )
 		pRanker->ExtraData ( EXTRA_SET_MATCHTAG, (void**)&iTag );
 
+	// weight pruning needs a single sorter that keeps the top-N by weight
+	ISphMatchSorter * pPruneSorter = nullptr;
+	if constexpr ( !RANDOMIZE )
+		pPruneSorter = ( tQuery.m_bWeightPruning && dSorters.GetLength()==1 ) ? dSorters[0] : nullptr;
+
+	// ranker returns matches in rowid order, so sort stage expressions could be calculated over the whole buffer
+	// (unless some of them allocate strings that must be freed for every match, as cutoff might stop before the end of it)
+	bool bBatchSortCalc = HAS_SORT_CALC && tCtx.m_dCalcSortPtrAttrs.IsEmpty() && HasBatchableItems ( tCtx.m_dCalcSort );
+	CSphVector<CSphMatch *> dBatch;
+
 	// do searching
 	CSphMatch * pMatch = pRanker->GetMatchesBuffer();
 	while (true)
@@ -7231,6 +7292,19 @@ void CSphIndex_VLN::MatchExtended ( CSphQueryContext& tCtx, const CSphQuery & tQ
 
 		SwitchProfile ( pProfile, SPH_QSTATE_SORT );
 
+		if ( bBatchSortCalc )
+		{
+			dBatch.Resize(0);
+			for ( int i=0; i<iMatches; i++ )
+				if ( !USE_KLIST || !m_tDeadRowMap.IsSet ( pMatch[i].m_tRowID ) )
+				{
+					pMatch[i].m_iWeight *= iIndexWeight;
+					dBatch.Add ( &pMatch[i] );
+				}
+
+			tCtx.CalcSortBatch(dBatch);
+		}
+
 		for ( int i=0; i<iMatches; i++ )
 		{
 			CSphMatch & tMatch = pMatch[i];
@@ -7240,10 +7314,13 @@ void CSphIndex_VLN::MatchExtended ( CSphQueryContext& tCtx, const CSphQuery & tQ
 					continue;
 			}
 
-			tMatch.m_iWeight *= iIndexWeight;
+			if ( !bBatchSortCalc )
+			{
+				tMatch.m_iWeight *= iIndexWeight;
 
-			if constexpr ( HAS_SORT_CALC )
-				tCtx.CalcSort ( tMatch );
+				if constexpr ( HAS_SORT_CALC )
+					tCtx.CalcSort ( tMatch );
+			}
 
 			if constexpr ( HAS_WEIGHT_FILTER )
 			{
@@ -7308,6 +7385,9 @@ void CSphIndex_VLN::MatchExtended ( CSphQueryContext& tCtx, const CSphQuery & tQ
 			if ( !iCutoff )
 				break;
 		}
+
+		if ( pPruneSorter )
+			sphSetRankerMinWeight ( pRanker, pPruneSorter, iIndexWeight );
 	}
 }
 
@@ -7348,6 +7428,14 @@ struct SphFinalMatchCalc_t final : MatchProcessor_i, ISphNoncopyable
 
 	void Process ( VecTraits_T<CSphMatch *> & dMatches ) final
 	{
+		CSphVector<CSphMatch *> dPending;
+		for ( auto & pMatch : dMatches )
+		{
+			assert(pMatch);
+			if ( pMatch->m_iTag<0 )
+				dPending.Add(pMatch);
+		}
+
 		CSphVector<ContextCalcItem_t *> dColumnWise, dRowWise;
 
 		// process columnar items in column-wise order (and the rest in rowwise order)
@@ -7358,33 +7446,32 @@ struct SphFinalMatchCalc_t final : MatchProcessor_i, ISphNoncopyable
 				dRowWise.Add(&i);
 
 		for ( const auto & pItem : dColumnWise )
-			for ( auto & pMatch : dMatches )
-			{
-				assert(pMatch);
-				if ( pMatch->m_iTag>=0 )
-					continue;
+			m_tCtx.CalcItemBatch ( dPending, *pItem );
 
-				m_tCtx.CalcItem ( *pMatch, *pItem );
+		// rowwise items keep their order as they might use each other's results
+		// but runs of batchable ones (e.g. arithmetic over attributes) are evaluated column-wise too
+		int iItem = 0;
+		while ( iItem<dRowWise.GetLength() )
+		{
+			if ( dRowWise[iItem]->m_pExpr->IsBatchable() )
+			{
+				m_tCtx.CalcItemBatch ( dPending, *dRowWise[iItem++] );
+				continue;
 			}
 
-		for ( auto & pMatch : dMatches )
-			for ( const auto & pItem : dRowWise )
-			{
-				assert(pMatch);
-				if ( pMatch->m_iTag>=0 )
-					continue;
+			int iEnd = iItem;
+			while ( iEnd<dRowWise.GetLength() && !dRowWise[iEnd]->m_pExpr->IsBatchable() )
+				iEnd++;
 
-				m_tCtx.CalcItem ( *pMatch, *pItem );
-			}
+			for ( auto & pMatch : dPending )
+				for ( int i = iItem; i < iEnd; i++ )
+					m_tCtx.CalcItem ( *pMatch, *dRowWise[i] );
 
-		for ( auto & pMatch : dMatches )
-		{
-			assert(pMatch);
-			if ( pMatch->m_iTag>=0 )
-				continue;
+			iItem = iEnd;
+		}
 
+		for ( auto & pMatch : dPending )
 			pMatch->m_iTag = m_iTag;
-		}
 	}
 };
 
@@ -7598,9 +7685,69 @@ bool Fullscan ( ITERATOR & tIterator, TO_STATIC && fnToStatic, const CSphQueryCo
 }
 
 
+/// same as Fullscan, but filter and sort stage items are calculated over whole rowid blocks
+template <typename ITERATOR, typename TO_STATIC>
+bool FullscanBatch ( ITERATOR & tIterator, TO_STATIC && fnToStatic, const CSphQueryContext & tCtx, CSphQueryResultMeta & tMeta, const VecTraits_T<ISphMatchSorter *> & dSorters, CSphMatch & tMatch, int iCutoff, bool bRandomize, int iIndexWeight, int64_t tmMaxTimer )
+{
+	auto tScopedStats = AtScopeExit ( [&tMeta, &tIterator]{tMeta.m_tStats.m_iFetchedDocs = (DWORD)tIterator.GetNumProcessed(); } );
+
+	bool bSingleSorter = dSorters.GetLength()==1 || dSorters[0]->IsJoin();
+	ScanBlock_c tBlock ( tMatch, tCtx.m_iMatchDynamic );
+	RowIdBlock_t dRowIDs;
+	Threads::Coro::HighFreqChecker_c fnHeavyCheck;
+	const int64_t& iCheckTimePoint { Threads::Coro::GetNextTimePointUS() };
+
+	while ( tIterator.GetNextRowIdBlock(dRowIDs) )
+	{
+		bool bCutoffHit = false;
+		for ( auto * pMatch : tBlock.Process ( tCtx, dRowIDs, fnToStatic, bRandomize, iIndexWeight ) )
+		{
+			bool bNewMatch = false;
+			if ( bSingleSorter )
+				bNewMatch = dSorters[0]->Push(*pMatch);
+			else
+				dSorters.for_each( [pMatch, &bNewMatch] ( ISphMatchSorter * p ) { bNewMatch |= p->Push ( *pMatch ); } );
+
+			if ( bNewMatch && iCutoff>0 && --iCutoff==0 )
+			{
+				bCutoffHit = true;
+				break;
+			}
+		}
+
+		// stringptr expressions should be duplicated (or taken over) at this point
+		tBlock.FreeData(tCtx);
+		if ( bCutoffHit )
+			return true;
+
+		if ( tmMaxTimer>0 && sph::TimeExceeded ( tmMaxTimer ) )
+		{
+			tMeta.m_sWarning = "query time exceeded max_query_time";
+			return true;
+		}
+
+		if ( fnHeavyCheck() && sph::TimeExceeded ( iCheckTimePoint ) )
+		{
+			if ( session::GetKilled() )
+			{
+				tMeta.m_sWarning = "query was killed";
+				return true;
+			}
+			Threads::Coro::RescheduleAndKeepCrashQuery();
+		}
+	}
+
+	return tIterator.WasCutoffHit();
+}
+
+
 template <typename ITERATOR, typename TO_STATIC>
 bool RunFullscan ( ITERATOR & tIterator, TO_STATIC && fnToStatic, const CSphQueryContext & tCtx, CSphQueryResultMeta & tMeta, const VecTraits_T<ISphMatchSorter *>& dSorters, CSphMatch & tMatch, int iCutoff, bool bRandomize, int iIndexWeight, int64_t tmMaxTimer )
 {
+	// rows come in ascending blocks, so expressions over attributes (columnar ones in particular) are cheaper to calculate block by block
+	if ( tCtx.IsScanBatchable() )
+		return FullscanBatch ( tIterator, std::forward<TO_STATIC> ( fnToStatic ), tCtx, tMeta, dSorters, tMatch, iCutoff, bRandomize, iIndexWeight, tmMaxTimer );
+
 	bool bHasFilterCalc = !tCtx.m_dCalcFilter.IsEmpty();
 	bool bHasSortCalc = !tCtx.m_dCalcSort.IsEmpty();
 	bool bHasFilter = !!tCtx.m_pFilter;
@@ -7881,21 +8028,53 @@ static void RemoveOptionalFilters ( const CSphVector<CSphFilterSettings> & dFilt
 }
 
 
-bool CSphIndex_VLN::ChooseIterators ( CSphVector<SecondaryIndexInfo_t> & dSIInfo, const CSphQuery & tQuery, const CSphVector<CSphFilterSettings> & dFilters, CSphQueryContext & tCtx, CreateFilterContext_t & tFlx, const ISphSchema & tMaxSorterSchema, CSphQueryResultMeta & tMeta, int iCutoff, int iThreads, CSphVector<CSphFilterSettings> & dModifiedFilters, ISphRanker * pRanker ) const
+KNNFilterPlan_t CSphIndex_VLN::ChooseKNNIterators ( CSphVector<SecondaryIndexInfo_t> & dSIInfo, const CSphQuery & tQuery, const CSphVector<CSphFilterSettings> & dFilters, const ISphSchema & tMaxSorterSchema, int iCutoff, StrVec_t & dWarnings ) const
+{
+	SelectIteratorCtx_t tSelectIteratorCtx ( tQuery, dFilters, m_tSchema, tMaxSorterSchema, m_pHistograms, m_pColumnar.get(), m_tSI, iCutoff, m_iDocinfo, 1 );
+
+	// filters are applied to the knn candidates; the more selective they are, the more candidates we need
+	const CSphColumnInfo * pKNNAttr = m_tSchema.GetAttr ( tQuery.m_sKNNAttr.cstr() );
+	int64_t iFilteredDocs = ( pKNNAttr && pKNNAttr->IsIndexedKNN() ) ? EstimateFilteredDocs(tSelectIteratorCtx) : m_iDocinfo;
+	int iExpandedK = CalcKNNExpandedK ( tQuery.m_iKNNK, m_iDocinfo, iFilteredDocs );
+
+	float fGraphCost = FLT_MAX;
+	tSelectIteratorCtx.m_bFromIterator = true;
+	tSelectIteratorCtx.m_fDocsLeft = float ( Min ( (int64_t)iExpandedK, m_iDocinfo ) )/m_iDocinfo;
+	dSIInfo = SelectIterators ( tSelectIteratorCtx, fGraphCost, dWarnings );
+	if ( iFilteredDocs>=m_iDocinfo )
+		return GetDefaultKNNPlan(tQuery);
+
+	// brute force costs at least its distance calculations; if the graph wins anyway, keep the iterators selected for it
+	KNNFilterPlan_t tGraphPlan = PlanFilteredKNN ( tQuery, pKNNAttr->m_tKNN, m_iDocinfo, iFilteredDocs, false, fGraphCost, 0.0f );
+	if ( tGraphPlan.m_eMode!=KNNFilterMode_e::BRUTEFORCE )
+		return tGraphPlan;
+
+	// same as a regular fullscan, but with distance calculations for every row that passes filters
+	float fBruteForceCost = FLT_MAX;
+	StrVec_t dBruteForceWarnings;
+	tSelectIteratorCtx.m_bFromIterator = false;
+	tSelectIteratorCtx.m_fDocsLeft = 1.0f;
+	auto dBruteForceSIInfo = SelectIterators ( tSelectIteratorCtx, fBruteForceCost, dBruteForceWarnings );
+
+	KNNFilterPlan_t tPlan = PlanFilteredKNN ( tQuery, pKNNAttr->m_tKNN, m_iDocinfo, iFilteredDocs, false, fGraphCost, fBruteForceCost );
+	if ( tPlan.m_eMode==KNNFilterMode_e::BRUTEFORCE )
+	{
+		dSIInfo.SwapData(dBruteForceSIInfo);
+		dWarnings.SwapData(dBruteForceWarnings);
+	}
+
+	return tPlan;
+}
+
+
+bool CSphIndex_VLN::ChooseIterators ( CSphVector<SecondaryIndexInfo_t> & dSIInfo, KNNFilterPlan_t & tKNNPlan, const CSphQuery & tQuery, const CSphVector<CSphFilterSettings> & dFilters, CSphQueryContext & tCtx, CreateFilterContext_t & tFlx, const ISphSchema & tMaxSorterSchema, CSphQueryResultMeta & tMeta, int iCutoff, int iThreads, CSphVector<CSphFilterSettings> & dModifiedFilters, ISphRanker * pRanker ) const
 {
 	StrVec_t dWarnings;
 	bool bKNN = !tQuery.m_sKNNAttr.IsEmpty();
 	float fBestCost = FLT_MAX;
 
 	if ( bKNN )
-	{
-		SelectIteratorCtx_t tSelectIteratorCtx ( tQuery, dFilters, m_tSchema, tMaxSorterSchema, m_pHistograms, m_pColumnar.get(), m_tSI, iCutoff, m_iDocinfo, 1 );
-		tSelectIteratorCtx.m_bFromIterator = true;
-
-		int iRequestedKNNDocs = Min ( tQuery.m_iKNNK, m_iDocinfo );
-		tSelectIteratorCtx.m_fDocsLeft = float(iRequestedKNNDocs)/m_iDocinfo;
-		dSIInfo = SelectIterators ( tSelectIteratorCtx, fBestCost, dWarnings );
-	}
+		tKNNPlan = ChooseKNNIterators ( dSIInfo, tQuery, dFilters, tMaxSorterSchema, iCutoff, dWarnings );
 	else
 	{
 		if ( !pRanker )
@@ -7928,10 +8107,21 @@ bool CSphIndex_VLN::ChooseIterators ( CSphVector<SecondaryIndexInfo_t> & dSIInfo
 
 std::pair<RowidIterator_i *, bool> CSphIndex_VLN::SpawnIterators ( const CSphQuery & tQuery, const CSphVector<CSphFilterSettings> & dFilters, CSphQueryContext & tCtx, CreateFilterContext_t & tFlx, const ISphSchema & tMaxSorterSchema, CSphQueryResultMeta & tMeta, int iCutoff, int iThreads, CSphVector<CSphFilterSettings> & dModifiedFilters, ISphRanker * pRanker ) const
 {
+	bool bKNN = !tQuery.m_sKNNAttr.IsEmpty();
+	KNNFilterPlan_t tKNNPlan = GetDefaultKNNPlan(tQuery);
+	auto fnReportKNNPlan = [&tMeta, &tQuery, &tKNNPlan]()
+	{
+		tMeta.m_tIteratorStats.m_dIterators.Add ( { tQuery.m_sKNNAttr, KNNFilterMode2Str ( tKNNPlan.m_eMode ) } );
+		tMeta.m_tIteratorStats.m_iTotal = 1;
+	};
+
 	if ( !dFilters.GetLength() )
 	{
-		if ( !tQuery.m_sKNNAttr.IsEmpty() )
-			return CreateKNNIterator ( m_pKNN.get(), tQuery, m_tSchema, tMaxSorterSchema, tMeta.m_sError );
+		if ( bKNN )
+		{
+			fnReportKNNPlan();
+			return CreateKNNIterator ( m_pKNN.get(), tQuery, tKNNPlan, m_tSchema, tMaxSorterSchema, tMeta.m_sError );
+		}
 
 		return { nullptr, false };
 	}
@@ -7940,12 +8130,23 @@ std::pair<RowidIterator_i *, bool> CSphIndex_VLN::SpawnIterators ( const CSphQue
 	const int64_t SMALL_INDEX_THRESH = 8192;
 	if ( m_iDocinfo < SMALL_INDEX_THRESH && g_iPseudoShardingThresh > 0 )
 	{
+		// small index; distances are calculated for every row that passes filters
+		if ( bKNN )
+		{
+			tKNNPlan.m_eMode = KNNFilterMode_e::BRUTEFORCE;
+			fnReportKNNPlan();
+		}
+
 		dModifiedFilters = dFilters;
 		return { nullptr, false };
 	}
 
 	CSphVector<SecondaryIndexInfo_t> dSIInfo;
-	if ( !ChooseIterators ( dSIInfo, tQuery, dFilters, tCtx, tFlx, tMaxSorterSchema, tMeta, iCutoff, iThreads, dModifiedFilters, pRanker ) )
+	bool bIterators = ChooseIterators ( dSIInfo, tKNNPlan, tQuery, dFilters, tCtx, tFlx, tMaxSorterSchema, tMeta, iCutoff, iThreads, dModifiedFilters, pRanker );
+	if ( bKNN )
+		fnReportKNNPlan();
+
+	if ( !bIterators )
 		return { nullptr, false };
 
 	RowIteratorsWithEstimates_t dSIIterators, dLookupIterators, dAnalyzerIterators, dKNNIterators;
@@ -7954,7 +8155,7 @@ std::pair<RowidIterator_i *, bool> CSphIndex_VLN::SpawnIterators ( const CSphQue
 
 	// knn iterators
 	bool bError = false;
-	dKNNIterators = CreateKNNIterators ( m_pKNN.get(), tQuery, m_tSchema, tMaxSorterSchema, bError, tMeta.m_sError );
+	dKNNIterators = CreateKNNIterators ( m_pKNN.get(), tQuery, tKNNPlan, m_tSchema, tMaxSorterSchema, bError, tMeta.m_sError );
 	if ( bError )
 		return { nullptr, true };
 
@@ -8083,6 +8284,7 @@ bool CSphIndex_VLN::SetupFiltersAndContext ( CSphQueryContext & tCtx, CreateFilt
 	tCtx.m_pLocalDocs = tArgs.m_pLocalDocs;
 	tCtx.m_iTotalDocs = ( tArgs.m_iTotalDocs ? tArgs.m_iTotalDocs : m_tStats.m_iTotalDocuments );
 	tCtx.m_iIndexTotalDocs = m_iDocinfo;
+	tCtx.m_pQcacheCollector = tArgs.m_pQcacheCollector;
 
 	return tCtx.CreateFilters ( tFlx, tMeta.m_sError, tMeta.m_sWarning );
 }
@@ -8423,6 +8625,12 @@ bool DiskIndexQwordSetup_c::Setup ( ISphQword * pWord ) const
 	{
 		tWord.SetDocReader ( m_pDoclist );
 
+		// kick off readahead of the doclist head right away, so that the i/o of all the query terms
+		// goes in parallel with the skiplist reads and the setup of the rest of the terms
+		int iPrefetch = GetReadPrefetch();
+		if ( iPrefetch && tRes.m_iDoclistHint>0 )
+			m_pDoclist->Prefetch ( tRes.m_iDoclistOffset, Min ( tRes.m_iDoclistHint, iPrefetch ) );
+
 		// read in skiplist
 		// OPTIMIZE? maybe add an option to decompress on preload instead?
 		if ( m_pSkips && tRes.m_iDocs>m_iSkiplistBlockSize )
@@ -8437,8 +8645,8 @@ bool DiskIndexQwordSetup_c::Setup ( ISphQword * pWord ) const
 			if ( !bFromCache )
 			{
 				tWord.m_pSkipData = new SkipData_t;
-				tWord.m_pSkipData->Read ( m_pSkips, tRes, tWord.m_iDocs, m_iSkiplistBlockSize );
-				bFromCache = bNeedCache && SkipCache::Add ( { m_pIndex->GetIndexId(), tWord.m_uWordID }, tWord.m_pSkipData );
+				tWord.m_pSkipData->Read ( m_pSkips, tRes, tWord.m_iDocs, m_iSkiplistBlockSize, pIndex->m_uVersion>=67 );
+				bFromCache = bNeedCache && SkipCache::Add ( { m_pIndex->GetIndexId(), tWord.m_uWordID }, tWord.m_pSkipData, m_pIndex->GetName(), tWord.m_sDictWord );
 			}
 		}
 
@@ -9405,10 +9613,40 @@ void CSphIndex_VLN::Preread()
 	if ( sphInterrupted() ) return;
 
 	m_bPassedRead = true;
+	WarmupSkipCache();
 	sphLogDebug ( "Preread successfully finished" );
 }
 
 
+void CSphIndex_VLN::WarmupSkipCache()
+{
+	if ( m_bDebugCheck || !m_pDoclistFile || !m_pHitlistFile )
+		return;
+
+	CSphVector<SkipCacheHotWord_t> dWords;
+	SkipCache::GetHotWords ( GetName(), m_iIndexId, dWords );
+	if ( dWords.IsEmpty() )
+		return;
+
+	DiskIndexQwordSetup_c tTermSetup ( m_pDoclistFile, m_pHitlistFile, m_tSkiplists.GetReadPtr(), m_tSettings.m_iSkiplistBlockSize, true, RowID_t(m_iDocinfo) );
+	tTermSetup.SetDict ( m_pDict );
+	tTermSetup.m_pIndex = this;
+
+	// setting up a term reads its skiplist and puts it to the cache
+	XQKeyword_t tKeyword;
+	for ( const auto & tWord : dWords )
+	{
+		std::unique_ptr<ISphQword> pQword { tTermSetup.QwordSpawn ( tKeyword ) };
+		pQword->m_uWordID = tWord.m_tWordId;
+		pQword->m_sWord = tWord.m_sWord;
+		pQword->m_sDictWord = tWord.m_sWord;
+		tTermSetup.QwordSetup ( pQword.get() );
+	}
+
+	sphLogDebug ( "table '%s': warmed up skiplist cache with %d hot words", GetName(), dWords.GetLength() );
+}
+
+
 CSphIndex::RenameResult_e CSphIndex_VLN::RenameEx ( CSphString sNewBase )
 {
 	if ( sNewBase == GetFilebase() )
@@ -10459,14 +10697,6 @@ void sphTransformExtendedQuery ( XQNode_t ** ppNode, const CSphIndexSettings & t
 }
 
 
-static void SetupSplitFilter ( CSphFilterSettings & tFilter, int iPart, int iTotal )
-{
-	tFilter.m_eType = SPH_FILTER_RANGE;
-	tFilter.m_sAttrName = "@rowid";
-	tFilter.m_iMinValue = iPart;
-	tFilter.m_iMaxValue = iTotal;
-}
-
 // basically the same code as QueryDiskChunks in an RT index
 template<typename RUN>
 static bool RunSplitQuery ( RUN && tRun, const CSphQuery & tQuery, CSphQueryResultMeta & tResult, VecTraits_T<ISphMatchSorter *> & dSorters, const CSphMultiQueryArgs & tArgs, QueryProfile_c * pProfiler, const SmallStringHash_T<int64_t> * pLocalDocs, int64_t iTotalDocs, const char * szIndexName, int iSplit, int64_t tmMaxTimer )
@@ -10538,6 +10768,7 @@ static bool RunSplitQuery ( RUN && tRun, const CSphQuery & tQuery, CSphQueryResu
 			tMultiArgs.m_iTotalDocs = iTotalDocs;
 			tMultiArgs.m_bModifySorterSchemas = false;
 			tMultiArgs.m_iTotalThreads = iConcurrency;
+			tMultiArgs.m_pQcacheCollector = tArgs.m_pQcacheCollector;
 
 			CSphQuery tQueryWithExtraFilter = tQuery;
 			SetupSplitFilter ( tQueryWithExtraFilter.m_dFilters.Add(), iJob, iJobs );
@@ -10580,7 +10811,7 @@ static bool RunSplitQuery ( RUN && tRun, const CSphQuery & tQuery, CSphQueryResu
 		}
 	});
 	QUERYINFO << "RunSplitQuery processed in " << tClonableCtx.NumWorked() << " thread(s)" << " index:" << szIndexName;
-	tClonableCtx.Finalize();
+	tClonableCtx.FinalizeAll();
 	// can not fail query due to interruption or timeout
 	// that is valid result set with just warning
 	// parent sorters merge well in case of interruption or timeout
@@ -517,6 +517,8 @@ struct CSphQuery
 	int				m_iKnnEf = 0;				///< KNN ef
 	CSphVector<float> m_dKNNVec;				///< KNN anchor vector
 
+	uint64_t		m_uTopNToken = 0;			///< master-assigned id for the top-N cutoffs it sends to agents (0 means none)
+
 	bool			m_bSortKbuffer = false;		///< whether to use PQ or K-buffer sorting algorithm
 	bool			m_bZSlist = false;			///< whether the ranker has to fetch the zonespanlist with this query
 	bool			m_bSimplify = false;		///< whether to apply boolean simplification
@@ -525,6 +527,7 @@ struct CSphQuery
 	bool			m_bNormalizedTFIDF = true;	///< whether to scale IDFs by query word count, so that TF*IDF is normalized
 	std::optional<bool> m_bLocalDF;				///< whether to use calculate DF among local indexes
 	bool			m_bLowPriority = false;		///< set low thread priority for this query
+	bool			m_bWeightPruning = false;	///< whether to skip docs that can't make it into the top-N by weight (total_found becomes a lower bound)
 	DWORD			m_uDebugFlags = 0;
 	QueryOption_e	m_eExpandKeywords = QUERY_OPT_DEFAULT;	///< control automatic query-time keyword expansion
 	int				m_iExpansionLimit = DEFAULT_QUERY_EXPANSION_LIMIT;	///< whether to limit wildcard expansion, default use index settings
@@ -535,6 +538,9 @@ struct CSphQuery
 	int				m_iDistinctThresh = 3500;			///< distinct accuracy thresh
 	bool			m_bExplicitDistinctThresh = false;	///< whether thresh was set via options
 
+	int64_t			m_iGroupbyMemLimit = 0;				///< spill groups to disk once they take more memory than that (0 means never)
+	bool			m_bExplicitGroupbyMemLimit = false;	///< whether limit was set via options
+
 	int				m_iMaxMatchThresh = 16384;
 	int				m_iNow = 0;	///< timestamp on query receive for all 'now' expressions to have the same base
 
@@ -895,6 +901,7 @@ class ISphQword;
 class ISphQwordSetup;
 class CSphQueryContext;
 class ISphFilter;
+class QcacheCollector_c;
 struct GetKeywordsSettings_t;
 struct SuggestArgs_t;
 struct SuggestResult_t;
@@ -948,6 +955,7 @@ struct CSphMultiQueryArgs : public ISphNoncopyable
 	bool									m_bFinalizeSorters = true;
 	int										m_iThreads = 1;
 	int										m_iTotalThreads = 1;
+	QcacheCollector_c *						m_pQcacheCollector = nullptr;
 
 	CSphMultiQueryArgs ( int iIndexWeight );
 };
@@ -1160,6 +1168,7 @@ public:
 	virtual int64_t *			GetFieldLens() const { return nullptr; }
 	virtual bool				IsStarDict ( bool bWordDict ) const;
 	int64_t						GetIndexId() const { return m_iIndexId; }
+	int64_t						GetUpdateGeneration() const { return m_iUpdateGeneration.load ( std::memory_order_relaxed ); }
 	void						SetMutableSettings ( const MutableIndexSettings_c & tSettings );
 	const MutableIndexSettings_c & GetMutableSettings () const { return m_tMutableSettings; }
 
@@ -1303,6 +1312,7 @@ public:
 
 protected:
 	int64_t						m_iIndexId;				///< internal (per daemon) unique index id, introduced for caching
+	std::atomic<int64_t>		m_iUpdateGeneration {0};	///< bumped on attribute updates; query cache doesn't reuse entries of previous generations
 
 	CSphSchema					m_tSchema;
 	CSphString					m_sLastError;
@@ -1460,6 +1470,10 @@ void				sphSetJsonOptions ( bool bStrict, bool bAutoconvNumbers, bool bKeynamesT
 void				SetUnhintedBuffer ( int iReadUnhinted );
 int					GetUnhintedBuffer();
 
+/// setup how much of every keyword doclist to prefetch on term setup (0 means no prefetch)
+void				SetReadPrefetch ( int iReadPrefetch );
+int					GetReadPrefetch();
+
 void				SetPseudoSharding ( bool bSet );
 bool				GetPseudoSharding();
 void				SetPseudoShardingThresh ( int iThresh );
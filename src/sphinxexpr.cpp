@@ -274,6 +274,10 @@ public:
 	float Eval ( const CSphMatch & tMatch ) const final { return (float) tMatch.GetAttr ( m_tLocator ); } // FIXME! OPTIMIZE!!! we can go the short route here
 	int IntEval ( const CSphMatch & tMatch ) const final { return (int)tMatch.GetAttr ( m_tLocator ); }
 	int64_t Int64Eval ( const CSphMatch & tMatch ) const final { return (int64_t)tMatch.GetAttr ( m_tLocator ); }
+	void EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, float * pRes ) const final			{ ARRAY_FOREACH ( i, dMatches ) pRes[i] = (float)dMatches[i]->GetAttr ( m_tLocator ); }
+	void IntEvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int * pRes ) const final			{ ARRAY_FOREACH ( i, dMatches ) pRes[i] = (int)dMatches[i]->GetAttr ( m_tLocator ); }
+	void Int64EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int64_t * pRes ) const final	{ ARRAY_FOREACH ( i, dMatches ) pRes[i] = (int64_t)dMatches[i]->GetAttr ( m_tLocator ); }
+	bool IsBatchable() const final { return true; }
 
 	uint64_t GetHash ( const ISphSchema & tSorterSchema, uint64_t uPrevHash, bool & bDisable ) final
 	{
@@ -298,6 +302,10 @@ public:
 	float Eval ( const CSphMatch & tMatch ) const final { return (float) tMatch.GetAttr ( m_tLocator ); }
 	int IntEval ( const CSphMatch & tMatch ) const final { return (int)tMatch.GetAttr ( m_tLocator ); }
 	int64_t Int64Eval ( const CSphMatch & tMatch ) const final { return (int64_t)tMatch.GetAttr ( m_tLocator ); }
+	void EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, float * pRes ) const final			{ ARRAY_FOREACH ( i, dMatches ) pRes[i] = (float)dMatches[i]->GetAttr ( m_tLocator ); }
+	void IntEvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int * pRes ) const final			{ ARRAY_FOREACH ( i, dMatches ) pRes[i] = (int)dMatches[i]->GetAttr ( m_tLocator ); }
+	void Int64EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int64_t * pRes ) const final	{ ARRAY_FOREACH ( i, dMatches ) pRes[i] = (int64_t)dMatches[i]->GetAttr ( m_tLocator ); }
+	bool IsBatchable() const final { return true; }
 
 	uint64_t GetHash ( const ISphSchema & tSorterSchema, uint64_t uPrevHash, bool & bDisable ) final
 	{
@@ -322,6 +330,10 @@ public:
 	float Eval ( const CSphMatch & tMatch ) const final { return (float)(int)tMatch.GetAttr ( m_tLocator ); }
 	int IntEval ( const CSphMatch & tMatch ) const final { return (int)tMatch.GetAttr ( m_tLocator ); }
 	int64_t Int64Eval ( const CSphMatch & tMatch ) const final { return (int)tMatch.GetAttr ( m_tLocator ); }
+	void EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, float * pRes ) const final			{ ARRAY_FOREACH ( i, dMatches ) pRes[i] = (float)(int)dMatches[i]->GetAttr ( m_tLocator ); }
+	void IntEvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int * pRes ) const final			{ ARRAY_FOREACH ( i, dMatches ) pRes[i] = (int)dMatches[i]->GetAttr ( m_tLocator ); }
+	void Int64EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int64_t * pRes ) const final	{ ARRAY_FOREACH ( i, dMatches ) pRes[i] = (int)dMatches[i]->GetAttr ( m_tLocator ); }
+	bool IsBatchable() const final { return true; }
 
 	uint64_t GetHash ( const ISphSchema & tSorterSchema, uint64_t uPrevHash, bool & bDisable ) final
 	{
@@ -344,6 +356,8 @@ class Expr_GetFloat_c : public Expr_WithLocator_c
 public:
 	Expr_GetFloat_c ( const CSphAttrLocator & tLocator, int iLocator ) : Expr_WithLocator_c ( tLocator, iLocator ) {}
 	float Eval ( const CSphMatch & tMatch ) const final { return tMatch.GetAttrFloat ( m_tLocator ); }
+	void EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, float * pRes ) const final { ARRAY_FOREACH ( i, dMatches ) pRes[i] = dMatches[i]->GetAttrFloat ( m_tLocator ); }
+	bool IsBatchable() const final { return true; }
 
 	uint64_t GetHash ( const ISphSchema & tSorterSchema, uint64_t uPrevHash, bool & bDisable ) final
 	{
@@ -493,6 +507,10 @@ public:
 	float Eval ( const CSphMatch & ) const final { return m_fValue; }
 	int IntEval ( const CSphMatch & ) const final { return (int)m_fValue; }
 	int64_t Int64Eval ( const CSphMatch & ) const final { return (int64_t)m_fValue; }
+	void EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, float * pRes ) const final			{ std::fill ( pRes, pRes+dMatches.GetLength(), m_fValue ); }
+	void IntEvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int * pRes ) const final			{ std::fill ( pRes, pRes+dMatches.GetLength(), (int)m_fValue ); }
+	void Int64EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int64_t * pRes ) const final	{ std::fill ( pRes, pRes+dMatches.GetLength(), (int64_t)m_fValue ); }
+	bool IsBatchable() const final { return true; }
 	bool IsConst () const final { return true; }
 
 	uint64_t GetHash ( const ISphSchema & tSorterSchema, uint64_t uPrevHash, bool & bDisable ) final
@@ -524,6 +542,10 @@ public:
 	float Eval ( const CSphMatch & ) const final { return (float) m_iValue; } // no assert() here cause generic float Eval() needs to work even on int-evaluator tree
 	int IntEval ( const CSphMatch & ) const final { return m_iValue; }
 	int64_t Int64Eval ( const CSphMatch & ) const final { return m_iValue; }
+	void EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, float * pRes ) const final			{ std::fill ( pRes, pRes+dMatches.GetLength(), (float)m_iValue ); }
+	void IntEvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int * pRes ) const final			{ std::fill ( pRes, pRes+dMatches.GetLength(), m_iValue ); }
+	void Int64EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int64_t * pRes ) const final	{ std::fill ( pRes, pRes+dMatches.GetLength(), (int64_t)m_iValue ); }
+	bool IsBatchable() const final { return true; }
 	bool IsConst () const final { return true; }
 	
 	uint64_t GetHash ( const ISphSchema & tSorterSchema, uint64_t uPrevHash, bool & bDisable ) final
@@ -555,6 +577,9 @@ public:
 	float Eval ( const CSphMatch & ) const final { return (float) m_iValue; } // no assert() here cause generic float Eval() needs to work even on int-evaluator tree
 	int IntEval ( const CSphMatch & ) const final { assert ( 0 ); return (int)m_iValue; }
 	int64_t Int64Eval ( const CSphMatch & ) const final { return m_iValue; }
+	void EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, float * pRes ) const final			{ std::fill ( pRes, pRes+dMatches.GetLength(), (float)m_iValue ); }
+	void Int64EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int64_t * pRes ) const final	{ std::fill ( pRes, pRes+dMatches.GetLength(), m_iValue ); }
+	bool IsBatchable() const final { return true; }
 	bool IsConst () const final { return true; }
 	
 	uint64_t GetHash ( const ISphSchema & tSorterSchema, uint64_t uPrevHash, bool & bDisable ) final
@@ -3319,6 +3344,34 @@ DECLARE_END()
 
 //////////////////////////////////////////////////////////////////////////
 
+static FORCE_INLINE void EvalArgBatch ( const ISphExpr & tExpr, const VecTraits_T<CSphMatch *> & dMatches, float * pRes )	{ tExpr.EvalBatch ( dMatches, pRes ); }
+static FORCE_INLINE void EvalArgBatch ( const ISphExpr & tExpr, const VecTraits_T<CSphMatch *> & dMatches, int * pRes )		{ tExpr.IntEvalBatch ( dMatches, pRes ); }
+static FORCE_INLINE void EvalArgBatch ( const ISphExpr & tExpr, const VecTraits_T<CSphMatch *> & dMatches, int64_t * pRes )	{ tExpr.Int64EvalBatch ( dMatches, pRes ); }
+
+/// binary op that evaluates its args over the whole block and then combines them in a plain loop
+class Expr_BinaryBatch_c : public Expr_Binary_c
+{
+public:
+	using Expr_Binary_c::Expr_Binary_c;
+
+	bool IsBatchable() const final { return m_pFirst->IsBatchable() && m_pSecond->IsBatchable(); }
+
+protected:
+	template <typename T, typename OP>
+	void BinaryEvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, T * pRes, OP && fnOp ) const
+	{
+		int iLen = dMatches.GetLength();
+		CSphFixedVector<T> dSecond ( iLen );
+		EvalArgBatch ( *m_pFirst, dMatches, pRes );
+		EvalArgBatch ( *m_pSecond, dMatches, dSecond.Begin() );
+
+		const T * pSecond = dSecond.Begin();
+		for ( int i = 0; i < iLen; i++ )
+			pRes[i] = fnOp ( pRes[i], pSecond[i] );
+	}
+};
+
+
 #define DECLARE_BINARY_TRAITS(_classname,_parent) \
 	class _classname : public _parent \
 	{ \
@@ -3357,23 +3410,42 @@ DECLARE_END()
 	DECLARE_BINARY_INT_EXPR ( _classname##Int_c,	(float)IntEval(tMatch),		_expr2,					(int64_t)IntEval(tMatch),	_expr4 ) \
 	DECLARE_BINARY_INT_EXPR ( _classname##Int64_c,	(float)Int64Eval(tMatch),	(int)Int64Eval(tMatch),	_expr3,						_expr4 )
 
+// same as DECLARE_BINARY_INT, but with batch evaluation; expressions are over 'a' and 'b' args
+#define DECLARE_BINARY_BATCH(_classname,_expr,_expr2,_expr3) \
+		DECLARE_BINARY_TRAITS ( _classname, Expr_BinaryBatch_c ) \
+		static FORCE_INLINE float	Op ( float a, float b )		{ return _expr; } \
+		static FORCE_INLINE int		Op ( int a, int b )			{ return _expr2; } \
+		static FORCE_INLINE int64_t	Op ( int64_t a, int64_t b )	{ return _expr3; } \
+		float Eval ( const CSphMatch & tMatch ) const final { return Op ( EVALFIRST, EVALSECOND ); } \
+		int IntEval ( const CSphMatch & tMatch ) const final { return Op ( INTFIRST, INTSECOND ); } \
+		int64_t Int64Eval ( const CSphMatch & tMatch ) const final { return Op ( INT64FIRST, INT64SECOND ); } \
+		void EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, float * pRes ) const final { BinaryEvalBatch ( dMatches, pRes, []( float a, float b ) { return Op ( a, b ); } ); } \
+		void IntEvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int * pRes ) const final { BinaryEvalBatch ( dMatches, pRes, []( int a, int b ) { return Op ( a, b ); } ); } \
+		void Int64EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int64_t * pRes ) const final { BinaryEvalBatch ( dMatches, pRes, []( int64_t a, int64_t b ) { return Op ( a, b ); } ); } \
+	};
+
 #define IFFLT(_expr)	( (_expr) ? 1.0f : 0.0f )
 #define IFINT(_expr)	( (_expr) ? 1 : 0 )
 
-DECLARE_BINARY_INT ( Expr_Add_c,	EVALFIRST + EVALSECOND,						(DWORD)INTFIRST + (DWORD)INTSECOND,				(uint64_t)INT64FIRST + (uint64_t)INT64SECOND )
-DECLARE_BINARY_INT ( Expr_Sub_c,	EVALFIRST - EVALSECOND,						(DWORD)INTFIRST - (DWORD)INTSECOND,				(uint64_t)INT64FIRST - (uint64_t)INT64SECOND )
-DECLARE_BINARY_INT ( Expr_Mul_c,	EVALFIRST * EVALSECOND,						(DWORD)INTFIRST * (DWORD)INTSECOND,				(uint64_t)INT64FIRST * (uint64_t)INT64SECOND )
+DECLARE_BINARY_BATCH ( Expr_Add_c,	a + b,										(DWORD)a + (DWORD)b,							(uint64_t)a + (uint64_t)b )
+DECLARE_BINARY_BATCH ( Expr_Sub_c,	a - b,										(DWORD)a - (DWORD)b,							(uint64_t)a - (uint64_t)b )
+DECLARE_BINARY_BATCH ( Expr_Mul_c,	a * b,										(DWORD)a * (DWORD)b,							(uint64_t)a * (uint64_t)b )
 DECLARE_BINARY_INT ( Expr_BitAnd_c,	(float)(int(EVALFIRST)&int(EVALSECOND)),	INTFIRST & INTSECOND,				INT64FIRST & INT64SECOND )
 DECLARE_BINARY_INT ( Expr_BitOr_c,	(float)(int(EVALFIRST)|int(EVALSECOND)),	INTFIRST | INTSECOND,				INT64FIRST | INT64SECOND )
 DECLARE_BINARY_INT ( Expr_Mod_c,	(float)(int(EVALFIRST)%int(EVALSECOND)),	INTFIRST % INTSECOND,				INT64FIRST % INT64SECOND )
 
-DECLARE_BINARY_TRAITS ( Expr_Div_c, Expr_Binary_c )
+DECLARE_BINARY_TRAITS ( Expr_Div_c, Expr_BinaryBatch_c )
 	   float Eval ( const CSphMatch & tMatch ) const final
 	   {
 			   float fSecond = m_pSecond->Eval ( tMatch );
 			   // ideally this would be SQLNULL instead of plain 0.0f
 			   return fSecond!=0.0f ? m_pFirst->Eval ( tMatch )/fSecond : 0.0f;
 	   }
+
+	   void EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, float * pRes ) const final
+	   {
+			   BinaryEvalBatch ( dMatches, pRes, []( float fFirst, float fSecond ) { return fSecond!=0.0f ? fFirst/fSecond : 0.0f; } );
+	   }
 DECLARE_END()
 
 DECLARE_BINARY_TRAITS ( Expr_Idiv_c, Expr_Binary_c )
@@ -3406,8 +3478,8 @@ DECLARE_BINARY_POLY ( Expr_Gte,		IFFLT ( EVALFIRST>=EVALSECOND ),				IFINT ( INT
 DECLARE_BINARY_POLY ( Expr_Eq,		IFFLT ( fabs ( EVALFIRST-EVALSECOND )<=1e-6 ),	IFINT ( INTFIRST==INTSECOND ),		IFINT ( INT64FIRST==INT64SECOND ), PopulateConstArgsEqInt )
 DECLARE_BINARY_POLY ( Expr_Ne,		IFFLT ( fabs ( EVALFIRST-EVALSECOND )>1e-6 ),	IFINT ( INTFIRST!=INTSECOND ),		IFINT ( INT64FIRST!=INT64SECOND ), PopulateConstArgsNeInt )
 
-DECLARE_BINARY_INT ( Expr_Min_c,	Min ( EVALFIRST, EVALSECOND ),					Min ( INTFIRST, INTSECOND ),		Min ( INT64FIRST, INT64SECOND ) )
-DECLARE_BINARY_INT ( Expr_Max_c,	Max ( EVALFIRST, EVALSECOND ),					Max ( INTFIRST, INTSECOND ),		Max ( INT64FIRST, INT64SECOND ) )
+DECLARE_BINARY_BATCH ( Expr_Min_c,	Min ( a, b ),									Min ( a, b ),						Min ( a, b ) )
+DECLARE_BINARY_BATCH ( Expr_Max_c,	Max ( a, b ),									Max ( a, b ),						Max ( a, b ) )
 DECLARE_BINARY_FLT ( Expr_Pow_c,	float ( pow ( EVALFIRST, EVALSECOND ) ) )
 
 DECLARE_BINARY_POLY ( Expr_And,		EVALFIRST!=0.0f && EVALSECOND!=0.0f,		IFINT ( INTFIRST && INTSECOND ),	IFINT ( INT64FIRST && INT64SECOND ), SetFlagAnd )
@@ -3485,9 +3557,297 @@ protected:
 		ISphExpr* Clone() const final { return new _classname(*this); } \
 	};
 
+/// ternary op that evaluates its args over the whole block and then combines them in a plain loop
+class Expr_TernaryBatch_c : public ExprThreeway_c
+{
+public:
+	using ExprThreeway_c::ExprThreeway_c;
+
+	bool IsBatchable() const final { return m_pFirst->IsBatchable() && m_pSecond->IsBatchable() && m_pThird->IsBatchable(); }
+
+protected:
+	template <typename T, typename OP>
+	void TernaryEvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, T * pRes, OP && fnOp ) const
+	{
+		int iLen = dMatches.GetLength();
+		CSphFixedVector<T> dSecond ( iLen );
+		CSphFixedVector<T> dThird ( iLen );
+		EvalArgBatch ( *m_pFirst, dMatches, pRes );
+		EvalArgBatch ( *m_pSecond, dMatches, dSecond.Begin() );
+		EvalArgBatch ( *m_pThird, dMatches, dThird.Begin() );
+
+		const T * pSecond = dSecond.Begin();
+		const T * pThird = dThird.Begin();
+		for ( int i = 0; i < iLen; i++ )
+			pRes[i] = fnOp ( pRes[i], pSecond[i], pThird[i] );
+	}
+};
+
+// same as DECLARE_TERNARY, but with batch evaluation; expressions are over 'a', 'b' and 'c' args
+#define DECLARE_TERNARY_BATCH(_classname,_expr,_expr2,_expr3) \
+	class _classname : public Expr_TernaryBatch_c \
+	{ \
+	public: \
+		_classname ( ISphExpr * pFirst, ISphExpr * pSecond, ISphExpr * pThird ) \
+			: Expr_TernaryBatch_c ( #_classname, pFirst, pSecond, pThird ) {} \
+		\
+		static FORCE_INLINE float	Op ( float a, float b, float c )			{ return _expr; } \
+		static FORCE_INLINE int		Op ( int a, int b, int c )					{ return _expr2; } \
+		static FORCE_INLINE int64_t	Op ( int64_t a, int64_t b, int64_t c )		{ return _expr3; } \
+		float Eval ( const CSphMatch & tMatch ) const final { return Op ( EVALFIRST, EVALSECOND, EVALTHIRD ); } \
+		int IntEval ( const CSphMatch & tMatch ) const final { return Op ( INTFIRST, INTSECOND, INTTHIRD ); } \
+		int64_t Int64Eval ( const CSphMatch & tMatch ) const final { return Op ( INT64FIRST, INT64SECOND, INT64THIRD ); } \
+		void EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, float * pRes ) const final { TernaryEvalBatch ( dMatches, pRes, []( float a, float b, float c ) { return Op ( a, b, c ); } ); } \
+		void IntEvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int * pRes ) const final { TernaryEvalBatch ( dMatches, pRes, []( int a, int b, int c ) { return Op ( a, b, c ); } ); } \
+		void Int64EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int64_t * pRes ) const final { TernaryEvalBatch ( dMatches, pRes, []( int64_t a, int64_t b, int64_t c ) { return Op ( a, b, c ); } ); } \
+		_classname ( const _classname& rhs ) : Expr_TernaryBatch_c (rhs) {} \
+		ISphExpr* Clone() const final { return new _classname(*this); } \
+	};
+
 DECLARE_TERNARY ( Expr_If_c,	( EVALFIRST!=0.0f ) ? EVALSECOND : EVALTHIRD,	INTFIRST ? INTSECOND : INTTHIRD,	INT64FIRST ? INT64SECOND : INT64THIRD )
-DECLARE_TERNARY ( Expr_Madd_c,	EVALFIRST*EVALSECOND+EVALTHIRD,					INTFIRST*INTSECOND + INTTHIRD,		INT64FIRST*INT64SECOND + INT64THIRD )
-DECLARE_TERNARY ( Expr_Mul3_c,	EVALFIRST*EVALSECOND*EVALTHIRD,					INTFIRST*INTSECOND*INTTHIRD,		INT64FIRST*INT64SECOND*INT64THIRD )
+DECLARE_TERNARY_BATCH ( Expr_Madd_c,	a*b+c,									a*b + c,							a*b + c )
+DECLARE_TERNARY_BATCH ( Expr_Mul3_c,	a*b*c,									a*b*c,								a*b*c )
+
+//////////////////////////////////////////////////////////////////////////
+// FUSED KERNELS
+//////////////////////////////////////////////////////////////////////////
+
+// small expressions over plain attributes and constants (like attr*const, attr1+attr2 or IF(attr>const,a,b))
+// are spawned as one node with inlined arg fetches instead of a tree of virtual calls
+// args and ops must give exactly the same results as the generic nodes
+
+// attribute values are covered by dependent columns hash, so only mark arg position here
+// (otherwise attr-1 and 1-attr would get the same hash)
+static uint64_t FusedAttrHash ( uint64_t uHash, char cTag )
+{
+	return sphFNV64 ( &cTag, sizeof(cTag), uHash );
+}
+
+/// int attribute arg, same as Expr_GetInt_c
+struct FusedAttrInt_t : public ExprLocatorTraits_t
+{
+	using ExprLocatorTraits_t::ExprLocatorTraits_t;
+
+	FORCE_INLINE float		Eval ( const CSphMatch & tMatch ) const		{ return (float)tMatch.GetAttr ( m_tLocator ); }
+	FORCE_INLINE int		IntEval ( const CSphMatch & tMatch ) const	{ return (int)tMatch.GetAttr ( m_tLocator ); }
+	FORCE_INLINE int64_t	Int64Eval ( const CSphMatch & tMatch ) const	{ return (int64_t)tMatch.GetAttr ( m_tLocator ); }
+	uint64_t				CalcHash ( uint64_t uHash ) const			{ return FusedAttrHash ( uHash, 'i' ); }
+};
+
+/// float attribute arg, same as Expr_GetFloat_c
+struct FusedAttrFloat_t : public ExprLocatorTraits_t
+{
+	using ExprLocatorTraits_t::ExprLocatorTraits_t;
+
+	FORCE_INLINE float		Eval ( const CSphMatch & tMatch ) const		{ return tMatch.GetAttrFloat ( m_tLocator ); }
+	FORCE_INLINE int		IntEval ( const CSphMatch & tMatch ) const	{ return (int)Eval(tMatch); }
+	FORCE_INLINE int64_t	Int64Eval ( const CSphMatch & tMatch ) const	{ return (int64_t)Eval(tMatch); }
+	uint64_t				CalcHash ( uint64_t uHash ) const			{ return FusedAttrHash ( uHash, 'f' ); }
+};
+
+/// constant arg, same as Expr_GetConst_c, Expr_GetIntConst_c or Expr_GetInt64Const_c (depending on what values it was set up with)
+struct FusedConst_t
+{
+	float	m_fValue = 0.0f;
+	int		m_iValue = 0;
+	int64_t	m_iValue64 = 0;
+
+	FORCE_INLINE float		Eval ( const CSphMatch & ) const			{ return m_fValue; }
+	FORCE_INLINE int		IntEval ( const CSphMatch & ) const			{ return m_iValue; }
+	FORCE_INLINE int64_t	Int64Eval ( const CSphMatch & ) const		{ return m_iValue64; }
+	void					HandleCommand ( ESphExprCommand, void * )	{}
+	void					FixupLocator ( const ISphSchema *, const ISphSchema * ) {}
+
+	uint64_t CalcHash ( uint64_t uHash ) const
+	{
+		uHash = sphFNV64 ( &m_fValue, sizeof(m_fValue), uHash );
+		return sphFNV64 ( &m_iValue64, sizeof(m_iValue64), uHash );
+	}
+};
+
+
+template <typename T, typename ARG>
+static FORCE_INLINE T FusedEval ( const ARG & tArg, const CSphMatch & tMatch )
+{
+	if constexpr ( std::is_same_v<T,float> )
+		return tArg.Eval(tMatch);
+	else if constexpr ( std::is_same_v<T,int> )
+		return tArg.IntEval(tMatch);
+	else
+		return tArg.Int64Eval(tMatch);
+}
+
+
+template <typename T, typename EXPR>
+static void FusedEvalBatch ( const EXPR & tExpr, const VecTraits_T<CSphMatch *> & dMatches, T * pRes )
+{
+	for ( int i = 0, iLen = dMatches.GetLength(); i < iLen; i++ )
+		pRes[i] = tExpr.template Calc<T> ( *dMatches[i] );
+}
+
+
+/// fused kernels are leaves as far as the rest of the engine is concerned
+template <typename EXPR>
+class Expr_Fused_T : public ISphExpr
+{
+public:
+	float		Eval ( const CSphMatch & tMatch ) const final		{ return Self().template Calc<float>(tMatch); }
+	int			IntEval ( const CSphMatch & tMatch ) const final	{ return Self().template Calc<int>(tMatch); }
+	int64_t		Int64Eval ( const CSphMatch & tMatch ) const final	{ return Self().template Calc<int64_t>(tMatch); }
+	void		EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, float * pRes ) const final			{ FusedEvalBatch ( Self(), dMatches, pRes ); }
+	void		IntEvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int * pRes ) const final			{ FusedEvalBatch ( Self(), dMatches, pRes ); }
+	void		Int64EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int64_t * pRes ) const final	{ FusedEvalBatch ( Self(), dMatches, pRes ); }
+	bool		IsBatchable() const final { return true; }
+	ISphExpr *	Clone() const final { return new EXPR ( Self() ); }
+
+protected:
+				Expr_Fused_T() = default;
+				Expr_Fused_T ( const Expr_Fused_T & ) {}
+
+private:
+	const EXPR & Self() const { return *static_cast<const EXPR *>(this); }
+};
+
+
+struct FusedAdd_t
+{
+	static constexpr bool FLOAT_ONLY = false;
+	template <typename T> static FORCE_INLINE T Op ( T a, T b ) { return Expr_Add_c::Op ( a, b ); }
+};
+
+struct FusedSub_t
+{
+	static constexpr bool FLOAT_ONLY = false;
+	template <typename T> static FORCE_INLINE T Op ( T a, T b ) { return Expr_Sub_c::Op ( a, b ); }
+};
+
+struct FusedMul_t
+{
+	static constexpr bool FLOAT_ONLY = false;
+	template <typename T> static FORCE_INLINE T Op ( T a, T b ) { return Expr_Mul_c::Op ( a, b ); }
+};
+
+// Expr_Div_c has no int math, its int evaluators go through the float one
+struct FusedDiv_t
+{
+	static constexpr bool FLOAT_ONLY = true;
+	static FORCE_INLINE float Op ( float a, float b ) { return b!=0.0f ? a/b : 0.0f; }
+};
+
+
+template <typename OP, typename LEFT, typename RIGHT>
+class Expr_FusedBinary_T : public Expr_Fused_T<Expr_FusedBinary_T<OP,LEFT,RIGHT>>
+{
+public:
+	Expr_FusedBinary_T ( const char * szClassName, const LEFT & tLeft, const RIGHT & tRight )
+		: m_tLeft ( tLeft )
+		, m_tRight ( tRight )
+		, m_szExprName ( szClassName )
+	{}
+
+	template <typename T>
+	FORCE_INLINE T Calc ( const CSphMatch & tMatch ) const
+	{
+		if constexpr ( OP::FLOAT_ONLY && !std::is_same_v<T,float> )
+			return (T)Calc<float>(tMatch);
+		else
+			return OP::Op ( FusedEval<T> ( m_tLeft, tMatch ), FusedEval<T> ( m_tRight, tMatch ) );
+	}
+
+	void FixupLocator ( const ISphSchema * pOldSchema, const ISphSchema * pNewSchema ) final
+	{
+		m_tLeft.FixupLocator ( pOldSchema, pNewSchema );
+		m_tRight.FixupLocator ( pOldSchema, pNewSchema );
+	}
+
+	void Command ( ESphExprCommand eCmd, void * pArg ) final
+	{
+		m_tLeft.HandleCommand ( eCmd, pArg );
+		m_tRight.HandleCommand ( eCmd, pArg );
+	}
+
+	uint64_t GetHash ( const ISphSchema & tSorterSchema, uint64_t uPrevHash, bool & bDisable ) final
+	{
+		EXPR_CLASS_NAME_NOCHECK(m_szExprName);
+		uHash = m_tLeft.CalcHash ( m_tRight.CalcHash(uHash) );
+		return CALC_DEP_HASHES();
+	}
+
+private:
+	LEFT			m_tLeft;
+	RIGHT			m_tRight;
+	const char *	m_szExprName = nullptr;
+};
+
+
+enum class FusedCmp_e
+{
+	LT,
+	GT,
+	EQ
+};
+
+// IF ( attr <cmp> const, a, b ) with the comparison done in T math (as in Expr_Lt/Gt/EqFloat_c, *Int_c or *Int64_c)
+template <FusedCmp_e CMP, typename T, typename ATTR, typename A, typename B>
+class Expr_FusedIf_T : public Expr_Fused_T<Expr_FusedIf_T<CMP,T,ATTR,A,B>>
+{
+public:
+	Expr_FusedIf_T ( const ATTR & tAttr, const FusedConst_t & tConst, const A & tA, const B & tB )
+		: m_tAttr ( tAttr )
+		, m_tConst ( tConst )
+		, m_tA ( tA )
+		, m_tB ( tB )
+	{}
+
+	template <typename RES>
+	FORCE_INLINE RES Calc ( const CSphMatch & tMatch ) const
+	{
+		return Compare ( FusedEval<T> ( m_tAttr, tMatch ), FusedEval<T> ( m_tConst, tMatch ) ) ? FusedEval<RES> ( m_tA, tMatch ) : FusedEval<RES> ( m_tB, tMatch );
+	}
+
+	void FixupLocator ( const ISphSchema * pOldSchema, const ISphSchema * pNewSchema ) final
+	{
+		m_tAttr.FixupLocator ( pOldSchema, pNewSchema );
+		m_tA.FixupLocator ( pOldSchema, pNewSchema );
+		m_tB.FixupLocator ( pOldSchema, pNewSchema );
+	}
+
+	void Command ( ESphExprCommand eCmd, void * pArg ) final
+	{
+		m_tAttr.HandleCommand ( eCmd, pArg );
+		m_tA.HandleCommand ( eCmd, pArg );
+		m_tB.HandleCommand ( eCmd, pArg );
+	}
+
+	uint64_t GetHash ( const ISphSchema & tSorterSchema, uint64_t uPrevHash, bool & bDisable ) final
+	{
+		EXPR_CLASS_NAME_NOCHECK("Expr_FusedIf_T");
+		int iCmp = (int)CMP;
+		int iCmpType = std::is_same_v<T,float> ? 0 : ( std::is_same_v<T,int> ? 1 : 2 );
+		CALC_POD_HASH(iCmp);
+		CALC_POD_HASH(iCmpType);
+		uHash = m_tB.CalcHash ( m_tA.CalcHash ( m_tConst.CalcHash(uHash) ) );
+		return CALC_DEP_HASHES();
+	}
+
+private:
+	ATTR			m_tAttr;
+	FusedConst_t	m_tConst;
+	A				m_tA;
+	B				m_tB;
+
+	static FORCE_INLINE bool Compare ( T a, T b )
+	{
+		if constexpr ( CMP==FusedCmp_e::LT )
+			return a<b;
+		else if constexpr ( CMP==FusedCmp_e::GT )
+			return a>b;
+		else if constexpr ( std::is_same_v<T,float> )
+			return fabs ( a-b )<=1e-6;
+		else
+			return a==b;
+	}
+};
 
 //////////////////////////////////////////////////////////////////////////
 // UDF CALL SITE
@@ -4372,6 +4732,8 @@ private:
 	ISphExpr *				CreateLevenshteinNode ( ISphExpr * pPattern, ISphExpr * pAttr, ISphExpr * pOpts );
 
 	ISphExpr *				CreateCmp ( const ExprNode_t & tNode, ISphExpr * pLeft, ISphExpr * pRight );
+	ISphExpr *				CreateFusedNode ( const ExprNode_t & tNode );
+	ISphExpr *				CreateFusedIf ( const ExprNode_t & tNode );
 
 	bool					CheckStoredArg ( ISphExpr * pExpr );
 	bool					PrepareFuncArgs ( const ExprNode_t & tNode, bool bSkipChildren, CSphRefcountedPtr<ISphExpr> & pLeft, CSphRefcountedPtr<ISphExpr> & pRight, VecRefPtrs_t<ISphExpr*> & dArgs );
@@ -6715,6 +7077,173 @@ bool ExprParser_t::CheckStoredArg ( ISphExpr * pExpr )
 	return true;
 }
 
+static bool IsFusedArg ( const ExprNode_t & tNode )
+{
+	return tNode.m_iToken==TOK_ATTR_INT || tNode.m_iToken==TOK_ATTR_FLOAT || tNode.m_iToken==TOK_CONST_INT || tNode.m_iToken==TOK_CONST_FLOAT;
+}
+
+// same values as CreateTree() spawns for constants
+static FusedConst_t CreateFusedConst ( const ExprNode_t & tNode )
+{
+	FusedConst_t tConst;
+	if ( tNode.m_iToken==TOK_CONST_INT && tNode.m_eRetType==SPH_ATTR_INTEGER )
+	{
+		tConst.m_iValue = (int)tNode.m_iConst;
+		tConst.m_iValue64 = tConst.m_iValue;
+		tConst.m_fValue = (float)tConst.m_iValue;
+	}
+	else if ( tNode.m_iToken==TOK_CONST_INT && tNode.m_eRetType==SPH_ATTR_BIGINT )
+	{
+		tConst.m_iValue64 = tNode.m_iConst;
+		tConst.m_iValue = (int)tNode.m_iConst;
+		tConst.m_fValue = (float)tNode.m_iConst;
+	}
+	else
+	{
+		tConst.m_fValue = tNode.m_iToken==TOK_CONST_INT ? float ( tNode.m_iConst ) : tNode.m_fConst;
+		tConst.m_iValue = (int)tConst.m_fValue;
+		tConst.m_iValue64 = (int64_t)tConst.m_fValue;
+	}
+
+	return tConst;
+}
+
+
+template <typename FN>
+static ISphExpr * CreateFusedArg ( const ExprNode_t & tNode, FN && fnCreate )
+{
+	switch ( tNode.m_iToken )
+	{
+	case TOK_ATTR_INT:		return fnCreate ( FusedAttrInt_t ( tNode.m_tLocator, tNode.m_iLocator ) );
+	case TOK_ATTR_FLOAT:	return fnCreate ( FusedAttrFloat_t ( tNode.m_tLocator, tNode.m_iLocator ) );
+	case TOK_CONST_INT:
+	case TOK_CONST_FLOAT:	return fnCreate ( CreateFusedConst(tNode) );
+	default:				return nullptr;
+	}
+}
+
+
+template <typename OP>
+static ISphExpr * CreateFusedBinary ( const char * szClassName, const ExprNode_t & tLeft, const ExprNode_t & tRight )
+{
+	return CreateFusedArg ( tLeft, [szClassName, &tRight]( const auto & tLeftArg )
+	{
+		return CreateFusedArg ( tRight, [szClassName, &tLeftArg]( const auto & tRightArg ) -> ISphExpr *
+		{
+			using LEFT = std::decay_t<decltype(tLeftArg)>;
+			using RIGHT = std::decay_t<decltype(tRightArg)>;
+			return new Expr_FusedBinary_T<OP,LEFT,RIGHT> ( szClassName, tLeftArg, tRightArg );
+		} );
+	} );
+}
+
+
+template <FusedCmp_e CMP, typename T>
+static ISphExpr * CreateFusedIf ( const ExprNode_t & tAttr, const ExprNode_t & tConst, const ExprNode_t & tA, const ExprNode_t & tB )
+{
+	return CreateFusedArg ( tAttr, [&]( const auto & tAttrArg )
+	{
+		return CreateFusedArg ( tA, [&]( const auto & tAArg )
+		{
+			return CreateFusedArg ( tB, [&]( const auto & tBArg ) -> ISphExpr *
+			{
+				using ATTR = std::decay_t<decltype(tAttrArg)>;
+				using A = std::decay_t<decltype(tAArg)>;
+				using B = std::decay_t<decltype(tBArg)>;
+
+				// float attrs are always compared as floats; a constant can't be here either
+				if constexpr ( std::is_same_v<ATTR,FusedConst_t> || ( std::is_same_v<ATTR,FusedAttrFloat_t> && !std::is_same_v<T,float> ) )
+					return nullptr;
+				else
+					return new Expr_FusedIf_T<CMP,T,ATTR,A,B> ( tAttrArg, CreateFusedConst(tConst), tAArg, tBArg );
+			} );
+		} );
+	} );
+}
+
+
+template <FusedCmp_e CMP>
+static ISphExpr * CreateFusedIf ( ESphAttr eCmpType, const ExprNode_t & tAttr, const ExprNode_t & tConst, const ExprNode_t & tA, const ExprNode_t & tB )
+{
+	switch ( eCmpType )
+	{
+	case SPH_ATTR_INTEGER:	return CreateFusedIf<CMP,int> ( tAttr, tConst, tA, tB );
+	case SPH_ATTR_BIGINT:	return CreateFusedIf<CMP,int64_t> ( tAttr, tConst, tA, tB );
+	default:				return CreateFusedIf<CMP,float> ( tAttr, tConst, tA, tB );
+	}
+}
+
+
+ISphExpr * ExprParser_t::CreateFusedIf ( const ExprNode_t & tNode )
+{
+	CSphVector<int> dArgs = GatherArgNodes ( tNode.m_iLeft );
+	if ( dArgs.GetLength()!=3 || !IsFusedArg ( m_dNodes[dArgs[1]] ) || !IsFusedArg ( m_dNodes[dArgs[2]] ) )
+		return nullptr;
+
+	const ExprNode_t & tCond = m_dNodes[dArgs[0]];
+	if ( tCond.m_iLeft<0 || tCond.m_iRight<0 )
+		return nullptr;
+
+	const ExprNode_t * pAttr = &m_dNodes[tCond.m_iLeft];
+	const ExprNode_t * pConst = &m_dNodes[tCond.m_iRight];
+	const ExprNode_t * pA = &m_dNodes[dArgs[1]];
+	const ExprNode_t * pB = &m_dNodes[dArgs[2]];
+
+	int iOp = tCond.m_iToken;
+	if ( pAttr->m_iToken==TOK_CONST_INT || pAttr->m_iToken==TOK_CONST_FLOAT )
+	{
+		// const <cmp> attr to attr <mirrored cmp> const
+		Swap ( pAttr, pConst );
+		switch ( iOp )
+		{
+		case '<':		iOp = '>'; break;
+		case '>':		iOp = '<'; break;
+		case TOK_LTE:	iOp = TOK_GTE; break;
+		case TOK_GTE:	iOp = TOK_LTE; break;
+		default:		break;
+		}
+	}
+
+	if ( ( pAttr->m_iToken!=TOK_ATTR_INT && pAttr->m_iToken!=TOK_ATTR_FLOAT ) || ( pConst->m_iToken!=TOK_CONST_INT && pConst->m_iToken!=TOK_CONST_FLOAT ) )
+		return nullptr;
+
+	// in int math a<=b is the same as !(a>b) etc, so just swap the branches
+	// that does not hold for floats (NaNs), so these stay generic
+	bool bIntCmp = tCond.m_eArgType==SPH_ATTR_INTEGER || tCond.m_eArgType==SPH_ATTR_BIGINT;
+	switch ( iOp )
+	{
+	case '<':		return ::CreateFusedIf<FusedCmp_e::LT> ( tCond.m_eArgType, *pAttr, *pConst, *pA, *pB );
+	case '>':		return ::CreateFusedIf<FusedCmp_e::GT> ( tCond.m_eArgType, *pAttr, *pConst, *pA, *pB );
+	case TOK_EQ:	return ::CreateFusedIf<FusedCmp_e::EQ> ( tCond.m_eArgType, *pAttr, *pConst, *pA, *pB );
+	case TOK_LTE:	return bIntCmp ? ::CreateFusedIf<FusedCmp_e::GT> ( tCond.m_eArgType, *pAttr, *pConst, *pB, *pA ) : nullptr;
+	case TOK_GTE:	return bIntCmp ? ::CreateFusedIf<FusedCmp_e::LT> ( tCond.m_eArgType, *pAttr, *pConst, *pB, *pA ) : nullptr;
+	case TOK_NE:	return bIntCmp ? ::CreateFusedIf<FusedCmp_e::EQ> ( tCond.m_eArgType, *pAttr, *pConst, *pB, *pA ) : nullptr;
+	default:		return nullptr;
+	}
+}
+
+/// spawn a fused kernel in place of a small subtree (if there's one for it)
+ISphExpr * ExprParser_t::CreateFusedNode ( const ExprNode_t & tNode )
+{
+	if ( tNode.m_iToken==TOK_FUNC && tNode.m_iFunc==FUNC_IF )
+		return CreateFusedIf(tNode);
+
+	if ( tNode.m_iLeft<0 || tNode.m_iRight<0 || !IsFusedArg ( m_dNodes[tNode.m_iLeft] ) || !IsFusedArg ( m_dNodes[tNode.m_iRight] ) )
+		return nullptr;
+
+	const ExprNode_t & tLeft = m_dNodes[tNode.m_iLeft];
+	const ExprNode_t & tRight = m_dNodes[tNode.m_iRight];
+	switch ( tNode.m_iToken )
+	{
+	case '+':	return CreateFusedBinary<FusedAdd_t> ( "Expr_FusedAdd", tLeft, tRight );
+	case '-':	return CreateFusedBinary<FusedSub_t> ( "Expr_FusedSub", tLeft, tRight );
+	case '*':	return CreateFusedBinary<FusedMul_t> ( "Expr_FusedMul", tLeft, tRight );
+	case '/':	return CreateFusedBinary<FusedDiv_t> ( "Expr_FusedDiv", tLeft, tRight );
+	default:	return nullptr;
+	}
+}
+
+
 ISphExpr * ExprParser_t::CreateCmp ( const ExprNode_t & tNode, ISphExpr * pLeft, ISphExpr * pRight )
 {
 	int iOp = tNode.m_iToken;
@@ -7070,6 +7599,9 @@ ISphExpr * ExprParser_t::CreateTree ( int iNode )
 	if ( iOp<=0 )	// tree doesn't need to be created (usually it was optimized away).
 		return nullptr;
 
+	if ( ISphExpr * pFused = CreateFusedNode(tNode) )
+		return pFused;
+
 	// avoid spawning argument node in some cases
 	bool bSkipChildren = false;
 	if ( iOp==TOK_FUNC )
@@ -138,6 +138,15 @@ public:
 	/// evaluate PACKEDFACTORS as a packed data ptr attr
 	virtual const BYTE * FactorEvalPacked ( const CSphMatch & ) const { assert ( 0 ); return nullptr; }
 
+	/// evaluate this expression for a block of matches (float, int and int64 math); pRes must have room for all of them
+	/// by default it is the same as calling Eval() for each match; leaves and arithmetic override it with tight loops
+	virtual void EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, float * pRes ) const			{ ARRAY_FOREACH ( i, dMatches ) pRes[i] = Eval ( *dMatches[i] ); }
+	virtual void IntEvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int * pRes ) const			{ ARRAY_FOREACH ( i, dMatches ) pRes[i] = IntEval ( *dMatches[i] ); }
+	virtual void Int64EvalBatch ( const VecTraits_T<CSphMatch *> & dMatches, int64_t * pRes ) const	{ ARRAY_FOREACH ( i, dMatches ) pRes[i] = Int64Eval ( *dMatches[i] ); }
+
+	/// is the whole expression tree evaluated faster by *EvalBatch() than match by match?
+	virtual bool IsBatchable() const { return false; }
+
 	/// check for arglist subtype
 	/// FIXME? replace with a single GetType() call?
 	virtual bool IsArglist () const { return false; }
@@ -263,6 +263,15 @@ struct Filter_WeightRange: public IFilter_Range
 };
 
 
+void SetupSplitFilter ( CSphFilterSettings & tFilter, int iPart, int iTotal )
+{
+	tFilter.m_eType = SPH_FILTER_RANGE;
+	tFilter.m_sAttrName = "@rowid";
+	tFilter.m_iMinValue = iPart;
+	tFilter.m_iMaxValue = iTotal;
+}
+
+
 RowIdBoundaries_t GetFilterRowIdBoundaries ( const CSphFilterSettings & tFilter, RowID_t tTotalDocs )
 {
 	assert ( tFilter.m_eType==SPH_FILTER_RANGE );
@@ -327,6 +327,7 @@ struct RowIdBoundaries_t
 	RowID_t m_tMaxRowID = INVALID_ROWID;
 };
 
+void	SetupSplitFilter ( CSphFilterSettings & tFilter, int iPart, int iTotal );	///< @rowid filter that matches iPart-th of iTotal pseudo-shards
 RowIdBoundaries_t GetFilterRowIdBoundaries ( const CSphFilterSettings & tFilter, RowID_t tTotalDocs );
 
 bool	FixupFilterSettings ( const CSphFilterSettings & tSettings, CommonFilterSettings_t & tFixedSettings, const CreateFilterContext_t & tCtx, const CSphString & sAttrName, CSphString & sError );
@@ -37,7 +37,7 @@
 //////////////////////////////////////////////////////////////////////////
 
 const DWORD		INDEX_MAGIC_HEADER			= 0x58485053;		///< my magic 'SPHX' header
-const DWORD		INDEX_FORMAT_VERSION		= 66;				///< added .spjidx
+const DWORD		INDEX_FORMAT_VERSION		= 67;				///< added per-block max hits to skiplists
 
 const char		MAGIC_CODE_SENTENCE			= '\x02';				// emitted from tokenizer on sentence boundary
 const char		MAGIC_CODE_PARAGRAPH		= '\x03';				// emitted from stripper (and passed via tokenizer) on paragraph boundary
@@ -117,6 +117,7 @@ enum ExtraData_e
 	EXTRA_SET_BOUNDARIES,
 	EXTRA_SET_ITERATOR,
 	EXTRA_SET_COLUMNAR,
+	EXTRA_SET_MINWEIGHT,
 };
 
 /// generic COM-like interface
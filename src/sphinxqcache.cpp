@@ -41,11 +41,13 @@ public:
 
 	void						Setup ( int64_t iMaxBytes, int iThreshMsec, int iTtlSec );
 	void						Add ( const CSphQuery & q, QcacheEntry_c * pResult, const ISphSchema & tSorterSchema );
-	QcacheEntry_c *				Find ( int64_t iIndexId, const CSphQuery & q, const ISphSchema & tSorterSchema );
+	bool						Prepare ( const CSphQuery & q, QcacheEntry_c * pResult, const ISphSchema & tSorterSchema ) const;
+	void						Insert ( QcacheEntry_c * pResult ) EXCLUDES ( m_tLock );
+	QcacheEntry_c *				Find ( int64_t iIndexId, int64_t iGeneration, const CSphQuery & q, const ISphSchema & tSorterSchema );
 	void						DeleteIndex ( int64_t iIndexId ) EXCLUDES ( m_tLock );
 
 private:
-	static uint64_t				GetKey ( int64_t iIndexId, const CSphQuery & q );
+	static uint64_t				GetKey ( int64_t iIndexId, int64_t iGeneration, const CSphQuery & q );
 	bool						IsValidEntry ( int i ) { return m_hData[i]!=QCACHE_NO_ENTRY && m_hData[i]!=QCACHE_DEAD_ENTRY; }
 	void						EnforceLimits ( bool bSizeOnly ) EXCLUDES ( m_tLock );
 	void						MruToHead ( int iRes );
@@ -348,22 +350,34 @@ static bool CalcFilterHashes ( CSphVector<uint64_t> & dFilters, const CSphQuery
 
 
 void Qcache_c::Add ( const CSphQuery & q, QcacheEntry_c * pResult, const ISphSchema & tSorterSchema )
+{
+	if ( Prepare ( q, pResult, tSorterSchema ) )
+		Insert ( pResult );
+}
+
+// finish the entry and calculate everything that depends on query and schema; false means the query can't be cached at all
+bool Qcache_c::Prepare ( const CSphQuery & q, QcacheEntry_c * pResult, const ISphSchema & tSorterSchema ) const
 {
 	pResult->Finish();
 
-	// do not cache too fast queries or too big rsets, for obvious reasons
 	// do not cache full scans, because we'll get an incorrect empty result set here
-	if ( pResult->m_iElapsedMsec < m_iThreshMs || pResult->GetSize() > m_iMaxBytes )
-		return;
-
 	if ( !CanCacheQuery(q) )
-		return;
+		return false;
 
 	if ( !CalcFilterHashes ( pResult->m_dFilters, q, tSorterSchema ) )
-		return;	// this query can't be cached because of the nature of expressions in filters
+		return false;	// this query can't be cached because of the nature of expressions in filters
+
+	pResult->m_Key = GetKey ( pResult->m_iIndexId, pResult->m_iGeneration, q );
+	return true;
+}
+
+void Qcache_c::Insert ( QcacheEntry_c * pResult )
+{
+	// do not cache too fast queries or too big rsets, for obvious reasons
+	if ( pResult->m_iElapsedMsec < m_iThreshMs || pResult->GetSize() > m_iMaxBytes )
+		return;
 
 	pResult->AddRef();
-	pResult->m_Key = GetKey ( pResult->m_iIndexId, q );
 
 	ScopedMutex_t dLock (m_tLock);
 
@@ -418,7 +432,7 @@ void Qcache_c::Add ( const CSphQuery & q, QcacheEntry_c * pResult, const ISphSch
 	EnforceLimits ( true );
 }
 
-QcacheEntry_c * Qcache_c::Find ( int64_t iIndexId, const CSphQuery & q, const ISphSchema & tSorterSchema )
+QcacheEntry_c * Qcache_c::Find ( int64_t iIndexId, int64_t iGeneration, const CSphQuery & q, const ISphSchema & tSorterSchema )
 {
 	if ( m_iMaxBytes<=0 )
 		return nullptr;
@@ -426,7 +440,7 @@ QcacheEntry_c * Qcache_c::Find ( int64_t iIndexId, const CSphQuery & q, const IS
 	if ( !CanCacheQuery(q) )
 		return nullptr;
 
-	uint64_t k = GetKey ( iIndexId, q );
+	uint64_t k = GetKey ( iIndexId, iGeneration, q );
 
 	bool bFilterHashesCalculated = false;
 	CSphVector<uint64_t> dFilters;
@@ -489,13 +503,15 @@ QcacheEntry_c * Qcache_c::Find ( int64_t iIndexId, const CSphQuery & q, const IS
 	return p;
 }
 
-uint64_t Qcache_c::GetKey ( int64_t iIndexId, const CSphQuery & q )
+uint64_t Qcache_c::GetKey ( int64_t iIndexId, int64_t iGeneration, const CSphQuery & q )
 {
 	// query cache key combines a bunch of data affecting things:
 	// - index id
+	// - index update generation (entries built before attribute updates are not reused)
 	// - MATCH() part
 	// - ranker
 	uint64_t k = sphFNV64 ( &iIndexId, sizeof(iIndexId) );
+	k = sphFNV64 ( &iGeneration, sizeof(iGeneration), k );
 	k = sphFNV64cont ( q.m_sQuery.cstr(), k );
 	k = sphFNV64 ( &q.m_eRanker, 1, k );
 	if ( q.m_eRanker==SPH_RANK_EXPR )
@@ -670,14 +686,46 @@ int QcacheRanker_c::GetMatches()
 
 //////////////////////////////////////////////////////////////////////////
 
+QcacheCollector_c::~QcacheCollector_c()
+{
+	ScopedMutex_t dLock ( m_tLock );
+	for ( auto & pEntry : m_dEntries )
+		SafeRelease ( pEntry );
+}
+
+void QcacheCollector_c::Add ( const CSphQuery & q, QcacheEntry_c * pResult, const ISphSchema & tSorterSchema )
+{
+	if ( !g_Qcache.Prepare ( q, pResult, tSorterSchema ) )
+		return;
+
+	pResult->AddRef();
+	ScopedMutex_t dLock ( m_tLock );
+	m_dEntries.Add ( pResult );
+}
+
+void QcacheCollector_c::Commit ( int iElapsedMsec )
+{
+	ScopedMutex_t dLock ( m_tLock );
+	for ( auto & pEntry : m_dEntries )
+	{
+		// each segment entry is as valuable as the whole query it saves
+		pEntry->m_iElapsedMsec = Max ( pEntry->m_iElapsedMsec, iElapsedMsec );
+		g_Qcache.Insert ( pEntry );
+		SafeRelease ( pEntry );
+	}
+	m_dEntries.Reset();
+}
+
+//////////////////////////////////////////////////////////////////////////
+
 void QcacheAdd ( const CSphQuery & q, QcacheEntry_c * pResult, const ISphSchema & tSorterSchema )
 {
 	return g_Qcache.Add ( q, pResult, tSorterSchema );
 }
 
-QcacheEntry_c * QcacheFind ( int64_t iIndexId, const CSphQuery & q, const ISphSchema & tSorterSchema )
+QcacheEntry_c * QcacheFind ( int64_t iIndexId, int64_t iGeneration, const CSphQuery & q, const ISphSchema & tSorterSchema )
 {
-	return g_Qcache.Find ( iIndexId, q, tSorterSchema );
+	return g_Qcache.Find ( iIndexId, iGeneration, q, tSorterSchema );
 }
 
 std::unique_ptr<ISphRanker> QcacheRanker ( QcacheEntry_c * pEntry, const ISphQwordSetup & tSetup )
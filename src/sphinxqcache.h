@@ -32,6 +32,7 @@ class QcacheEntry_c : public ISphRefcountedMT
 
 public:
 	int64_t						m_iIndexId = -1;
+	int64_t						m_iGeneration = 0;	///< index update generation the entry was built with
 	int64_t						m_tmStarted { sphMicroTimer() };
 	int							m_iElapsedMsec = 0;
 	CSphVector<uint64_t>		m_dFilters;			///< hashes of the filters that were applied to cached query
@@ -80,8 +81,25 @@ struct QcacheStatus_t
 };
 
 
+/// collects entries of a query over several immutable segments (like disk chunks of RT table)
+/// every entry is still keyed by its own segment, but caching decision is made once for the whole query,
+/// so that query over many chunks, each of them being fast, still gets cached
+class QcacheCollector_c : public ISphNoncopyable
+{
+public:
+								~QcacheCollector_c();
+
+	void						Add ( const CSphQuery & q, QcacheEntry_c * pResult, const ISphSchema & tSorterSchema ) EXCLUDES ( m_tLock );
+	void						Commit ( int iElapsedMsec ) EXCLUDES ( m_tLock );
+
+private:
+	CSphMutex					m_tLock;
+	CSphVector<QcacheEntry_c*>	m_dEntries GUARDED_BY ( m_tLock );
+};
+
+
 void					QcacheAdd ( const CSphQuery & q, QcacheEntry_c * pResult, const ISphSchema & tSorterSchema );
-QcacheEntry_c *			QcacheFind ( int64_t iIndexId, const CSphQuery & q, const ISphSchema & tSorterSchema );
+QcacheEntry_c *			QcacheFind ( int64_t iIndexId, int64_t iGeneration, const CSphQuery & q, const ISphSchema & tSorterSchema );
 std::unique_ptr<ISphRanker>			QcacheRanker ( QcacheEntry_c * pEntry, const ISphQwordSetup & tSetup );
 const QcacheStatus_t &	QcacheGetStatus();
 void					QcacheSetup ( int64_t iMaxBytes, int iThreshMsec, int iTtlSec );
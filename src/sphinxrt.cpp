@@ -27,6 +27,7 @@
 #include "indexcheck.h"
 #include "indexsettings.h"
 #include "indexformat.h"
+#include "std/bitpack.h"
 #include "coroutine.h"
 #include "mini_timer.h"
 #include "binlog.h"
@@ -86,6 +87,7 @@ constexpr int MAX_SEGMENTS						= 32;
 constexpr int MAX_PROGRESSION_SEGMENT			= 8;
 constexpr int64_t MAX_SEGMENT_VECTOR_LEN		= INT_MAX;
 constexpr int MAX_TOLERATE_LOAD_SEGMENTS		= MAX_SEGMENTS * ( SIMULTANEOUS_SAVE_LIMIT + 1 );	///< if on load N of segments exceedes this value - perform safe loading
+constexpr DWORD MIN_KNN_GRAPH_ROWS				= 1024;		///< smaller segments have no hnsw graphs, brute force over them is cheaper than building one on every commit
 
 //////////////////////////////////////////////////////////////////////////
 
@@ -327,6 +329,7 @@ void RtSegment_t::UpdateUsedRam() const NO_THREAD_SAFETY_ANALYSIS
 	iUsedRam += m_dInfixFilterCP.AllocatedBytes();
 	iUsedRam += m_pDocstore ? m_pDocstore->AllocatedBytes() : 0;
 	iUsedRam += m_pColumnar ? m_pColumnar->AllocatedBytes() : 0;
+	iUsedRam += m_pKNN ? m_pKNN->AllocatedBytes() : 0;
 	FixupRAMCounter ( iUsedRam - std::exchange ( m_iUsedRam, iUsedRam ) );
 }
 
@@ -454,42 +457,203 @@ void RtSegment_t::BuildDocID2RowIDMap ( const CSphSchema & tSchema )
 	}
 }
 
+
+void RtSegment_t::BuildKNN ( const CSphSchema & tSchema )
+{
+	m_pKNN.reset();
+	if ( m_uRows<MIN_KNN_GRAPH_ROWS )
+		return;
+
+	m_pKNN = CreateKNNRT(tSchema);
+	if ( !m_pKNN )
+		return;
+
+	FakeRL_t _ {m_tLock}; // called during build/merge/load when segment is not yet published
+	int iStride = GetStride();
+	auto dColumnarIterators = CreateAllColumnarIterators ( m_pColumnar.get(), tSchema );
+	for ( RowID_t tRowID = 0; tRowID<m_uRows; tRowID++ )
+		if ( !m_tDeadRowMap.IsSet(tRowID) )
+			m_pKNN->AddDoc ( tRowID, m_dRows.Begin() + (int64_t)tRowID*iStride, m_dBlobs.Begin(), dColumnarIterators );
+}
+
+
+void RtSegment_t::MergeKNN ( const RtSegment_t & tA, const RtSegment_t & tB, const VecTraits_T<RowID_t> & dRowMapA, const VecTraits_T<RowID_t> & dRowMapB, const CSphSchema & tSchema )
+{
+	// take over the graphs of the larger segment and add rows of the smaller one
+	// rebuild from scratch if too many of the inherited vectors are gone
+	const float MAX_DELETED_RATIO = 0.25f;
+
+	bool bBaseA = tA.m_uRows>=tB.m_uRows;
+	const RtSegment_t & tBase = bBaseA ? tA : tB;
+	if ( !tBase.m_pKNN )
+	{
+		BuildKNN(tSchema);
+		return;
+	}
+
+	// source segments are still searched until the merged one is published, so their graphs can't be taken over in place;
+	// a copy is a few flat arrays, re-inserting the vectors costs a graph search per each of them
+	auto pKNN = tBase.m_pKNN->Clone();
+	pKNN->RemapRows ( bBaseA ? dRowMapA : dRowMapB );
+	if ( !pKNN->Relocate(tSchema) || pKNN->GetDeletedRatio() > MAX_DELETED_RATIO )
+	{
+		BuildKNN(tSchema);
+		return;
+	}
+
+	FakeRL_t _ {m_tLock};
+	int iStride = GetStride();
+	auto dColumnarIterators = CreateAllColumnarIterators ( m_pColumnar.get(), tSchema );
+	for ( auto tRowID : bBaseA ? dRowMapB : dRowMapA )
+		if ( tRowID!=INVALID_ROWID )
+			pKNN->AddDoc ( tRowID, m_dRows.Begin() + (int64_t)tRowID*iStride, m_dBlobs.Begin(), dColumnarIterators );
+
+	m_pKNN = std::move(pKNN);
+}
+
+
+void RtSegment_t::RelocateKNN ( const CSphSchema & tSchema )
+{
+	if ( m_pKNN && m_pKNN->Relocate(tSchema) )
+		return;
+
+	BuildKNN(tSchema);
+}
+
 //////////////////////////////////////////////////////////////////////////
 
-class RtDocWriter_c
+// packed doclist is a sequence of blocks of RT_DOC_BLOCK docs (the last one of a word may be shorter).
+// block starts with 4 bytes of bit widths (rowid deltas, field masks, hit counts, hits), followed by 4 streams,
+// each one is a number of BITPACK_GROUP groups (last group padded with zeroes).
+// rowid deltas are stored minus 1, so that the first rowid of a word (which follows INVALID_ROWID) is stored as is.
+static const int RT_DOC_STREAMS = 4;
+
+static inline int DocBlockGroups ( int iDocs )
 {
-	CSphTightVector<BYTE> &		m_dDocs;
-	RowID_t						m_tLastRowID {INVALID_ROWID};
+	return ( iDocs + BITPACK_GROUP - 1 ) / BITPACK_GROUP;
+}
 
-public:
-	explicit RtDocWriter_c ( CSphTightVector<BYTE> & dDocs )
-		: m_dDocs ( dDocs )
-	{}
+// whole block size, or -1 if widths are broken
+static int DocBlockBytes ( const BYTE * pWidths, int iDocs )
+{
+	int iBytes = 0;
+	for ( int iStream = 0; iStream<RT_DOC_STREAMS; ++iStream )
+	{
+		if ( pWidths[iStream]>32 )
+			return -1;
+		iBytes += BitpackGroupBytes ( pWidths[iStream] );
+	}
+	return RT_DOC_STREAMS + iBytes*DocBlockGroups ( iDocs );
+}
+
+static const BYTE * UnzipDocBlock ( const BYTE * pIn, int iDocs, RtDocBlock_t & tBlock, RowID_t tLastRowID )
+{
+	assert ( iDocs>0 && iDocs<=RT_DOC_BLOCK );
+	const BYTE * pWidths = pIn;
+	pIn += RT_DOC_STREAMS;
 
-	inline void operator<< ( const RtDoc_t & tDoc)
+	int iGroups = DocBlockGroups ( iDocs );
+	DWORD * dStreams[RT_DOC_STREAMS] = { tBlock.m_dRowIDs, tBlock.m_dDocFields, tBlock.m_dHits, tBlock.m_dHit };
+	for ( int iStream = 0; iStream<RT_DOC_STREAMS; ++iStream )
 	{
-		m_dDocs.ReserveGap ( 5 + 5 * sizeof ( DWORD ) );
-		ZipDword ( m_dDocs, tDoc.m_tRowID - std::exchange ( m_tLastRowID, tDoc.m_tRowID ) );
-		ZipDword ( m_dDocs, tDoc.m_uDocFields );
-		ZipDword ( m_dDocs, tDoc.m_uHits );
-		if ( tDoc.m_uHits == 1 )
+		int iWidth = pWidths[iStream];
+		for ( int i = 0; i<iGroups; ++i )
 		{
-			ZipDword ( m_dDocs, tDoc.m_uHit & 0xffffffUL );
-			ZipDword ( m_dDocs, tDoc.m_uHit >> 24 );
-		} else
-			ZipDword ( m_dDocs, tDoc.m_uHit );
+			BitunpackGroup ( pIn, dStreams[iStream] + i*BITPACK_GROUP, iWidth );
+			pIn += BitpackGroupBytes ( iWidth );
+		}
 	}
 
-	DWORD WriterPos () const
+	RowID_t tRowID = tLastRowID;
+	for ( int i = 0; i<iDocs; ++i )
 	{
-		return m_dDocs.GetLength();
+		tRowID += tBlock.m_dRowIDs[i] + 1;
+		tBlock.m_dRowIDs[i] = tRowID;
 	}
 
-	void ZipRestart ()
+	return pIn;
+}
+
+
+RtDocWriter_c::RtDocWriter_c ( CSphTightVector<BYTE> & dDocs, RtDocFormat_e eFormat )
+	: m_dDocs ( dDocs )
+	, m_eFormat ( eFormat )
+{}
+
+RtDocWriter_c::~RtDocWriter_c()
+{
+	ZipBlock();
+}
+
+void RtDocWriter_c::operator<< ( const RtDoc_t & tDoc )
+{
+	if ( m_eFormat==RtDocFormat_e::PACKED )
 	{
-		m_tLastRowID = INVALID_ROWID;
+		assert ( m_tLastRowID==INVALID_ROWID || tDoc.m_tRowID>m_tLastRowID );
+		m_tBlock.m_dRowIDs[m_iBlockDocs] = tDoc.m_tRowID - std::exchange ( m_tLastRowID, tDoc.m_tRowID ) - 1;
+		m_tBlock.m_dDocFields[m_iBlockDocs] = tDoc.m_uDocFields;
+		m_tBlock.m_dHits[m_iBlockDocs] = tDoc.m_uHits;
+		m_tBlock.m_dHit[m_iBlockDocs] = tDoc.m_uHit;
+		if ( ++m_iBlockDocs==RT_DOC_BLOCK )
+			ZipBlock();
+		return;
 	}
-};
+
+	m_dDocs.ReserveGap ( 5 + 5 * sizeof ( DWORD ) );
+	ZipDword ( m_dDocs, tDoc.m_tRowID - std::exchange ( m_tLastRowID, tDoc.m_tRowID ) );
+	ZipDword ( m_dDocs, tDoc.m_uDocFields );
+	ZipDword ( m_dDocs, tDoc.m_uHits );
+	if ( tDoc.m_uHits == 1 )
+	{
+		ZipDword ( m_dDocs, tDoc.m_uHit & 0xffffffUL );
+		ZipDword ( m_dDocs, tDoc.m_uHit >> 24 );
+	} else
+		ZipDword ( m_dDocs, tDoc.m_uHit );
+}
+
+void RtDocWriter_c::ZipBlock()
+{
+	if ( !m_iBlockDocs )
+		return;
+
+	int iGroups = DocBlockGroups ( m_iBlockDocs );
+	DWORD * dStreams[RT_DOC_STREAMS] = { m_tBlock.m_dRowIDs, m_tBlock.m_dDocFields, m_tBlock.m_dHits, m_tBlock.m_dHit };
+	BYTE dWidths[RT_DOC_STREAMS];
+	int iBytes = 0;
+	for ( int iStream = 0; iStream<RT_DOC_STREAMS; ++iStream )
+	{
+		DWORD * pStream = dStreams[iStream];
+		for ( int i = m_iBlockDocs; i<iGroups*BITPACK_GROUP; ++i )
+			pStream[i] = 0;
+
+		dWidths[iStream] = (BYTE)BitpackWidth ( pStream, m_iBlockDocs );
+		iBytes += iGroups*BitpackGroupBytes ( dWidths[iStream] );
+	}
+
+	BYTE * pOut = m_dDocs.AddN ( RT_DOC_STREAMS + iBytes );
+	memcpy ( pOut, dWidths, RT_DOC_STREAMS );
+	pOut += RT_DOC_STREAMS;
+	for ( int iStream = 0; iStream<RT_DOC_STREAMS; ++iStream )
+		for ( int i = 0; i<iGroups; ++i )
+		{
+			BitpackGroup ( dStreams[iStream] + i*BITPACK_GROUP, pOut, dWidths[iStream] );
+			pOut += BitpackGroupBytes ( dWidths[iStream] );
+		}
+
+	m_iBlockDocs = 0;
+}
+
+DWORD RtDocWriter_c::WriterPos () const
+{
+	assert ( !m_iBlockDocs );
+	return m_dDocs.GetLength();
+}
+
+void RtDocWriter_c::ZipRestart ()
+{
+	ZipBlock();
+	m_tLastRowID = INVALID_ROWID;
+}
 
 
 RtDocReader_c::RtDocReader_c ( const RtSegment_t * pSeg, const RtWord_t & tWord )
@@ -502,12 +666,36 @@ void RtDocReader_c::Init ( const RtSegment_t* pSeg, const RtWord_t& tWord )
 	m_pDocs = ( pSeg->m_dDocs.begin() ? pSeg->m_dDocs.begin() + tWord.m_uDoc : nullptr );
 	m_iLeft = tWord.m_uDocs;
 	m_tDoc.m_tRowID = INVALID_ROWID;
+	m_eFormat = pSeg->m_eDocFormat;
+	m_iBlockDoc = m_iBlockDocs = 0;
+}
+
+void RtDocReader_c::UnzipBlock ()
+{
+	m_iBlockDocs = Min ( m_iLeft, RT_DOC_BLOCK );
+	m_iBlockDoc = 0;
+	m_pDocs = UnzipDocBlock ( m_pDocs, m_iBlockDocs, m_tBlock, m_tDoc.m_tRowID );
 }
 
 bool RtDocReader_c::UnzipDoc ()
 {
 	if ( !m_iLeft || !m_pDocs )
 		return false;
+
+	if ( m_eFormat==RtDocFormat_e::PACKED )
+	{
+		if ( m_iBlockDoc==m_iBlockDocs )
+			UnzipBlock();
+
+		m_tDoc.m_tRowID = m_tBlock.m_dRowIDs[m_iBlockDoc];
+		m_tDoc.m_uDocFields = m_tBlock.m_dDocFields[m_iBlockDoc];
+		m_tDoc.m_uHits = m_tBlock.m_dHits[m_iBlockDoc];
+		m_tDoc.m_uHit = m_tBlock.m_dHit[m_iBlockDoc];
+		++m_iBlockDoc;
+		--m_iLeft;
+		return true;
+	}
+
 	const BYTE* pIn = m_pDocs;
 	m_tDoc.m_tRowID += UnzipDword ( pIn );
 	UnzipDword ( &m_tDoc.m_uDocFields, pIn );
@@ -1493,7 +1681,7 @@ private:
 	void						SetMemLimit ( int64_t iMemLimit );
 	void						RecalculateRateLimit ( int64_t iSaved, int64_t iInserted, bool bEmergent );
 	void						AlterSave ( bool bSaveRam );
-	bool 						BinlogCommit ( RtSegment_t * pSeg, const VecTraits_T<DocID_t> & dKlist, int64_t iAddTotalBytes, CSphString & sError );
+	bool 						BinlogCommit ( RtSegment_t * pSeg, const VecTraits_T<DocID_t> & dKlist, int64_t iAddTotalBytes, int64_t * pSyncPos, CSphString & sError );
 	bool						StopOptimize();
 	void						UpdateUnlockedCount();
 	bool						CheckSegmentConsistency ( const RtSegment_t* pNewSeg, bool bSilent=true ) const;
@@ -2239,6 +2427,7 @@ RtSegment_t * CreateSegment ( RtAccum_t* pAcc, int iWordsCheckpoint, ESphHitless
 	}
 
 	pSeg->BuildDocID2RowIDMap ( pAcc->m_pIndex->GetInternalSchema() );
+	pSeg->BuildKNN ( pAcc->m_pIndex->GetInternalSchema() );
 	pAcc->m_tNextRowID = 0;
 
 	return pSeg;
@@ -2355,7 +2544,7 @@ void RtIndex_c::DeleteFieldFromDict ( RtSegment_t * pSeg, int iKillField )
 		tOutWord = *tInWord;
 		tOutWord.m_uDocs = tOutWord.m_uHits = 0;
 
-		RtDocWriter_c tOutDocs ( dDocs );
+		RtDocWriter_c tOutDocs ( dDocs, tInSeg.m_eDocFormat );
 		tOutWord.m_uDoc = tOutDocs.WriterPos();
 
 		RtDocReader_c tInDocs ( &tInSeg, *tInWord );
@@ -2434,6 +2623,51 @@ private:
 	RowID_t NextAliveRow ( RowID_t tRowID ) const { return SkipDeadRows ( tRowID+1 ); }
 };
 
+// iterate over alive rows, or over a preselected (sorted) subset of them
+class RtScanRows_c
+{
+public:
+	class Iterator_c
+	{
+	public:
+		Iterator_c ( RtLiveRows_c::Iterator_c tLive, const RowID_t * pRow, bool bSubset )
+			: m_tLive ( tLive )
+			, m_pRow ( pRow )
+			, m_bSubset ( bSubset )
+		{}
+
+		RowID_t operator*() const { return m_bSubset ? *m_pRow : *m_tLive; }
+		bool operator!= ( const Iterator_c & rhs ) const { return m_bSubset ? m_pRow!=rhs.m_pRow : m_tLive!=rhs.m_tLive; }
+
+		Iterator_c & operator++ ()
+		{
+			if ( m_bSubset )
+				++m_pRow;
+			else
+				++m_tLive;
+
+			return *this;
+		}
+
+	private:
+		RtLiveRows_c::Iterator_c	m_tLive;
+		const RowID_t *				m_pRow = nullptr;
+		bool						m_bSubset = false;
+	};
+
+	RtScanRows_c ( const RtSegment_t & tSeg, const VecTraits_T<RowID_t> * pRows )
+		: m_tLiveRows ( tSeg )
+		, m_pRows ( pRows )
+	{}
+
+	Iterator_c begin() const { return { m_tLiveRows.begin(), m_pRows ? m_pRows->Begin() : nullptr, !!m_pRows }; }
+	Iterator_c end() const { return { m_tLiveRows.end(), m_pRows ? m_pRows->Begin()+m_pRows->GetLength() : nullptr, !!m_pRows }; }
+
+private:
+	RtLiveRows_c				m_tLiveRows;
+	const VecTraits_T<RowID_t> * m_pRows = nullptr;
+};
+
 template <typename BLOOM_TRAITS>
 inline bool BuildBloom_T ( const BYTE * sWord, int iLen, int iInfixCodepointCount, bool bUtf8, int iKeyValCount, BLOOM_TRAITS & tBloom )
 {
@@ -2603,7 +2837,7 @@ void RtIndex_c::MergeKeywords ( RtSegment_t & tSeg, const RtSegment_t & tSeg1, c
 	tSeg.m_dDocs.Reserve ( Max ( tSeg1.m_dDocs.GetLength(), tSeg2.m_dDocs.GetLength() ) );
 	tSeg.m_dHits.Reserve ( Max ( tSeg1.m_dHits.GetLength(), tSeg2.m_dHits.GetLength() ) );
 
-	RtDocWriter_c tOutDoc ( tSeg.m_dDocs );
+	RtDocWriter_c tOutDoc ( tSeg.m_dDocs, tSeg.m_eDocFormat );
 	RtWordWriter_c tOut ( tSeg.m_dWords, tSeg.m_dWordCheckpoints, tSeg.m_dKeywordCheckpoints, m_bKeywordDict, m_iWordsCheckpoint, m_tSettings.m_eHitless );
 	RtWordReader_c tIn1 ( &tSeg1, m_bKeywordDict, m_iWordsCheckpoint, m_tSettings.m_eHitless );
 	RtWordReader_c tIn2 ( &tSeg2, m_bKeywordDict, m_iWordsCheckpoint, m_tSettings.m_eHitless );
@@ -2667,6 +2901,9 @@ RtSegment_t* RtIndex_c::MergeTwoSegments ( const RtSegment_t* pA, const RtSegmen
 	auto * pSeg = new RtSegment_t (0, m_tSchema);
 	FakeWL_t _ { pSeg->m_tLock }; // as pSeg is just created - we don't need real guarding and use fake lock to mute thread safety warnings
 
+	// fresh segments are always varint (they also go to binlog as is), merged ones use the table's doclist format
+	pSeg->m_eDocFormat = m_tMutableSettings.m_eDocFormat;
+
 	assert ( !!pA->m_pDocstore==!!pB->m_pDocstore );
 	if ( ( m_tSchema.HasStoredFields() || m_tSchema.HasStoredAttrs() ) && pA->m_pDocstore && pB->m_pDocstore )
 		pSeg->SetupDocstore ( &m_tSchema );
@@ -2695,6 +2932,7 @@ RtSegment_t* RtIndex_c::MergeTwoSegments ( const RtSegment_t* pA, const RtSegmen
 
 	assert ( pSeg->GetStride() == m_iStride );
 	pSeg->BuildDocID2RowIDMap ( m_tSchema );
+	pSeg->MergeKNN ( *pA, *pB, dRowMapA, dRowMapB, m_tSchema );
 	MergeKeywords ( *pSeg, *pA, *pB, dRowMapA, dRowMapB );
 
 	if ( m_bKeywordDict )
@@ -3287,49 +3525,56 @@ bool RtIndex_c::CommitReplayable ( RtSegment_t * pNewSeg, const VecTraits_T<DocI
 	if ( pNewSeg && !CheckSegmentConsistency ( pNewSeg, false ) )
 		DumpInsert ( pNewSeg );
 
-	// We're going to modify segments, so fall into serial fiber. From here no concurrent changes may happen
-	ScopedScheduler_c tSerialFiber { m_tWorkers.SerialChunkAccess() };
-
-	// for pure kills it is not necessary to wait, as it can't increase N of segments.
-	if ( pNewSeg )
+	// with binlog_flush=1 the txn is synced only after we leave serial fiber, so that next commits to this table may join the same fsync
+	int64_t iSyncPos = 0;
 	{
-		TRACE_VARID ( "rt", "wait_segments", iId );
-		m_tUnLockedSegments.Wait ( [] ( int iVals ) { return iVals < MAX_SEGMENTS; } );
-	}
-
-	TRACE_VARID ( "rt", "CommitReplayable.serial", iId );
+		// We're going to modify segments, so fall into serial fiber. From here no concurrent changes may happen
+		ScopedScheduler_c tSerialFiber { m_tWorkers.SerialChunkAccess() };
 
-	RTLOGV << "CommitReplayable";
+		// for pure kills it is not necessary to wait, as it can't increase N of segments.
+		if ( pNewSeg )
+		{
+			TRACE_VARID ( "rt", "wait_segments", iId );
+			m_tUnLockedSegments.Wait ( [] ( int iVals ) { return iVals < MAX_SEGMENTS; } );
+		}
 
-	// first of all, binlog txn data for recovery
-	if ( !BinlogCommit ( pNewSeg, dAccKlist, iAddTotalBytes, sError ) )
-		return false;
+		TRACE_VARID ( "rt", "CommitReplayable.serial", iId );
 
-	// 1. Apply kill-list to existing chunks/segments
-	iTotalKilled = ApplyKillList ( dAccKlist );
+		RTLOGV << "CommitReplayable";
 
-	// 2. Add new RAM-segment (if any). As we 1-st kill, then add - whole change is *not* atomic, ACID is broken here.
-	if ( pNewSeg )
-	{
-		auto tNewState = RtWriter();
-		tNewState.InitRamSegs ( RtWriter_c::copy );
-		tNewState.m_pNewRamSegs->Add ( AdoptSegment ( pNewSeg ) );
-	}
+		// first of all, binlog txn data for recovery
+		if ( !BinlogCommit ( pNewSeg, dAccKlist, iAddTotalBytes, &iSyncPos, sError ) )
+			return false;
 
-	// update stats
-	m_tStats.m_iTotalDocuments += iNewDocs - iTotalKilled;
-	m_tStats.m_iTotalBytes += iAddTotalBytes;
+		// 1. Apply kill-list to existing chunks/segments
+		iTotalKilled = ApplyKillList ( dAccKlist );
 
-	if ( dLens.GetLength() )
-		for ( int i = 0; i < m_tSchema.GetFieldsCount(); ++i )
+		// 2. Add new RAM-segment (if any). As we 1-st kill, then add - whole change is *not* atomic, ACID is broken here.
+		if ( pNewSeg )
 		{
-			m_dFieldLensRam[i] += dLens[i];
-			m_dFieldLens[i] = m_dFieldLensRam[i] + m_dFieldLensDisk[i];
+			auto tNewState = RtWriter();
+			tNewState.InitRamSegs ( RtWriter_c::copy );
+			tNewState.m_pNewRamSegs->Add ( AdoptSegment ( pNewSeg ) );
 		}
 
-	// backoff segments merging and m.b. saving disk chunk (that is not our deal, other worker will do it).
-	StartMergeSegments ( pNewSeg ? MergeSeg_e::NEWSEG : MergeSeg_e::KILLED );
+		// update stats
+		m_tStats.m_iTotalDocuments += iNewDocs - iTotalKilled;
+		m_tStats.m_iTotalBytes += iAddTotalBytes;
+
+		if ( dLens.GetLength() )
+			for ( int i = 0; i < m_tSchema.GetFieldsCount(); ++i )
+			{
+				m_dFieldLensRam[i] += dLens[i];
+				m_dFieldLens[i] = m_dFieldLensRam[i] + m_dFieldLensDisk[i];
+			}
+
+		// backoff segments merging and m.b. saving disk chunk (that is not our deal, other worker will do it).
+		StartMergeSegments ( pNewSeg ? MergeSeg_e::NEWSEG : MergeSeg_e::KILLED );
+	}
 
+	// the change is already visible, as with binlog_flush=2; the client just doesn't get OK until it is on disk.
+	// If the sync fails, the daemon dies instead of keeping a live change which is not durable
+	Binlog::WaitSynced ( GetName(), iSyncPos );
 	return true;
 }
 
@@ -3714,6 +3959,7 @@ bool RtIndex_c::WriteDocs ( SaveDiskDataContext_t & tCtx, CSphWriter & tWriterDi
 				++iDocs;
 				iHits += pDoc->m_uHits;
 				tSkiplistRowID = tRowID;
+				dSkiplist.Last().m_uMaxHits = Max ( dSkiplist.Last().m_uMaxHits, pDoc->m_uHits );
 
 				tWriterDocs.ZipOffset ( tRowID - std::exchange ( tLastRowID, tRowID ) );
 				tWriterDocs.ZipInt ( pDoc->m_uHits );
@@ -3741,6 +3987,9 @@ bool RtIndex_c::WriteDocs ( SaveDiskDataContext_t & tCtx, CSphWriter & tWriterDi
 
 		// write skiplist
 		int64_t iSkiplistOff = tWriterSkips.GetPos();
+		if ( dSkiplist.GetLength()>1 )
+			tWriterSkips.ZipInt ( dSkiplist[0].m_uMaxHits );
+
 		for ( int i=1; i<dSkiplist.GetLength(); ++i )
 		{
 			const SkiplistEntry_t & tPrev = dSkiplist[i-1];
@@ -3750,6 +3999,7 @@ bool RtIndex_c::WriteDocs ( SaveDiskDataContext_t & tCtx, CSphWriter & tWriterDi
 			tWriterSkips.ZipInt ( tCur.m_tBaseRowIDPlus1 - tPrev.m_tBaseRowIDPlus1 - iSkiplistBlockSize );
 			tWriterSkips.ZipOffset ( tCur.m_iOffset - tPrev.m_iOffset - 4*iSkiplistBlockSize );
 			tWriterSkips.ZipOffset ( tCur.m_iBaseHitlistPos - tPrev.m_iBaseHitlistPos );
+			tWriterSkips.ZipInt ( tCur.m_uMaxHits );
 		}
 
 		// write dict entry if necessary
@@ -4869,11 +5119,14 @@ static bool LoadVector ( CSphReader & tReader, CSphVector < T, P > & tVector,
 	return true;
 }
 
+// RAM chunk header flags; no flags means a chunk written before the flags were introduced
+static const DWORD RAMCHUNK_HAS_DOC_FORMAT = 1;	///< segment headers carry RtDocFormat_e
+
 void RtIndex_c::SaveRamSegment ( const RtSegment_t* pSeg, CSphWriter& wrChunk ) const REQUIRES_SHARED ( pSeg->m_tLock )
 {
 	wrChunk.PutDword ( pSeg->m_uRows );
 	wrChunk.PutDword ( (DWORD)pSeg->m_tAliveRows.load ( std::memory_order_relaxed ) );
-	wrChunk.PutDword ( 0 );
+	wrChunk.PutDword ( (DWORD)pSeg->m_eDocFormat );
 	SaveVector ( wrChunk, pSeg->m_dWords );
 	if ( m_bKeywordDict )
 		SaveVector ( wrChunk, pSeg->m_dKeywordCheckpoints );
@@ -4930,7 +5183,7 @@ bool RtIndex_c::SaveRamChunk ()
 
 	auto pSegments = m_tRtChunks.RamSegs();
 	auto& dSegments = *pSegments;
-	wrChunk.PutDword ( 0 );
+	wrChunk.PutDword ( RAMCHUNK_HAS_DOC_FORMAT );
 	wrChunk.PutDword ( dSegments.GetLength() );
 
 	// no locks here, because it's only intended to be called from dtor
@@ -4973,7 +5226,7 @@ bool RtIndex_c::LoadRamChunk ( DWORD uVersion, bool bRebuildInfixes, bool bFixup
 	int64_t iFileSize = rdChunk.GetFilesize();
 
 	bool bHasMorphology = ( m_pDict && m_pDict->HasMorphology() ); // fresh and old-format index still has no dictionary at this point
-	rdChunk.GetDword ();
+	DWORD uChunkFlags = rdChunk.GetDword ();
 
 	auto iSegmentCount = (int) rdChunk.GetDword();
 	if ( !CheckVectorLength<RtSegVec_c::BASE> ( iSegmentCount, iFileSize, "ram-chunks", m_sLastError ) )
@@ -4996,7 +5249,16 @@ bool RtIndex_c::LoadRamChunk ( DWORD uVersion, bool bRebuildInfixes, bool bFixup
 		RtSegmentRefPtf_t pSeg { new RtSegment_t ( uRows, m_tSchema ) };
 		pSeg->m_tAliveRows.store ( rdChunk.GetDword (), std::memory_order_relaxed );
 
-		rdChunk.GetDword ();
+		DWORD uDocFormat = rdChunk.GetDword ();
+		if ( uChunkFlags & RAMCHUNK_HAS_DOC_FORMAT )
+		{
+			if ( uDocFormat>(DWORD)RtDocFormat_e::PACKED )
+			{
+				m_sLastError.SetSprintf ( "unknown RAM segment doclist format %u", uDocFormat );
+				return false;
+			}
+			pSeg->m_eDocFormat = (RtDocFormat_e)uDocFormat;
+		}
 		if ( !LoadVector ( rdChunk, pSeg->m_dWords, iFileSize, "ram-words", m_sLastError ) )
 			return false;
 
@@ -5058,6 +5320,7 @@ bool RtIndex_c::LoadRamChunk ( DWORD uVersion, bool bRebuildInfixes, bool bFixup
 			BuildSegmentInfixes ( pSeg, bHasMorphology, m_bKeywordDict, m_tSettings.m_iMinInfixLen, m_iWordsCheckpoint, ( m_iMaxCodepointLength>1 ), m_tSettings.m_eHitless );
 
 		pSeg->BuildDocID2RowIDMap(m_tSchema);
+		pSeg->BuildKNN(m_tSchema);
 
 		CheckSegmentConsistency ( pSeg );
 
@@ -5300,6 +5563,8 @@ void RtIndex_c::DebugCheckRamSegment ( const RtSegment_t & tSegment, int iSegmen
 	const BYTE * pCurHit = tSegment.m_dHits.Begin();
 	const BYTE * pMaxHit = pCurHit+tSegment.m_dHits.GetLength();
 
+	const bool bPacked = tSegment.m_eDocFormat==RtDocFormat_e::PACKED;
+
 	CSphVector<RtWordCheckpoint_t> dRefCheckpoints;
 	int nWordsRead = 0;
 	int nCheckpointWords = 0;
@@ -5504,41 +5769,40 @@ void RtIndex_c::DebugCheckRamSegment ( const RtSegment_t & tSegment, int iSegmen
 		// read all docs from doclist
 		RtDoc_t tDoc;
 		RowID_t tPrevRowID = INVALID_ROWID;
+		RtDocBlock_t tBlock;
+		int iBlockDoc = 0;
+		int iBlockDocs = 0;
 
-		for ( DWORD uDoc=0; uDoc<tWord.m_uDocs && pCurDoc<pMaxDoc; uDoc++ )
+		for ( DWORD uDoc=0; uDoc<tWord.m_uDocs && ( pCurDoc<pMaxDoc || iBlockDoc<iBlockDocs ); uDoc++ )
 		{
 			bool bEmbeddedHit = false;
-			pIn = pCurDoc;
-
-			tDoc.m_tRowID += UnzipDword ( pIn );
-			if ( pIn>=pMaxDoc )
-			{
-				tReporter.Fail ( "reading past doclist end (segment=%d, word=%d, read_wordid=" UINT64_FMT ", read_word=%s, doclist_offset=%u, doclist_size=%d)",
-					iSegment, nWordsRead, (uint64_t)tWord.m_uWordID, szWord, uDocOffset, tSegment.m_dDocs.GetLength() );
-				break;
-			}
-
-			UnzipDword ( &tDoc.m_uDocFields, pIn );
-			if ( pIn>=pMaxDoc )
+			if ( bPacked )
 			{
-				tReporter.Fail ( "reading past doclist end (segment=%d, word=%d, read_wordid=" UINT64_FMT ", read_word=%s, doclist_offset=%u, doclist_size=%d)",
-					iSegment, nWordsRead, (uint64_t)tWord.m_uWordID, szWord, uDocOffset, tSegment.m_dDocs.GetLength() );
-				break;
-			}
-
-			UnzipDword ( &tDoc.m_uHits, pIn );
-			if ( pIn>=pMaxDoc )
-			{
-				tReporter.Fail ( "reading past doclist end (segment=%d, word=%d, read_wordid=" UINT64_FMT ", read_word=%s, doclist_offset=%u, doclist_size=%d)",
-					iSegment, nWordsRead, (uint64_t)tWord.m_uWordID, szWord, uDocOffset, tSegment.m_dDocs.GetLength() );
-				break;
-			}
+				if ( iBlockDoc==iBlockDocs )
+				{
+					iBlockDocs = Min ( int ( tWord.m_uDocs-uDoc ), RT_DOC_BLOCK );
+					iBlockDoc = 0;
+					int iBlockBytes = pCurDoc+RT_DOC_STREAMS<=pMaxDoc ? DocBlockBytes ( pCurDoc, iBlockDocs ) : -1;
+					if ( iBlockBytes<0 || pCurDoc+iBlockBytes>pMaxDoc )
+					{
+						tReporter.Fail ( "broken packed doclist block (segment=%d, word=%d, read_wordid=" UINT64_FMT ", read_word=%s, doclist_offset=%u, doclist_size=%d)",
+							iSegment, nWordsRead, (uint64_t)tWord.m_uWordID, szWord, uDocOffset, tSegment.m_dDocs.GetLength() );
+						break;
+					}
+					pCurDoc = UnzipDocBlock ( pCurDoc, iBlockDocs, tBlock, tDoc.m_tRowID );
+				}
 
-			if ( tDoc.m_uHits==1 )
+				tDoc.m_tRowID = tBlock.m_dRowIDs[iBlockDoc];
+				tDoc.m_uDocFields = tBlock.m_dDocFields[iBlockDoc];
+				tDoc.m_uHits = tBlock.m_dHits[iBlockDoc];
+				tDoc.m_uHit = tBlock.m_dHit[iBlockDoc];
+				bEmbeddedHit = tDoc.m_uHits==1;
+				++iBlockDoc;
+			} else
 			{
-				bEmbeddedHit = true;
+				pIn = pCurDoc;
 
-				auto a = UnzipDword ( pIn );
+				tDoc.m_tRowID += UnzipDword ( pIn );
 				if ( pIn>=pMaxDoc )
 				{
 					tReporter.Fail ( "reading past doclist end (segment=%d, word=%d, read_wordid=" UINT64_FMT ", read_word=%s, doclist_offset=%u, doclist_size=%d)",
@@ -5546,27 +5810,56 @@ void RtIndex_c::DebugCheckRamSegment ( const RtSegment_t & tSegment, int iSegmen
 					break;
 				}
 
-				auto b = UnzipDword ( pIn );
-				if ( pIn>pMaxDoc )
+				UnzipDword ( &tDoc.m_uDocFields, pIn );
+				if ( pIn>=pMaxDoc )
 				{
 					tReporter.Fail ( "reading past doclist end (segment=%d, word=%d, read_wordid=" UINT64_FMT ", read_word=%s, doclist_offset=%u, doclist_size=%d)",
 						iSegment, nWordsRead, (uint64_t)tWord.m_uWordID, szWord, uDocOffset, tSegment.m_dDocs.GetLength() );
 					break;
 				}
 
-				tDoc.m_uHit = HITMAN::Create ( b, a );
-			} else
-			{
-				UnzipDword ( &tDoc.m_uHit, pIn );
-				if ( pIn>pMaxDoc )
+				UnzipDword ( &tDoc.m_uHits, pIn );
+				if ( pIn>=pMaxDoc )
 				{
 					tReporter.Fail ( "reading past doclist end (segment=%d, word=%d, read_wordid=" UINT64_FMT ", read_word=%s, doclist_offset=%u, doclist_size=%d)",
 						iSegment, nWordsRead, (uint64_t)tWord.m_uWordID, szWord, uDocOffset, tSegment.m_dDocs.GetLength() );
 					break;
 				}
-			}
 
-			pCurDoc = pIn;
+				if ( tDoc.m_uHits==1 )
+				{
+					bEmbeddedHit = true;
+
+					auto a = UnzipDword ( pIn );
+					if ( pIn>=pMaxDoc )
+					{
+						tReporter.Fail ( "reading past doclist end (segment=%d, word=%d, read_wordid=" UINT64_FMT ", read_word=%s, doclist_offset=%u, doclist_size=%d)",
+							iSegment, nWordsRead, (uint64_t)tWord.m_uWordID, szWord, uDocOffset, tSegment.m_dDocs.GetLength() );
+						break;
+					}
+
+					auto b = UnzipDword ( pIn );
+					if ( pIn>pMaxDoc )
+					{
+						tReporter.Fail ( "reading past doclist end (segment=%d, word=%d, read_wordid=" UINT64_FMT ", read_word=%s, doclist_offset=%u, doclist_size=%d)",
+							iSegment, nWordsRead, (uint64_t)tWord.m_uWordID, szWord, uDocOffset, tSegment.m_dDocs.GetLength() );
+						break;
+					}
+
+					tDoc.m_uHit = HITMAN::Create ( b, a );
+				} else
+				{
+					UnzipDword ( &tDoc.m_uHit, pIn );
+					if ( pIn>pMaxDoc )
+					{
+						tReporter.Fail ( "reading past doclist end (segment=%d, word=%d, read_wordid=" UINT64_FMT ", read_word=%s, doclist_offset=%u, doclist_size=%d)",
+							iSegment, nWordsRead, (uint64_t)tWord.m_uWordID, szWord, uDocOffset, tSegment.m_dDocs.GetLength() );
+						break;
+					}
+				}
+
+				pCurDoc = pIn;
+			}
 
 			if ( uDoc && tDoc.m_tRowID<=tPrevRowID )
 			{
@@ -6991,22 +7284,15 @@ private:
 class SorterSchemaTransform_c
 {
 public:
-			SorterSchemaTransform_c ( int iNumChunks, bool bFinalizeSorters );
+			SorterSchemaTransform_c ( const RtGuard_t & tGuard, bool bFinalizeSorters );
 
-	void	Set ( int iChunk, const CSphQueryResult & tChunkResult ) { m_dDiskChunkData[iChunk].Set(tChunkResult); }
 	void	Transform ( ISphMatchSorter * pSorter, const RtGuard_t& tGuard );
 
 private:
 	struct DiskChunkData_t
 	{
-		const BYTE *			m_pBlobPool;
-		columnar::Columnar_i *	m_pColumnar;
-
-		void Set ( const CSphQueryResult & tChunkResult )
-		{
-			m_pBlobPool = tChunkResult.m_pBlobPool;
-			m_pColumnar = tChunkResult.m_pColumnar;
-		}
+		const BYTE *			m_pBlobPool = nullptr;
+		columnar::Columnar_i *	m_pColumnar = nullptr;
 	};
 
 	CSphVector<DiskChunkData_t>	m_dDiskChunkData;
@@ -7014,10 +7300,17 @@ private:
 };
 
 
-SorterSchemaTransform_c::SorterSchemaTransform_c ( int iNumChunks, bool bFinalizeSorters )
+// pools are taken from the chunks themselves before search starts; chunk jobs may run in parallel, and must not write here
+SorterSchemaTransform_c::SorterSchemaTransform_c ( const RtGuard_t & tGuard, bool bFinalizeSorters )
 	: m_bFinalizeSorters ( bFinalizeSorters )
 {
-	m_dDiskChunkData.Resize(iNumChunks);
+	m_dDiskChunkData.Resize ( tGuard.m_dDiskChunks.GetLength() );
+	ARRAY_FOREACH ( i, m_dDiskChunkData )
+	{
+		const CSphIndex & tChunk = tGuard.m_dDiskChunks[i]->Cidx();
+		m_dDiskChunkData[i].m_pBlobPool = tChunk.GetRawBlobAttrs();
+		m_dDiskChunkData[i].m_pColumnar = tChunk.GetColumnar();
+	}
 }
 
 
@@ -7085,16 +7378,35 @@ static int64_t CalcMaxCountDistinct ( const CSphQuery & tQuery, const RtGuard_t
 }
 
 
-static bool CalcDiskChunkSplits ( IntVec_t & dThreads, int iJobs, const CSphQuery & tQuery, const CSphMultiQueryArgs & tArgs, const RtGuard_t & tGuard )
+/// a piece of work for disk chunk search: whole chunk, or a rowid range of it (same as pseudo-sharding)
+struct DiskChunkJob_t
 {
-	CSphVector<SplitData_t> dSplitData ( iJobs );
+	int		m_iChunk = 0;
+	int		m_iPart = 0;
+	int		m_iParts = 1;
+	int64_t	m_iCost = 0;
+};
 
-	int iMaxThreadsPerIndex = CalcMaxThreadsPerIndex ( tArgs.m_iThreads, iJobs );
+static const int JOBS_PER_THREAD = 4;			///< how many jobs (on average) each thread gets; more jobs means better balance but more per-job overhead
+static const int64_t MIN_JOB_DOCS = 65536;		///< don't split chunks into ranges smaller than that
+
+/// split disk chunks into jobs of roughly the same cost; the jobs are then fetched by any free worker,
+/// so a huge chunk (say, after optimize) gets searched by several workers along with the small ones.
+/// jobs come largest first, as it gives the best balance when all of them are fetched from the same queue.
+/// returns false if the query must run in a single thread.
+static bool MakeDiskChunkJobs ( CSphVector<DiskChunkJob_t> & dJobs, const CSphQuery & tQuery, const CSphMultiQueryArgs & tArgs, const RtGuard_t & tGuard )
+{
+	int iChunks = tGuard.m_dDiskChunks.GetLength();
+	CSphVector<SplitData_t> dSplitData ( iChunks );
+
+	int iMaxThreadsPerIndex = CalcMaxThreadsPerIndex ( tArgs.m_iThreads, iChunks );
 	int64_t iMaxCountDistinct = CalcMaxCountDistinct ( tQuery, tGuard );
+	int64_t iTotalCost = 0;
 	ARRAY_FOREACH ( i, dSplitData )
 	{
 		bool bForceSingleThread = false;
-		auto tMetric = tGuard.m_dDiskChunks[i]->Cidx().GetPseudoShardingMetric ( { &tQuery, 1 }, { &iMaxCountDistinct, 1 }, iMaxThreadsPerIndex, bForceSingleThread );
+		const CSphIndex & tIndex = tGuard.m_dDiskChunks[i]->Cidx();
+		auto tMetric = tIndex.GetPseudoShardingMetric ( { &tQuery, 1 }, { &iMaxCountDistinct, 1 }, iMaxThreadsPerIndex, bForceSingleThread );
 		if ( bForceSingleThread )
 			return false;
 
@@ -7102,21 +7414,50 @@ static bool CalcDiskChunkSplits ( IntVec_t & dThreads, int iJobs, const CSphQuer
 		auto & tSplitData = dSplitData[i];
 		tSplitData.m_iMetric = tMetric.first;
 		tSplitData.m_iThreadCap = tQuery.m_iConcurrency ? 0 : tMetric.second;	// ignore thread cap if concurrency is explicitly specified
+		iTotalCost += tIndex.GetStats().m_iTotalDocuments;
+	}
+
+	int64_t iJobCost = Max ( iTotalCost / ( (int64_t)tArgs.m_iThreads*JOBS_PER_THREAD ), MIN_JOB_DOCS );
+
+	dJobs.Resize(0);
+	for ( int iChunk = iChunks-1; iChunk>=0; --iChunk )
+	{
+		const auto & tSplitData = dSplitData[iChunk];
+		int64_t iChunkCost = tGuard.m_dDiskChunks[iChunk]->Cidx().GetStats().m_iTotalDocuments;
+
+		int iParts = 1;
+		if ( GetPseudoSharding() && tArgs.m_iThreads>1 && tSplitData.m_iMetric>0 && tSplitData.m_iThreadCap!=1 )
+		{
+			iParts = (int)Min ( ( tSplitData.m_iMetric + iJobCost - 1 ) / iJobCost, (int64_t)tArgs.m_iThreads*JOBS_PER_THREAD );
+			if ( tSplitData.m_iThreadCap>1 )
+				iParts = Min ( iParts, tSplitData.m_iThreadCap );
+
+			iParts = Max ( iParts, 1 );
+		}
+
+		for ( int iPart = 0; iPart<iParts; ++iPart )
+			dJobs.Add ( { iChunk, iPart, iParts, iChunkCost/iParts } );
 	}
 
-	// we have more free threads than disk chunks; makes sense to apply pseudo_sharding
-	if ( tArgs.m_iThreads>iJobs )
-		DistributeThreadsOverIndexes ( dThreads, dSplitData, tArgs.m_iThreads );
+	// chunks of the same size still go from the newest to the oldest, as before
+	dJobs.Sort ( Lesser ( [] ( const DiskChunkJob_t & a, const DiskChunkJob_t & b )
+	{
+		if ( a.m_iCost!=b.m_iCost )
+			return a.m_iCost>b.m_iCost;
+
+		if ( a.m_iChunk!=b.m_iChunk )
+			return a.m_iChunk>b.m_iChunk;
 
+		return a.m_iPart<b.m_iPart;
+	} ) );
 	return true;
 }
 
 
-static bool QueryDiskChunks ( const CSphQuery & tQuery, CSphQueryResultMeta & tResult, const CSphMultiQueryArgs & tArgs, const RtGuard_t & tGuard, VecTraits_T<ISphMatchSorter *> & dSorters, QueryProfile_c * pProfiler, bool bGotLocalDF, const SmallStringHash_T<int64_t> * pLocalDocs, int64_t iTotalDocs, const char * szIndexName, SorterSchemaTransform_c & tSSTransform, int64_t tmMaxTimer )
+static bool QueryDiskChunks ( const CSphQuery & tQuery, CSphQueryResultMeta & tResult, const CSphMultiQueryArgs & tArgs, const RtGuard_t & tGuard, VecTraits_T<ISphMatchSorter *> & dSorters, QueryProfile_c * pProfiler, bool bGotLocalDF, const SmallStringHash_T<int64_t> * pLocalDocs, int64_t iTotalDocs, const char * szIndexName, int64_t tmMaxTimer, QcacheCollector_c * pQcacheCollector )
 {
-	// counter of tasks we will issue now
-	int iJobs = tGuard.m_dDiskChunks.GetLength();
-	if ( !iJobs )
+	int iChunks = tGuard.m_dDiskChunks.GetLength();
+	if ( !iChunks )
 		return true;
 
 	assert ( !dSorters.IsEmpty () );
@@ -7130,14 +7471,20 @@ static bool QueryDiskChunks ( const CSphQuery & tQuery, CSphQueryResultMeta & tR
 	// because disk chunk search within the loop will switch the profiler state
 	SwitchProfile ( pProfiler, SPH_QSTATE_INIT );
 
-	// uninitilized dSplits (due to tClonableCtx.IsSingle()) could still cause the SplitQuery code path at the CSphIndex_VLN::MultiQuery as
-	// dSplits[iChunk] -> tMultiArgs.m_iThreads
-	// then at the m_dDiskChunks
-	// if ( tArgs.m_iThreads>1 ) return SplitQuery
-	IntVec_t dSplits {iJobs};
-	dSplits.Fill(1); // moved here from CalcDiskChunkSplits to prevent short-cuts
+	// jobs are either whole chunks or rowid ranges of chunks; every job runs in a single thread,
+	// and free workers fetch the next job from the shared queue, so no worker gets stuck with all the heavy chunks
+	CSphVector<DiskChunkJob_t> dJobs;
+	bool bSingle = tClonableCtx.IsSingle() || !MakeDiskChunkJobs ( dJobs, tQuery, tArgs, tGuard );
+	if ( bSingle )
+	{
+		dJobs.Resize(0);
+		for ( int iChunk = iChunks-1; iChunk>=0; --iChunk )
+			dJobs.Add ( { iChunk, 0, 1, 0 } );
+	}
 
-	auto pDispatcher = Dispatcher::Make ( iJobs, tArgs.m_iThreads, tDispatch, tClonableCtx.IsSingle() || !CalcDiskChunkSplits ( dSplits, iJobs, tQuery, tArgs, tGuard ));
+	// counter of tasks we will issue now
+	int iJobs = dJobs.GetLength();
+	auto pDispatcher = Dispatcher::Make ( iJobs, tArgs.m_iThreads, tDispatch, bSingle );
 
 	const int iThreads = pDispatcher->GetConcurrency();
 	tClonableCtx.LimitConcurrency ( iThreads );
@@ -7172,9 +7519,10 @@ static bool QueryDiskChunks ( const CSphQuery & tQuery, CSphQueryResultMeta & tR
 		while ( !CheckInterrupt() ) // some earlier job met error; abort.
 		{
 			// jobs come in ascending order from 0 up to iJobs-1.
-			// We walk over disk chunk in reverse order, from last to 0-th.
-			auto iChunk = iJobs - iJob - 1;
-			RTQUERYINFO << "QueryDiskChunks " << tJobContext.second << ", Jb/Chunk: " << iJob << "/" << iChunk;
+			const DiskChunkJob_t & tJob = dJobs[iJob];
+			auto iChunk = tJob.m_iChunk;
+			bool bLastJob = iJob==iJobs-1;
+			RTQUERYINFO << "QueryDiskChunks " << tJobContext.second << ", Jb/Chunk/Part: " << iJob << "/" << iChunk << "/" << tJob.m_iPart;
 			iJob = -1; // mark it consumed
 			myinfo::SetTaskInfo ( "%d ch %d:", Threads::Coro::NumOfRestarts(), iChunk );
 			auto & dLocalSorters = tCtx.m_dSorters;
@@ -7191,27 +7539,35 @@ static bool QueryDiskChunks ( const CSphQuery & tQuery, CSphQueryResultMeta & tR
 			tMultiArgs.m_bLocalDF = bGotLocalDF;
 			tMultiArgs.m_pLocalDocs = pLocalDocs;
 			tMultiArgs.m_iTotalDocs = iTotalDocs;
-			tMultiArgs.m_iThreads = dSplits[iChunk];
 			tMultiArgs.m_iTotalThreads = iThreads;
+			tMultiArgs.m_pQcacheCollector = pQcacheCollector;
 
 			// we use sorters in both disk chunks and ram chunks,
 			// that's why we don't want to move to a new schema before we searched ram chunks
 			tMultiArgs.m_bModifySorterSchemas = false;
 
-			bool bChunkSucceed = tGuard.m_dDiskChunks[iChunk]->Cidx().MultiQuery ( tChunkResult, tQuery, dLocalSorters, tMultiArgs ) ;
+			bool bChunkSucceed;
+			if ( tJob.m_iParts>1 )
+			{
+				CSphQuery tQueryWithExtraFilter = tQuery;
+				SetupSplitFilter ( tQueryWithExtraFilter.m_dFilters.Add(), tJob.m_iPart, tJob.m_iParts );
+				bChunkSucceed = tGuard.m_dDiskChunks[iChunk]->Cidx().MultiQuery ( tChunkResult, tQueryWithExtraFilter, dLocalSorters, tMultiArgs );
+			} else
+				bChunkSucceed = tGuard.m_dDiskChunks[iChunk]->Cidx().MultiQuery ( tChunkResult, tQuery, dLocalSorters, tMultiArgs );
+
 			bSucceed.fetch_and ( bChunkSucceed );
 			if ( !bChunkSucceed )
 				Interrupt ( "" );
 
-			// check terms inconsistency among disk chunks
-			tThMeta.MergeWordStats ( tChunkMeta );
+			// check terms inconsistency among disk chunks; every part of a chunk reports the stats of the whole chunk
+			if ( !tJob.m_iPart )
+				tThMeta.MergeWordStats ( tChunkMeta );
 			tThMeta.m_bHasPrediction |= tChunkMeta.m_bHasPrediction;
-			tSSTransform.Set ( iChunk, tChunkResult );
 
 			if ( tThMeta.m_bHasPrediction )
 				tThMeta.m_tStats.Add ( tChunkMeta.m_tStats );
 
-			if ( iChunk && sph::TimeExceeded ( tmMaxTimer ) )
+			if ( !bLastJob && sph::TimeExceeded ( tmMaxTimer ) )
 				Interrupt ( "query time exceeded max_query_time" );
 
 			if ( tThMeta.m_sWarning.IsEmpty() && !tChunkMeta.m_sWarning.IsEmpty() )
@@ -7238,7 +7594,7 @@ static bool QueryDiskChunks ( const CSphQuery & tQuery, CSphQueryResultMeta & tR
 		}
 	});
 	RTQUERYINFO "QueryDiskChunks processed in " << tClonableCtx.NumWorked() << " thread(s)";
-	tClonableCtx.Finalize();
+	tClonableCtx.FinalizeAll();
 
 	return bSucceed;
 }
@@ -7343,21 +7699,42 @@ static bool SetupFilters ( const CSphQuery & tQuery, const ISphSchema * pSchema,
 }
 
 
-static bool PerformFullscan ( const VecTraits_T<RtSegmentRefPtf_t> & dRamChunks, int iMaxDynamicSize, int iIndexWeight, int iStride, int iCutoff, int64_t tmMaxTimer, QueryProfile_c * pProfiler, CSphQueryContext & tCtx, VecTraits_T<ISphMatchSorter*> & dSorters, CSphString & sWarning )
+static void AddKNNPlanStats ( IteratorStats_t & tStats, const CSphString & sAttr, KNNFilterMode_e eMode )
+{
+	IteratorStats_t tSegmentStats;
+	tSegmentStats.m_dIterators.Add ( { sAttr, KNNFilterMode2Str(eMode) } );
+	tSegmentStats.m_iTotal = 1;
+	tStats.Merge(tSegmentStats);
+}
+
+
+static bool PerformFullscan ( const VecTraits_T<RtSegmentRefPtf_t> & dRamChunks, const ISphSchema & tMaxSorterSchema, int iIndexWeight, int iStride, int iCutoff, int64_t tmMaxTimer, QueryProfile_c * pProfiler, CSphQueryContext & tCtx, VecTraits_T<ISphMatchSorter*> & dSorters, IteratorStats_t & tIteratorStats, CSphString & sWarning )
 {
 	if ( !iCutoff )
 		return true;
 
 	bool bRandomize = dSorters[0]->IsRandom();
+	const CSphQuery & tQuery = tCtx.m_tQuery;
+	bool bKNN = !tQuery.m_sKNNAttr.IsEmpty();
+	const CSphColumnInfo * pKNNAttr = bKNN ? tMaxSorterSchema.GetAttr ( tQuery.m_sKNNAttr.cstr() ) : nullptr;
+	CSphVector<knn::DocDist_t> dKNNRows;
+	CSphVector<RowID_t> dRowIDs;
+	BitVec_T<uint64_t> tKNNAllowed;
 
 	SwitchProfile ( pProfiler, SPH_QSTATE_FULLSCAN );
 
 	// full scan
 	// FIXME? OPTIMIZE? add shortcuts here too?
 	CSphMatch tMatch;
-	tMatch.Reset ( iMaxDynamicSize );
+	tMatch.Reset ( tMaxSorterSchema.GetDynamicSize() );
 	tMatch.m_iWeight = iIndexWeight;
 
+	// rows are scanned in ascending order, so expressions over attributes (columnar ones in particular) are calculated block by block
+	const int SCAN_BLOCK_ROWS = 1024;
+	bool bBatch = tCtx.IsScanBatchable();
+	ScanBlock_c tBlock ( tMatch, tMaxSorterSchema.GetDynamicSize() );
+	CSphVector<RowID_t> dBlockRows;
+
 	ARRAY_FOREACH ( iSeg, dRamChunks )
 	{
 		RtSegment_t & tSeg = *dRamChunks[iSeg];
@@ -7377,7 +7754,125 @@ static bool PerformFullscan ( const VecTraits_T<RtSegmentRefPtf_t> & dRamChunks,
 
 		session::Info().m_pSessionOpaque2 = (void*)tSeg.m_pDocstore.get();
 
-		for ( auto tRowID : RtLiveRows_c(tSeg) )
+		// knn search over segment's hnsw graph; only the nearest rows are scanned, same as in disk chunks
+		// distances are already calculated, so pass them to knn_dist() (after the blob pool is set as it resets them)
+		bool bKNNSearch = false;
+		KNNFilterPlan_t tKNNPlan = GetDefaultKNNPlan(tQuery);
+		if ( bKNN && tSeg.m_pKNN )
+		{
+			// rows that pass filters are passed to the graph, so it could skip the rest or score just them
+			// a sample tells if filters reject anything at all; if they do, exact counts are cheap compared to distance calculations
+			const BitVec_T<uint64_t> * pAllowed = nullptr;
+			if ( tCtx.m_pFilter && pKNNAttr )
+			{
+				const DWORD KNN_FILTER_SAMPLE = 256;
+				auto fnPassesFilter = [&] ( RowID_t tRowID )
+				{
+					tMatch.m_tRowID = tRowID;
+					tMatch.m_pStatic = tSeg.m_dRows.Begin() + (int64_t)tRowID*iStride;
+
+					tCtx.CalcFilter ( tMatch );
+					bool bPass = tCtx.m_pFilter->Eval ( tMatch );
+					tCtx.FreeDataFilter ( tMatch );
+					return bPass;
+				};
+
+				int64_t iAlive = tSeg.m_tAliveRows.load ( std::memory_order_relaxed );
+				DWORD uSampleStep = Max ( tSeg.m_uRows / KNN_FILTER_SAMPLE, 1U );
+				bool bAllPass = true;
+				for ( RowID_t tRowID = 0; tRowID<tSeg.m_uRows && bAllPass; tRowID += uSampleStep )
+					if ( !tSeg.m_tDeadRowMap.IsSet(tRowID) )
+						bAllPass = fnPassesFilter(tRowID);
+
+				tKNNPlan = PlanFilteredKNN ( tQuery, pKNNAttr->m_tKNN, iAlive, bAllPass ? iAlive : 0, true );
+				if ( tKNNPlan.m_eMode!=KNNFilterMode_e::GRAPH )
+				{
+					tKNNAllowed.Init ( tSeg.m_uRows );
+					int64_t iAllowed = 0;
+					for ( auto tRowID : RtLiveRows_c(tSeg) )
+						if ( fnPassesFilter(tRowID) )
+						{
+							tKNNAllowed.BitSet(tRowID);
+							iAllowed++;
+						}
+
+					tKNNPlan = PlanFilteredKNN ( tQuery, pKNNAttr->m_tKNN, iAlive, iAllowed, true );
+					if ( tKNNPlan.m_eMode!=KNNFilterMode_e::GRAPH )
+						pAllowed = &tKNNAllowed;
+				}
+			}
+
+			dKNNRows.Resize(0);
+			bKNNSearch = tSeg.m_pKNN->Search ( tQuery.m_sKNNAttr, tQuery.m_dKNNVec, tKNNPlan, tSeg.m_tDeadRowMap, pAllowed, dKNNRows );
+			if ( bKNNSearch )
+			{
+				dRowIDs.Resize(0);
+				for ( const auto & i : dKNNRows )
+					dRowIDs.Add ( i.m_tRowID );
+
+				SetKNNDistData ( tMaxSorterSchema, { dKNNRows.Begin(), (size_t)dKNNRows.GetLength() } );
+			}
+		}
+
+		// segments without graphs calculate distances for every row
+		if ( bKNN )
+			AddKNNPlanStats ( tIteratorStats, tQuery.m_sKNNAttr, bKNNSearch ? tKNNPlan.m_eMode : KNNFilterMode_e::BRUTEFORCE );
+
+		RtScanRows_c tScanRows ( tSeg, bKNNSearch ? &dRowIDs : nullptr );
+		if ( bBatch )
+		{
+			auto fnToStatic = [&tSeg, iStride]( RowID_t tRowID ){ return tSeg.m_dRows.Begin() + (int64_t)tRowID*iStride; };
+			auto tRow = tScanRows.begin();
+			auto tEnd = tScanRows.end();
+			while ( tRow!=tEnd )
+			{
+				dBlockRows.Resize(0);
+				for ( ; tRow!=tEnd && dBlockRows.GetLength()<SCAN_BLOCK_ROWS; ++tRow )
+					dBlockRows.Add(*tRow);
+
+				bool bCutoffHit = false;
+				for ( auto * pMatch : tBlock.Process ( tCtx, dBlockRows, fnToStatic, bRandomize, iIndexWeight ) )
+				{
+					// storing segment in matches tag for finding strings attrs offset later, biased against default zero
+					pMatch->m_iTag = iSeg+1;
+
+					bool bNewMatch = false;
+					for ( auto * pSorter: dSorters )
+						bNewMatch |= pSorter->Push ( *pMatch );
+
+					if ( bNewMatch && --iCutoff==0 )
+					{
+						bCutoffHit = true;
+						break;
+					}
+				}
+
+				// stringptr expressions should be duplicated (or taken over) at this point
+				tBlock.FreeData(tCtx);
+				if ( bCutoffHit )
+					return true;
+
+				if ( sph::TimeExceeded ( tmMaxTimer ) )
+				{
+					sWarning = "query time exceeded max_query_time";
+					return true;
+				}
+
+				if ( Threads::Coro::RuntimeExceeded() )
+				{
+					if ( session::GetKilled() )
+					{
+						sWarning = "query was killed";
+						return true;
+					}
+					Threads::Coro::RescheduleAndKeepCrashQuery();
+				}
+			}
+
+			continue;
+		}
+
+		for ( auto tRowID : tScanRows )
 		{
 			tMatch.m_tRowID = tRowID;
 			tMatch.m_pStatic = tSeg.m_dRows.Begin() + (int64_t)tRowID*iStride;
@@ -7449,7 +7944,7 @@ static bool DoFullScanQuery ( const RtSegVec_c & dRamChunks, const ISphSchema &
 		// FIXME! OPTIMIZE! check if we can early reject the whole index
 
 		int iCutoff = ApplyImplicitCutoff ( tQuery, dSorters, false );
-		tMeta.m_bTotalMatchesApprox |= PerformFullscan ( dRamChunks, tMaxSorterSchema.GetDynamicSize(), tArgs.m_iIndexWeight, iStride, iCutoff, tmMaxTimer, pProfiler, tCtx, dSorters, tMeta.m_sWarning );
+		tMeta.m_bTotalMatchesApprox |= PerformFullscan ( dRamChunks, tMaxSorterSchema, tArgs.m_iIndexWeight, iStride, iCutoff, tmMaxTimer, pProfiler, tCtx, dSorters, tMeta.m_tIteratorStats, tMeta.m_sWarning );
 	}
 
 	return FinalExpressionCalculation ( tCtx, dRamChunks, dSorters, tArgs.m_bFinalizeSorters, tMeta );
@@ -7462,6 +7957,7 @@ static void PerformFullTextSearch ( const RtSegVec_c & dRamChunks, RtQwordSetup_
 		return;
 
 	bool bRandomize = dSorters[0]->IsRandom();
+	ISphMatchSorter * pPruneSorter = ( tCtx.m_tQuery.m_bWeightPruning && dSorters.GetLength()==1 && !bRandomize ) ? dSorters[0] : nullptr;
 	// query matching
 	ARRAY_FOREACH ( iSeg, dRamChunks )
 	{
@@ -7555,6 +8051,9 @@ static void PerformFullTextSearch ( const RtSegVec_c & dRamChunks, RtQwordSetup_
 				iSeg = dRamChunks.GetLength();
 				break;
 			}
+
+			if ( pPruneSorter )
+				sphSetRankerMinWeight ( pRanker, pPruneSorter, iIndexWeight );
 		}
 	}
 }
@@ -7764,11 +8263,16 @@ bool RtIndex_c::MultiQuery ( CSphQueryResult & tResult, const CSphQuery & tQuery
 	MiniTimer_c dTimerGuard;
 	int64_t tmMaxTimer = dTimerGuard.Engage ( tQuery.m_uMaxQueryMsec ); // max_query_time
 
-	SorterSchemaTransform_c tSSTransform ( dDiskChunks.GetLength(), tArgs.m_bFinalizeSorters );
+	SorterSchemaTransform_c tSSTransform ( tGuard, tArgs.m_bFinalizeSorters );
+
+	// disk chunks never change (except kills, which are applied after cached ranker anyway), so their results are cached per chunk.
+	// Decision to cache is made for the whole query, as RAM segments are searched each time again.
+	QcacheCollector_c tQcacheCollector;
+	auto CommitQcache = [&tQcacheCollector, tmQueryStart] { tQcacheCollector.Commit ( int ( ( sphMicroTimer()-tmQueryStart )/1000 ) ); };
 
 	if ( !dDiskChunks.IsEmpty() )
 	{
-		if ( !QueryDiskChunks ( tQuery, tMeta, tArgs, tGuard, dSorters, pProfiler, bGotLocalDF, pLocalDocs, iTotalDocs, GetName(), tSSTransform, tmMaxTimer ) )
+		if ( !QueryDiskChunks ( tQuery, tMeta, tArgs, tGuard, dSorters, pProfiler, bGotLocalDF, pLocalDocs, iTotalDocs, GetName(), tmMaxTimer, &tQcacheCollector ) )
 			return false;
 	}
 
@@ -7834,8 +8338,8 @@ bool RtIndex_c::MultiQuery ( CSphQueryResult & tResult, const CSphQuery & tQuery
 
 	CSphScopedPayload tPayloads;
 
+	// RAM segments are not cached; they're merged and replaced too often
 	// FIXME!!! add proper
-	// - qcache invalidation after INSERT \ DELETE \ UPDATE and for plain index afte UPDATE #256
 	// - qcache duplicates removal from killed document at segment #263
 	tCtx.m_bSkipQCache = true;
 
@@ -7860,6 +8364,7 @@ bool RtIndex_c::MultiQuery ( CSphQueryResult & tResult, const CSphQuery & tQuery
 		for ( auto i : dSorters )
 			tSSTransform.Transform ( i, tGuard );
 
+		CommitQcache();
 		tResult.m_pDocstore = m_tSchema.HasStoredFields () ? this : nullptr;
 		tMeta.m_iQueryTime = 0;
 		return true;
@@ -7899,6 +8404,7 @@ bool RtIndex_c::MultiQuery ( CSphQueryResult & tResult, const CSphQuery & tQuery
 	if ( tMeta.m_bHasPrediction )
 		tMeta.m_tStats.Add ( tQueryStats );
 
+	CommitQcache();
 	tResult.m_pDocstore = m_tSchema.HasStoredFields() ? this : nullptr;
 	tMeta.m_iQueryTime = int ( ( sphMicroTimer()-tmQueryStart )/1000 );
 	tMeta.m_iCpuTime += sphTaskCpuTimer ()-tmCpuQueryStart;
@@ -8583,6 +9089,14 @@ bool RtIndex_c::AddRemoveAttribute ( bool bAdd, const AttrAddRemoveCtx_t & tCtx,
 	} else
 		AddRemoveRowwiseAttr ( tGuard, bAdd, tNewCtx.m_sName, tNewCtx.m_eType, tOldSchema, tNewSchema, sError );
 
+	// rows and columnar storages were rewritten, so knn graphs need new locators (or a rebuild if knn attrs were added/removed)
+	for ( auto & pConstSeg : tGuard.m_dRamSegs )
+	{
+		auto * pSeg = const_cast<RtSegment_t*> ( pConstSeg.Ptr() );
+		pSeg->RelocateKNN(m_tSchema);
+		pSeg->UpdateUsedRam();
+	}
+
 	AddRemoveFromRamDocstore ( tOldSchema, tNewSchema );
 
 	// fixme: we can't rollback at this point
@@ -9118,8 +9632,41 @@ int64_t RtIndex_c::GetCount() const
 		 return { 0, 1 };
 
 	auto tGuard = RtGuard();
-	int iThreadCap = GetPseudoSharding() ? 0 : tGuard.m_dDiskChunks.GetLength();
-	return { GetStats().m_iTotalDocuments, iThreadCap };
+	if ( !GetPseudoSharding() )
+		return { GetStats().m_iTotalDocuments, tGuard.m_dDiskChunks.GetLength() };
+
+	// disk chunks get split into rowid ranges by the same cost model as plain tables (see QueryDiskChunks),
+	// so sum up what chunks say instead of capping threads by the number of chunks
+	int64_t iMetric = 0;
+	int64_t iDiskDocs = 0;
+	int iThreadCap = 0;
+	bool bCapped = true;
+	int iMaxThreadsPerChunk = CalcMaxThreadsPerIndex ( iThreads, tGuard.m_dDiskChunks.GetLength() );
+	for ( const auto & pChunk : tGuard.m_dDiskChunks )
+	{
+		const CSphIndex & tChunk = pChunk->Cidx();
+		auto tMetric = tChunk.GetPseudoShardingMetric ( dQueries, dMaxCountDistinct, iMaxThreadsPerChunk, bForceSingleThread );
+		if ( bForceSingleThread )
+			return { 0, 1 };
+
+		// chunks that won't be split still are separate jobs that need a thread
+		int64_t iChunkDocs = tChunk.GetStats().m_iTotalDocuments;
+		iDiskDocs += iChunkDocs;
+		iMetric += tMetric.first ? tMetric.first : iChunkDocs;
+		if ( tMetric.second )
+			iThreadCap += tMetric.second;
+		else
+			bCapped = false;
+	}
+
+	// ram segments are searched in one go
+	iMetric += Max ( GetStats().m_iTotalDocuments - iDiskDocs, 0 );
+	if ( bCapped )
+		iThreadCap = Max ( iThreadCap, 1 );
+	else
+		iThreadCap = 0;
+
+	return { iMetric, iThreadCap };
 }
 
 
@@ -9236,7 +9783,7 @@ static int64_t NumAliveDocs ( const CSphIndex& dChunk )
 	return dChunk.GetStats().m_iTotalDocuments - tStatus.m_iDead;
 }
 
-bool RtIndex_c::BinlogCommit ( RtSegment_t * pSeg, const VecTraits_T<DocID_t> & dKlist, int64_t iAddTotalBytes, CSphString & sError ) REQUIRES ( pSeg->m_tLock )
+bool RtIndex_c::BinlogCommit ( RtSegment_t * pSeg, const VecTraits_T<DocID_t> & dKlist, int64_t iAddTotalBytes, int64_t * pSyncPos, CSphString & sError ) REQUIRES ( pSeg->m_tLock )
 {
 //	Tracer::AsyncOp tTracer ( "rt", "RtIndex_c::BinlogCommit" );
 	return Binlog::Commit ( &m_iTID, GetName(), sError, [pSeg,&dKlist,iAddTotalBytes,bKeywordDict=m_bKeywordDict] (Writer_i & tWriter) REQUIRES ( pSeg->m_tLock )
@@ -9249,6 +9796,7 @@ bool RtIndex_c::BinlogCommit ( RtSegment_t * pSeg, const VecTraits_T<DocID_t> &
 			return;
 		}
 
+		assert ( pSeg->m_eDocFormat==RtDocFormat_e::VARINT && "binlog expects fresh segments" );
 		tWriter.ZipOffset ( pSeg->m_uRows );
 		tWriter.ZipOffset ( iAddTotalBytes );
 		Binlog::SaveVector ( tWriter, pSeg->m_dWords );
@@ -9285,7 +9833,7 @@ bool RtIndex_c::BinlogCommit ( RtSegment_t * pSeg, const VecTraits_T<DocID_t> &
 			pSeg->m_pColumnar->Save ( tWriter );
 
 		Binlog::SaveVector ( tWriter, dKlist );
-	});
+	}, pSyncPos );
 }
 
 
@@ -9347,6 +9895,7 @@ Binlog::CheckTnxResult_t RtIndex_c::ReplayCommit ( CSphReader & tReader, CSphStr
 		}
 
 		pSeg->BuildDocID2RowIDMap ( GetInternalSchema() );
+		pSeg->BuildKNN ( GetInternalSchema() );
 	}
 
 	if ( !Binlog::LoadVector ( tReader, dKlist ) ) return Warn ( sError, tReader );
@@ -20,6 +20,7 @@
 #include "attribute.h"
 #include "docstore.h"
 #include "columnarrt.h"
+#include "knnrt.h"
 #include "coroutine.h"
 #include "tokenizer/tokenizer.h"
 #include "indexing_sources/source_document.h"
@@ -213,6 +214,17 @@ struct RtDoc_t
 };
 
 
+/// packed doclist block, see RtDocFormat_e::PACKED
+static constexpr int RT_DOC_BLOCK = 128;
+struct RtDocBlock_t
+{
+	DWORD m_dRowIDs[RT_DOC_BLOCK];
+	DWORD m_dDocFields[RT_DOC_BLOCK];
+	DWORD m_dHits[RT_DOC_BLOCK];
+	DWORD m_dHit[RT_DOC_BLOCK];
+};
+
+
 struct RtWord_t
 {
 	union
@@ -251,6 +263,7 @@ public:
 	CSphTightVector<uint64_t>		m_dInfixFilterCP;
 	CSphTightVector<BYTE>			m_dDocs;
 	CSphTightVector<BYTE>			m_dHits;
+	RtDocFormat_e					m_eDocFormat = RtDocFormat_e::VARINT;	///< encoding of m_dDocs
 
 	DWORD							m_uRows = 0;			///< number of actually allocated rows
 	std::atomic<int64_t>			m_tAliveRows { 0 };		///< number of alive (non-killed) rows
@@ -262,6 +275,7 @@ public:
 	DeadRowMap_Ram_c				m_tDeadRowMap;
 	std::unique_ptr<DocstoreRT_i>	m_pDocstore;
 	std::unique_ptr<ColumnarRT_i>	m_pColumnar;
+	std::unique_ptr<KNNRT_i>		m_pKNN;					///< hnsw graphs over knn-indexed attrs
 	const ISphSchema&				m_tSchema;
 
 	mutable bool					m_bConsistent{false};
@@ -283,6 +297,9 @@ public:
 
 	void					SetupDocstore ( const CSphSchema * pSchema );
 	void					BuildDocID2RowIDMap ( const CSphSchema & tSchema );
+	void					BuildKNN ( const CSphSchema & tSchema );
+	void					MergeKNN ( const RtSegment_t & tA, const RtSegment_t & tB, const VecTraits_T<RowID_t> & dRowMapA, const VecTraits_T<RowID_t> & dRowMapB, const CSphSchema & tSchema );
+	void					RelocateKNN ( const CSphSchema & tSchema );
 
 	void					MaybeAddPostponedUpdate ( const RowsToUpdate_t& dRows, const UpdateContext_t& tCtx );
 	void					UpdateAttributesOffline ( VecTraits_T<PostponedUpdate_t>& dPostUpdates ) final;
@@ -328,6 +345,12 @@ class RtDocReader_c
 	const BYTE* m_pDocs = nullptr;
 	int m_iLeft = 0;
 	RtDoc_t m_tDoc;
+	RtDocFormat_e m_eFormat = RtDocFormat_e::VARINT;
+	int m_iBlockDoc = 0;	///< next doc in m_tBlock
+	int m_iBlockDocs = 0;	///< docs decoded into m_tBlock
+	RtDocBlock_t m_tBlock;
+
+	void UnzipBlock();
 
 public:
 	RtDocReader_c() = default;
@@ -340,6 +363,25 @@ public:
 	inline const RtDoc_t& operator*() const { return m_tDoc; }
 };
 
+class RtDocWriter_c
+{
+	CSphTightVector<BYTE> &		m_dDocs;
+	RowID_t						m_tLastRowID {INVALID_ROWID};
+	RtDocFormat_e				m_eFormat;
+	int							m_iBlockDocs = 0;	///< docs pending in m_tBlock
+	RtDocBlock_t				m_tBlock;
+
+	void ZipBlock();
+
+public:
+	explicit RtDocWriter_c ( CSphTightVector<BYTE> & dDocs, RtDocFormat_e eFormat = RtDocFormat_e::VARINT );
+	~RtDocWriter_c();
+
+	void operator<< ( const RtDoc_t & tDoc );
+	DWORD WriterPos () const;
+	void ZipRestart ();
+};
+
 class RtHitReader_c
 {
 	const BYTE* m_pCur = nullptr;
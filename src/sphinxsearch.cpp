@@ -15,6 +15,7 @@
 #include "querycontext.h"
 #include "sphinxplugin.h"
 #include "sphinxqcache.h"
+#include "sphinxsort.h"
 #include "attribute.h"
 #include "conversion.h"
 #include "secondaryindex.h"
@@ -29,23 +30,38 @@ bool operator == ( const SkiplistEntry_t & a, RowID_t b )	{ return a.m_tBaseRowI
 bool operator < ( RowID_t a, const SkiplistEntry_t & b )	{ return a<b.m_tBaseRowIDPlus1; }
 
 
-void SkipData_t::Read ( const BYTE * pSkips, const DictEntry_t & tRes, int iDocs, int iSkipBlockSize )
+void SkipData_t::Read ( const BYTE * pSkips, const DictEntry_t & tRes, int iDocs, int iSkipBlockSize, bool bHasMaxHits )
 {
 	const BYTE * pSkip = pSkips + tRes.m_iSkiplistOffset;
 
+	m_bHasMaxHits = bHasMaxHits;
 	m_dSkiplist.Add();
 	m_dSkiplist.Last().m_tBaseRowIDPlus1 = 0;
 	m_dSkiplist.Last().m_iOffset = tRes.m_iDoclistOffset;
 	m_dSkiplist.Last().m_iBaseHitlistPos = 0;
 
-	for ( int i=1; i < iDocs/iSkipBlockSize; i++ )
+	// max hits of a block are only valid up to the next block, so read all the blocks (including the last partial one) in that case
+	int iSkips = iDocs/iSkipBlockSize;
+	if ( bHasMaxHits )
+	{
+		iSkips = ( iDocs+iSkipBlockSize-1 ) / iSkipBlockSize;
+		m_dSkiplist.Last().m_uMaxHits = UnzipIntBE(pSkip);
+	}
+
+	for ( int i=1; i < iSkips; i++ )
 	{
 		SkiplistEntry_t & t = m_dSkiplist.Add();
 		SkiplistEntry_t & p = m_dSkiplist [ m_dSkiplist.GetLength()-2 ];
 		t.m_tBaseRowIDPlus1 = p.m_tBaseRowIDPlus1 + iSkipBlockSize + UnzipIntBE(pSkip);
 		t.m_iOffset = p.m_iOffset + 4*iSkipBlockSize + UnzipOffsetBE(pSkip);
 		t.m_iBaseHitlistPos = p.m_iBaseHitlistPos + UnzipOffsetBE(pSkip);
+		if ( bHasMaxHits )
+			t.m_uMaxHits = UnzipIntBE(pSkip);
 	}
+
+	m_uMaxHits = 0;
+	for ( const auto & t : m_dSkiplist )
+		m_uMaxHits = Max ( m_uMaxHits, t.m_uMaxHits );
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -97,6 +113,35 @@ int	ISphQword::GetAtomPos() const
 	return m_iAtomPos;
 }
 
+/// upper bound of per-doc hits over the whole doclist (UINT_MAX if unknown)
+DWORD ISphQword::GetMaxHits() const
+{
+	if ( m_pSkipData && m_pSkipData->m_bHasMaxHits )
+		return m_pSkipData->m_uMaxHits;
+
+	// total hits of a word are a valid (if loose) bound too
+	return m_iHits>0 ? (DWORD)m_iHits : UINT_MAX;
+}
+
+/// upper bound of per-doc hits over the skiplist block that holds tRowID
+/// also returns the first rowid of the next block, or INVALID_ROWID if there's no block-level info
+DWORD ISphQword::GetBlockMaxHits ( RowID_t tRowID, RowID_t & tNextBlock ) const
+{
+	tNextBlock = INVALID_ROWID;
+	if ( !m_pSkipData || !m_pSkipData->m_bHasMaxHits )
+		return GetMaxHits();
+
+	const auto & dSkiplist = m_pSkipData->m_dSkiplist;
+	int iBlock = FindSpan ( dSkiplist, tRowID );
+	if ( iBlock<0 )
+		return GetMaxHits();
+
+	if ( iBlock+1<dSkiplist.GetLength() )
+		tNextBlock = dSkiplist[iBlock+1].m_tBaseRowIDPlus1;
+
+	return dSkiplist[iBlock].m_uMaxHits;
+}
+
 
 /// per-document zone information (span start/end positions)
 struct ZoneInfo_t
@@ -164,6 +209,7 @@ public:
 	DWORD						m_uPayloadMask = 0;					///< exposed for ranker state functors
 	int							m_iQwords = 0;						///< exposed for ranker state functors
 	int							m_iMaxQpos = 0;						///< max in-query pos among all keywords, including dupes; for ranker state functors
+	int							m_iMaxRankBonus = -1;				///< upper bound of the non-BM25 part of the weight (in SPH_BM25_SCALE units); -1 means no weight pruning
 
 protected:
 	std::unique_ptr<ExtNode_i>	m_pRoot;
@@ -178,6 +224,7 @@ protected:
 
 	int64_t *					m_pNanoBudget = nullptr;
 	QcacheEntry_c *				m_pQcacheEntry = nullptr;			///< data to cache if we decide that the current query is worth caching
+	float						m_fMinTFIDF = -FLT_MAX;				///< docs with a lesser tf-idf can't make it into the sorter
 
 	StrVec_t					m_dZones;
 	CSphVector<std::unique_ptr<ExtNode_i>>		m_dZoneStartTerm;
@@ -193,6 +240,7 @@ protected:
 
 	void						CleanupZones ( RowID_t tMaxRowID );
 	void						UpdateQcache ( int iMatches );
+	void						SetMinWeight ( int iMinWeight );
 
 	virtual float				CalcRankCost ( int64_t iDocs ) const = 0;
 
@@ -212,6 +260,10 @@ protected:
 		case EXTRA_SET_BOUNDARIES:
 			m_pRoot->SetRowidBoundaries ( *(const RowIdBoundaries_t*)ppResult );
 			return true;
+
+		case EXTRA_SET_MINWEIGHT:
+			SetMinWeight ( *(int*)ppResult );
+			return true;
 		
 		default:
 			return false;
@@ -273,6 +325,15 @@ public:
 };
 
 
+/// states that can rank all the hits of a doc in one tight loop provide UpdateBlock ( pHits, pHitsEnd )
+/// NOTE! it is inherited, so a state that overrides Update() of a state with UpdateBlock() must override UpdateBlock() too
+template < typename STATE, typename = void >
+struct HasUpdateBlock_T : std::false_type {};
+
+template < typename STATE >
+struct HasUpdateBlock_T < STATE, std::void_t<decltype ( std::declval<STATE&>().UpdateBlock ( (const ExtHit_t *)nullptr, (const ExtHit_t *)nullptr ) )> > : std::true_type {};
+
+
 template < typename STATE, bool USE_BM25 >
 class ExtRanker_State_T : public ExtRanker_T<USE_BM25>
 {
@@ -695,6 +756,7 @@ ExtRanker_c::ExtRanker_c ( const XQQuery_t & tXQ, const ISphQwordSetup & tSetup,
 	{
 		m_pQcacheEntry = new QcacheEntry_c();
 		m_pQcacheEntry->m_iIndexId = m_pIndex->GetIndexId();
+		m_pQcacheEntry->m_iGeneration = m_pIndex->GetUpdateGeneration();
 	}
 
 	memset ( m_dMyDocs, 0, sizeof ( m_dMyDocs ) );
@@ -765,12 +827,31 @@ void ExtRanker_c::UpdateQcache ( int iMatches )
 }
 
 
+void ExtRanker_c::SetMinWeight ( int iMinWeight )
+{
+	if ( m_iMaxRankBonus<0 )
+		return;
+
+	// weight is int((tfidf+0.5)*SPH_BM25_SCALE) + rank*SPH_BM25_SCALE, and rank never exceeds m_iMaxRankBonus
+	// so docs below that tf-idf can't reach iMinWeight; a couple of weight units are kept as a margin for rounding
+	float fMinTFIDF = float ( iMinWeight-2 ) / SPH_BM25_SCALE - 0.5f - float ( m_iMaxRankBonus );
+	if ( fMinTFIDF<=m_fMinTFIDF )
+		return;
+
+	m_fMinTFIDF = fMinTFIDF;
+	m_pRoot->SetMinTFIDF ( fMinTFIDF );
+}
+
+
 void ExtRanker_c::FinalizeCache ( const ISphSchema & tSorterSchema )
 {
 	if ( m_pQcacheEntry )
 	{
 		CSphScopedProfile tProf ( m_pCtx->m_pProfile, SPH_QSTATE_QCACHE_FINAL );
-		QcacheAdd ( m_pCtx->m_tQuery, m_pQcacheEntry, tSorterSchema );
+		if ( m_pCtx->m_pQcacheCollector )
+			m_pCtx->m_pQcacheCollector->Add ( m_pCtx->m_tQuery, m_pQcacheEntry, tSorterSchema );
+		else
+			QcacheAdd ( m_pCtx->m_tQuery, m_pQcacheEntry, tSorterSchema );
 	}
 
 	SafeReleaseAndZero ( m_pQcacheEntry );
@@ -1220,9 +1301,9 @@ int ExtRanker_WeightSum_c<USE_BM25>::GetMatches ()
 		} else
 		{
 			// just sum weights over the lowest 32 fields
+			// branchless, so that the loop vectorizes
 			for ( int i=0; i<iWeights; i++ )
-				if ( uMask & (1<<i) )
-					uRank += m_pWeights[i];
+				uRank += m_pWeights[i] & -(int)( ( uMask>>i ) & 1 );
 		}
 
 		Swap ( this->m_dMatches[iMatches], this->m_dMyMatches[pDoc-this->m_dMyDocs] ); // OPTIMIZE? can avoid this swap and simply return m_dMyMatches (though in lesser chunks)
@@ -1335,11 +1416,11 @@ int ExtRanker_State_T<STATE,USE_BM25>::GetMatches ()
 	for ( RowID_t tCurRowID=INVALID_ROWID; iMatches < MAX_BLOCK_DOCS; )
 	{
 		// keep ranking
-		while ( pHlist->m_tRowID==tCurRowID )
+		if ( this->m_bZSlist )
 		{
-			m_tState.Update ( pHlist );
-			if ( this->m_bZSlist )
+			while ( pHlist->m_tRowID==tCurRowID )
 			{
+				m_tState.Update ( pHlist );
 				ARRAY_FOREACH ( i, this->m_dZones )
 				{
 					int iSpan;
@@ -1353,8 +1434,20 @@ int ExtRanker_State_T<STATE,USE_BM25>::GetMatches ()
 						dSpans[i] = iSpan;
 					}
 				}
+				++pHlist;
 			}
-			++pHlist;
+		} else
+		{
+			// no zones, so feed all the hits of the current doc at once
+			const ExtHit_t * pDocHits = pHlist;
+			while ( pHlist->m_tRowID==tCurRowID )
+				++pHlist;
+
+			if constexpr ( HasUpdateBlock_T<STATE>::value )
+				m_tState.UpdateBlock ( pDocHits, pHlist );
+			else
+				for ( ; pDocHits<pHlist; ++pDocHits )
+					m_tState.Update ( pDocHits );
 		}
 
 		// flush current doc
@@ -1510,6 +1603,38 @@ struct RankerState_Proximity_fn : public ISphExtra
 		}
 	}
 
+	// same as Update() over all the hits of a doc, but keeps the running lcs state in locals
+	void UpdateBlock ( const ExtHit_t * pHit, const ExtHit_t * pEnd )
+	{
+		if_const ( HANDLE_DUPES )
+		{
+			for ( ; pHit<pEnd; ++pHit )
+				Update ( pHit );
+			return;
+		}
+
+		BYTE uCurLCS = m_uCurLCS;
+		int iExpDelta = m_iExpDelta;
+		int iLastHitPosWithField = m_iLastHitPosWithField;
+		for ( ; pHit<pEnd; ++pHit )
+		{
+			const int iPosWithField = HITMAN::GetPosWithField ( pHit->m_uHitpos );
+			const int iDelta = iPosWithField - pHit->m_uQuerypos;
+			if ( iPosWithField>iLastHitPosWithField )
+				uCurLCS = BYTE ( ( iDelta==iExpDelta ? uCurLCS : 0 ) + pHit->m_uWeight );
+
+			BYTE & uFieldLCS = m_uLCS [ HITMAN::GetField ( pHit->m_uHitpos ) ];
+			uFieldLCS = Max ( uFieldLCS, uCurLCS );
+
+			iLastHitPosWithField = iPosWithField;
+			iExpDelta = iDelta + pHit->m_uSpanlen - 1;
+		}
+
+		m_uCurLCS = uCurLCS;
+		m_iExpDelta = iExpDelta;
+		m_iLastHitPosWithField = iLastHitPosWithField;
+	}
+
 	int Finalize ( const CSphMatch & tMatch )
 	{
 		m_uCurLCS = 0;
@@ -1660,6 +1785,59 @@ public:
 		m_uMinExpPos = HITMAN::GetPosWithField ( pHlist->m_uHitpos ) + 1;
 	}
 
+	// same as Update() over all the hits of a doc, but keeps the running lcs state in locals
+	void UpdateBlock ( const ExtHit_t * pHit, const ExtHit_t * pEnd )
+	{
+		if_const ( HANDLE_DUPES )
+		{
+			for ( ; pHit<pEnd; ++pHit )
+				Update ( pHit );
+			return;
+		}
+
+		if ( pHit==pEnd )
+			return;
+
+		BYTE uCurLCS = m_uCurLCS;
+		int iExpDelta = m_iExpDelta;
+		int iLastHitPos = m_iLastHitPos;
+		for ( ; pHit<pEnd; ++pHit )
+		{
+			const DWORD uField = HITMAN::GetField ( pHit->m_uHitpos );
+			const int iPos = HITMAN::GetPos ( pHit->m_uHitpos );
+			const int iPosWithField = HITMAN::GetPosWithField ( pHit->m_uHitpos );
+			const int iDelta = iPosWithField - pHit->m_uQuerypos;
+			const bool bNext = iPosWithField>iLastHitPos;
+
+			// update LCS and exact hit flag
+			if ( iDelta==iExpDelta )
+			{
+				if ( bNext )
+					uCurLCS = BYTE ( uCurLCS + pHit->m_uWeight );
+				if ( HITMAN::IsEnd ( pHit->m_uHitpos ) && (int)pHit->m_uQuerypos==m_iMaxQpos && iPos==m_iMaxQpos )
+					m_tExactHit.BitSet ( uField );
+			} else
+			{
+				if ( bNext )
+					uCurLCS = BYTE ( pHit->m_uWeight );
+				if ( iPos==1 && HITMAN::IsEnd ( pHit->m_uHitpos ) && m_iMaxQpos==1 )
+					m_tExactHit.BitSet ( uField );
+			}
+
+			m_uLCS[uField] = Max ( m_uLCS[uField], uCurLCS );
+			if ( !m_dMinHitPos[uField] )
+				m_dMinHitPos[uField] = iPos;
+
+			iExpDelta = iDelta + pHit->m_uSpanlen - 1;
+			iLastHitPos = iPosWithField;
+		}
+
+		m_uCurLCS = uCurLCS;
+		m_iExpDelta = iExpDelta;
+		m_iLastHitPos = iLastHitPos;
+		m_uMinExpPos = iLastHitPos + 1;
+	}
+
 	int Finalize ( const CSphMatch & tMatch )
 	{
 		m_iExpDelta = -1;
@@ -1734,6 +1912,12 @@ struct RankerState_ProximityPayload_fn : public RankerState_Proximity_fn<USE_BM2
 			RankerState_Proximity_fn<USE_BM25,false>::Update ( pHlist );
 	}
 
+	void UpdateBlock ( const ExtHit_t * pHit, const ExtHit_t * pEnd )
+	{
+		for ( ; pHit<pEnd; ++pHit )
+			Update ( pHit );
+	}
+
 	int Finalize ( const CSphMatch & tMatch )
 	{
 		// as usual, redundant 'this' is just because gcc is stupid
@@ -1777,6 +1961,13 @@ struct RankerState_MatchAny_fn : public RankerState_Proximity_fn<false,false>
 		m_uMatchMask [ HITMAN::GetField ( pHlist->m_uHitpos ) ] |= ( 1<<(pHlist->m_uQuerypos-1) );
 	}
 
+	void UpdateBlock ( const ExtHit_t * pHit, const ExtHit_t * pEnd )
+	{
+		RankerState_Proximity_fn<false,false>::UpdateBlock ( pHit, pEnd );
+		for ( ; pHit<pEnd; ++pHit )
+			m_uMatchMask [ HITMAN::GetField ( pHit->m_uHitpos ) ] |= ( 1<<(pHit->m_uQuerypos-1) );
+	}
+
 	int Finalize ( const CSphMatch & )
 	{
 		m_uCurLCS = 0;
@@ -1815,6 +2006,14 @@ struct RankerState_Wordcount_fn : public ISphExtra
 		m_iRank += m_pWeights [ HITMAN::GetField ( pHlist->m_uHitpos ) ];
 	}
 
+	void UpdateBlock ( const ExtHit_t * pHit, const ExtHit_t * pEnd )
+	{
+		int iRank = 0;
+		for ( ; pHit<pEnd; ++pHit )
+			iRank += m_pWeights [ HITMAN::GetField ( pHit->m_uHitpos ) ];
+		m_iRank += iRank;
+	}
+
 	int Finalize ( const CSphMatch & )
 	{
 		int iRes = m_iRank;
@@ -1840,6 +2039,14 @@ struct RankerState_Fieldmask_fn : public ISphExtra
 		m_uRank |= 1UL << HITMAN::GetField ( pHlist->m_uHitpos );
 	}
 
+	void UpdateBlock ( const ExtHit_t * pHit, const ExtHit_t * pEnd )
+	{
+		DWORD uRank = 0;
+		for ( ; pHit<pEnd; ++pHit )
+			uRank |= 1UL << HITMAN::GetField ( pHit->m_uHitpos );
+		m_uRank |= uRank;
+	}
+
 	int Finalize ( const CSphMatch & )
 	{
 		DWORD uRes = m_uRank;
@@ -4412,6 +4619,42 @@ static bool HasQwordDupes ( XQNode_t * pNode )
 }
 
 
+/// upper bound of the non-BM25 part of the weight for the rankers that support weight pruning, -1 for all the others
+static int GetMaxRankBonus ( ESphRankMode eRanker, const XQQuery_t & tXQ, const CSphQueryContext & tCtx, int iMaxQpos )
+{
+	int64_t iSumWeights = 0;
+	int64_t iSumWeights32 = 0;	// weightsum ranker only looks at the lowest 32 fields
+	for ( int i=0; i<tCtx.m_iWeights; i++ )
+	{
+		int iWeight = Max ( tCtx.m_dWeights[i], 0 );
+		iSumWeights += iWeight;
+		if ( i<32 )
+			iSumWeights32 += iWeight;
+	}
+
+	int64_t iBonus = -1;
+	switch ( eRanker )
+	{
+	case SPH_RANK_BM25:
+		iBonus = Max ( iSumWeights32, 1 );
+		break;
+
+	case SPH_RANK_PROXIMITY_BM25:
+		// per-field lcs can't be longer than the query itself
+		if ( tXQ.m_bSingleWord )
+			iBonus = Max ( iSumWeights32, 1 );
+		else
+			iBonus = Min ( iMaxQpos, 255 ) * iSumWeights;
+		break;
+
+	default:
+		break;
+	}
+
+	return (int)Min ( iBonus, (int64_t)INT_MAX );
+}
+
+
 std::unique_ptr<ISphRanker> sphCreateRanker ( const XQQuery_t & tXQ, const CSphQuery & tQuery, CSphQueryResultMeta & tMeta, const ISphQwordSetup & tTermSetup, const CSphQueryContext & tCtx, const ISphSchema & tSorterSchema )
 {
 	// shortcut
@@ -4430,11 +4673,15 @@ std::unique_ptr<ISphRanker> sphCreateRanker ( const XQQuery_t & tXQ, const CSphQ
 	// can we serve this from cache?
 	QcacheEntryRefPtr_t pCached;
 	if ( !tRankerSettings.m_bSkipQCache )
-		pCached = QcacheFind ( pIndex->GetIndexId(), tQuery, tSorterSchema );
+		pCached = QcacheFind ( pIndex->GetIndexId(), pIndex->GetUpdateGeneration(), tQuery, tSorterSchema );
 
 	if ( pCached )
 		return QcacheRanker ( pCached, tTermSetup );
 
+	// weight pruning makes the result set partial, so we might use the cache but must never populate it
+	if ( tQuery.m_bWeightPruning )
+		tRankerSettings.m_bSkipQCache = true;
+
 	// we need this for rankers that populate nodes with docs immediately after creation (e.g. payload nodes)
 	tRankerSettings.m_bRowidLimits = tQuery.m_dFilters.any_of ( []( auto & tFilter ){ return tFilter.m_sAttrName=="@rowid"; } );
 	if ( tRankerSettings.m_bRowidLimits ) 
@@ -4635,9 +4882,26 @@ std::unique_ptr<ISphRanker> sphCreateRanker ( const XQQuery_t & tXQ, const CSphQ
 		pRanker->SetTermDupes ( hQwords, iMaxQpos );
 	if ( !pRanker->InitState ( tCtx, tMeta.m_sError ) )
 		pRanker.reset();
+
+	if ( pRanker && tQuery.m_bWeightPruning && !uPayloadMask )
+		pRanker->m_iMaxRankBonus = GetMaxRankBonus ( tQuery.m_eRanker, tXQ, tCtx, iMaxQpos );
+
 	return pRanker;
 }
 
+void sphSetRankerMinWeight ( ISphRanker * pRanker, const ISphMatchSorter * pSorter, int iIndexWeight )
+{
+	assert ( pRanker && pSorter );
+
+	int iWorst = 0;
+	if ( iIndexWeight<=0 || !pSorter->GetWeightThreshold ( iWorst ) )
+		return;
+
+	// sorter sees weights multiplied by index weight; truncating division never makes the threshold higher than it should be
+	int iMinWeight = iWorst / iIndexWeight;
+	pRanker->ExtraData ( EXTRA_SET_MINWEIGHT, (void**)&iMinWeight );
+}
+
 //////////////////////////////////////////////////////////////////////////
 /// HIT MARKER
 //////////////////////////////////////////////////////////////////////////
@@ -37,6 +37,7 @@ struct SkiplistEntry_t
 	RowID_t		m_tBaseRowIDPlus1;	///< delta decoder rowid base (stored as base rowid + 1)
 	int64_t		m_iOffset;			///< offset in the doclist file (relative to the doclist start)
 	int64_t		m_iBaseHitlistPos;	///< delta decoder hitlist offset base
+	DWORD		m_uMaxHits = 0;		///< max hits per doc in this block (used to bound per-block term weight)
 };
 
 bool operator < ( const SkiplistEntry_t & a, RowID_t b );
@@ -47,8 +48,10 @@ struct DictEntry_t;
 struct SkipData_t
 {
 	CSphVector<SkiplistEntry_t> m_dSkiplist;
+	bool		m_bHasMaxHits = false;	///< whether entries carry m_uMaxHits (indexes v.67+)
+	DWORD		m_uMaxHits = 0;			///< max hits per doc over the whole doclist
 
-	void Read ( const BYTE * pSkips, const DictEntry_t & tRes, int iDocs, int iSkipBlockSize );
+	void Read ( const BYTE * pSkips, const DictEntry_t & tRes, int iDocs, int iSkipBlockSize, bool bHasMaxHits );
 };
 
 class RtIndex_c;
@@ -105,6 +108,8 @@ public:
 	virtual void				Reset();
 
 	int							GetAtomPos() const;
+	DWORD						GetMaxHits() const;
+	DWORD						GetBlockMaxHits ( RowID_t tRowID, RowID_t & tNextBlock ) const;
 
 	virtual bool SetupScan ( const RtIndex_c * pIndex, int iSegment, const RtGuard_t& tGuard ) { return false; }
 };
@@ -158,6 +163,9 @@ public:
 /// factory
 std::unique_ptr<ISphRanker> sphCreateRanker ( const XQQuery_t & tXQ, const CSphQuery & tQuery, CSphQueryResultMeta & tMeta, const ISphQwordSetup & tTermSetup, const CSphQueryContext & tCtx, const ISphSchema & tSorterSchema );
 
+/// weight pruning; let the ranker skip the docs that can't beat the worst match of a full sorter
+void sphSetRankerMinWeight ( ISphRanker * pRanker, const ISphMatchSorter * pSorter, int iIndexWeight );
+
 class QwordScan_c : public ISphQword
 {
 public:
@@ -32,6 +32,7 @@
 
 static bool g_bAccurateAggregation = false;
 static int g_iDistinctThresh = 3500;
+static int64_t g_iGroupbyMemLimit = 0;
 
 void SetAccurateAggregationDefault ( bool bEnabled )
 {
@@ -56,6 +57,28 @@ int GetDistinctThreshDefault()
 	return g_iDistinctThresh;
 }
 
+
+void SetGroupbyMemLimitDefault ( int64_t iMemLimit )
+{
+	g_iGroupbyMemLimit = iMemLimit;
+}
+
+
+int64_t GetGroupbyMemLimitDefault()
+{
+	return g_iGroupbyMemLimit;
+}
+
+
+int64_t GetGroupbyMemLimit ( const CSphQuery & tQuery )
+{
+	// N-best and count(distinct) sorters don't spill
+	if ( tQuery.m_sGroupBy.IsEmpty() || tQuery.m_iGroupbyLimit>1 || !tQuery.m_sGroupDistinct.IsEmpty() )
+		return 0;
+
+	return tQuery.m_bExplicitGroupbyMemLimit ? tQuery.m_iGroupbyMemLimit : g_iGroupbyMemLimit;
+}
+
 //////////////////////////////////////////////////////////////////////////
 // SORTING QUEUES
 //////////////////////////////////////////////////////////////////////////
@@ -101,6 +124,16 @@ public:
 
 	bool	IsGroupby () const final										{ return false; }
 	const CSphMatch * GetWorst() const final								{ return m_dIData.IsEmpty() ? nullptr : Root(); }
+
+	bool GetWeightThreshold ( int & iWeight ) const final
+	{
+		if ( Used()<m_iSize || !IsWeightFirst() )
+			return false;
+
+		iWeight = Root()->m_iWeight;
+		return true;
+	}
+
 	bool	Push ( const CSphMatch & tEntry ) final							{ return PushT ( tEntry, [this] ( CSphMatch & tTrg, const CSphMatch & tMatch ) { m_pSchema->CloneMatch ( tTrg, tMatch ); }); }
 	void	Push ( const VecTraits_T<const CSphMatch> & dMatches ) final
 	{
@@ -224,6 +257,18 @@ private:
 		return &m_dData [ m_dIData.First() ];
 	}
 
+	bool IsWeightFirst() const
+	{
+		if constexpr ( std::is_same_v<COMP, MatchRelevanceLt_fn> )
+			return true;
+
+		if constexpr ( std::is_same_v<COMP, MatchGeneric1_fn> || std::is_same_v<COMP, MatchGeneric2_fn> || std::is_same_v<COMP, MatchGeneric3_fn>
+			|| std::is_same_v<COMP, MatchGeneric4_fn> || std::is_same_v<COMP, MatchGeneric5_fn> )
+			return m_tState.m_eKeypart[0]==SPH_KEYPART_WEIGHT && ( m_tState.m_uAttrDesc & 1 );
+
+		return false;
+	}
+
 	/// generic add entry to the queue
 	template <typename MATCH, typename PUSHER>
 	bool PushT ( MATCH && tEntry, PUSHER && PUSH )
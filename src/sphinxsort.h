@@ -92,6 +92,9 @@ public:
 	/// get a pointer to the worst element, NULL if there is no fixed location
 	virtual const CSphMatch * GetWorst() const { return nullptr; }
 
+	/// get the weight of the worst match if the sorter is full and sorts by weight first (so that lesser weights can't get in)
+	virtual bool		GetWeightThreshold ( int & iWeight ) const { return false; }
+
 	/// returns whether the sorter can be cloned to distribute processing over multi threads
 	/// (delete and update sorters are too complex by side effects and can't be cloned)
 	virtual bool		CanBeCloned() const { return true; }
@@ -102,6 +105,10 @@ public:
 	/// move resultset into target
 	virtual void		MoveTo ( ISphMatchSorter * pRhs, bool bCopyMeta ) = 0;
 
+	/// move resultsets of several same sorters into this one at once, splitting the work over iThreads
+	/// returns false if not supported (or not worth it); sources are left intact then and should be moved with MoveTo()
+	virtual bool		MoveFromParallel ( const VecTraits_T<ISphMatchSorter *> & dSources, int iThreads ) { return false; }
+
 	/// makes the same sorter
 	virtual void		CloneTo ( ISphMatchSorter * pTrg ) const = 0;
 
@@ -156,6 +163,10 @@ bool	GetAccurateAggregationDefault();
 void	SetDistinctThreshDefault ( int iThresh );
 int 	GetDistinctThreshDefault();
 
+void	SetGroupbyMemLimitDefault ( int64_t iMemLimit );
+int64_t	GetGroupbyMemLimit ( const CSphQuery & tQuery );
+int64_t	GetGroupbyMemLimitDefault();
+
 int		ApplyImplicitCutoff ( const CSphQuery & tQuery, const VecTraits_T<ISphMatchSorter*> & dSorters, bool bFT );
 
 ISphMatchSorter *	CreateCollectQueue ( int iMaxMatches, CSphVector<BYTE> & tCollection );
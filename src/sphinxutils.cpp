@@ -925,6 +925,7 @@ static KeyDesc_t g_dKeysIndex[] =
 	{ "columnar_compression_int64", KEY_REMOVED, nullptr },
 	{ "columnar_subblock",		KEY_REMOVED, nullptr },
 	{ "optimize_cutoff",		0, nullptr },
+	{ "rt_doclist_format",		0, nullptr },
 	{ "engine_default",			0, nullptr },
 	{ "knn",					0, nullptr },
 	{ "json_secondary_indexes",	0, nullptr },
@@ -981,6 +982,7 @@ static KeyDesc_t g_dKeysSearchd[] =
 	{ "read_buffer_hits",		0, NULL },
 	{ "read_buffer_columnar",	0, NULL },
 	{ "read_unhinted",			0, NULL },
+	{ "read_prefetch",			0, NULL },
 	{ "max_batch_queries",		0, NULL },
 	{ "subtree_docs_cache",		0, NULL },
 	{ "subtree_hits_cache",		0, NULL },
@@ -991,6 +993,7 @@ static KeyDesc_t g_dKeysSearchd[] =
 	{ "binlog_flush",			0, NULL },
 	{ "binlog_path",			0, NULL },
 	{ "binlog_max_log_size",	0, NULL },
+	{ "binlog_group_commit_window",	0, NULL },
 	{ "binlog_filename_digits",	0, NULL },
 	{ "binlog_common",			0, NULL },
 	{ "thread_stack",			0, NULL },
@@ -1009,8 +1012,10 @@ static KeyDesc_t g_dKeysSearchd[] =
 	{ "rt_merge_maxiosize",		0, NULL },
 	{ "ha_ping_interval",		0, NULL },
 	{ "ha_period_karma",		0, NULL },
+	{ "ha_hedged_requests",		0, NULL },
 	{ "predicted_time_costs",	0, NULL },
 	{ "persistent_connections_limit",	0, NULL },
+	{ "persistent_connections_wait",	0, NULL },
 	{ "ondisk_attrs_default",	KEY_REMOVED, NULL },
 	{ "shutdown_timeout",		0, NULL },
 	{ "query_log_min_msec",		0, NULL },
@@ -1018,6 +1023,8 @@ static KeyDesc_t g_dKeysSearchd[] =
 	{ "agent_query_timeout",	0, NULL },
 	{ "agent_retry_delay",		0, NULL },
 	{ "agent_retry_count",		0, NULL },
+	{ "agent_streaming_merge",	0, NULL },
+	{ "agent_topn_pushdown",	0, NULL },
 	{ "net_wait_tm",			0, NULL },
 	{ "net_throttle_action",	0, NULL },
 	{ "net_throttle_accept",	0, NULL },
@@ -1044,6 +1051,7 @@ static KeyDesc_t g_dKeysSearchd[] =
 	{ "access_dict",			0, nullptr },
 	{ "docstore_cache_size",	0, nullptr },
 	{ "skiplist_cache_size",	0, nullptr },
+	{ "skiplist_cache_hotlist",	0, nullptr },
 	{ "ssl_cert",				0, nullptr },
 	{ "ssl_key",				0, nullptr },
 	{ "ssl_ca",					0, nullptr },
@@ -1058,6 +1066,7 @@ static KeyDesc_t g_dKeysSearchd[] =
 	{ "secondary_indexes",		0, nullptr },
 	{ "accurate_aggregation",	0, nullptr },
 	{ "distinct_precision_threshold", 0, nullptr },
+	{ "groupby_mem_limit",		0, nullptr },
 	{ "preopen_tables",			0, nullptr },
 	{ "buddy_path",				0, nullptr },
 	{ "telemetry",				0, nullptr },
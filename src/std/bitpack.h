@@ -0,0 +1,29 @@
+//
+// Copyright (c) 2017-2024, Manticore Software LTD (https://manticoresearch.com)
+// All rights reserved
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License. You should have
+// received a copy of the GPL license along with this program; if you
+// did not, you can find it at http://www.gnu.org
+//
+
+#pragma once
+
+#include "ints.h"
+
+// fixed-width bit packing of DWORD values in groups of BITPACK_GROUP values.
+// group of width W occupies exactly W dwords (BitpackGroupBytes(W) bytes), so groups are decoded without any branching on data
+constexpr int BITPACK_GROUP = 32;
+constexpr int BitpackGroupBytes ( int iWidth ) { return iWidth * (int)sizeof ( DWORD ); }
+
+// bits needed to store any of iCount values (0..32)
+int BitpackWidth ( const DWORD * pValues, int iCount );
+
+// pack BITPACK_GROUP values of width iWidth; output may be unaligned
+void BitpackGroup ( const DWORD * pIn, BYTE * pOut, int iWidth );
+
+// unpack BITPACK_GROUP values of width iWidth; input may be unaligned
+void BitunpackGroup ( const BYTE * pIn, DWORD * pOut, int iWidth );
+
+#include "bitpack_impl.h"
@@ -0,0 +1,127 @@
+//
+// Copyright (c) 2017-2024, Manticore Software LTD (https://manticoresearch.com)
+// All rights reserved
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License. You should have
+// received a copy of the GPL license along with this program; if you
+// did not, you can find it at http://www.gnu.org
+//
+
+#include "generics.h"
+#include "log2.h"
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <utility>
+
+namespace bitpack_detail
+{
+
+FORCE_INLINE DWORD LoadDword ( const BYTE * pIn, int iWord )
+{
+	DWORD uRes;
+	memcpy ( &uRes, pIn + iWord * sizeof ( DWORD ), sizeof ( DWORD ) );
+	return uRes;
+}
+
+// every shift and offset is a compile-time constant here, so the whole group unrolls into straight shift/mask code
+// which compilers turn into vector ops
+template<int WIDTH, int I>
+FORCE_INLINE void UnpackOne ( const BYTE * pIn, DWORD * pOut )
+{
+	constexpr int iBit = I * WIDTH;
+	constexpr int iWord = iBit >> 5;
+	constexpr int iShift = iBit & 31;
+	constexpr DWORD uMask = WIDTH==32 ? 0xFFFFFFFFU : ( 1U << WIDTH ) - 1;
+
+	DWORD uValue = LoadDword ( pIn, iWord ) >> iShift;
+	if constexpr ( iShift + WIDTH > 32 )
+		uValue |= LoadDword ( pIn, iWord + 1 ) << ( 32 - iShift );
+	pOut[I] = uValue & uMask;
+}
+
+template<int WIDTH, int I>
+FORCE_INLINE void PackOne ( const DWORD * pIn, DWORD * pOut )
+{
+	constexpr int iBit = I * WIDTH;
+	constexpr int iWord = iBit >> 5;
+	constexpr int iShift = iBit & 31;
+
+	pOut[iWord] |= pIn[I] << iShift;
+	if constexpr ( iShift + WIDTH > 32 )
+		pOut[iWord + 1] |= pIn[I] >> ( 32 - iShift );
+}
+
+template<int WIDTH, int... I>
+void Unpack ( const BYTE * pIn, DWORD * pOut, std::integer_sequence<int, I...> )
+{
+	if constexpr ( WIDTH==0 )
+		memset ( pOut, 0, BITPACK_GROUP * sizeof ( DWORD ) );
+	else
+		( UnpackOne<WIDTH, I> ( pIn, pOut ), ... );
+}
+
+template<int WIDTH, int... I>
+void Pack ( const DWORD * pIn, BYTE * pOut, std::integer_sequence<int, I...> )
+{
+	if constexpr ( WIDTH>0 )
+	{
+		DWORD dPacked[WIDTH] {};
+		( PackOne<WIDTH, I> ( pIn, dPacked ), ... );
+		memcpy ( pOut, dPacked, sizeof ( dPacked ) );
+	}
+}
+
+template<int WIDTH>
+void UnpackGroup ( const BYTE * pIn, DWORD * pOut )
+{
+	Unpack<WIDTH> ( pIn, pOut, std::make_integer_sequence<int, BITPACK_GROUP>() );
+}
+
+template<int WIDTH>
+void PackGroup ( const DWORD * pIn, BYTE * pOut )
+{
+	Pack<WIDTH> ( pIn, pOut, std::make_integer_sequence<int, BITPACK_GROUP>() );
+}
+
+using UnpackFn_t = void ( * ) ( const BYTE *, DWORD * );
+using PackFn_t = void ( * ) ( const DWORD *, BYTE * );
+
+template<int... W>
+constexpr std::array<UnpackFn_t, sizeof...( W )> MakeUnpackers ( std::integer_sequence<int, W...> )
+{
+	return { &UnpackGroup<W>... };
+}
+
+template<int... W>
+constexpr std::array<PackFn_t, sizeof...( W )> MakePackers ( std::integer_sequence<int, W...> )
+{
+	return { &PackGroup<W>... };
+}
+
+} // namespace bitpack_detail
+
+
+inline int BitpackWidth ( const DWORD * pValues, int iCount )
+{
+	DWORD uAll = 0;
+	for ( int i = 0; i < iCount; ++i )
+		uAll |= pValues[i];
+	return uAll ? sphLog2 ( uAll ) : 0;
+}
+
+inline void BitpackGroup ( const DWORD * pIn, BYTE * pOut, int iWidth )
+{
+	static constexpr auto dPackers = bitpack_detail::MakePackers ( std::make_integer_sequence<int, 33>() );
+	assert ( iWidth>=0 && iWidth<=32 );
+	assert ( BitpackWidth ( pIn, BITPACK_GROUP )<=iWidth );
+	dPackers[iWidth] ( pIn, pOut );
+}
+
+inline void BitunpackGroup ( const BYTE * pIn, DWORD * pOut, int iWidth )
+{
+	static constexpr auto dUnpackers = bitpack_detail::MakeUnpackers ( std::make_integer_sequence<int, 33>() );
+	assert ( iWidth>=0 && iWidth<=32 );
+	dUnpackers[iWidth] ( pIn, pOut );
+}
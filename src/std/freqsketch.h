@@ -0,0 +1,45 @@
+//
+// Copyright (c) 2017-2024, Manticore Software LTD (https://manticoresearch.com)
+// All rights reserved
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License. You should have
+// received a copy of the GPL license along with this program; if you
+// did not, you can find it at http://www.gnu.org
+//
+
+#pragma once
+
+#include "ints.h"
+#include "fixedvector.h"
+
+#include <atomic>
+
+/// TinyLFU-style frequency sketch; a count-min sketch of small saturating counters
+/// which are halved every now and then, so it tracks recent popularity of the keys rather than all-time one.
+/// Counters are relaxed atomics, updated without any lock: an increment may get lost on a race, which is fine for an estimate,
+/// and concurrent lookups never wait for each other
+class FrequencySketch_c
+{
+public:
+	explicit	FrequencySketch_c ( int64_t iWidth );
+
+	void		Increment ( DWORD uHash );
+	int			Estimate ( DWORD uHash ) const;
+	void		SetMax ( DWORD uHash );
+
+	static constexpr int	DEPTH = 4;
+	static constexpr BYTE	MAX_COUNT = 15;
+	static constexpr int	MAX_WIDTH = 1<<22;
+
+private:
+	CSphFixedVector<std::atomic<BYTE>>	m_dCounters {0};
+	DWORD					m_uMask = 0;
+	std::atomic<int64_t>	m_iAdditions {0};
+	int64_t					m_iAgeAt = 0;
+
+	int			Index ( DWORD uHash, int iRow ) const;
+	void		Age();
+};
+
+#include "freqsketch_impl.h"
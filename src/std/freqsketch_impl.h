@@ -0,0 +1,80 @@
+//
+// Copyright (c) 2017-2024, Manticore Software LTD (https://manticoresearch.com)
+// All rights reserved
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License. You should have
+// received a copy of the GPL license along with this program; if you
+// did not, you can find it at http://www.gnu.org
+//
+
+#pragma once
+
+inline FrequencySketch_c::FrequencySketch_c ( int64_t iWidth )
+{
+	int iPow2 = 1;
+	while ( iPow2<iWidth && iPow2<MAX_WIDTH )
+		iPow2 <<= 1;
+
+	m_uMask = iPow2-1;
+	m_dCounters.Reset ( iPow2*DEPTH );
+	for ( auto & tCounter : m_dCounters )
+		tCounter.store ( 0, std::memory_order_relaxed );
+
+	m_iAgeAt = (int64_t)iPow2*10;
+}
+
+
+inline void FrequencySketch_c::Increment ( DWORD uHash )
+{
+	bool bIncremented = false;
+	for ( int i = 0; i < DEPTH; ++i )
+	{
+		auto & tCounter = m_dCounters[Index ( uHash, i )];
+		BYTE uCounter = tCounter.load ( std::memory_order_relaxed );
+		if ( uCounter<MAX_COUNT )
+		{
+			tCounter.store ( uCounter+1, std::memory_order_relaxed );
+			bIncremented = true;
+		}
+	}
+
+	// exactly one thread crosses the threshold, and ages the counters
+	if ( bIncremented && m_iAdditions.fetch_add ( 1, std::memory_order_relaxed )+1==m_iAgeAt )
+		Age();
+}
+
+
+inline int FrequencySketch_c::Estimate ( DWORD uHash ) const
+{
+	int iMin = MAX_COUNT;
+	for ( int i = 0; i < DEPTH; ++i )
+		iMin = Min ( iMin, (int)m_dCounters[Index ( uHash, i )].load ( std::memory_order_relaxed ) );
+
+	return iMin;
+}
+
+
+inline void FrequencySketch_c::SetMax ( DWORD uHash )
+{
+	for ( int i = 0; i < DEPTH; ++i )
+		m_dCounters[Index ( uHash, i )].store ( MAX_COUNT, std::memory_order_relaxed );
+}
+
+
+inline int FrequencySketch_c::Index ( DWORD uHash, int iRow ) const
+{
+	static const DWORD dSeeds[DEPTH] = { 0x97CB3127, 0xB8C2E17D, 0x2F9A5E13, 0x6C8E9CF5 };
+	DWORD uRowHash = ( uHash ^ dSeeds[iRow] ) * 0x9E3779B1;
+	uRowHash ^= uRowHash >> 15;
+	return iRow*( m_uMask+1 ) + ( uRowHash & m_uMask );
+}
+
+
+inline void FrequencySketch_c::Age()
+{
+	for ( auto & tCounter : m_dCounters )
+		tCounter.store ( tCounter.load ( std::memory_order_relaxed ) >> 1, std::memory_order_relaxed );
+
+	m_iAdditions.fetch_sub ( m_iAgeAt/2, std::memory_order_relaxed );
+}
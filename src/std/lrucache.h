@@ -17,11 +17,23 @@
 #include "mutex.h"
 #include "openhash.h"
 
+#include <atomic>
+#include <memory>
+
+struct LRUCacheStats_t
+{
+	int64_t	m_iMaxBytes = 0;
+	int64_t	m_iUsedBytes = 0;
+	int64_t	m_iEntries = 0;
+	int64_t	m_iEvictions = 0;
+	int64_t	m_iContended = 0;	///< lock acquisitions which had to wait for another thread
+};
+
 template <typename KEY, typename VALUE, typename HELPER>
 class LRUCache_T
 {
 public:
-			LRUCache_T ( int64_t iCacheSize );
+			LRUCache_T ( int64_t iCacheSize, int64_t iMaxEntrySize = 0 );	///< iMaxEntrySize==0 means 1/64 of the cache
 			~LRUCache_T();
 
 	bool	Find ( KEY tKey, VALUE & tData );
@@ -31,6 +43,15 @@ public:
 	template <typename COND>
 	void	Delete ( COND && fnCond );
 
+	/// walks the entries from the most to the least recently used one
+	template <typename FN>
+	void	ForEach ( FN && fnAction );
+
+	/// if an entry of uSize bytes doesn't fit, returns true and the key of the entry which would be swept first
+	bool	GetVictim ( DWORD uSize, KEY & tVictim );
+
+	LRUCacheStats_t GetStats();
+
 protected:
 	struct LinkedEntry_t
 	{
@@ -46,10 +67,14 @@ protected:
 	LinkedEntry_t *		m_pTail = nullptr;
 	int64_t				m_iCacheSize = 0;
 	int64_t				m_iMemUsed = 0;
+	int64_t				m_iMaxEntrySize = 0;
+	int64_t				m_iEvicted = 0;		///< entries swept out to make space for the new ones
+	std::atomic<int64_t> m_iContended {0};
 	CSphMutex			m_tLock;
 	OpenHashTable_T<KEY, LinkedEntry_t *, HELPER> m_tHash;
 
 	void	Delete ( LinkedEntry_t * pEntry );
+	void	Lock() ACQUIRE ( m_tLock );
 
 private:
 	void	MoveToHead ( LinkedEntry_t * pEntry );
@@ -58,6 +83,37 @@ private:
 	bool	HaveSpaceFor ( DWORD uSpaceNeeded ) const;
 };
 
+/// same as LRUCache_T, but split into independent segments by the key hash, each with its own lock and LRU list,
+/// so that concurrent lookups of different keys don't serialize on a single mutex
+template <typename KEY, typename VALUE, typename HELPER, int SHARD_BITS = 4>
+class ShardedLRUCache_T
+{
+	using Shard_t = LRUCache_T<KEY, VALUE, HELPER>;
+	static constexpr int SHARDS = 1 << SHARD_BITS;
+
+public:
+	explicit ShardedLRUCache_T ( int64_t iCacheSize );
+
+	bool	Find ( KEY tKey, VALUE & tData )		{ return GetShard(tKey).Find ( tKey, tData ); }
+	bool	Add ( KEY tKey, const VALUE & tData )	{ return GetShard(tKey).Add ( tKey, tData ); }
+	void	Release ( KEY tKey )					{ GetShard(tKey).Release ( tKey ); }
+	bool	GetVictim ( KEY tKey, DWORD uSize, KEY & tVictim ) { return GetShard(tKey).GetVictim ( uSize, tVictim ); }
+
+	template <typename COND>
+	void	Delete ( COND && fnCond );
+
+	/// walks the entries shard by shard; within a shard, from the most to the least recently used one
+	template <typename FN>
+	void	ForEach ( FN && fnAction );
+
+	LRUCacheStats_t GetStats();
+
+private:
+	std::unique_ptr<Shard_t> m_dShards[SHARDS];
+
+	Shard_t & GetShard ( const KEY & tKey ) const;
+};
+
 #include "lrucache_impl.h"
 
 #endif // _lrucache_
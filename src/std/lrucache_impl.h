@@ -13,8 +13,9 @@
 #include "scopedlock.h"
 
 template <typename KEY, typename VALUE, typename HELPER>
-LRUCache_T<KEY,VALUE,HELPER>::LRUCache_T ( int64_t iCacheSize )
+LRUCache_T<KEY,VALUE,HELPER>::LRUCache_T ( int64_t iCacheSize, int64_t iMaxEntrySize )
 	: m_iCacheSize ( iCacheSize )
+	, m_iMaxEntrySize ( iMaxEntrySize ? iMaxEntrySize : iCacheSize/64 )
 	, m_tHash ( 1024 )
 {}
 
@@ -33,7 +34,8 @@ LRUCache_T<KEY,VALUE,HELPER>::~LRUCache_T()
 template <typename KEY, typename VALUE, typename HELPER>
 bool LRUCache_T<KEY,VALUE,HELPER>::Find ( KEY tKey, VALUE & tData )
 {
-	ScopedMutex_t tLock(m_tLock);
+	Lock();
+	ScopedMutex_t tLock ( m_tLock, ScopedMutex_t::adopt_lock );
 
 	LinkedEntry_t ** ppEntry = m_tHash.Find(tKey);
 	if ( !ppEntry )
@@ -49,7 +51,8 @@ bool LRUCache_T<KEY,VALUE,HELPER>::Find ( KEY tKey, VALUE & tData )
 template <typename KEY, typename VALUE, typename HELPER>
 bool LRUCache_T<KEY,VALUE,HELPER>::Add ( KEY tKey, const VALUE & tData )
 {
-	ScopedMutex_t tLock(m_tLock);
+	Lock();
+	ScopedMutex_t tLock ( m_tLock, ScopedMutex_t::adopt_lock );
 
 	// if another thread managed to add a similar block while we were uncompressing ours, let it be
 	LinkedEntry_t ** ppEntry = m_tHash.Find(tKey);
@@ -60,8 +63,7 @@ bool LRUCache_T<KEY,VALUE,HELPER>::Add ( KEY tKey, const VALUE & tData )
 	DWORD uSpaceNeeded = uSize + sizeof(LinkedEntry_t);
 	if ( !HaveSpaceFor ( uSpaceNeeded ) )
 	{
-		DWORD MAX_BLOCK_SIZE = m_iCacheSize/64;
-		if ( uSpaceNeeded>MAX_BLOCK_SIZE )
+		if ( uSpaceNeeded>m_iMaxEntrySize )
 			return false;
 
 		SweepUnused ( uSpaceNeeded );
@@ -82,7 +84,8 @@ bool LRUCache_T<KEY,VALUE,HELPER>::Add ( KEY tKey, const VALUE & tData )
 template <typename KEY, typename VALUE, typename HELPER>
 void LRUCache_T<KEY,VALUE,HELPER>::Release ( KEY tKey )
 {
-	ScopedMutex_t tLock(m_tLock);
+	Lock();
+	ScopedMutex_t tLock ( m_tLock, ScopedMutex_t::adopt_lock );
 
 	LinkedEntry_t ** ppEntry = m_tHash.Find(tKey);
 	assert(ppEntry);
@@ -96,7 +99,8 @@ template <typename KEY, typename VALUE, typename HELPER>
 template <typename COND>
 void LRUCache_T<KEY,VALUE,HELPER>::Delete ( COND && fnCond )
 {
-	ScopedMutex_t tLock(m_tLock);
+	Lock();
+	ScopedMutex_t tLock ( m_tLock, ScopedMutex_t::adopt_lock );
 
 	LinkedEntry_t * pEntry = m_pHead;
 	while ( pEntry )
@@ -113,6 +117,61 @@ void LRUCache_T<KEY,VALUE,HELPER>::Delete ( COND && fnCond )
 	}
 }
 
+template <typename KEY, typename VALUE, typename HELPER>
+template <typename FN>
+void LRUCache_T<KEY,VALUE,HELPER>::ForEach ( FN && fnAction )
+{
+	Lock();
+	ScopedMutex_t tLock ( m_tLock, ScopedMutex_t::adopt_lock );
+
+	for ( LinkedEntry_t * pEntry = m_pHead; pEntry; pEntry = pEntry->m_pNext )
+		fnAction ( pEntry->m_tKey, pEntry->m_tValue );
+}
+
+template <typename KEY, typename VALUE, typename HELPER>
+bool LRUCache_T<KEY,VALUE,HELPER>::GetVictim ( DWORD uSize, KEY & tVictim )
+{
+	Lock();
+	ScopedMutex_t tLock ( m_tLock, ScopedMutex_t::adopt_lock );
+
+	if ( HaveSpaceFor ( uSize + sizeof(LinkedEntry_t) ) )
+		return false;
+
+	// same order as SweepUnused
+	for ( LinkedEntry_t * pEntry = m_pTail; pEntry; pEntry = pEntry->m_pPrev )
+		if ( !pEntry->m_iRefcount )
+		{
+			tVictim = pEntry->m_tKey;
+			return true;
+		}
+
+	return false;
+}
+
+template <typename KEY, typename VALUE, typename HELPER>
+LRUCacheStats_t LRUCache_T<KEY,VALUE,HELPER>::GetStats()
+{
+	LRUCacheStats_t tStats;
+	tStats.m_iContended = m_iContended.load ( std::memory_order_relaxed );
+
+	ScopedMutex_t tLock ( m_tLock );
+	tStats.m_iMaxBytes = m_iCacheSize;
+	tStats.m_iUsedBytes = m_iMemUsed;
+	tStats.m_iEntries = m_tHash.GetLength();
+	tStats.m_iEvictions = m_iEvicted;
+	return tStats;
+}
+
+template <typename KEY, typename VALUE, typename HELPER>
+void LRUCache_T<KEY,VALUE,HELPER>::Lock()
+{
+	if ( m_tLock.TryLock() )
+		return;
+
+	m_iContended.fetch_add ( 1, std::memory_order_relaxed );
+	m_tLock.Lock();
+}
+
 
 template <typename KEY, typename VALUE, typename HELPER>
 void LRUCache_T<KEY,VALUE,HELPER>::MoveToHead ( LinkedEntry_t * pEntry )
@@ -191,6 +250,7 @@ void LRUCache_T<KEY,VALUE,HELPER>::SweepUnused ( DWORD uSpaceNeeded )
 			LinkedEntry_t * pToDelete = pEntry;
 			pEntry = pEntry->m_pPrev;
 			Delete(pToDelete);
+			m_iEvicted++;
 		}
 		else
 			pEntry = pEntry->m_pPrev;
@@ -202,3 +262,54 @@ bool LRUCache_T<KEY,VALUE,HELPER>::HaveSpaceFor ( DWORD uSpaceNeeded ) const
 {
 	return m_iMemUsed+uSpaceNeeded <= m_iCacheSize;
 }
+
+//////////////////////////////////////////////////////////////////////////
+
+template <typename KEY, typename VALUE, typename HELPER, int SHARD_BITS>
+ShardedLRUCache_T<KEY,VALUE,HELPER,SHARD_BITS>::ShardedLRUCache_T ( int64_t iCacheSize )
+{
+	// max entry size is still derived from the whole cache size, so sharding doesn't change what is cacheable
+	for ( auto & pShard : m_dShards )
+		pShard = std::make_unique<Shard_t> ( iCacheSize/SHARDS, iCacheSize/64 );
+}
+
+template <typename KEY, typename VALUE, typename HELPER, int SHARD_BITS>
+template <typename COND>
+void ShardedLRUCache_T<KEY,VALUE,HELPER,SHARD_BITS>::Delete ( COND && fnCond )
+{
+	for ( auto & pShard : m_dShards )
+		pShard->Delete ( fnCond );
+}
+
+template <typename KEY, typename VALUE, typename HELPER, int SHARD_BITS>
+template <typename FN>
+void ShardedLRUCache_T<KEY,VALUE,HELPER,SHARD_BITS>::ForEach ( FN && fnAction )
+{
+	for ( auto & pShard : m_dShards )
+		pShard->ForEach ( fnAction );
+}
+
+template <typename KEY, typename VALUE, typename HELPER, int SHARD_BITS>
+LRUCacheStats_t ShardedLRUCache_T<KEY,VALUE,HELPER,SHARD_BITS>::GetStats()
+{
+	LRUCacheStats_t tStats;
+	for ( auto & pShard : m_dShards )
+	{
+		LRUCacheStats_t tShard = pShard->GetStats();
+		tStats.m_iMaxBytes += tShard.m_iMaxBytes;
+		tStats.m_iUsedBytes += tShard.m_iUsedBytes;
+		tStats.m_iEntries += tShard.m_iEntries;
+		tStats.m_iEvictions += tShard.m_iEvictions;
+		tStats.m_iContended += tShard.m_iContended;
+	}
+
+	return tStats;
+}
+
+template <typename KEY, typename VALUE, typename HELPER, int SHARD_BITS>
+typename ShardedLRUCache_T<KEY,VALUE,HELPER,SHARD_BITS>::Shard_t & ShardedLRUCache_T<KEY,VALUE,HELPER,SHARD_BITS>::GetShard ( const KEY & tKey ) const
+{
+	// shard by the high bits of the mixed hash; the low bits are used by the hash table inside the shard
+	DWORD uHash = HELPER::GetHash ( tKey ) * 0x9E3779B1;
+	return *m_dShards[uHash >> ( 32-SHARD_BITS )];
+}
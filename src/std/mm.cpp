@@ -108,6 +108,11 @@ void mmadvise ( void* pMem, size_t uSize, Advise_e eAdvise )
 #endif
 		);
 		break;
+	case Advise_e::WILLNEED:
+#ifdef MADV_WILLNEED
+		madvise ( pMem, uSize, MADV_WILLNEED );
+#endif
+		break;
 	}
 }
 
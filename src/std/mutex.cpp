@@ -51,6 +51,12 @@ bool CSphMutex::TimedLock ( int iMsec )
 	return ( uWait!=WAIT_FAILED && uWait!=WAIT_TIMEOUT );
 }
 
+bool CSphMutex::TryLock ()
+{
+	DWORD uWait = WaitForSingleObject ( m_tMutex, 0 );
+	return ( uWait!=WAIT_FAILED && uWait!=WAIT_TIMEOUT );
+}
+
 bool CSphMutex::Unlock ()
 {
 	return ReleaseMutex ( m_tMutex )==TRUE;
@@ -118,6 +124,11 @@ bool CSphMutex::TimedLock ( int iMsec )
 #endif
 }
 
+bool CSphMutex::TryLock ()
+{
+	return ( pthread_mutex_trylock ( &m_tMutex )==0 );
+}
+
 bool CSphMutex::Unlock ()
 {
 	return ( pthread_mutex_unlock ( &m_tMutex )==0 );
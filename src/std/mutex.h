@@ -34,6 +34,7 @@ public:
 	bool Lock() ACQUIRE();
 	bool Unlock() RELEASE();
 	bool TimedLock ( int iMsec ) TRY_ACQUIRE ( true );
+	bool TryLock() TRY_ACQUIRE ( true );
 
 	// Just for clang negative capabilities.
 	const CSphMutex& operator!() const { return *this; }